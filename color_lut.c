@@ -0,0 +1,198 @@
+#include "color_lut.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+//rgba in 0 to 255, one lane per channel
+typedef float v4sf __attribute__((vector_size(16)));
+
+static inline float clamp01(float x) {
+	return (x < 0) ? 0 : (x > 1 ? 1 : x);
+}
+
+//texel of node r, g, b
+static inline unsigned char *node(unsigned char *lut, int r, int g, int b) {
+	int x = (b % COLOR_LUT_TILES) * COLOR_LUT_SIZE + r;
+	int y = (b / COLOR_LUT_TILES) * COLOR_LUT_SIZE + g;
+	return lut + (y * COLOR_LUT_WIDTH + x) * 4;
+}
+
+static inline v4sf texel(const unsigned char *lut, int r, int g, int b) {
+	const unsigned char *p = node((unsigned char*) lut, r, g, b);
+	v4sf c = { p[0], p[1], p[2], p[3] };
+	return c;
+}
+
+//filtered fetch of slice b at x, y in nodes, 0 to 255
+static inline v4sf fetch(const unsigned char *lut, float x, float y, int b) {
+	const int max = COLOR_LUT_SIZE - 1;
+	int x0 = (int) x;
+	int y0 = (int) y;
+	int x1 = (x0 < max) ? x0 + 1 : max;
+	int y1 = (y0 < max) ? y0 + 1 : max;
+	float fx = x - x0;
+	float fy = y - y0;
+	v4sf top = texel(lut, x0, y0, b)
+			+ (texel(lut, x1, y0, b) - texel(lut, x0, y0, b)) * fx;
+	v4sf bottom = texel(lut, x0, y1, b)
+			+ (texel(lut, x1, y1, b) - texel(lut, x0, y1, b)) * fx;
+	return top + (bottom - top) * fy;
+}
+
+//the two fetches of the shaders mixed by blue, 0 to 255
+static inline v4sf lookup(const unsigned char *lut, float r, float g,
+		float b) {
+	const int max = COLOR_LUT_SIZE - 1;
+	float x = clamp01(r) * max;
+	float y = clamp01(g) * max;
+	float z = clamp01(b) * max;
+	int b0 = (int) z;
+	int b1 = (b0 < max) ? b0 + 1 : max;
+	v4sf c0 = fetch(lut, x, y, b0);
+	return c0 + (fetch(lut, x, y, b1) - c0) * (z - b0);
+}
+
+static unsigned char *lut_alloc() {
+	return malloc(COLOR_LUT_WIDTH * COLOR_LUT_WIDTH * 4);
+}
+
+unsigned char *color_lut_offset(float offset) {
+	unsigned char *lut = lut_alloc();
+	unsigned char level[COLOR_LUT_SIZE];
+	for (int i = 0; i < COLOR_LUT_SIZE; i++) {
+		float c = (float) i / (COLOR_LUT_SIZE - 1);
+		level[i] = (unsigned char) (clamp01((c - offset) / (1 - offset))
+				* 255.0f + 0.5f);
+	}
+	for (int b = 0; b < COLOR_LUT_SIZE; b++) {
+		for (int g = 0; g < COLOR_LUT_SIZE; g++) {
+			for (int r = 0; r < COLOR_LUT_SIZE; r++) {
+				unsigned char *p = node(lut, r, g, b);
+				p[0] = level[r];
+				p[1] = level[g];
+				p[2] = level[b];
+				p[3] = 255;
+			}
+		}
+	}
+	return lut;
+}
+
+//trilinear lookup of a .cube table of size^3 rgb, red fastest
+static void cube_sample(const float *table, int size, const float pos[3],
+		float out[3]) {
+	int i0[3], i1[3];
+	float f[3];
+	for (int c = 0; c < 3; c++) {
+		float x = fminf(fmaxf(pos[c], 0), size - 1);
+		i0[c] = (int) x;
+		i1[c] = (i0[c] < size - 1) ? i0[c] + 1 : i0[c];
+		f[c] = x - i0[c];
+	}
+	for (int c = 0; c < 3; c++) {
+		float v = 0;
+		for (int k = 0; k < 8; k++) {
+			int r = (k & 1) ? i1[0] : i0[0];
+			int g = (k & 2) ? i1[1] : i0[1];
+			int b = (k & 4) ? i1[2] : i0[2];
+			float w = ((k & 1) ? f[0] : 1 - f[0]) * ((k & 2) ? f[1] : 1 - f[1])
+					* ((k & 4) ? f[2] : 1 - f[2]);
+			v += w * table[((b * size + g) * size + r) * 3 + c];
+		}
+		out[c] = v;
+	}
+}
+
+unsigned char *color_lut_load_cube(const char *path) {
+	FILE *fp = fopen(path, "r");
+	if (fp == NULL) {
+		printf("can not open color lut %s\n", path);
+		return NULL;
+	}
+	char line[256];
+	int size = 0;
+	int num = 0;
+	float domain_min[3] = { 0, 0, 0 };
+	float domain_max[3] = { 1, 1, 1 };
+	float *table = NULL;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		float v[3];
+		if (line[0] == '#' || strncmp(line, "TITLE", 5) == 0) {
+			continue;
+		} else if (sscanf(line, "LUT_3D_SIZE %d", &size) == 1) {
+			if (size < 2 || size > 256 || table != NULL) {
+				break;
+			}
+			table = malloc(sizeof(float) * size * size * size * 3);
+		} else if (strncmp(line, "LUT_1D_SIZE", 11) == 0) {
+			printf("%s : 1D luts are not supported\n", path);
+			break;
+		} else if (sscanf(line, "DOMAIN_MIN %f %f %f", &v[0], &v[1], &v[2])
+				== 3) {
+			memcpy(domain_min, v, sizeof(v));
+		} else if (sscanf(line, "DOMAIN_MAX %f %f %f", &v[0], &v[1], &v[2])
+				== 3) {
+			memcpy(domain_max, v, sizeof(v));
+		} else if (sscanf(line, "%f %f %f", &v[0], &v[1], &v[2]) == 3) {
+			if (table == NULL || num >= size * size * size) {
+				num = -1;
+				break;
+			}
+			memcpy(table + num * 3, v, sizeof(v));
+			num++;
+		}
+	}
+	fclose(fp);
+	if (table == NULL || num != size * size * size) {
+		printf("%s : not a 3D .cube lut\n", path);
+		free(table);
+		return NULL;
+	}
+
+	unsigned char *lut = lut_alloc();
+	for (int b = 0; b < COLOR_LUT_SIZE; b++) {
+		for (int g = 0; g < COLOR_LUT_SIZE; g++) {
+			for (int r = 0; r < COLOR_LUT_SIZE; r++) {
+				int rgb[3] = { r, g, b };
+				float pos[3], out[3];
+				for (int c = 0; c < 3; c++) {
+					float in = (float) rgb[c] / (COLOR_LUT_SIZE - 1);
+					pos[c] = (in - domain_min[c])
+							/ (domain_max[c] - domain_min[c]) * (size - 1);
+				}
+				cube_sample(table, size, pos, out);
+				unsigned char *p = node(lut, r, g, b);
+				for (int c = 0; c < 3; c++) {
+					p[c] = (unsigned char) (clamp01(out[c]) * 255.0f + 0.5f);
+				}
+				p[3] = 255;
+			}
+		}
+	}
+	free(table);
+	printf("color lut %s, %d nodes per channel\n", path, size);
+	return lut;
+}
+
+void color_lut_grade(const unsigned char *lut, float rgb[3]) {
+	v4sf c = lookup(lut, rgb[0], rgb[1], rgb[2]) * (1.0f / 255);
+	for (int i = 0; i < 3; i++) {
+		rgb[i] = c[i];
+	}
+}
+
+void color_lut_apply(const unsigned char *lut, unsigned char *pixels,
+		int width, int height, int stride) {
+	const float scale = 1.0f / 255;
+	for (int y = 0; y < height; y++) {
+		unsigned char *p = pixels + y * stride;
+		for (int x = 0; x < width; x++, p += 4) {
+			v4sf c = lookup(lut, p[0] * scale, p[1] * scale, p[2] * scale)
+					+ 0.5f;
+			p[0] = (unsigned char) c[0];
+			p[1] = (unsigned char) c[1];
+			p[2] = (unsigned char) c[2];
+		}
+	}
+}
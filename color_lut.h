@@ -0,0 +1,37 @@
+#ifndef _COLOR_LUT_H
+#define _COLOR_LUT_H
+
+#define COLOR_LUT_SIZE 64 //nodes per channel
+#define COLOR_LUT_TILES 8 //slices of blue per row of the texture
+#define COLOR_LUT_WIDTH (COLOR_LUT_SIZE * COLOR_LUT_TILES) //and height
+#define COLOR_LUT_OFFSET 0.15 //the grading the shaders had built in
+
+/**
+ * Colour grading by a 3D lookup table, as a 2D RGBA texture of
+ * COLOR_LUT_WIDTH squared the shaders sample once per pixel: slice b of
+ * blue is the COLOR_LUT_SIZE squared tile b % COLOR_LUT_TILES across and
+ * b / COLOR_LUT_TILES down, red along x and green along y in it. Red and
+ * green are interpolated by the texture filter, blue by mixing fetches of
+ * the two nearest slices, so smooth gradients stay smooth in every channel.
+ */
+
+/**
+ * The table of an Adobe / Resolve .cube file resampled to the texture,
+ * NULL if it can not be read. 1D tables are not supported.
+ */
+unsigned char *color_lut_load_cube(const char *path);
+
+/* (c - offset) / (1 - offset) per channel, the grading of old */
+unsigned char *color_lut_offset(float offset);
+
+/* one colour, rgb in 0 to 1 and clamped, as the shaders look it up */
+void color_lut_grade(const unsigned char *lut, float rgb[3]);
+
+/**
+ * CPU grading of RGBA images for the offline paths, the lookup of the
+ * shaders on four lanes per pixel. Alpha is kept.
+ */
+void color_lut_apply(const unsigned char *lut, unsigned char *pixels,
+		int width, int height, int stride);
+
+#endif
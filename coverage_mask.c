@@ -0,0 +1,364 @@
+#include "coverage_mask.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.141592654
+#endif
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+//radii from the camera axis the shaders switch at, see equirectangular.frag
+#define LOGO_R 0.65
+#define OVERLAP 0.03
+//r over a block is bounded from 3 x 3 samples, the spread of the samples
+//is widened for the parts of the block between them
+#define SAMPLE_SPREAD 1.25
+#define SAMPLE_INSET 0.001 //of a cell, keeps the samples off the cube edges
+#define MARGIN 0.01 //of r, the interpolated directions fall a little short
+//largest slope of the radius the shaders remap r to, pow(x, 1.2)
+#define REMAP_SLOPE 1.2
+//a view within COVERAGE_MASK_SLACK on rows x and y of unif_matrix moves no
+//direction by more than sqrt(6) of it
+#define TURN_SLACK 2.5
+
+typedef struct {
+	int columns; //cells
+	int rows;
+	int block_x; //cells classified together
+	int block_y;
+	//direction at x, y of the grid, 0 to columns and rows
+	void (*direction)(const void *arg, float x, float y, float dir[3]);
+	//the vertex of the mesh at x, y, on the grid
+	void (*vertex)(const void *arg, float x, float y, float v[4]);
+	const void *arg;
+	//cells of a class put together, the mesh is flat so any rect of
+	//cells is a quad
+	bool merge;
+} GRID_T;
+
+typedef struct {
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+	int c; //enum COVERAGE_CLASS
+} RECT_T;
+
+typedef struct {
+	enum CPU_REMAP_MODE mode;
+	int columns;
+	int rows;
+} BOARD_T;
+
+typedef struct {
+	float tan_x;
+	float tan_y;
+	float step_x;
+	float step_y;
+} WINDOW_T;
+
+static void board_direction(const void *arg, float x, float y, float dir[3]) {
+	const BOARD_T *board = arg;
+	//the board quad is the viewport flipped, see equirectangular.vert
+	cpu_remap_direction(board->mode, 1.0f - x / board->columns,
+			1.0f - y / board->rows, dir);
+}
+
+static void board_vertex(const void *arg, float x, float y, float v[4]) {
+	const BOARD_T *board = arg;
+	v[0] = x / board->columns;
+	v[1] = y / board->rows;
+	v[2] = 1.0f;
+	v[3] = 1.0f;
+}
+
+//as window_mesh_build()
+static void window_vertex(const void *arg, float x, float y, float v[4]) {
+	const WINDOW_T *window = arg;
+	float tx = -window->tan_x + window->step_x * x;
+	float ty = -window->tan_y + window->step_y * y;
+	float len = sqrt(tx * tx + ty * ty + 1.0);
+	v[0] = tx / len;
+	v[1] = ty / len;
+	v[2] = 1.0 / len;
+	v[3] = 1.0f;
+}
+
+static void window_direction(const void *arg, float x, float y, float dir[3]) {
+	float v[4];
+	window_vertex(arg, x, y, v);
+	memcpy(dir, v, sizeof(float) * 3);
+}
+
+static float dot(const float a[3], const float b[3]) {
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+//radius of the camera image the shaders take r to, never more than r
+static float remapped(float r, int num_of_cam) {
+	if (num_of_cam == 1) {
+		if (r >= 0.55) {
+			return powf(r - 0.55, 1.2) + powf(0.05, 1.1) + powf(0.10, 1.09)
+					+ 0.4;
+		} else if (r >= 0.50) {
+			return powf(r - 0.50, 1.1) + powf(0.10, 1.09) + 0.4;
+		}
+	}
+	if (r >= 0.40) {
+		return powf(r - 0.4, 1.09) + 0.4;
+	}
+	return r;
+}
+
+/**
+ * Whether every fragment within rho radians of pos, in camera coordinates,
+ * takes its texel of camera from off the image, as the u and v the shaders
+ * test. cam1 looks the other way.
+ */
+static bool off_image(const COVERAGE_CAMERA_T *camera, bool cam1,
+		int num_of_cam, const float pos[3], float rho) {
+	float r = acosf(fmaxf(fminf(pos[1], 1.0f), -1.0f)) / M_PI;
+	float yaw = atan2f(pos[0], pos[2]);
+	if (cam1) {
+		r = 1.0f - r;
+		yaw = -yaw;
+	}
+	float r_max = r + rho / M_PI;
+	if (r_max >= 0.9) {
+		return false; //the turn about the axis is unbounded at the far pole
+	}
+	float f = camera->horizon_r * remapped(r, num_of_cam);
+	float yaw2 = yaw + M_PI + camera->offset_yaw;
+	float u = f * cosf(yaw2) + 0.5 + camera->offset_x;
+	float v = f * sinf(yaw2) + 0.5 - camera->offset_y;
+	//image per radian, the remapped radius grows by at most REMAP_SLOPE / pi,
+	//around the axis by remapped(r) / sin(pi r) <= r / sin(pi r)
+	float scale = camera->horizon_r
+			* fmaxf(REMAP_SLOPE / M_PI, r_max / sinf(M_PI * r_max));
+	float du = fmaxf(fmaxf(-u, u - 1.0f), 0.0f);
+	float dv = fmaxf(fmaxf(-v, v - 1.0f), 0.0f);
+	return sqrtf(du * du + dv * dv)
+			> scale * rho + MARGIN * camera->horizon_r;
+}
+
+//each cell a rect of its own
+static int cells(const unsigned char *classes, int columns, int rows,
+		RECT_T *rects) {
+	int n = 0;
+	for (int j = 0; j < rows; j++) {
+		for (int i = 0; i < columns; i++) {
+			RECT_T r = { i, j, i + 1, j + 1, classes[j * columns + i] };
+			rects[n++] = r;
+		}
+	}
+	return n;
+}
+
+//the cells in rects as wide as they go, then as high, a few quads instead
+//of a pair of triangles per cell whose edges would be shaded twice
+static int merge(unsigned char *classes, int columns, int rows,
+		RECT_T *rects) {
+	const unsigned char done = COVERAGE_CLASS_NUM;
+	int n = 0;
+	for (int j = 0; j < rows; j++) {
+		for (int i = 0; i < columns; i++) {
+			unsigned char *row = classes + j * columns;
+			int c = row[i];
+			if (c == done) {
+				continue;
+			}
+			int x1 = i + 1;
+			while (x1 < columns && row[x1] == c) {
+				x1++;
+			}
+			int y1 = j + 1;
+			for (; y1 < rows; y1++) {
+				const unsigned char *next = classes + y1 * columns;
+				int x = i;
+				while (x < x1 && next[x] == c) {
+					x++;
+				}
+				if (x < x1) {
+					break;
+				}
+			}
+			for (int y = j; y < y1; y++) {
+				memset(classes + y * columns + i, done, x1 - i);
+			}
+			RECT_T r = { i, j, x1, y1, c };
+			rects[n++] = r;
+		}
+	}
+	return n;
+}
+
+//the cells from x0, y0 to x1, y1 of the grid, rows those of unif_matrix
+static enum COVERAGE_CLASS classify(const GRID_T *grid, int num_of_cam,
+		const COVERAGE_CAMERA_T *cameras, const float rows[3][3], int x0,
+		int y0, int x1, int y1) {
+	float center[3];
+	grid->direction(grid->arg, (x0 + x1) / 2.0f, (y0 + y1) / 2.0f, center);
+	float spread = 0; //radians
+	for (int a = 0; a < 3; a++) {
+		for (int b = 0; b < 3; b++) {
+			float x = x0 + SAMPLE_INSET
+					+ (x1 - x0 - 2 * SAMPLE_INSET) * a / 2.0f;
+			float y = y0 + SAMPLE_INSET
+					+ (y1 - y0 - 2 * SAMPLE_INSET) * b / 2.0f;
+			float dir[3];
+			grid->direction(grid->arg, x, y, dir);
+			spread = fmaxf(spread, acosf(fminf(dot(center, dir), 1.0f)));
+		}
+	}
+	//pos of the shaders
+	float pos[3] = { dot(rows[0], center), dot(rows[1], center), dot(rows[2],
+			center) };
+	//r of the shaders, 0 on the axis of cam0 or the camera to 1
+	float r = acosf(fmaxf(fminf(pos[1], 1.0f), -1.0f)) / M_PI;
+	float d = (spread * SAMPLE_SPREAD + COVERAGE_MASK_SLACK) / M_PI + MARGIN;
+	//how far from center a fragment of the cells can be over the views the
+	//mask holds for
+	float rho = spread * SAMPLE_SPREAD + TURN_SLACK * COVERAGE_MASK_SLACK;
+	if (num_of_cam == 1) {
+		if (r - d > LOGO_R) {
+			return COVERAGE_LOGO;
+		} else if (r + d < LOGO_R) {
+			return (cameras != NULL && off_image(&cameras[0], false, 1, pos,
+					rho)) ? COVERAGE_BLACK : COVERAGE_CAM0;
+		}
+	} else {
+		//each camera the cells may take a texel of is off its image
+		bool cam0 = (r - d < 0.5 + OVERLAP);
+		bool cam1 = (r + d > 0.5 - OVERLAP);
+		if (cameras != NULL
+				&& (!cam0 || off_image(&cameras[0], false, 2, pos, rho))
+				&& (!cam1 || off_image(&cameras[1], true, 2, pos, rho))) {
+			return COVERAGE_BLACK;
+		}
+		if (r + d < 0.5 - OVERLAP) {
+			return COVERAGE_CAM0;
+		} else if (r - d > 0.5 + OVERLAP) {
+			return COVERAGE_CAM1;
+		}
+	}
+	return COVERAGE_FULL;
+}
+
+static int build(COVERAGE_MASK_T *mask, const GRID_T *grid, int num_of_cam,
+		const COVERAGE_CAMERA_T *cameras, const float unif_matrix[16]) {
+	memset(mask, 0, sizeof(COVERAGE_MASK_T));
+	float rows[3][3];
+	for (int j = 0; j < 3; j++) {
+		for (int i = 0; i < 3; i++) {
+			rows[j][i] = unif_matrix[j + 4 * i];
+		}
+	}
+	memcpy(mask->axis, rows[1], sizeof(mask->axis));
+	memcpy(mask->turn, rows[0], sizeof(mask->turn));
+
+	int num_cells = grid->columns * grid->rows;
+	unsigned char *classes = malloc(num_cells);
+	RECT_T *rects = malloc(sizeof(RECT_T) * num_cells);
+	if (classes == NULL || rects == NULL) {
+		free(classes);
+		free(rects);
+		return -1;
+	}
+	int count[COVERAGE_CLASS_NUM] = { };
+	for (int y0 = 0; y0 < grid->rows; y0 += grid->block_y) {
+		for (int x0 = 0; x0 < grid->columns; x0 += grid->block_x) {
+			int x1 = MIN(x0 + grid->block_x, grid->columns);
+			int y1 = MIN(y0 + grid->block_y, grid->rows);
+			enum COVERAGE_CLASS c = classify(grid, num_of_cam, cameras, rows,
+					x0, y0, x1, y1);
+			for (int j = y0; j < y1; j++) {
+				memset(classes + j * grid->columns + x0, c, x1 - x0);
+			}
+			count[c] += (x1 - x0) * (y1 - y0);
+		}
+	}
+	int num_rects = (grid->merge) ?
+			merge(classes, grid->columns, grid->rows, rects) :
+			cells(classes, grid->columns, grid->rows, rects);
+	free(classes);
+
+	int num_quads[COVERAGE_CLASS_NUM] = { };
+	for (int i = 0; i < num_rects; i++) {
+		num_quads[rects[i].c]++;
+	}
+	for (int c = 0; c < COVERAGE_CLASS_NUM; c++) {
+		mask->area[c] = (float) count[c] / num_cells;
+		if (num_quads[c] == 0) {
+			continue;
+		}
+		mask->vertices[c] = malloc(sizeof(float) * 4 * 6 * num_quads[c]);
+		if (mask->vertices[c] == NULL) {
+			free(rects);
+			coverage_mask_free(mask);
+			return -1;
+		}
+	}
+	for (int i = 0; i < num_rects; i++) {
+		const RECT_T *r = &rects[i];
+		float *v = mask->vertices[r->c] + mask->num_vertices[r->c] * 4;
+		//the two triangles facing as in the strips they are cut from, which
+		//are culled
+		grid->vertex(grid->arg, r->x0, r->y0, v);
+		grid->vertex(grid->arg, r->x1, r->y0, v + 4);
+		grid->vertex(grid->arg, r->x0, r->y1, v + 8);
+		grid->vertex(grid->arg, r->x0, r->y1, v + 12);
+		grid->vertex(grid->arg, r->x1, r->y0, v + 16);
+		grid->vertex(grid->arg, r->x1, r->y1, v + 20);
+		mask->num_vertices[r->c] += 6;
+	}
+	free(rects);
+	return 0;
+}
+
+int coverage_mask_board(COVERAGE_MASK_T *mask, enum CPU_REMAP_MODE mode,
+		int num_of_cam, const COVERAGE_CAMERA_T *cameras,
+		const float unif_matrix[16], int width, int height) {
+	//the directions jump between faces, no cell may take in two
+	bool cube = (mode == CPU_REMAP_CUBEMAP || mode == CPU_REMAP_EAC);
+	int faces_x = cube ? 3 : 1;
+	int faces_y = cube ? 2 : 1;
+	BOARD_T board = { mode };
+	board.columns = (width + COVERAGE_MASK_TILE * faces_x - 1)
+			/ (COVERAGE_MASK_TILE * faces_x) * faces_x;
+	board.rows = (height + COVERAGE_MASK_TILE * faces_y - 1)
+			/ (COVERAGE_MASK_TILE * faces_y) * faces_y;
+	GRID_T grid = { board.columns, board.rows, 1, 1, board_direction,
+			board_vertex, &board, true };
+	return build(mask, &grid, num_of_cam, cameras, unif_matrix);
+}
+
+int coverage_mask_window(COVERAGE_MASK_T *mask, int num_of_cam,
+		const COVERAGE_CAMERA_T *cameras, const float unif_matrix[16],
+		float tan_x, float tan_y, int steps, int width, int height) {
+	WINDOW_T window = { tan_x, tan_y, 2 * tan_x / steps, 2 * tan_y / steps };
+	GRID_T grid = { steps, steps, MAX(1, steps * COVERAGE_MASK_TILE / width),
+			MAX(1, steps * COVERAGE_MASK_TILE / height), window_direction,
+			window_vertex, &window, false };
+	return build(mask, &grid, num_of_cam, cameras, unif_matrix);
+}
+
+bool coverage_mask_holds(const COVERAGE_MASK_T *mask,
+		const float unif_matrix[16]) {
+	float axis[3] = { unif_matrix[1], unif_matrix[5], unif_matrix[9] };
+	float turn[3] = { unif_matrix[0], unif_matrix[4], unif_matrix[8] };
+	if (acosf(fminf(dot(mask->axis, axis), 1.0f)) >= COVERAGE_MASK_SLACK) {
+		return false;
+	}
+	//the black cells turn with the view about the axis
+	return mask->area[COVERAGE_BLACK] == 0
+			|| acosf(fminf(dot(mask->turn, turn), 1.0f)) < COVERAGE_MASK_SLACK;
+}
+
+void coverage_mask_free(COVERAGE_MASK_T *mask) {
+	for (int c = 0; c < COVERAGE_CLASS_NUM; c++) {
+		free(mask->vertices[c]);
+		mask->vertices[c] = NULL;
+	}
+}
@@ -0,0 +1,78 @@
+#ifndef _COVERAGE_MASK_H
+#define _COVERAGE_MASK_H
+
+#include "cpu_remap.h"
+
+#define COVERAGE_MASK_TILE 32 //pixels, cells of the full sphere frames
+//radians the camera axis may move by before a mask has to be made again
+#define COVERAGE_MASK_SLACK 0.05
+
+/**
+ * What the fragments of a frame can end up showing, found per cell of the
+ * frame for a view (unif_matrix) so the cells that only show one thing are
+ * drawn by a variant of the plain shaders that only does that: one camera
+ * inside the logo circle, one of two cameras away from the blend band, the
+ * logo, nothing but black. The rest are drawn as before.
+ * The camera classes only look at the radius from the camera axis, turning
+ * the view about the axis changes nothing for them. The cells that fall off
+ * the camera images, which the shaders draw black, are found from where
+ * their camera texels would be, if the cameras are given. Those depend on
+ * the whole view: a mask without black cells holds while the axis is
+ * within COVERAGE_MASK_SLACK of where it was, one with black cells while
+ * the view is.
+ */
+enum COVERAGE_CLASS {
+	COVERAGE_FULL,
+	COVERAGE_CAM0, //cam0 or the one camera, ONLY_CAM0
+	COVERAGE_CAM1, //cam1, ONLY_CAM1
+	COVERAGE_LOGO, //ONLY_LOGO
+	COVERAGE_BLACK, //off the camera images, ONLY_BLACK
+	COVERAGE_CLASS_NUM
+};
+
+//calibration of a camera as the shaders take it
+typedef struct {
+	float offset_yaw;
+	float offset_x;
+	float offset_y;
+	float horizon_r;
+} COVERAGE_CAMERA_T;
+
+typedef struct {
+	//cells of each class as GL_TRIANGLES, 4 floats a vertex as the meshes
+	//they are cut from, NULL if none
+	float *vertices[COVERAGE_CLASS_NUM];
+	int num_vertices[COVERAGE_CLASS_NUM];
+	float area[COVERAGE_CLASS_NUM]; //fraction of the frame
+	float axis[3]; //of cam0 or the camera in the frame, row y of unif_matrix
+	float turn[3]; //row x of unif_matrix, held too if there are black cells
+} COVERAGE_MASK_T;
+
+/**
+ * Cells of about COVERAGE_MASK_TILE pixels of a width x height frame drawn
+ * with the board quad, mode EQUIRECTANGULAR, CUBEMAP or EAC, the cells of a
+ * cubemap within a face. cameras, num_of_cam of them, NULL to leave the
+ * black cells in the other classes. Returns 0, -1 if out of memory.
+ */
+int coverage_mask_board(COVERAGE_MASK_T *mask, enum CPU_REMAP_MODE mode,
+		int num_of_cam, const COVERAGE_CAMERA_T *cameras,
+		const float unif_matrix[16], int width, int height);
+
+/**
+ * Cells of the window mesh of window_mesh_build() for a width x height
+ * frame, classified in blocks of about COVERAGE_MASK_TILE pixels. The
+ * window shader of one camera clamps to the image edge instead of drawing
+ * black, cameras is NULL for it.
+ */
+int coverage_mask_window(COVERAGE_MASK_T *mask, int num_of_cam,
+		const COVERAGE_CAMERA_T *cameras, const float unif_matrix[16],
+		float tan_x, float tan_y, int steps, int width, int height);
+
+/* whether mask still holds for a view of unif_matrix */
+bool coverage_mask_holds(const COVERAGE_MASK_T *mask,
+		const float unif_matrix[16]);
+
+/* frees the vertices, the rest of mask stays */
+void coverage_mask_free(COVERAGE_MASK_T *mask);
+
+#endif
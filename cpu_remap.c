@@ -0,0 +1,464 @@
+#include "cpu_remap.h"
+#include "window_mesh.h" //the extent of the patch WINDOW frames are drawn with
+#include "color_lut.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#ifndef M_PI
+#define M_PI 3.141592654
+#endif
+
+#define SHADER_PI 3.1415926535f //M_PI of the shaders
+#define OVERLAP 0.03f
+
+//rgba in 0 to 1, one lane per channel
+typedef float v4sf __attribute__((vector_size(16)));
+
+struct _CPU_REMAP_T {
+	pthread_mutex_t call_mutex; //one cpu_remap() at a time
+	pthread_mutex_t mutex;
+	pthread_cond_t cond; //a frame was started
+	pthread_cond_t done_cond; //a tile was finished
+	bool stop;
+	uint32_t frame_seq;
+	const CPU_REMAP_PARAMS_T *params;
+	unsigned char *dst;
+	int width;
+	int height;
+	int stride;
+	int next_tile;
+	int num_tiles;
+	int tiles_done;
+	int num_threads;
+	pthread_t thread[CPU_REMAP_MAX_THREADS];
+};
+
+//per frame constants of the shaders
+typedef struct {
+	const CPU_REMAP_PARAMS_T *p;
+	int width;
+	int height;
+	float pixel_size;
+	float scale; //WINDOW
+	float aspect_ratio;
+	float mesh_limit; //tan of half the window mesh fov
+	const CPU_REMAP_IMAGE_T *cam; //the active camera
+	const CPU_REMAP_CAMERA_T *opt;
+} CONTEXT_T;
+
+static const v4sf lg_black = { 0, 0, 0, 1 };
+
+static inline v4sf texel(const CPU_REMAP_IMAGE_T *img, int x, int y) {
+	const unsigned char *p = img->pixels + y * img->stride + x * 4;
+	v4sf c = { p[0], p[1], p[2], p[3] };
+	return c * (1.0f / 255);
+}
+
+static inline int clamp_int(int v, int max) {
+	return (v < 0) ? 0 : (v > max ? max : v);
+}
+
+static inline int wrap_int(int v, int size) {
+	v %= size;
+	return (v < 0) ? v + size : v;
+}
+
+//texture2D() of a CLAMP_TO_EDGE camera texture
+static v4sf sample_cam(const CONTEXT_T *ctx, const CPU_REMAP_IMAGE_T *img,
+		float u, float v) {
+	if (ctx->p->filter == CPU_REMAP_NEAREST) {
+		return texel(img, clamp_int((int) floorf(u * img->width),
+				img->width - 1), clamp_int((int) floorf(v * img->height),
+				img->height - 1));
+	}
+	float x = u * img->width - 0.5f;
+	float y = v * img->height - 0.5f;
+	float x0f = floorf(x);
+	float y0f = floorf(y);
+	float fx = x - x0f;
+	float fy = y - y0f;
+	int x0 = clamp_int((int) x0f, img->width - 1);
+	int x1 = clamp_int((int) x0f + 1, img->width - 1);
+	int y0 = clamp_int((int) y0f, img->height - 1);
+	int y1 = clamp_int((int) y0f + 1, img->height - 1);
+	v4sf top = texel(img, x0, y0)
+			+ (texel(img, x1, y0) - texel(img, x0, y0)) * fx;
+	v4sf bottom = texel(img, x0, y1)
+			+ (texel(img, x1, y1) - texel(img, x0, y1)) * fx;
+	return top + (bottom - top) * fy;
+}
+
+//texture2D() of the logo, LINEAR and REPEAT as load_texture() sets it
+static v4sf sample_logo(const CONTEXT_T *ctx, float u, float v) {
+	const CPU_REMAP_IMAGE_T *img = &ctx->p->logo;
+	if (img->pixels == NULL) {
+		return lg_black;
+	}
+	float x = u * img->width - 0.5f;
+	float y = v * img->height - 0.5f;
+	float x0f = floorf(x);
+	float y0f = floorf(y);
+	float fx = x - x0f;
+	float fy = y - y0f;
+	int x0 = wrap_int((int) x0f, img->width);
+	int x1 = wrap_int((int) x0f + 1, img->width);
+	int y0 = wrap_int((int) y0f, img->height);
+	int y1 = wrap_int((int) y0f + 1, img->height);
+	v4sf top = texel(img, x0, y0)
+			+ (texel(img, x1, y0) - texel(img, x0, y0)) * fx;
+	v4sf bottom = texel(img, x0, y1)
+			+ (texel(img, x1, y1) - texel(img, x0, y1)) * fx;
+	return top + (bottom - top) * fy;
+}
+
+//the sharpness block every shader has
+static v4sf sharpen(const CONTEXT_T *ctx, const CPU_REMAP_IMAGE_T *img,
+		float u, float v, float gain) {
+	if (ctx->p->sharpness_gain == 0.0f) {
+		return sample_cam(ctx, img, u, v);
+	}
+	float ps = ctx->pixel_size;
+	v4sf fc = sample_cam(ctx, img, u, v) * (1.0f + 4.0f * gain);
+	fc -= sample_cam(ctx, img, u - ps, v) * gain;
+	fc -= sample_cam(ctx, img, u, v - ps) * gain;
+	fc -= sample_cam(ctx, img, u, v + ps) * gain;
+	fc -= sample_cam(ctx, img, u + ps, v) * gain;
+	return fc;
+}
+
+//graded() of the shaders
+static inline v4sf graded(const CONTEXT_T *ctx, v4sf fc) {
+	if (ctx->p->color_lut == NULL) {
+		return fc;
+	}
+	float rgb[3] = { fc[0], fc[1], fc[2] };
+	color_lut_grade(ctx->p->color_lut, rgb);
+	v4sf c = { rgb[0], rgb[1], rgb[2], fc[3] };
+	return c;
+}
+
+static inline bool out_of_texture(float u, float v) {
+	return (u <= 0.0f || u > 1.0f || v <= 0.0f || v > 1.0f);
+}
+
+//window.frag and equirectangular.frag
+static v4sf fisheye_one(const CONTEXT_T *ctx, const float pos[3],
+		bool equirect) {
+	const CPU_REMAP_CAMERA_T *opt = ctx->opt;
+	float pitch = asinf(fminf(fmaxf(pos[1], -1.0f), 1.0f));
+	float yaw = atan2f(pos[0], pos[2]);
+	float r = (SHADER_PI / 2.0f - pitch) / SHADER_PI;
+	if (r > 0.65f) {
+		float yaw2 = -yaw;
+		r = (1.0f - r) / 0.35f * 0.5f;
+		return sample_logo(ctx, r * cosf(yaw2) + 0.5f, r * sinf(yaw2) + 0.5f);
+	} else if (r >= 0.55f) {
+		r = powf(r - 0.55f, 1.2f) + powf(0.05f, 1.1f) + powf(0.10f, 1.09f)
+				+ 0.4f;
+	} else if (r >= 0.50f) {
+		r = powf(r - 0.50f, 1.1f) + powf(0.10f, 1.09f) + 0.4f;
+	} else if (r >= 0.40f) {
+		r = powf(r - 0.4f, 1.09f) + 0.4f;
+	}
+
+	float yaw2 = yaw + SHADER_PI + opt->offset_yaw;
+	float cos_yaw2 = cosf(yaw2);
+	float sin_yaw2 = sinf(yaw2);
+	float u = opt->horizon_r * r * cos_yaw2 + 0.5f + opt->offset_x;
+	float v = opt->horizon_r * r * sin_yaw2 + 0.5f - opt->offset_y;
+	if (equirect && out_of_texture(u, v)) {
+		return lg_black;
+	}
+	v4sf fc = sharpen(ctx, ctx->cam, u, v,
+			ctx->p->sharpness_gain + (equirect ? r : r / 2.0f));
+	if (r >= 0.45f) {
+		float r_r = powf(r - 0.45f, 1.015f) + 0.45f;
+		u = opt->horizon_r * r_r * cos_yaw2 + 0.5f + opt->offset_x;
+		v = opt->horizon_r * r_r * sin_yaw2 + 0.5f - opt->offset_y;
+		v4sf fc_b = sample_cam(ctx, ctx->cam, u, v);
+		fc[2] = fc_b[2];
+
+		r_r = powf(r - 0.45f, 1.0075f) + 0.45f;
+		u = opt->horizon_r * r_r * cos_yaw2 + 0.5f + opt->offset_x;
+		v = opt->horizon_r * r_r * sin_yaw2 + 0.5f - opt->offset_y;
+		fc_b = sample_cam(ctx, ctx->cam, u, v);
+		fc[1] = fc_b[1];
+	}
+	return graded(ctx, fc);
+}
+
+//window.frag and equirectangular.frag with TWO_CAMERAS
+static v4sf fisheye_two(const CONTEXT_T *ctx, const float pos[3],
+		bool equirect) {
+	const CPU_REMAP_PARAMS_T *p = ctx->p;
+	float pitch = asinf(fminf(fmaxf(pos[1], -1.0f), 1.0f));
+	float yaw = atan2f(pos[0], pos[2]);
+	float r = (SHADER_PI / 2.0f - pitch) / SHADER_PI;
+	v4sf fc0 = lg_black;
+	v4sf fc1 = lg_black;
+	if (r < 0.5f + OVERLAP) {
+		const CPU_REMAP_CAMERA_T *opt = &p->cam_options[0];
+		float r2 = r;
+		if (r2 >= 0.40f) {
+			r2 = powf(r2 - 0.4f, 1.09f) + 0.4f;
+		}
+		float yaw2 = yaw + SHADER_PI + opt->offset_yaw;
+		float u = opt->horizon_r * r2 * cosf(yaw2) + 0.5f + opt->offset_x;
+		float v = opt->horizon_r * r2 * sinf(yaw2) + 0.5f - opt->offset_y;
+		if (!out_of_texture(u, v)) {
+			fc0 = sharpen(ctx, &p->cam[0], u, v,
+					p->sharpness_gain + (equirect ? r2 : r));
+		}
+	}
+	if (r > 0.5f - OVERLAP) {
+		const CPU_REMAP_CAMERA_T *opt = &p->cam_options[1];
+		float r2 = 1.0f - r;
+		if (r2 >= 0.40f) {
+			r2 = powf(r2 - 0.4f, 1.09f) + 0.4f;
+		}
+		float yaw2 = -yaw + SHADER_PI + opt->offset_yaw;
+		float u = opt->horizon_r * r2 * cosf(yaw2) + 0.5f + opt->offset_x;
+		float v = opt->horizon_r * r2 * sinf(yaw2) + 0.5f - opt->offset_y;
+		if (!out_of_texture(u, v)) {
+			fc1 = sharpen(ctx, &p->cam[1], u, v, p->sharpness_gain + r2);
+		}
+	}
+	if (r < 0.5f - OVERLAP) {
+		return graded(ctx, fc0);
+	} else if (r < 0.5f + OVERLAP) {
+		return graded(ctx,
+				(fc0 * ((0.5f + OVERLAP) - r) + fc1 * (r - (0.5f - OVERLAP)))
+						/ (OVERLAP * 2.0f));
+	} else {
+		return graded(ctx, fc1);
+	}
+}
+
+//column major like the uniform
+static void rotate(const float m[16], const float in[3], float out[3]) {
+	for (int i = 0; i < 3; i++) {
+		out[i] = m[i] * in[0] + m[4 + i] * in[1] + m[8 + i] * in[2]
+				+ m[12 + i];
+	}
+}
+
+//cube_direction() of cubemap.frag, x and y from the top left of the image
+static void cube_direction(float x, float y, bool equi_angular,
+		float dir[3]) {
+	float px = x * 3.0f, py = y * 2.0f;
+	int fx = (px < 1.0f) ? 0 : (px < 2.0f ? 1 : 2);
+	int fy = (py < 1.0f) ? 0 : 1;
+	float a = (px - fx) * 2.0f - 1.0f;
+	float b = (py - fy) * 2.0f - 1.0f;
+	if (equi_angular) {
+		a = tanf(a * (SHADER_PI / 4.0f));
+		b = tanf(b * (SHADER_PI / 4.0f));
+	}
+	static const float faces[6][3][3] = { //center, right, down
+			{ { 1, 0, 0 }, { 0, 0, 1 }, { 0, -1, 0 } }, //left
+			{ { 0, 0, 1 }, { -1, 0, 0 }, { 0, -1, 0 } }, //front
+			{ { -1, 0, 0 }, { 0, 0, -1 }, { 0, -1, 0 } }, //right
+			{ { 0, -1, 0 }, { 0, 0, -1 }, { 1, 0, 0 } }, //bottom
+			{ { 0, 0, -1 }, { 0, 1, 0 }, { 1, 0, 0 } }, //back
+			{ { 0, 1, 0 }, { 0, 0, 1 }, { 1, 0, 0 } } }; //top
+	const float (*f)[3] = faces[fy * 3 + fx];
+	float len = sqrtf(1.0f + a * a + b * b);
+	for (int i = 0; i < 3; i++) {
+		dir[i] = (f[0][i] + a * f[1][i] + b * f[2][i]) / len;
+	}
+}
+
+void cpu_remap_direction(enum CPU_REMAP_MODE mode, float x, float y,
+		float dir[3]) {
+	if (mode == CPU_REMAP_EQUIRECTANGULAR) {
+		//equirectangular.vert flips tcoord
+		float tx = 1.0f - x;
+		float ty = 1.0f - y;
+		float pitch_orig = -SHADER_PI / 2.0f + SHADER_PI * ty;
+		float yaw_orig = 2.0f * SHADER_PI * tx - SHADER_PI;
+		dir[0] = cosf(pitch_orig) * sinf(yaw_orig);
+		dir[1] = sinf(pitch_orig);
+		dir[2] = cosf(pitch_orig) * cosf(yaw_orig);
+	} else {
+		//the viewport is the image upside down, x and y from its top left
+		cube_direction(x, y, mode == CPU_REMAP_EAC, dir);
+	}
+}
+
+//the pixel at x, y of the viewport, from 0 to 1
+static v4sf shade(const CONTEXT_T *ctx, float x, float y) {
+	const CPU_REMAP_PARAMS_T *p = ctx->p;
+	switch (p->mode) {
+	case CPU_REMAP_BOARD:
+		return sample_logo(ctx, x, 1.0f - y);
+	case CPU_REMAP_FISHEYE:
+		return sharpen(ctx, ctx->cam, x + ctx->opt->offset_x,
+				y - ctx->opt->offset_y, p->sharpness_gain);
+	case CPU_REMAP_WINDOW: {
+		//inverse of window.vert, black where the mesh does not reach
+		float dir[3] = { -(x * 2.0f - 1.0f) / ctx->scale, -(y * 2.0f - 1.0f)
+				/ (ctx->scale * ctx->aspect_ratio), 1.0f };
+		if (fabsf(dir[0]) > ctx->mesh_limit
+				|| fabsf(dir[1]) > ctx->mesh_limit) {
+			return lg_black;
+		}
+		float len = sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + 1.0f);
+		float pos[3];
+		for (int i = 0; i < 3; i++) {
+			dir[i] /= len;
+		}
+		rotate(p->unif_matrix, dir, pos);
+		return (p->num_of_cam == 1) ?
+				fisheye_one(ctx, pos, false) : fisheye_two(ctx, pos, false);
+	}
+	case CPU_REMAP_EQUIRECTANGULAR:
+	case CPU_REMAP_CUBEMAP:
+	case CPU_REMAP_EAC: {
+		float dir[3], pos[3];
+		cpu_remap_direction(p->mode, x, y, dir);
+		rotate(p->unif_matrix, dir, pos);
+		return (p->num_of_cam == 1) ?
+				fisheye_one(ctx, pos, true) : fisheye_two(ctx, pos, true);
+	}
+	}
+	return lg_black;
+}
+
+static void draw_tile(const CONTEXT_T *ctx, unsigned char *dst, int stride,
+		int tile) {
+	int y_end = (tile + 1) * CPU_REMAP_TILE_ROWS;
+	if (y_end > ctx->height) {
+		y_end = ctx->height;
+	}
+	for (int y = tile * CPU_REMAP_TILE_ROWS; y < y_end; y++) {
+		unsigned char *out = dst + y * stride;
+		float fy = (y + 0.5f) / ctx->height;
+		for (int x = 0; x < ctx->width; x++) {
+			v4sf c = shade(ctx, (x + 0.5f) / ctx->width, fy);
+			//unorm conversion of the framebuffer
+			for (int i = 0; i < 4; i++) {
+				float f = (c[i] < 0) ? 0 : (c[i] > 1 ? 1 : c[i]);
+				out[x * 4 + i] = (unsigned char) (f * 255.0f + 0.5f);
+			}
+		}
+	}
+}
+
+static void context_init(CONTEXT_T *ctx, const CPU_REMAP_PARAMS_T *params,
+		int width, int height) {
+	ctx->p = params;
+	ctx->width = width;
+	ctx->height = height;
+	int active_cam = (params->active_cam < params->num_of_cam) ?
+			params->active_cam : 0;
+	ctx->cam = &params->cam[active_cam];
+	ctx->opt = &params->cam_options[active_cam];
+	ctx->pixel_size = (params->pixel_size > 0) ?
+			params->pixel_size : 1.0f / ctx->cam->width;
+	ctx->scale = 1.0 / tan(params->fov * M_PI / 180.0 / 2);
+	ctx->aspect_ratio = (float) width / height;
+	ctx->mesh_limit = tan(WINDOW_MESH_MAX_FOV * M_PI / 180.0 / 2);
+}
+
+//draws tiles of the current frame until none are left, called locked
+static void draw_tiles(CPU_REMAP_T *remap) {
+	if (remap->next_tile >= remap->num_tiles) { //params may be gone already
+		return;
+	}
+	CONTEXT_T ctx;
+	context_init(&ctx, remap->params, remap->width, remap->height);
+	while (remap->next_tile < remap->num_tiles) {
+		int tile = remap->next_tile++;
+		pthread_mutex_unlock(&remap->mutex);
+		draw_tile(&ctx, remap->dst, remap->stride, tile);
+		pthread_mutex_lock(&remap->mutex);
+		remap->tiles_done++;
+	}
+	pthread_cond_broadcast(&remap->done_cond);
+}
+
+static void *remap_thread(void *arg) {
+	CPU_REMAP_T *remap = (CPU_REMAP_T*) arg;
+	uint32_t frame_seq = 0;
+	pthread_mutex_lock(&remap->mutex);
+	while (1) {
+		while (!remap->stop && remap->frame_seq == frame_seq) {
+			pthread_cond_wait(&remap->cond, &remap->mutex);
+		}
+		if (remap->stop) {
+			break;
+		}
+		frame_seq = remap->frame_seq;
+		draw_tiles(remap);
+	}
+	pthread_mutex_unlock(&remap->mutex);
+	return NULL;
+}
+
+CPU_REMAP_T *cpu_remap_create(int num_threads) {
+	CPU_REMAP_T *remap = calloc(1, sizeof(CPU_REMAP_T));
+	if (remap == NULL) {
+		return NULL;
+	}
+	if (num_threads > CPU_REMAP_MAX_THREADS) {
+		num_threads = CPU_REMAP_MAX_THREADS;
+	}
+	pthread_mutex_init(&remap->call_mutex, 0);
+	pthread_mutex_init(&remap->mutex, 0);
+	pthread_cond_init(&remap->cond, 0);
+	pthread_cond_init(&remap->done_cond, 0);
+	for (int i = 0; i < num_threads; i++) {
+		if (pthread_create(&remap->thread[i], NULL, remap_thread, remap)
+				!= 0) {
+			printf("cpu remap : failed to start thread\n");
+			break;
+		}
+		remap->num_threads++;
+	}
+	return remap;
+}
+
+void cpu_remap_delete(CPU_REMAP_T *remap) {
+	if (remap == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&remap->mutex);
+	remap->stop = true;
+	pthread_cond_broadcast(&remap->cond);
+	pthread_mutex_unlock(&remap->mutex);
+	for (int i = 0; i < remap->num_threads; i++) {
+		pthread_join(remap->thread[i], NULL);
+	}
+	pthread_cond_destroy(&remap->done_cond);
+	pthread_cond_destroy(&remap->cond);
+	pthread_mutex_destroy(&remap->mutex);
+	pthread_mutex_destroy(&remap->call_mutex);
+	free(remap);
+}
+
+void cpu_remap(CPU_REMAP_T *remap, const CPU_REMAP_PARAMS_T *params,
+		unsigned char *dst, int width, int height, int stride) {
+	pthread_mutex_lock(&remap->call_mutex);
+	pthread_mutex_lock(&remap->mutex);
+	remap->params = params;
+	remap->dst = dst;
+	remap->width = width;
+	remap->height = height;
+	remap->stride = stride;
+	remap->next_tile = 0;
+	remap->num_tiles = (height + CPU_REMAP_TILE_ROWS - 1) / CPU_REMAP_TILE_ROWS;
+	remap->tiles_done = 0;
+	remap->frame_seq++;
+	pthread_cond_broadcast(&remap->cond);
+
+	draw_tiles(remap);
+	while (remap->tiles_done < remap->num_tiles) {
+		pthread_cond_wait(&remap->done_cond, &remap->mutex);
+	}
+	pthread_mutex_unlock(&remap->mutex);
+	pthread_mutex_unlock(&remap->call_mutex);
+}
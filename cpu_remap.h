@@ -0,0 +1,86 @@
+#ifndef _CPU_REMAP_H
+#define _CPU_REMAP_H
+
+#include <stdbool.h>
+
+#define CPU_REMAP_MAX_CAM 2
+#define CPU_REMAP_MAX_THREADS 16
+#define CPU_REMAP_TILE_ROWS 16
+
+enum CPU_REMAP_MODE {
+	CPU_REMAP_BOARD, //board.frag, the logo image upside down
+	CPU_REMAP_WINDOW, //window.frag
+	CPU_REMAP_EQUIRECTANGULAR, //equirectangular*.frag
+	CPU_REMAP_FISHEYE, //fisheye.frag
+	CPU_REMAP_CUBEMAP, //cubemap*.frag, 3x2 faces
+	CPU_REMAP_EAC //cubemap*.frag with EQUI_ANGULAR
+};
+
+enum CPU_REMAP_FILTER {
+	CPU_REMAP_NEAREST, //as the camera textures of the gpu
+	CPU_REMAP_BILINEAR
+};
+
+typedef struct {
+	const unsigned char *pixels; //RGBA, first row at v = 0
+	int width;
+	int height;
+	int stride; //bytes per row
+} CPU_REMAP_IMAGE_T;
+
+typedef struct {
+	float offset_yaw;
+	float offset_x;
+	float offset_y;
+	float horizon_r;
+} CPU_REMAP_CAMERA_T;
+
+/**
+ * What redraw_render_texture() gives the shaders.
+ * unif_matrix is the uniform as uploaded, column major.
+ */
+typedef struct {
+	enum CPU_REMAP_MODE mode;
+	enum CPU_REMAP_FILTER filter; //of the cameras, the logo is always linear
+	int num_of_cam; //2 blends two cameras like the TWO_CAMERAS shaders
+	int active_cam; //of one camera modes
+	CPU_REMAP_IMAGE_T cam[CPU_REMAP_MAX_CAM];
+	CPU_REMAP_CAMERA_T cam_options[CPU_REMAP_MAX_CAM];
+	CPU_REMAP_IMAGE_T logo; //pixels NULL draws black
+	float sharpness_gain;
+	//graded by as the COLOR_LUT shaders, see color_lut.h, NULL for none
+	const unsigned char *color_lut;
+	float pixel_size; //0 for 1 / width of the active camera
+	float unif_matrix[16];
+	float fov; //WINDOW, degrees
+} CPU_REMAP_PARAMS_T;
+
+typedef struct _CPU_REMAP_T CPU_REMAP_T;
+
+/**
+ * The projections of the shaders in C, for servers, archives and checking
+ * the shaders without a gpu. Pixels match the gpu within rounding and the
+ * float precision of its trig with CPU_REMAP_NEAREST, bilinear sampling
+ * trades that for smoother output. Frames are split into bands of
+ * CPU_REMAP_TILE_ROWS rows shared by num_threads threads and the caller.
+ */
+CPU_REMAP_T *cpu_remap_create(int num_threads);
+
+void cpu_remap_delete(CPU_REMAP_T *remap);
+
+/**
+ * The direction the shaders of a full sphere mode (EQUIRECTANGULAR,
+ * CUBEMAP, EAC) look at x, y of the viewport from 0 to 1, before
+ * unif_matrix.
+ */
+void cpu_remap_direction(enum CPU_REMAP_MODE mode, float x, float y,
+		float dir[3]);
+
+/**
+ * Draws params into RGBA dst as glReadPixels() would return the frame,
+ * the first row is the bottom of the gl viewport. One call at a time.
+ */
+void cpu_remap(CPU_REMAP_T *remap, const CPU_REMAP_PARAMS_T *params,
+		unsigned char *dst, int width, int height, int stride);
+
+#endif
@@ -0,0 +1,107 @@
+#include "frame_channel.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+
+void frame_channel_init(FRAME_CHANNEL_T *ch, const char *name, int depth) {
+	memset(ch, 0, sizeof(FRAME_CHANNEL_T));
+	pthread_mutex_init(&ch->mutex, 0);
+	pthread_cond_init(&ch->cond, 0);
+	strncpy(ch->name, name, sizeof(ch->name) - 1);
+	if (depth < 1) {
+		depth = 1;
+	} else if (depth > FRAME_CHANNEL_MAX_DEPTH) {
+		depth = FRAME_CHANNEL_MAX_DEPTH;
+	}
+	ch->depth = depth;
+}
+
+void frame_channel_publish(FRAME_CHANNEL_T *ch, IMAGE_DATA *image_data) {
+	IMAGE_DATA *dropped = NULL;
+
+	addref_image(image_data);
+	pthread_mutex_lock(&ch->mutex);
+	if (ch->num == ch->depth) {
+		dropped = ch->queue[ch->head];
+		ch->head = (ch->head + 1) % FRAME_CHANNEL_MAX_DEPTH;
+		ch->num--;
+		ch->dropped++;
+	}
+	ch->queue[(ch->head + ch->num) % FRAME_CHANNEL_MAX_DEPTH] = image_data;
+	ch->num++;
+	ch->published++;
+	pthread_cond_signal(&ch->cond);
+	pthread_mutex_unlock(&ch->mutex);
+
+	if (dropped) {
+		release_image(dropped);
+	}
+}
+
+IMAGE_DATA *frame_channel_wait(FRAME_CHANNEL_T *ch, long usec) {
+	IMAGE_DATA *image_data = NULL;
+	int retcode = 0;
+
+	pthread_mutex_lock(&ch->mutex);
+	if (usec > 0) {
+		long sec;
+		struct timeval now;
+		struct timespec timeout;
+		gettimeofday(&now, NULL);
+		usec += now.tv_usec;
+
+		sec = usec / 1000000;
+		usec = usec % 1000000;
+		timeout.tv_sec = now.tv_sec + sec;
+		timeout.tv_nsec = usec * 1000;
+		while (ch->num == 0 && retcode != ETIMEDOUT) {
+			retcode = pthread_cond_timedwait(&ch->cond, &ch->mutex, &timeout);
+		}
+	} else {
+		while (ch->num == 0) {
+			pthread_cond_wait(&ch->cond, &ch->mutex);
+		}
+	}
+	if (ch->num > 0) {
+		image_data = ch->queue[ch->head];
+		ch->head = (ch->head + 1) % FRAME_CHANNEL_MAX_DEPTH;
+		ch->num--;
+		ch->received++;
+	}
+	pthread_mutex_unlock(&ch->mutex);
+
+	return image_data;
+}
+
+void frame_channel_flush(FRAME_CHANNEL_T *ch) {
+	IMAGE_DATA *queue[FRAME_CHANNEL_MAX_DEPTH];
+	int num;
+
+	pthread_mutex_lock(&ch->mutex);
+	for (num = 0; ch->num > 0; num++) {
+		queue[num] = ch->queue[ch->head];
+		ch->head = (ch->head + 1) % FRAME_CHANNEL_MAX_DEPTH;
+		ch->num--;
+	}
+	pthread_mutex_unlock(&ch->mutex);
+
+	for (int i = 0; i < num; i++) {
+		release_image(queue[i]);
+	}
+}
+
+void frame_channel_destroy(FRAME_CHANNEL_T *ch) {
+	frame_channel_flush(ch);
+	pthread_cond_destroy(&ch->cond);
+	pthread_mutex_destroy(&ch->mutex);
+}
+
+void frame_channel_print_stats(FRAME_CHANNEL_T *ch) {
+	pthread_mutex_lock(&ch->mutex);
+	printf("%s : published %llu, received %llu, dropped %llu, queued %d\n",
+			ch->name, (unsigned long long) ch->published,
+			(unsigned long long) ch->received,
+			(unsigned long long) ch->dropped, ch->num);
+	pthread_mutex_unlock(&ch->mutex);
+}
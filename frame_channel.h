@@ -0,0 +1,45 @@
+#ifndef _FRAME_CHANNEL_H
+#define _FRAME_CHANNEL_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "image_data.h"
+
+#define FRAME_CHANNEL_MAX_DEPTH 16
+
+/**
+ * Single consumer frame queue.
+ * Every published frame is handed to the consumer exactly once. When the
+ * queue is full the oldest frame is dropped and counted, so depth 1 gives
+ * latest-frame-wins and a larger depth buffers bursts.
+ */
+typedef struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	char name[32];
+	int depth;
+	int head;
+	int num;
+	IMAGE_DATA *queue[FRAME_CHANNEL_MAX_DEPTH];
+	uint64_t published;
+	uint64_t received;
+	uint64_t dropped;
+} FRAME_CHANNEL_T;
+
+void frame_channel_init(FRAME_CHANNEL_T *ch, const char *name, int depth);
+
+/* the channel takes its own reference */
+void frame_channel_publish(FRAME_CHANNEL_T *ch, IMAGE_DATA *image_data);
+
+/* NULL on timeout, usec <= 0 waits forever, caller owns the reference */
+IMAGE_DATA *frame_channel_wait(FRAME_CHANNEL_T *ch, long usec);
+
+/* release queued frames */
+void frame_channel_flush(FRAME_CHANNEL_T *ch);
+
+/* flush and free what frame_channel_init() made, no one may wait on ch */
+void frame_channel_destroy(FRAME_CHANNEL_T *ch);
+
+void frame_channel_print_stats(FRAME_CHANNEL_T *ch);
+
+#endif
@@ -0,0 +1,146 @@
+#include "frame_encoder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+static double now_msec() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void *encoder_thread_func(void *arg) {
+	FRAME_ENCODER_T *encoder = (FRAME_ENCODER_T*) arg;
+
+	pthread_mutex_lock(&encoder->mutex);
+	while (1) {
+		while (encoder->num == 0 && !encoder->exit) {
+			pthread_cond_wait(&encoder->cond, &encoder->mutex);
+		}
+		if (encoder->num == 0) { //exit, nothing left
+			break;
+		}
+		unsigned char *image = encoder->images[encoder->head];
+		pthread_mutex_unlock(&encoder->mutex);
+
+		double start = now_msec();
+		encoder->encode_func(encoder->user_data, image);
+		double elapsed = now_msec() - start;
+
+		pthread_mutex_lock(&encoder->mutex);
+		encoder->head = (encoder->head + 1) % encoder->num_images;
+		encoder->num--;
+		encoder->stats.encoded++;
+		encoder->stats.encode_msec += elapsed;
+		pthread_cond_broadcast(&encoder->cond);
+	}
+	pthread_mutex_unlock(&encoder->mutex);
+
+	return NULL;
+}
+
+FRAME_ENCODER_T *frame_encoder_create(int num_images, int image_size,
+		FRAME_ENCODER_FUNC encode_func, void *user_data) {
+	FRAME_ENCODER_T *encoder = malloc(sizeof(FRAME_ENCODER_T));
+	memset(encoder, 0, sizeof(FRAME_ENCODER_T));
+	if (num_images < 1) {
+		num_images = 1;
+	} else if (num_images > FRAME_ENCODER_MAX_IMAGES) {
+		num_images = FRAME_ENCODER_MAX_IMAGES;
+	}
+	encoder->num_images = num_images;
+	for (int i = 0; i < num_images; i++) {
+		encoder->images[i] = malloc(image_size);
+		if (encoder->images[i] == NULL) {
+			printf("frame_encoder : could not allocate %d bytes\n",
+					image_size);
+			for (int j = 0; j < i; j++) {
+				free(encoder->images[j]);
+			}
+			free(encoder);
+			return NULL;
+		}
+	}
+	encoder->encode_func = encode_func;
+	encoder->user_data = user_data;
+	pthread_mutex_init(&encoder->mutex, 0);
+	pthread_cond_init(&encoder->cond, 0);
+	pthread_create(&encoder->thread, NULL, encoder_thread_func,
+			(void*) encoder);
+
+	return encoder;
+}
+
+void frame_encoder_delete(FRAME_ENCODER_T *encoder) {
+	pthread_mutex_lock(&encoder->mutex);
+	encoder->exit = true;
+	pthread_cond_broadcast(&encoder->cond);
+	pthread_mutex_unlock(&encoder->mutex);
+	pthread_join(encoder->thread, NULL);
+
+	for (int i = 0; i < encoder->num_images; i++) {
+		free(encoder->images[i]);
+	}
+	pthread_cond_destroy(&encoder->cond);
+	pthread_mutex_destroy(&encoder->mutex);
+	free(encoder);
+}
+
+unsigned char *frame_encoder_acquire(FRAME_ENCODER_T *encoder) {
+	pthread_mutex_lock(&encoder->mutex);
+	if (encoder->num + encoder->acquired == encoder->num_images) {
+		double start = now_msec();
+		while (encoder->num + encoder->acquired == encoder->num_images) {
+			pthread_cond_wait(&encoder->cond, &encoder->mutex);
+		}
+		encoder->stats.acquire_wait_msec += now_msec() - start;
+	}
+	unsigned char *image = encoder->images[(encoder->head + encoder->num
+			+ encoder->acquired) % encoder->num_images];
+	encoder->acquired++;
+	pthread_mutex_unlock(&encoder->mutex);
+
+	return image;
+}
+
+unsigned char *frame_encoder_try_acquire(FRAME_ENCODER_T *encoder) {
+	unsigned char *image = NULL;
+	pthread_mutex_lock(&encoder->mutex);
+	if (encoder->num + encoder->acquired == encoder->num_images) {
+		encoder->stats.dropped++;
+	} else {
+		image = encoder->images[(encoder->head + encoder->num
+				+ encoder->acquired) % encoder->num_images];
+		encoder->acquired++;
+	}
+	pthread_mutex_unlock(&encoder->mutex);
+
+	return image;
+}
+
+void frame_encoder_submit(FRAME_ENCODER_T *encoder) {
+	pthread_mutex_lock(&encoder->mutex);
+	if (encoder->acquired > 0) {
+		encoder->acquired--;
+		encoder->num++;
+		pthread_cond_broadcast(&encoder->cond);
+	}
+	pthread_mutex_unlock(&encoder->mutex);
+}
+
+void frame_encoder_drain(FRAME_ENCODER_T *encoder) {
+	pthread_mutex_lock(&encoder->mutex);
+	while (encoder->num > 0) {
+		pthread_cond_wait(&encoder->cond, &encoder->mutex);
+	}
+	pthread_mutex_unlock(&encoder->mutex);
+}
+
+void frame_encoder_get_stats(FRAME_ENCODER_T *encoder,
+		FRAME_ENCODER_STATS_T *stats) {
+	pthread_mutex_lock(&encoder->mutex);
+	*stats = encoder->stats;
+	memset(&encoder->stats, 0, sizeof(encoder->stats));
+	pthread_mutex_unlock(&encoder->mutex);
+}
@@ -0,0 +1,64 @@
+#ifndef _FRAME_ENCODER_H
+#define _FRAME_ENCODER_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FRAME_ENCODER_MAX_IMAGES 8
+
+typedef void (*FRAME_ENCODER_FUNC)(void *user_data, unsigned char *image);
+
+typedef struct {
+	uint64_t encoded;
+	double encode_msec; //in encode_func, summed
+	double acquire_wait_msec; //producer waited for a free image, summed
+	uint64_t dropped; //try_acquire found every image in use
+} FRAME_ENCODER_STATS_T;
+
+/**
+ * Encodes frame images on a worker thread.
+ * The encoder owns num_images buffers of image_size bytes. The producer
+ * takes a free one, fills it and submits it; the worker hands submitted
+ * images to encode_func in order and frees them again. With every image
+ * queued acquire blocks, so a slow encoder holds the producer back instead
+ * of dropping frames, try_acquire drops the frame instead.
+ */
+typedef struct {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	FRAME_ENCODER_FUNC encode_func;
+	void *user_data;
+	int num_images;
+	unsigned char *images[FRAME_ENCODER_MAX_IMAGES];
+	int head; //oldest submitted, in encode_func while num > 0
+	int num; //submitted, not yet encoded
+	int acquired; //taken by the producer after those, not yet submitted
+	bool exit;
+	FRAME_ENCODER_STATS_T stats;
+} FRAME_ENCODER_T;
+
+FRAME_ENCODER_T *frame_encoder_create(int num_images, int image_size,
+		FRAME_ENCODER_FUNC encode_func, void *user_data);
+
+/* drains the queue first */
+void frame_encoder_delete(FRAME_ENCODER_T *encoder);
+
+/* next free image, waits while every image is acquired or queued */
+unsigned char *frame_encoder_acquire(FRAME_ENCODER_T *encoder);
+
+/* next free image, NULL instead of waiting while every image is in use */
+unsigned char *frame_encoder_try_acquire(FRAME_ENCODER_T *encoder);
+
+/* queue the oldest image acquired, images are encoded in acquire order */
+void frame_encoder_submit(FRAME_ENCODER_T *encoder);
+
+/* wait until every submitted image is encoded */
+void frame_encoder_drain(FRAME_ENCODER_T *encoder);
+
+/* stats since the last call */
+void frame_encoder_get_stats(FRAME_ENCODER_T *encoder,
+		FRAME_ENCODER_STATS_T *stats);
+
+#endif
@@ -0,0 +1,194 @@
+#include "frame_pairing.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+static uint64_t now_usec() {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (uint64_t) now.tv_sec * 1000000 + now.tv_usec;
+}
+
+void frame_pairing_init(FRAME_PAIRING_T *pairing, int num_of_cam,
+		uint64_t tolerance) {
+	memset(pairing, 0, sizeof(FRAME_PAIRING_T));
+	pthread_mutex_init(&pairing->mutex, 0);
+	mrevent_init(&pairing->ready_event);
+	if (num_of_cam > FRAME_PAIRING_MAX_CAM) {
+		num_of_cam = FRAME_PAIRING_MAX_CAM;
+	}
+	pairing->num_of_cam = num_of_cam;
+	pairing->tolerance = tolerance;
+}
+
+static IMAGE_DATA *queue_pop(FRAME_PAIRING_T *pairing, int cam) {
+	IMAGE_DATA *image_data = pairing->queue[cam][0];
+	pairing->queue_num[cam]--;
+	memmove(&pairing->queue[cam][0], &pairing->queue[cam][1],
+			pairing->queue_num[cam] * sizeof(IMAGE_DATA*));
+	return image_data;
+}
+
+//call with mutex held
+static void release_pending(FRAME_PAIRING_T *pairing) {
+	uint64_t now;
+	if (pairing->pending[0] == NULL) {
+		return;
+	}
+	now = now_usec();
+	if (pairing->in_flight) {
+		if (now - pairing->released_usec < FRAME_PAIRING_DECODE_TIMEOUT) {
+			return;
+		}
+		pairing->stats.decode_timeouts++;
+	}
+	for (int i = 0; i < pairing->num_of_cam; i++) {
+		if (pairing->output[i] != NULL) {
+			frame_channel_publish(pairing->output[i], pairing->pending[i]);
+		}
+		release_image(pairing->pending[i]);
+		pairing->pending[i] = NULL;
+	}
+	pairing->in_flight = true;
+	pairing->decoded_mask = 0;
+	pairing->released_usec = now;
+	pairing->stats.pairs++;
+	mrevent_reset(&pairing->ready_event);
+}
+
+static void drop_all(FRAME_PAIRING_T *pairing) {
+	for (int i = 0; i < pairing->num_of_cam; i++) {
+		while (pairing->queue_num[i] > 0) {
+			release_image(queue_pop(pairing, i));
+		}
+		release_image(pairing->pending[i]);
+		pairing->pending[i] = NULL;
+	}
+	pairing->in_flight = false;
+	pairing->decoded_mask = 0;
+	mrevent_reset(&pairing->ready_event);
+}
+
+void frame_pairing_reset(FRAME_PAIRING_T *pairing, uint64_t tolerance) {
+	pthread_mutex_lock(&pairing->mutex);
+	drop_all(pairing);
+	pairing->tolerance = tolerance;
+	pthread_mutex_unlock(&pairing->mutex);
+}
+
+void frame_pairing_set_output(FRAME_PAIRING_T *pairing, int cam,
+		FRAME_CHANNEL_T *ch) {
+	pthread_mutex_lock(&pairing->mutex);
+	pairing->output[cam] = ch;
+	pthread_mutex_unlock(&pairing->mutex);
+}
+
+void frame_pairing_push(FRAME_PAIRING_T *pairing, int cam,
+		IMAGE_DATA *image_data) {
+	if (cam >= pairing->num_of_cam) {
+		return;
+	}
+	addref_image(image_data);
+	pthread_mutex_lock(&pairing->mutex);
+	if (pairing->queue_num[cam] == FRAME_PAIRING_QUEUE_DEPTH) {
+		release_image(queue_pop(pairing, cam));
+		pairing->stats.unpaired[cam]++;
+	}
+	pairing->queue[cam][pairing->queue_num[cam]++] = image_data;
+
+	while (1) {
+		bool complete = true;
+		int oldest = 0;
+		uint64_t min = UINT64_MAX;
+		uint64_t max = 0;
+		for (int i = 0; i < pairing->num_of_cam; i++) {
+			if (pairing->queue_num[i] == 0) {
+				complete = false; //wait for more frames
+				break;
+			}
+			uint64_t timestamp = pairing->queue[i][0]->timestamp;
+			if (timestamp < min) {
+				min = timestamp;
+				oldest = i;
+			}
+			if (timestamp > max) {
+				max = timestamp;
+			}
+		}
+		if (!complete) {
+			break;
+		}
+		if (max - min > pairing->tolerance) {
+			release_image(queue_pop(pairing, oldest));
+			pairing->stats.unpaired[oldest]++;
+			continue;
+		}
+		if (pairing->pending[0] != NULL) { //renderer is behind
+			for (int i = 0; i < pairing->num_of_cam; i++) {
+				release_image(pairing->pending[i]);
+			}
+			pairing->stats.stale++;
+		}
+		for (int i = 0; i < pairing->num_of_cam; i++) {
+			pairing->pending[i] = queue_pop(pairing, i);
+		}
+		pairing->stats.matched++;
+		pairing->stats.skew_sum += max - min;
+		if (max - min > pairing->stats.skew_max) {
+			pairing->stats.skew_max = max - min;
+		}
+	}
+	release_pending(pairing);
+	pthread_mutex_unlock(&pairing->mutex);
+}
+
+void frame_pairing_decoded(FRAME_PAIRING_T *pairing, int cam) {
+	pthread_mutex_lock(&pairing->mutex);
+	if (pairing->in_flight) {
+		pairing->decoded_mask |= 1 << cam;
+		if (pairing->decoded_mask == (1 << pairing->num_of_cam) - 1) {
+			mrevent_trigger(&pairing->ready_event);
+		}
+	}
+	pthread_mutex_unlock(&pairing->mutex);
+}
+
+int frame_pairing_wait(FRAME_PAIRING_T *pairing, long usec) {
+	return mrevent_wait(&pairing->ready_event, usec);
+}
+
+void frame_pairing_rendered(FRAME_PAIRING_T *pairing) {
+	pthread_mutex_lock(&pairing->mutex);
+	pairing->in_flight = false;
+	pairing->decoded_mask = 0;
+	pairing->stats.rendered++;
+	mrevent_reset(&pairing->ready_event);
+	release_pending(pairing);
+	pthread_mutex_unlock(&pairing->mutex);
+}
+
+void frame_pairing_get_stats(FRAME_PAIRING_T *pairing,
+		FRAME_PAIRING_STATS_T *stats) {
+	pthread_mutex_lock(&pairing->mutex);
+	*stats = pairing->stats;
+	pthread_mutex_unlock(&pairing->mutex);
+}
+
+void frame_pairing_print_stats(FRAME_PAIRING_T *pairing) {
+	FRAME_PAIRING_STATS_T stats;
+	frame_pairing_get_stats(pairing, &stats);
+	printf("pairing : pairs %llu, rendered %llu, stale %llu, "
+			"decode timeouts %llu\n", (unsigned long long) stats.pairs,
+			(unsigned long long) stats.rendered,
+			(unsigned long long) stats.stale,
+			(unsigned long long) stats.decode_timeouts);
+	printf("pairing : skew avg %.2fms, max %.2fms, tolerance %.2fms\n",
+			(stats.matched == 0) ?
+					0 : (double) stats.skew_sum / stats.matched / 1000,
+			(double) stats.skew_max / 1000,
+			(double) pairing->tolerance / 1000);
+	for (int i = 0; i < pairing->num_of_cam; i++) {
+		printf("pairing : cam%d unpaired %llu\n", i,
+				(unsigned long long) stats.unpaired[i]);
+	}
+}
@@ -0,0 +1,78 @@
+#ifndef _FRAME_PAIRING_H
+#define _FRAME_PAIRING_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "image_data.h"
+#include "mrevent.h"
+#include "frame_channel.h"
+
+#define FRAME_PAIRING_MAX_CAM 4
+#define FRAME_PAIRING_QUEUE_DEPTH 4
+#define FRAME_PAIRING_DEFAULT_TOLERANCE 8000 //usec
+//a released set that is not decoded in time does not block the next one
+#define FRAME_PAIRING_DECODE_TIMEOUT 200000 //usec
+
+typedef struct {
+	uint64_t matched; //sets formed, released or not
+	uint64_t pairs; //sets released to the decoders
+	uint64_t rendered;
+	uint64_t unpaired[FRAME_PAIRING_MAX_CAM]; //no partner within tolerance
+	uint64_t stale; //replaced by a newer set before release
+	uint64_t decode_timeouts;
+	uint64_t skew_sum; //usec
+	uint64_t skew_max; //usec
+} FRAME_PAIRING_STATS_T;
+
+/**
+ * Groups frames of all cameras by capture timestamp.
+ * A set is formed when the oldest queued frame of every camera lies within
+ * the tolerance, otherwise the oldest frame has no partner and is dropped.
+ * Sets are handed to the decoder channels one at a time: the next one is
+ * released after every decoder has produced its frame and the renderer has
+ * drawn them, so the textures always hold frames of the same instant.
+ */
+typedef struct {
+	pthread_mutex_t mutex;
+	int num_of_cam;
+	uint64_t tolerance; //usec
+	FRAME_CHANNEL_T *output[FRAME_PAIRING_MAX_CAM];
+	IMAGE_DATA *queue[FRAME_PAIRING_MAX_CAM][FRAME_PAIRING_QUEUE_DEPTH];
+	int queue_num[FRAME_PAIRING_MAX_CAM];
+	IMAGE_DATA *pending[FRAME_PAIRING_MAX_CAM]; //matched, not yet released
+	bool in_flight;
+	uint32_t decoded_mask;
+	uint64_t released_usec;
+	MREVENT_T ready_event;
+	FRAME_PAIRING_STATS_T stats;
+} FRAME_PAIRING_T;
+
+void frame_pairing_init(FRAME_PAIRING_T *pairing, int num_of_cam,
+		uint64_t tolerance);
+
+/* drop queued frames and sets, also applies a new tolerance */
+void frame_pairing_reset(FRAME_PAIRING_T *pairing, uint64_t tolerance);
+
+void frame_pairing_set_output(FRAME_PAIRING_T *pairing, int cam,
+		FRAME_CHANNEL_T *ch);
+
+/* the pairing takes its own reference */
+void frame_pairing_push(FRAME_PAIRING_T *pairing, int cam,
+		IMAGE_DATA *image_data);
+
+/* decoder of cam finished a frame */
+void frame_pairing_decoded(FRAME_PAIRING_T *pairing, int cam);
+
+/* 0 once every decoder has produced its frame of the current set */
+int frame_pairing_wait(FRAME_PAIRING_T *pairing, long usec);
+
+/* the current set is drawn, release the next one */
+void frame_pairing_rendered(FRAME_PAIRING_T *pairing);
+
+void frame_pairing_get_stats(FRAME_PAIRING_T *pairing,
+		FRAME_PAIRING_STATS_T *stats);
+
+void frame_pairing_print_stats(FRAME_PAIRING_T *pairing);
+
+#endif
@@ -8,12 +8,19 @@
 #include <cstring>
 #include <chrono>
 
-GLProgram::GLProgram(const char *vertex_file, const char *fragment_file) {
+GLProgram::GLProgram(const char *vertex_file, const char *fragment_file,
+		const std::vector<std::string> *defines) {
 	GLint status;
+	std::string header;
+	if (defines) {
+		for (size_t i = 0; i < defines->size(); i++) {
+			header += "#define " + (*defines)[i] + "\n";
+		}
+	}
 	m_program_id = glCreateProgram();
 
-	m_vertex_id = LoadShader(GL_VERTEX_SHADER, vertex_file);
-	m_fragment_id = LoadShader(GL_FRAGMENT_SHADER, fragment_file);
+	m_vertex_id = LoadShader(GL_VERTEX_SHADER, vertex_file, header);
+	m_fragment_id = LoadShader(GL_FRAGMENT_SHADER, fragment_file, header);
 	glAttachShader(m_program_id, m_vertex_id);
 	glAttachShader(m_program_id, m_fragment_id);
 
@@ -32,6 +39,7 @@ GLProgram::GLProgram(const char *vertex_file, const char *fragment_file) {
 		delete[] msg;
 		throw std::invalid_argument(s.str());
 	}
+	ReadLocations();
 }
 
 GLProgram::~GLProgram() {
@@ -44,7 +52,96 @@ GLuint GLProgram::GetId() {
 	return m_program_id;
 }
 
-GLuint GLProgram::LoadShader(GLenum shader_type, const char *source_file) {
+GLint GLProgram::GetUniformLocation(const char *name) {
+	std::map<std::string, Uniform>::iterator it = m_uniforms.find(name);
+	return (it == m_uniforms.end()) ? -1 : it->second.location;
+}
+
+GLint GLProgram::GetAttribLocation(const char *name) {
+	std::map<std::string, GLint>::iterator it = m_attribs.find(name);
+	return (it == m_attribs.end()) ? -1 : it->second;
+}
+
+void GLProgram::Uniform1f(const char *name, GLfloat v0) {
+	Uniform *uniform = Changed(name, &v0, sizeof(v0));
+	if (uniform) {
+		glUniform1f(uniform->location, v0);
+	}
+}
+
+void GLProgram::Uniform1i(const char *name, GLint v0) {
+	Uniform *uniform = Changed(name, &v0, sizeof(v0));
+	if (uniform) {
+		glUniform1i(uniform->location, v0);
+	}
+}
+
+void GLProgram::Uniform2fv(const char *name, const GLfloat *value) {
+	Uniform *uniform = Changed(name, value, sizeof(GLfloat) * 2);
+	if (uniform) {
+		glUniform2fv(uniform->location, 1, value);
+	}
+}
+
+void GLProgram::Uniform4fv(const char *name, const GLfloat *value) {
+	Uniform *uniform = Changed(name, value, sizeof(GLfloat) * 4);
+	if (uniform) {
+		glUniform4fv(uniform->location, 1, value);
+	}
+}
+
+void GLProgram::UniformMatrix4fv(const char *name, const GLfloat *value) {
+	Uniform *uniform = Changed(name, value, sizeof(GLfloat) * 16);
+	if (uniform) {
+		glUniformMatrix4fv(uniform->location, 1, GL_FALSE, value);
+	}
+}
+
+//the uniform to upload value to, NULL if it is not active or has it already
+GLProgram::Uniform *GLProgram::Changed(const char *name, const void *value,
+		size_t size) {
+	std::map<std::string, Uniform>::iterator it = m_uniforms.find(name);
+	if (it == m_uniforms.end()) {
+		return NULL;
+	}
+	Uniform *uniform = &it->second;
+	if (uniform->value.size() == size
+			&& std::memcmp(&uniform->value[0], value, size) == 0) {
+		return NULL;
+	}
+	uniform->value.assign((const unsigned char*) value,
+			(const unsigned char*) value + size);
+	return uniform;
+}
+
+void GLProgram::ReadLocations() {
+	GLint count, max_len;
+	GLint size;
+	GLenum type;
+
+	glGetProgramiv(m_program_id, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(m_program_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_len);
+	std::vector<char> name(max_len + 1);
+	for (GLint i = 0; i < count; i++) {
+		glGetActiveUniform(m_program_id, i, name.size(), NULL, &size, &type,
+				&name[0]);
+		Uniform uniform;
+		uniform.location = glGetUniformLocation(m_program_id, &name[0]);
+		m_uniforms[&name[0]] = uniform;
+	}
+
+	glGetProgramiv(m_program_id, GL_ACTIVE_ATTRIBUTES, &count);
+	glGetProgramiv(m_program_id, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_len);
+	name.resize(max_len + 1);
+	for (GLint i = 0; i < count; i++) {
+		glGetActiveAttrib(m_program_id, i, name.size(), NULL, &size, &type,
+				&name[0]);
+		m_attribs[&name[0]] = glGetAttribLocation(m_program_id, &name[0]);
+	}
+}
+
+GLuint GLProgram::LoadShader(GLenum shader_type, const char *source_file,
+		const std::string &header) {
 	GLint status;
 	GLuint shader_id;
 	char *shader_source = ReadFile(source_file);
@@ -56,8 +153,9 @@ GLuint GLProgram::LoadShader(GLenum shader_type, const char *source_file) {
 		throw std::invalid_argument(s.str());
 	}
 
+	const GLchar *sources[2] = { header.c_str(), shader_source };
 	shader_id = glCreateShader(shader_type);
-	glShaderSource(shader_id, 1, (const GLchar**) &shader_source, NULL);
+	glShaderSource(shader_id, 2, sources, NULL);
 	glCompileShader(shader_id);
 	delete[] shader_source;
 
@@ -71,7 +169,8 @@ GLuint GLProgram::LoadShader(GLenum shader_type, const char *source_file) {
 		msg = new char[msg_len];
 		glGetShaderInfoLog(shader_id, msg_len, NULL, msg);
 
-		s << "Failed to compile " << source_file << ": " << msg;
+		s << "Failed to compile " << source_file << " " << header << ": "
+				<< msg;
 		delete[] msg;
 		throw std::invalid_argument(s.str());
 	}
@@ -99,6 +198,39 @@ char* GLProgram::ReadFile(const char *file) {
 	return ret;
 }
 
+GLProgramVariants::GLProgramVariants(const char *vertex_file,
+		const char *fragment_file, const char * const *define_names,
+		int num_of_defines) :
+		m_vertex_file(vertex_file), m_fragment_file(fragment_file) {
+	for (int i = 0; i < num_of_defines; i++) {
+		m_define_names.push_back(define_names[i]);
+	}
+}
+
+GLProgramVariants::~GLProgramVariants() {
+	std::map<unsigned int, GLProgram*>::iterator it;
+	for (it = m_variants.begin(); it != m_variants.end(); it++) {
+		delete it->second;
+	}
+}
+
+GLProgram *GLProgramVariants::Get(unsigned int key) {
+	std::map<unsigned int, GLProgram*>::iterator it = m_variants.find(key);
+	if (it != m_variants.end()) {
+		return it->second;
+	}
+	std::vector<std::string> defines;
+	for (size_t i = 0; i < m_define_names.size(); i++) {
+		if (key & (1 << i)) {
+			defines.push_back(m_define_names[i]);
+		}
+	}
+	GLProgram *program = new GLProgram(m_vertex_file.c_str(),
+			m_fragment_file.c_str(), &defines);
+	m_variants[key] = program;
+	return program;
+}
+
 void *GLProgram_new(const char *vertex_file, const char *fragment_file)
 {
 	return (void*)new GLProgram(vertex_file, fragment_file);
@@ -111,3 +243,48 @@ void GLProgram_delete(const void *_this)
 {
 	delete ((GLProgram*)_this);
 }
+GLint GLProgram_GetUniformLocation(const void *_this, const char *name)
+{
+	return ((GLProgram*)_this)->GetUniformLocation(name);
+}
+GLint GLProgram_GetAttribLocation(const void *_this, const char *name)
+{
+	return ((GLProgram*)_this)->GetAttribLocation(name);
+}
+void GLProgram_Uniform1f(const void *_this, const char *name, GLfloat v0)
+{
+	((GLProgram*)_this)->Uniform1f(name, v0);
+}
+void GLProgram_Uniform1i(const void *_this, const char *name, GLint v0)
+{
+	((GLProgram*)_this)->Uniform1i(name, v0);
+}
+void GLProgram_Uniform2fv(const void *_this, const char *name,
+		const GLfloat *value)
+{
+	((GLProgram*)_this)->Uniform2fv(name, value);
+}
+void GLProgram_Uniform4fv(const void *_this, const char *name,
+		const GLfloat *value)
+{
+	((GLProgram*)_this)->Uniform4fv(name, value);
+}
+void GLProgram_UniformMatrix4fv(const void *_this, const char *name,
+		const GLfloat *value)
+{
+	((GLProgram*)_this)->UniformMatrix4fv(name, value);
+}
+void *GLProgramVariants_new(const char *vertex_file, const char *fragment_file,
+		const char * const *define_names, int num_of_defines)
+{
+	return (void*)new GLProgramVariants(vertex_file, fragment_file,
+			define_names, num_of_defines);
+}
+void *GLProgramVariants_Get(const void *_this, unsigned int key)
+{
+	return (void*)((GLProgramVariants*)_this)->Get(key);
+}
+void GLProgramVariants_delete(const void *_this)
+{
+	delete ((GLProgramVariants*)_this);
+}
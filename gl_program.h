@@ -7,9 +7,21 @@
 
 #ifdef __cplusplus
 
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Locations of the active uniforms and attributes are read once after
+ * linking. The Uniform* setters keep the last value of each uniform and
+ * skip the gl call when it did not change or the shader does not have the
+ * uniform, they expect the program to be in use.
+ */
 class GLProgram {
 public:
-	GLProgram(const char *vertex_file, const char *fragment_file);
+	//defines are put in front of both sources as #define lines, NULL for none
+	GLProgram(const char *vertex_file, const char *fragment_file,
+			const std::vector<std::string> *defines = NULL);
 	virtual ~GLProgram();
 
 	GLuint GetId();
@@ -17,11 +29,45 @@ public:
 		return m_program_id;
 	}
 	;
+	GLint GetUniformLocation(const char *name); //-1 if not active
+	GLint GetAttribLocation(const char *name); //-1 if not active
+	void Uniform1f(const char *name, GLfloat v0);
+	void Uniform1i(const char *name, GLint v0);
+	void Uniform2fv(const char *name, const GLfloat *value);
+	void Uniform4fv(const char *name, const GLfloat *value);
+	void UniformMatrix4fv(const char *name, const GLfloat *value);
 private:
+	struct Uniform {
+		GLint location;
+		std::vector<unsigned char> value; //empty until the first upload
+	};
 	GLuint m_vertex_id, m_fragment_id, m_program_id;
+	std::map<std::string, Uniform> m_uniforms;
+	std::map<std::string, GLint> m_attribs;
 
-	GLuint LoadShader(GLenum shader_type, const char *source_file);
+	GLuint LoadShader(GLenum shader_type, const char *source_file,
+			const std::string &header);
 	char* ReadFile(const char *file);
+	void ReadLocations();
+	Uniform *Changed(const char *name, const void *value, size_t size);
+};
+
+/**
+ * Specializations of one shader pair. Bit i of a key defines
+ * define_names[i], a variant is compiled the first time its key is asked
+ * for and kept until the set is deleted.
+ */
+class GLProgramVariants {
+public:
+	GLProgramVariants(const char *vertex_file, const char *fragment_file,
+			const char * const *define_names, int num_of_defines);
+	virtual ~GLProgramVariants();
+
+	GLProgram *Get(unsigned int key);
+private:
+	std::string m_vertex_file, m_fragment_file;
+	std::vector<std::string> m_define_names;
+	std::map<unsigned int, GLProgram*> m_variants;
 };
 
 extern "C" {
@@ -31,6 +77,22 @@ extern "C" {
 void *GLProgram_new(const char *vertex_file, const char *fragment_file);
 GLuint GLProgram_GetId(const void *_this);
 void GLProgram_delete(const void *_this);
+GLint GLProgram_GetUniformLocation(const void *_this, const char *name);
+GLint GLProgram_GetAttribLocation(const void *_this, const char *name);
+void GLProgram_Uniform1f(const void *_this, const char *name, GLfloat v0);
+void GLProgram_Uniform1i(const void *_this, const char *name, GLint v0);
+void GLProgram_Uniform2fv(const void *_this, const char *name,
+		const GLfloat *value);
+void GLProgram_Uniform4fv(const void *_this, const char *name,
+		const GLfloat *value);
+void GLProgram_UniformMatrix4fv(const void *_this, const char *name,
+		const GLfloat *value);
+
+void *GLProgramVariants_new(const char *vertex_file, const char *fragment_file,
+		const char * const *define_names, int num_of_defines);
+//a GLProgram for the GLProgram_* functions
+void *GLProgramVariants_Get(const void *_this, unsigned int key);
+void GLProgramVariants_delete(const void *_this);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,90 @@
+#include "gl_state.h"
+#include <stdbool.h>
+
+typedef struct {
+	bool valid;
+	GLuint name;
+} BINDING_T;
+
+static BINDING_T lg_program;
+static BINDING_T lg_active_texture;
+static BINDING_T lg_texture[GL_STATE_MAX_TEXTURE_UNITS];
+static BINDING_T lg_array_buffer;
+static BINDING_T lg_framebuffer;
+
+//true if binding has to be set to name
+static bool update(BINDING_T *binding, GLuint name) {
+	if (binding->valid && binding->name == name) {
+		return false;
+	}
+	binding->valid = true;
+	binding->name = name;
+	return true;
+}
+
+void gl_state_reset() {
+	lg_program.valid = false;
+	lg_active_texture.valid = false;
+	for (int i = 0; i < GL_STATE_MAX_TEXTURE_UNITS; i++) {
+		lg_texture[i].valid = false;
+	}
+	lg_array_buffer.valid = false;
+	lg_framebuffer.valid = false;
+}
+
+void gl_state_use_program(GLuint program) {
+	if (update(&lg_program, program)) {
+		glUseProgram(program);
+	}
+}
+
+void gl_state_bind_texture(int unit, GLuint texture) {
+	if (unit < 0 || unit >= GL_STATE_MAX_TEXTURE_UNITS) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		lg_active_texture.valid = false;
+		return;
+	}
+	//active even if texture is bound already, callers edit it next
+	if (update(&lg_active_texture, unit)) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+	if (update(&lg_texture[unit], texture)) {
+		glBindTexture(GL_TEXTURE_2D, texture);
+	}
+}
+
+void gl_state_bind_array_buffer(GLuint buffer) {
+	if (update(&lg_array_buffer, buffer)) {
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	}
+}
+
+void gl_state_bind_framebuffer(GLuint framebuffer) {
+	if (update(&lg_framebuffer, framebuffer)) {
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	}
+}
+
+void gl_state_delete_texture(GLuint texture) {
+	glDeleteTextures(1, &texture);
+	for (int i = 0; i < GL_STATE_MAX_TEXTURE_UNITS; i++) {
+		if (lg_texture[i].valid && lg_texture[i].name == texture) {
+			lg_texture[i].valid = false; //drivers differ in which units
+		}
+	}
+}
+
+void gl_state_delete_framebuffer(GLuint framebuffer) {
+	glDeleteFramebuffers(1, &framebuffer);
+	if (lg_framebuffer.valid && lg_framebuffer.name == framebuffer) {
+		lg_framebuffer.name = 0;
+	}
+}
+
+void gl_state_delete_array_buffer(GLuint buffer) {
+	glDeleteBuffers(1, &buffer);
+	if (lg_array_buffer.valid && lg_array_buffer.name == buffer) {
+		lg_array_buffer.name = 0;
+	}
+}
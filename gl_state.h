@@ -0,0 +1,32 @@
+#ifndef _GL_STATE_H
+#define _GL_STATE_H
+
+#include <GLES2/gl2.h>
+
+#define GL_STATE_MAX_TEXTURE_UNITS 8
+
+/**
+ * Bindings of the gl context the render loop runs in, gl is only called
+ * when one changes. Everything that binds programs, 2D textures, array
+ * buffers or framebuffers in that context has to go through here, or call
+ * gl_state_reset() afterwards.
+ */
+void gl_state_reset();
+
+void gl_state_use_program(GLuint program);
+
+//makes unit active and binds texture to it
+void gl_state_bind_texture(int unit, GLuint texture);
+
+void gl_state_bind_array_buffer(GLuint buffer);
+
+void gl_state_bind_framebuffer(GLuint framebuffer);
+
+//deleting a bound object unbinds it, its name may come back from glGen*
+void gl_state_delete_texture(GLuint texture);
+
+void gl_state_delete_framebuffer(GLuint framebuffer);
+
+void gl_state_delete_array_buffer(GLuint buffer);
+
+#endif
@@ -0,0 +1,250 @@
+#include "h264_parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+#define NAL_SLICE 1
+#define NAL_IDR 5
+#define NAL_SEI 6
+#define NAL_AUD 9
+
+enum H264_SCAN_STATE {
+	H264_SCAN_START_CODE, H264_SCAN_NAL_HEADER, H264_SCAN_SLICE_HEADER
+};
+
+struct _H264_PARSER_T {
+	IMAGE_POOL_T *pool;
+	IMAGE_DATA *au; //unit in progress, image_size is the bytes written
+	int scan_pos; //bytes of au already scanned
+	enum H264_SCAN_STATE state;
+	int zeros; //zero bytes before scan_pos
+	int nal_start; //start code of the current nal unit, offset in au
+	bool has_slice;
+	bool resync; //discard bytes up to the next unit start
+	uint64_t write_usec;
+
+	IMAGE_DATA *frames[H264_PARSER_MAX_FRAMES];
+	int frame_head;
+	int frame_num;
+
+	H264_PARSER_STATS_T stats;
+};
+
+static uint64_t parser_now_usec() {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (uint64_t) now.tv_sec * 1000000 + now.tv_usec;
+}
+
+H264_PARSER_T *h264_parser_create(IMAGE_POOL_T *pool) {
+	H264_PARSER_T *parser = calloc(1, sizeof(H264_PARSER_T));
+	parser->pool = pool;
+	parser->resync = true;
+	return parser;
+}
+
+void h264_parser_delete(H264_PARSER_T *parser) {
+	if (parser == NULL) {
+		return;
+	}
+	h264_parser_reset(parser);
+	free(parser);
+}
+
+static void scan_reset(H264_PARSER_T *parser) {
+	parser->scan_pos = 0;
+	parser->state = H264_SCAN_START_CODE;
+	parser->zeros = 0;
+	parser->has_slice = false;
+	parser->resync = true;
+}
+
+void h264_parser_reset(H264_PARSER_T *parser) {
+	while (parser->frame_num > 0) {
+		release_image(h264_parser_get_frame(parser));
+	}
+	release_image(parser->au);
+	parser->au = NULL;
+	scan_reset(parser);
+}
+
+//room for len more bytes in the unit in progress
+static bool reserve(H264_PARSER_T *parser, int len) {
+	if (parser->au == NULL) {
+		parser->au = image_pool_alloc(parser->pool,
+				MAX(len, H264_PARSER_READ_CHUNK));
+		if (parser->au != NULL) {
+			parser->au->image_size = 0;
+			parser->au->timestamp = parser->write_usec;
+		}
+	} else if (image_pool_capacity(parser->au) < parser->au->image_size + len) {
+		parser->au = image_pool_grow(parser->pool, parser->au,
+				parser->au->image_size + len);
+	}
+	if (parser->au == NULL) {
+		parser->stats.pool_failures++;
+		parser->stats.discarded_bytes += len;
+		scan_reset(parser);
+		return false;
+	}
+	return true;
+}
+
+static void queue_frame(H264_PARSER_T *parser, IMAGE_DATA *au) {
+	parser->frames[(parser->frame_head + parser->frame_num)
+			% H264_PARSER_MAX_FRAMES] = au;
+	parser->frame_num++;
+	parser->stats.frames++;
+}
+
+//a new unit starts at the current nal, returns the bytes cut from au
+static int unit_start(H264_PARSER_T *parser) {
+	IMAGE_DATA *au = parser->au;
+	int start = parser->nal_start;
+	int tail = au->image_size - start;
+
+	if (parser->has_slice) {
+		IMAGE_DATA *next = image_pool_alloc(parser->pool,
+				MAX(tail, H264_PARSER_READ_CHUNK));
+		if (next == NULL) { //complete the unit, resync on the next one
+			parser->stats.pool_failures++;
+			parser->stats.discarded_bytes += tail;
+			au->image_size = start;
+			queue_frame(parser, au);
+			parser->au = NULL;
+			scan_reset(parser);
+			return 0;
+		}
+		memcpy(next->image_buff, au->image_buff + start, tail);
+		next->image_size = tail;
+		next->timestamp = parser->write_usec;
+		au->image_size = start;
+		queue_frame(parser, au);
+		parser->au = next;
+	} else if (parser->resync) {
+		memmove(au->image_buff, au->image_buff + start, tail);
+		au->image_size = tail;
+		au->timestamp = parser->write_usec;
+		parser->stats.discarded_bytes += start;
+	} else {
+		return 0; //parameter sets before the first slice of this unit
+	}
+	parser->has_slice = false;
+	parser->resync = false;
+	parser->nal_start = 0;
+	return start;
+}
+
+static void scan(H264_PARSER_T *parser) {
+	while (parser->au != NULL && parser->scan_pos < parser->au->image_size
+			&& parser->frame_num < H264_PARSER_MAX_FRAMES) {
+		int pos = parser->scan_pos++;
+		unsigned char c = parser->au->image_buff[pos];
+		int type;
+
+		switch (parser->state) {
+		case H264_SCAN_START_CODE:
+			if (c == 0) {
+				parser->zeros++;
+				continue;
+			}
+			if (c == 1 && parser->zeros >= 2) {
+				//a 4 byte start code belongs to the next nal
+				parser->nal_start = pos - MIN(parser->zeros, 3);
+				parser->state = H264_SCAN_NAL_HEADER;
+			}
+			parser->zeros = 0;
+			break;
+		case H264_SCAN_NAL_HEADER:
+			type = c & 0x1f;
+			parser->state = H264_SCAN_START_CODE;
+			parser->zeros = (c == 0) ? 1 : 0;
+			if (type == NAL_SLICE || type == NAL_IDR) {
+				parser->state = H264_SCAN_SLICE_HEADER;
+			} else if (type >= NAL_SEI && type <= NAL_AUD) {
+				parser->scan_pos -= unit_start(parser);
+			}
+			break;
+		case H264_SCAN_SLICE_HEADER:
+			parser->state = H264_SCAN_START_CODE;
+			parser->zeros = (c == 0) ? 1 : 0;
+			if (c & 0x80) { //ue(v) first_mb_in_slice == 0
+				parser->scan_pos -= unit_start(parser);
+			}
+			//a slice before the unit start of a resync is partial, its
+			//bytes are discarded with the rest at the next unit start
+			if (parser->au != NULL && !parser->resync) {
+				parser->has_slice = true;
+			}
+			break;
+		}
+	}
+}
+
+int h264_parser_fill(H264_PARSER_T *parser, int fd) {
+	int len;
+	parser->write_usec = parser_now_usec();
+	if (!reserve(parser, H264_PARSER_READ_CHUNK)) {
+		unsigned char buff[4096]; //keep draining the source
+		return read(fd, buff, sizeof(buff));
+	}
+	len = read(fd, parser->au->image_buff + parser->au->image_size,
+			H264_PARSER_READ_CHUNK);
+	if (len > 0) {
+		parser->au->image_size += len;
+		parser->stats.bytes += len;
+		scan(parser);
+	}
+	return len;
+}
+
+int h264_parser_write(H264_PARSER_T *parser, const unsigned char *data,
+		int len) {
+	parser->write_usec = parser_now_usec();
+	if (!reserve(parser, len)) {
+		return -1;
+	}
+	memcpy(parser->au->image_buff + parser->au->image_size, data, len);
+	parser->au->image_size += len;
+	parser->stats.bytes += len;
+	scan(parser);
+	return len;
+}
+
+IMAGE_DATA *h264_parser_get_frame(H264_PARSER_T *parser) {
+	IMAGE_DATA *image_data;
+	if (parser->frame_num == 0) {
+		scan(parser); //bytes left over while the queue was full
+		if (parser->frame_num == 0) {
+			return NULL;
+		}
+	}
+	image_data = parser->frames[parser->frame_head];
+	parser->frame_head = (parser->frame_head + 1) % H264_PARSER_MAX_FRAMES;
+	parser->frame_num--;
+	return image_data;
+}
+
+void h264_parser_flush(H264_PARSER_T *parser) {
+	scan(parser);
+	if (parser->frame_num == H264_PARSER_MAX_FRAMES) {
+		return; //called again once the queue is drained
+	}
+	if (parser->au != NULL && parser->has_slice) {
+		queue_frame(parser, parser->au);
+	} else {
+		release_image(parser->au);
+	}
+	parser->au = NULL;
+	scan_reset(parser);
+}
+
+void h264_parser_get_stats(H264_PARSER_T *parser, H264_PARSER_STATS_T *stats) {
+	*stats = parser->stats;
+}
@@ -0,0 +1,50 @@
+#ifndef _H264_PARSER_H
+#define _H264_PARSER_H
+
+#include <stdint.h>
+#include "image_data.h"
+#include "image_pool.h"
+
+#define H264_PARSER_READ_CHUNK (64 * 1024)
+#define H264_PARSER_MAX_FRAMES 8
+
+typedef struct _H264_PARSER_T H264_PARSER_T;
+
+typedef struct {
+	uint64_t bytes;
+	uint64_t frames;
+	uint64_t discarded_bytes; //before the first access unit or after a failure
+	uint64_t pool_failures;
+} H264_PARSER_STATS_T;
+
+/**
+ * Splits an Annex-B byte stream into access units.
+ * A unit that holds a slice ends where the next one begins: at an access
+ * unit delimiter, SEI, SPS or PPS, or at a slice with first_mb_in_slice 0.
+ * The end of a unit is therefore only known once the first bytes of the
+ * next one have been read. Units are assembled in buffers from pool and
+ * stamped with the time their first bytes were written.
+ */
+H264_PARSER_T *h264_parser_create(IMAGE_POOL_T *pool);
+
+void h264_parser_delete(H264_PARSER_T *parser);
+
+/* drop queued units and the one in progress, wait for the next unit start */
+void h264_parser_reset(H264_PARSER_T *parser);
+
+/* read() up to H264_PARSER_READ_CHUNK bytes from fd, returns read()'s result */
+int h264_parser_fill(H264_PARSER_T *parser, int fd);
+
+/* copy data into the parser, returns len or -1 if the pool is exhausted */
+int h264_parser_write(H264_PARSER_T *parser, const unsigned char *data,
+		int len);
+
+/* next complete access unit or NULL, caller owns the returned reference */
+IMAGE_DATA *h264_parser_get_frame(H264_PARSER_T *parser);
+
+/* end of stream, the unit in progress is completed */
+void h264_parser_flush(H264_PARSER_T *parser);
+
+void h264_parser_get_stats(H264_PARSER_T *parser, H264_PARSER_STATS_T *stats);
+
+#endif
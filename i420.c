@@ -0,0 +1,53 @@
+#include "i420.h"
+#include <math.h>
+
+//i420.frag
+static const float lg_coef[3][3] = { { 65.481, 128.553, 24.966 }, { -37.797,
+		-74.203, 112.0 }, { 112.0, -93.786, -18.214 } };
+
+static unsigned char to_byte(float v) {
+	v = floorf(v + 0.5f);
+	return (v < 0) ? 0 : (v > 255) ? 255 : (unsigned char) v;
+}
+
+bool i420_supported(int width, int height) {
+	return width > 0 && height > 0 && width % 8 == 0 && height % 4 == 0;
+}
+
+void i420_from_rgb(const unsigned char *rgb, int width, int height,
+		int stride, int pixel_bytes, unsigned char *i420) {
+	unsigned char *y_plane = i420;
+	unsigned char *u_plane = y_plane + width * height;
+	unsigned char *v_plane = u_plane + (width / 2) * (height / 2);
+	const float *y_coef = lg_coef[0];
+	const float *u_coef = lg_coef[1];
+	const float *v_coef = lg_coef[2];
+
+	for (int y = 0; y < height; y++) {
+		const unsigned char *p = rgb + y * stride;
+		for (int x = 0; x < width; x++, p += pixel_bytes) {
+			y_plane[y * width + x] = to_byte(
+					16.0f
+							+ (y_coef[0] * p[0] + y_coef[1] * p[1]
+									+ y_coef[2] * p[2]) / 255.0f);
+		}
+	}
+	for (int y = 0; y < height / 2; y++) {
+		const unsigned char *row0 = rgb + 2 * y * stride;
+		const unsigned char *row1 = row0 + stride;
+		for (int x = 0; x < width / 2; x++) {
+			float c[3];
+			for (int i = 0; i < 3; i++) {
+				int o = 2 * x * pixel_bytes + i;
+				c[i] = (row0[o] + row0[o + pixel_bytes] + row1[o]
+						+ row1[o + pixel_bytes]) / (4 * 255.0f);
+			}
+			u_plane[y * (width / 2) + x] = to_byte(
+					128.0f + u_coef[0] * c[0] + u_coef[1] * c[1]
+							+ u_coef[2] * c[2]);
+			v_plane[y * (width / 2) + x] = to_byte(
+					128.0f + v_coef[0] * c[0] + v_coef[1] * c[1]
+							+ v_coef[2] * c[2]);
+		}
+	}
+}
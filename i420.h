@@ -0,0 +1,24 @@
+#ifndef _I420_H
+#define _I420_H
+
+#include <stdbool.h>
+
+/**
+ * I420 as shader/i420.frag packs it: a width x height y plane followed by
+ * width / 2 x height / 2 u and v planes, BT.601 limited range. Chroma is
+ * taken from the average of each 2x2 block. width has to be a multiple of
+ * 8 and height of 4 for the shader, which reads the planes back as RGBA.
+ */
+#define I420_SIZE(width, height) ((width) * (height) * 3 / 2)
+
+/* true if the gpu conversion can pack a frame of this size */
+bool i420_supported(int width, int height);
+
+/**
+ * CPU reference of i420.frag for checking it. rgb rows are stride bytes
+ * apart with pixel_bytes (3 or 4) per pixel, the first row goes first.
+ */
+void i420_from_rgb(const unsigned char *rgb, int width, int height,
+		int stride, int pixel_bytes, unsigned char *i420);
+
+#endif
@@ -0,0 +1,42 @@
+#include "image_data.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+IMAGE_DATA *create_image(int image_buff_size) {
+	IMAGE_DATA *image_data = malloc(sizeof(IMAGE_DATA) + image_buff_size);
+	memset(image_data, 0, sizeof(IMAGE_DATA));
+	image_data->refcount = 1;
+	image_data->image_buff = (unsigned char*) image_data + sizeof(IMAGE_DATA);
+	image_data->image_size = image_buff_size;
+	return image_data;
+}
+
+int addref_image(IMAGE_DATA *image_data) {
+	if (image_data == NULL)
+		return 0;
+
+	int refcount = __atomic_load_n(&image_data->refcount, __ATOMIC_RELAXED);
+	do {
+		if (refcount == 0) { //already on its way out
+			return 0;
+		}
+	} while (!__atomic_compare_exchange_n(&image_data->refcount, &refcount,
+			refcount + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+	return refcount + 1;
+}
+
+int release_image(IMAGE_DATA *image_data) {
+	if (image_data == NULL)
+		return 0;
+
+	int ret = __atomic_sub_fetch(&image_data->refcount, 1, __ATOMIC_ACQ_REL);
+	if (ret == 0) {
+		if (image_data->release) {
+			image_data->release(image_data);
+		} else {
+			free(image_data);
+		}
+	}
+	return ret;
+}
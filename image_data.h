@@ -0,0 +1,22 @@
+#ifndef _IMAGE_DATA_H
+#define _IMAGE_DATA_H
+
+#include <stdint.h>
+
+typedef struct _IMAGE_DATA {
+	int refcount;
+	int image_size;
+	unsigned char *image_buff;
+	uint64_t timestamp; //capture time in usec, 0 if unknown
+	//called instead of free() when refcount reaches zero
+	void (*release)(struct _IMAGE_DATA *image_data);
+	void *owner;
+} IMAGE_DATA;
+
+IMAGE_DATA *create_image(int image_buff_size);
+
+int addref_image(IMAGE_DATA *image_data);
+
+int release_image(IMAGE_DATA *image_data);
+
+#endif
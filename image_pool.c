@@ -0,0 +1,175 @@
+#include "image_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define NUM_OF_CLASSES (IMAGE_POOL_MAX_CLASS - IMAGE_POOL_MIN_CLASS + 1)
+#define HEADER_SIZE ((sizeof(IMAGE_POOL_ITEM_T) + IMAGE_POOL_ALIGN - 1) & ~(IMAGE_POOL_ALIGN - 1))
+
+typedef struct _IMAGE_POOL_ITEM_T {
+	IMAGE_DATA image; //must be first, release callback casts back
+	struct _IMAGE_POOL_ITEM_T *next;
+	int size_class;
+} IMAGE_POOL_ITEM_T;
+
+struct _IMAGE_POOL_T {
+	pthread_mutex_t mlock;
+	char name[32];
+	uint64_t max_bytes;
+	IMAGE_POOL_ITEM_T *free_list[NUM_OF_CLASSES];
+	IMAGE_POOL_STATS_T stats;
+};
+
+static int size_class(int size) {
+	int c = IMAGE_POOL_MIN_CLASS;
+	while (c <= IMAGE_POOL_MAX_CLASS && (1 << c) < size) {
+		c++;
+	}
+	return c;
+}
+
+static void pool_release(IMAGE_DATA *image_data) {
+	IMAGE_POOL_T *pool = (IMAGE_POOL_T*) image_data->owner;
+	IMAGE_POOL_ITEM_T *item = (IMAGE_POOL_ITEM_T*) image_data;
+	uint64_t bytes = 1 << item->size_class;
+
+	pthread_mutex_lock(&pool->mlock);
+	item->next = pool->free_list[item->size_class - IMAGE_POOL_MIN_CLASS];
+	pool->free_list[item->size_class - IMAGE_POOL_MIN_CLASS] = item;
+	pool->stats.in_use--;
+	pool->stats.in_use_bytes -= bytes;
+	pool->stats.free++;
+	pool->stats.free_bytes += bytes;
+	pthread_mutex_unlock(&pool->mlock);
+}
+
+//give free buffers back to the heap until bytes fit, call with mlock held
+static void pool_trim(IMAGE_POOL_T *pool, uint64_t bytes) {
+	for (int i = NUM_OF_CLASSES - 1; i >= 0; i--) {
+		while (pool->free_list[i] != NULL
+				&& pool->stats.in_use_bytes + pool->stats.free_bytes + bytes
+						> pool->max_bytes) {
+			IMAGE_POOL_ITEM_T *item = pool->free_list[i];
+			pool->free_list[i] = item->next;
+			pool->stats.free--;
+			pool->stats.free_bytes -= 1 << item->size_class;
+			free(item);
+		}
+	}
+}
+
+IMAGE_POOL_T *image_pool_create(const char *name, uint64_t max_bytes) {
+	IMAGE_POOL_T *pool = malloc(sizeof(IMAGE_POOL_T));
+	memset(pool, 0, sizeof(IMAGE_POOL_T));
+	pthread_mutex_init(&pool->mlock, NULL);
+	strncpy(pool->name, name, sizeof(pool->name) - 1);
+	pool->max_bytes = max_bytes;
+	return pool;
+}
+
+void image_pool_delete(IMAGE_POOL_T *pool) {
+	if (pool == NULL) {
+		return;
+	}
+	for (int i = 0; i < NUM_OF_CLASSES; i++) {
+		while (pool->free_list[i] != NULL) {
+			IMAGE_POOL_ITEM_T *item = pool->free_list[i];
+			pool->free_list[i] = item->next;
+			free(item);
+		}
+	}
+	pthread_mutex_destroy(&pool->mlock);
+	free(pool);
+}
+
+IMAGE_DATA *image_pool_alloc(IMAGE_POOL_T *pool, int size) {
+	int c = size_class(size);
+	if (c > IMAGE_POOL_MAX_CLASS) {
+		return NULL;
+	}
+	uint64_t bytes = 1 << c;
+	IMAGE_POOL_ITEM_T *item;
+
+	pthread_mutex_lock(&pool->mlock);
+	item = pool->free_list[c - IMAGE_POOL_MIN_CLASS];
+	if (item != NULL) {
+		pool->free_list[c - IMAGE_POOL_MIN_CLASS] = item->next;
+		pool->stats.free--;
+		pool->stats.free_bytes -= bytes;
+		pool->stats.reuses++;
+	} else {
+		if (pool->max_bytes > 0) {
+			pool_trim(pool, bytes);
+			if (pool->stats.in_use_bytes + pool->stats.free_bytes + bytes
+					> pool->max_bytes) {
+				pool->stats.failures++;
+				pthread_mutex_unlock(&pool->mlock);
+				return NULL;
+			}
+		}
+		if (posix_memalign((void**) &item, IMAGE_POOL_ALIGN,
+				HEADER_SIZE + bytes) != 0) {
+			pool->stats.failures++;
+			pthread_mutex_unlock(&pool->mlock);
+			return NULL;
+		}
+		pool->stats.allocs++;
+	}
+	pool->stats.in_use++;
+	pool->stats.in_use_bytes += bytes;
+	if (pool->stats.in_use_bytes + pool->stats.free_bytes
+			> pool->stats.peak_bytes) {
+		pool->stats.peak_bytes = pool->stats.in_use_bytes
+				+ pool->stats.free_bytes;
+	}
+	pthread_mutex_unlock(&pool->mlock);
+
+	memset(item, 0, sizeof(IMAGE_POOL_ITEM_T));
+	item->size_class = c;
+	item->image.refcount = 1;
+	item->image.image_buff = (unsigned char*) item + HEADER_SIZE;
+	item->image.image_size = size;
+	item->image.release = pool_release;
+	item->image.owner = pool;
+	return &item->image;
+}
+
+int image_pool_capacity(IMAGE_DATA *image_data) {
+	if (image_data->release != pool_release) {
+		return image_data->image_size;
+	}
+	return 1 << ((IMAGE_POOL_ITEM_T*) image_data)->size_class;
+}
+
+IMAGE_DATA *image_pool_grow(IMAGE_POOL_T *pool, IMAGE_DATA *image_data,
+		int size) {
+	IMAGE_DATA *new_image = image_pool_alloc(pool, size);
+	if (new_image != NULL && image_data != NULL) {
+		memcpy(new_image->image_buff, image_data->image_buff,
+				image_data->image_size);
+		new_image->image_size = image_data->image_size;
+		new_image->timestamp = image_data->timestamp;
+	}
+	release_image(image_data);
+	return new_image;
+}
+
+void image_pool_get_stats(IMAGE_POOL_T *pool, IMAGE_POOL_STATS_T *stats) {
+	pthread_mutex_lock(&pool->mlock);
+	*stats = pool->stats;
+	pthread_mutex_unlock(&pool->mlock);
+}
+
+void image_pool_print_stats(IMAGE_POOL_T *pool) {
+	IMAGE_POOL_STATS_T stats;
+	image_pool_get_stats(pool, &stats);
+	printf("%s : in use %d (%lluKB), free %d (%lluKB), peak %lluKB, "
+			"allocs %llu, reuses %llu, failures %llu\n", pool->name,
+			stats.in_use, (unsigned long long) stats.in_use_bytes / 1024,
+			stats.free, (unsigned long long) stats.free_bytes / 1024,
+			(unsigned long long) stats.peak_bytes / 1024,
+			(unsigned long long) stats.allocs,
+			(unsigned long long) stats.reuses,
+			(unsigned long long) stats.failures);
+}
@@ -0,0 +1,53 @@
+#ifndef _IMAGE_POOL_H
+#define _IMAGE_POOL_H
+
+#include <stdint.h>
+#include "image_data.h"
+
+#define IMAGE_POOL_ALIGN 64
+#define IMAGE_POOL_MIN_CLASS 16 //64KB
+#define IMAGE_POOL_MAX_CLASS 24 //16MB
+
+typedef struct _IMAGE_POOL_T IMAGE_POOL_T;
+
+typedef struct {
+	int in_use;
+	int free;
+	uint64_t in_use_bytes;
+	uint64_t free_bytes;
+	uint64_t peak_bytes; //high-water mark of in_use + free
+	uint64_t allocs; //buffers taken from the heap
+	uint64_t reuses; //buffers taken from the free lists
+	uint64_t failures; //refused by max_bytes
+} IMAGE_POOL_STATS_T;
+
+/**
+ * Pool of compressed frame buffers.
+ * Buffers are cache-line aligned and rounded up to power of two size
+ * classes. Released buffers go back to the free list of their class, so
+ * after the first few frames the pool stops touching the heap. max_bytes
+ * caps the total footprint (0 for no limit); free buffers of other classes
+ * are trimmed before an allocation is refused.
+ * The producers that own their buffers take them from here: the raw file
+ * input, the UDP receiver and the H.264 parser. MJPEG from a fifo does not,
+ * its frames are views into the ingest ring, see mjpeg_ring.h.
+ */
+IMAGE_POOL_T *image_pool_create(const char *name, uint64_t max_bytes);
+
+void image_pool_delete(IMAGE_POOL_T *pool);
+
+/* refcount 1, image_size = size, NULL if max_bytes would be exceeded */
+IMAGE_DATA *image_pool_alloc(IMAGE_POOL_T *pool, int size);
+
+/* usable bytes behind image_buff */
+int image_pool_capacity(IMAGE_DATA *image_data);
+
+/* new buffer of at least size bytes holding the old contents, releases the old one */
+IMAGE_DATA *image_pool_grow(IMAGE_POOL_T *pool, IMAGE_DATA *image_data,
+		int size);
+
+void image_pool_get_stats(IMAGE_POOL_T *pool, IMAGE_POOL_STATS_T *stats);
+
+void image_pool_print_stats(IMAGE_POOL_T *pool);
+
+#endif
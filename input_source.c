@@ -0,0 +1,442 @@
+#include "input_source.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "mjpeg_ring.h"
+#include "h264_parser.h"
+#include "frame_channel.h"
+#include "raw_container.h"
+#include "test_pattern.h"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+static uint64_t now_usec() {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (uint64_t) now.tv_sec * 1000000 + now.tv_usec;
+}
+
+IMAGE_DATA *input_source_next_frame(INPUT_SOURCE_T *source, long usec) {
+	return source->next_frame(source, usec);
+}
+
+void input_source_print_stats(INPUT_SOURCE_T *source) {
+	if (source != NULL && source->print_stats != NULL) {
+		source->print_stats(source);
+	}
+}
+
+void input_source_close(INPUT_SOURCE_T *source) {
+	if (source != NULL) {
+		source->close(source);
+	}
+}
+
+//byte streams are cut into frames by the same parsers whatever feeds them
+typedef struct {
+	MJPEG_RING_T *ring; //mjpeg
+	H264_PARSER_T *parser; //h264
+} STREAM_FRAMER_T;
+
+static int framer_init(STREAM_FRAMER_T *framer, enum INPUT_CODEC codec,
+		IMAGE_POOL_T *pool) {
+	if (codec == INPUT_CODEC_MJPEG) {
+		framer->ring = mjpeg_ring_create(MJPEG_RING_DEFAULT_SIZE);
+		return (framer->ring != NULL) ? 0 : -1;
+	} else {
+		framer->parser = h264_parser_create(pool);
+		return 0;
+	}
+}
+
+static void framer_delete(STREAM_FRAMER_T *framer) {
+	if (framer->ring != NULL) {
+		mjpeg_ring_delete(framer->ring);
+	}
+	h264_parser_delete(framer->parser);
+}
+
+static IMAGE_DATA *framer_get_frame(STREAM_FRAMER_T *framer) {
+	return (framer->ring != NULL) ?
+			mjpeg_ring_get_frame(framer->ring) :
+			h264_parser_get_frame(framer->parser);
+}
+
+static int framer_fill(STREAM_FRAMER_T *framer, int fd) {
+	return (framer->ring != NULL) ?
+			mjpeg_ring_fill(framer->ring, fd) :
+			h264_parser_fill(framer->parser, fd);
+}
+
+static void framer_write(STREAM_FRAMER_T *framer, const unsigned char *data,
+		int len) {
+	if (framer->ring != NULL) {
+		while (len > 0) {
+			int written = mjpeg_ring_write(framer->ring, data, len);
+			data += written;
+			len -= written;
+		}
+	} else {
+		h264_parser_write(framer->parser, data, len);
+	}
+}
+
+static void framer_print_stats(STREAM_FRAMER_T *framer, const char *name) {
+	if (framer->ring != NULL) {
+		MJPEG_RING_STATS_T stats;
+		mjpeg_ring_get_stats(framer->ring, &stats);
+		printf("%s : frames %llu, dropped %llu, resyncs %llu, "
+				"overflows %llu, stalls %llu, ring %dKB\n", name,
+				(unsigned long long) stats.frames,
+				(unsigned long long) stats.dropped_frames,
+				(unsigned long long) stats.resyncs,
+				(unsigned long long) stats.overflows,
+				(unsigned long long) stats.stalls,
+				MJPEG_RING_DEFAULT_SIZE / 1024);
+	} else {
+		H264_PARSER_STATS_T stats;
+		h264_parser_get_stats(framer->parser, &stats);
+		printf("%s : access units %llu, %lluKB, discarded %lluB, "
+				"pool failures %llu\n", name,
+				(unsigned long long) stats.frames,
+				(unsigned long long) stats.bytes / 1024,
+				(unsigned long long) stats.discarded_bytes,
+				(unsigned long long) stats.pool_failures);
+	}
+}
+
+//fifo
+
+typedef struct {
+	INPUT_SOURCE_T source; //must be first, callbacks cast back
+	int fd;
+	STREAM_FRAMER_T framer;
+} FIFO_SOURCE_T;
+
+static IMAGE_DATA *fifo_next_frame(INPUT_SOURCE_T *source, long usec) {
+	FIFO_SOURCE_T *fifo = (FIFO_SOURCE_T*) source;
+	uint64_t deadline = now_usec() + usec;
+	IMAGE_DATA *image_data;
+
+	while ((image_data = framer_get_frame(&fifo->framer)) == NULL) {
+		if (source->eos) {
+			return NULL;
+		}
+		if (usec > 0) {
+			uint64_t now = now_usec();
+			struct pollfd pfd = { fifo->fd, POLLIN };
+			if (now >= deadline
+					|| poll(&pfd, 1, (deadline - now + 999) / 1000) <= 0) {
+				return NULL;
+			}
+		}
+		if (framer_fill(&fifo->framer, fifo->fd) <= 0) {
+			source->eos = true;
+			if (fifo->framer.parser != NULL) {
+				h264_parser_flush(fifo->framer.parser); //the last unit
+			}
+		}
+	}
+	return image_data;
+}
+
+static void fifo_print_stats(INPUT_SOURCE_T *source) {
+	framer_print_stats(&((FIFO_SOURCE_T*) source)->framer, source->name);
+}
+
+static void fifo_close(INPUT_SOURCE_T *source) {
+	FIFO_SOURCE_T *fifo = (FIFO_SOURCE_T*) source;
+	framer_delete(&fifo->framer);
+	close(fifo->fd);
+	free(fifo);
+}
+
+INPUT_SOURCE_T *input_source_fifo_open(const char *path,
+		enum INPUT_CODEC codec, IMAGE_POOL_T *pool) {
+	FIFO_SOURCE_T *fifo = calloc(1, sizeof(FIFO_SOURCE_T));
+	fifo->fd = open(path, O_RDONLY);
+	if (fifo->fd == -1) {
+		printf("failed to open %s\n", path);
+		free(fifo);
+		return NULL;
+	}
+	if (framer_init(&fifo->framer, codec, pool) != 0) {
+		close(fifo->fd);
+		free(fifo);
+		return NULL;
+	}
+#ifdef F_SETPIPE_SZ
+	//larger pipe buffer, fewer wakeups per frame
+	fcntl(fifo->fd, F_SETPIPE_SZ, MJPEG_RING_READ_CHUNK);
+#endif
+	snprintf(fifo->source.name, sizeof(fifo->source.name), "%s fifo", path);
+	fifo->source.codec = codec;
+	fifo->source.next_frame = fifo_next_frame;
+	fifo->source.print_stats = fifo_print_stats;
+	fifo->source.close = fifo_close;
+	printf("%s ready\n", path);
+	return &fifo->source;
+}
+
+//udp
+
+typedef struct {
+	INPUT_SOURCE_T source; //must be first, callbacks cast back
+	UDP_RECEIVER_T *receiver;
+	int stream_id;
+	FRAME_CHANNEL_T channel;
+} UDP_SOURCE_T;
+
+//called on the udp receiver thread
+static void udp_frame_arrived(void *user, IMAGE_DATA *image_data) {
+	frame_channel_publish(&((UDP_SOURCE_T*) user)->channel, image_data);
+}
+
+static IMAGE_DATA *udp_next_frame(INPUT_SOURCE_T *source, long usec) {
+	return frame_channel_wait(&((UDP_SOURCE_T*) source)->channel, usec);
+}
+
+static void udp_print_stats(INPUT_SOURCE_T *source) {
+	frame_channel_print_stats(&((UDP_SOURCE_T*) source)->channel);
+}
+
+static void udp_close(INPUT_SOURCE_T *source) {
+	UDP_SOURCE_T *udp = (UDP_SOURCE_T*) source;
+	udp_receiver_remove_stream(udp->receiver, udp->stream_id);
+	frame_channel_destroy(&udp->channel);
+	free(udp);
+}
+
+INPUT_SOURCE_T *input_source_udp_open(UDP_RECEIVER_T *receiver, int stream_id,
+		enum INPUT_CODEC codec, IMAGE_POOL_T *pool) {
+	UDP_SOURCE_T *udp = calloc(1, sizeof(UDP_SOURCE_T));
+	udp->receiver = receiver;
+	udp->stream_id = stream_id;
+	snprintf(udp->source.name, sizeof(udp->source.name), "udp stream %d",
+			stream_id);
+	//no drops here, a lost h264 access unit breaks the following ones
+	frame_channel_init(&udp->channel, udp->source.name,
+			FRAME_CHANNEL_MAX_DEPTH);
+	if (udp_receiver_add_stream(receiver, stream_id,
+			(codec == INPUT_CODEC_MJPEG) ? UDP_PAYLOAD_MJPEG : UDP_PAYLOAD_H264,
+			pool, udp_frame_arrived, udp) != 0) {
+		printf("no free stream on the udp receiver\n");
+		frame_channel_destroy(&udp->channel);
+		free(udp);
+		return NULL;
+	}
+	udp->source.codec = codec;
+	udp->source.next_frame = udp_next_frame;
+	udp->source.print_stats = udp_print_stats;
+	udp->source.close = udp_close;
+	return &udp->source;
+}
+
+//file
+
+typedef struct {
+	INPUT_SOURCE_T source; //must be first, callbacks cast back
+	RAW_READER_T *reader;
+	IMAGE_POOL_T *pool; //NULL maps the frames
+	int frame_num;
+	int frame;
+	//wall clock and file time of the frame the clock was started at
+	uint64_t base_usec;
+	uint64_t base_time;
+} FILE_SOURCE_T;
+
+static IMAGE_DATA *file_next_frame(INPUT_SOURCE_T *source, long usec) {
+	FILE_SOURCE_T *file = (FILE_SOURCE_T*) source;
+
+	if (file->frame >= file->frame_num) {
+		source->eos = true;
+		return NULL;
+	}
+	if (source->realtime) {
+		uint64_t time = raw_reader_get_time(file->reader, file->frame);
+		uint64_t now = now_usec();
+		if (file->base_usec == 0) {
+			file->base_usec = now;
+			file->base_time = time;
+		} else if (time - file->base_time > now - file->base_usec) {
+			uint64_t wait = time - file->base_time - (now - file->base_usec);
+			if (usec > 0 && usec < wait) {
+				usleep(usec);
+				return NULL;
+			}
+			usleep(wait);
+		}
+	} else {
+		file->base_usec = 0; //restart the clock when pacing resumes
+	}
+	if (file->pool != NULL) {
+		return raw_reader_read_frame(file->reader, file->frame++, file->pool);
+	}
+	return raw_reader_get_frame(file->reader, file->frame++);
+}
+
+static void file_print_stats(INPUT_SOURCE_T *source) {
+	FILE_SOURCE_T *file = (FILE_SOURCE_T*) source;
+	printf("%s : frame %d/%d\n", source->name, file->frame, file->frame_num);
+}
+
+static void file_close(INPUT_SOURCE_T *source) {
+	FILE_SOURCE_T *file = (FILE_SOURCE_T*) source;
+	raw_reader_close(file->reader);
+	free(file);
+}
+
+static int file_get_frame_num(INPUT_SOURCE_T *source) {
+	return ((FILE_SOURCE_T*) source)->frame_num;
+}
+
+static int file_get_position(INPUT_SOURCE_T *source) {
+	return ((FILE_SOURCE_T*) source)->frame;
+}
+
+static int file_find_frame(INPUT_SOURCE_T *source, uint64_t usec) {
+	return raw_reader_find_frame(((FILE_SOURCE_T*) source)->reader, usec);
+}
+
+static void file_seek(INPUT_SOURCE_T *source, int frame) {
+	FILE_SOURCE_T *file = (FILE_SOURCE_T*) source;
+	file->frame = MAX(0, MIN(frame, file->frame_num - 1));
+	file->base_usec = 0;
+	source->eos = false;
+}
+
+INPUT_SOURCE_T *input_source_file_open(const char *path, IMAGE_POOL_T *pool) {
+	FILE_SOURCE_T *file;
+	RAW_READER_T *reader = raw_reader_open(path);
+	if (reader == NULL) {
+		printf("failed to open %s\n", path);
+		return NULL;
+	}
+	file = calloc(1, sizeof(FILE_SOURCE_T));
+	file->reader = reader;
+	file->pool = pool;
+	file->frame_num = raw_reader_get_frame_num(reader);
+	snprintf(file->source.name, sizeof(file->source.name), "%s", path);
+	file->source.codec = INPUT_CODEC_MJPEG;
+	file->source.realtime = true;
+	file->source.next_frame = file_next_frame;
+	file->source.print_stats = file_print_stats;
+	file->source.close = file_close;
+	file->source.get_frame_num = file_get_frame_num;
+	file->source.get_position = file_get_position;
+	file->source.find_frame = file_find_frame;
+	file->source.seek = file_seek;
+
+	printf("open %s : %d frames, %.1fsec%s\n", path, file->frame_num,
+			raw_reader_get_time(reader, file->frame_num - 1) / 1000000.0,
+			raw_reader_is_legacy(reader) ? " (legacy)" : "");
+	return &file->source;
+}
+
+//synthetic
+
+typedef struct {
+	INPUT_SOURCE_T source; //must be first, callbacks cast back
+	TEST_PATTERN_T *pattern;
+	unsigned char *buff;
+	STREAM_FRAMER_T framer;
+	uint64_t period; //usec
+	uint64_t next_tick; //ticks since the epoch, 0 before the first frame
+	uint64_t frames;
+	uint64_t bytes;
+	uint64_t late_frames; //ticks skipped because the reader was late
+} SYNTHETIC_SOURCE_T;
+
+static IMAGE_DATA *synthetic_next_frame(INPUT_SOURCE_T *source, long usec) {
+	SYNTHETIC_SOURCE_T *synthetic = (SYNTHETIC_SOURCE_T*) source;
+	IMAGE_DATA *image_data = framer_get_frame(&synthetic->framer);
+	uint64_t now = now_usec();
+	uint64_t tick;
+	uint64_t due;
+	int size;
+
+	if (image_data != NULL) {
+		return image_data;
+	}
+	if (synthetic->next_tick == 0) {
+		synthetic->next_tick = now / synthetic->period + 1;
+	}
+	tick = synthetic->next_tick;
+	due = tick * synthetic->period;
+	if (due > now) {
+		if (usec > 0 && usec < due - now) {
+			usleep(usec);
+			return NULL;
+		}
+		usleep(due - now);
+	} else if (now - due >= synthetic->period) {
+		uint64_t skipped = (now - due) / synthetic->period;
+		synthetic->late_frames += skipped;
+		tick += skipped;
+	}
+
+	if (source->codec == INPUT_CODEC_MJPEG) {
+		size = test_pattern_jpeg(synthetic->pattern, tick, synthetic->buff);
+	} else {
+		size = test_pattern_h264(synthetic->pattern, tick, synthetic->buff);
+	}
+	framer_write(&synthetic->framer, synthetic->buff, size);
+	synthetic->next_tick = tick + 1;
+	synthetic->frames++;
+	synthetic->bytes += size;
+
+	//an h264 unit is cut when the next one starts, like from a camera
+	return framer_get_frame(&synthetic->framer);
+}
+
+static void synthetic_print_stats(INPUT_SOURCE_T *source) {
+	SYNTHETIC_SOURCE_T *synthetic = (SYNTHETIC_SOURCE_T*) source;
+	printf("%s : frames %llu, late %llu, avg %lluKB\n", source->name,
+			(unsigned long long) synthetic->frames,
+			(unsigned long long) synthetic->late_frames,
+			(unsigned long long) ((synthetic->frames == 0) ?
+					0 : synthetic->bytes / synthetic->frames / 1024));
+	framer_print_stats(&synthetic->framer, source->name);
+}
+
+static void synthetic_close(INPUT_SOURCE_T *source) {
+	SYNTHETIC_SOURCE_T *synthetic = (SYNTHETIC_SOURCE_T*) source;
+	framer_delete(&synthetic->framer);
+	test_pattern_delete(synthetic->pattern);
+	free(synthetic->buff);
+	free(synthetic);
+}
+
+INPUT_SOURCE_T *input_source_synthetic_open(enum INPUT_CODEC codec,
+		int width, int height, int fps, int id, IMAGE_POOL_T *pool) {
+	SYNTHETIC_SOURCE_T *synthetic = calloc(1, sizeof(SYNTHETIC_SOURCE_T));
+	if (framer_init(&synthetic->framer, codec, pool) != 0) {
+		free(synthetic);
+		return NULL;
+	}
+	synthetic->pattern = test_pattern_create(width, height, id);
+	synthetic->buff = malloc(test_pattern_max_size(synthetic->pattern));
+	synthetic->period = 1000000 / MAX(fps, 1);
+	snprintf(synthetic->source.name, sizeof(synthetic->source.name),
+			"pattern%d %dx%d@%d", id, width, height, fps);
+	synthetic->source.codec = codec;
+	synthetic->source.next_frame = synthetic_next_frame;
+	synthetic->source.print_stats = synthetic_print_stats;
+	synthetic->source.close = synthetic_close;
+	return &synthetic->source;
+}
+
+void input_source_synthetic_set_jpeg_options(INPUT_SOURCE_T *source,
+		int detail, int restart_interval) {
+	SYNTHETIC_SOURCE_T *synthetic = (SYNTHETIC_SOURCE_T*) source;
+	test_pattern_set_jpeg_options(synthetic->pattern, detail,
+			restart_interval);
+	free(synthetic->buff);
+	synthetic->buff = malloc(test_pattern_max_size(synthetic->pattern));
+}
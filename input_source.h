@@ -0,0 +1,70 @@
+#ifndef _INPUT_SOURCE_H
+#define _INPUT_SOURCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "image_data.h"
+#include "image_pool.h"
+#include "udp_receiver.h"
+
+enum INPUT_CODEC {
+	INPUT_CODEC_MJPEG, INPUT_CODEC_H264
+};
+
+typedef struct _INPUT_SOURCE_T INPUT_SOURCE_T;
+
+/**
+ * Compressed frames of one camera, whatever they come from.
+ * Every source hands out complete frames, a JPEG or an H.264 access unit,
+ * stamped with their capture or arrival time, so the decoders, pairing and
+ * dumping do not care about the transport. A source is read by one thread.
+ */
+struct _INPUT_SOURCE_T {
+	char name[64];
+	enum INPUT_CODEC codec;
+	bool eos; //no more frames will come
+	bool realtime; //recordings are delivered at their recorded pace
+	/* NULL if no frame is due within usec, usec <= 0 waits for one */
+	IMAGE_DATA *(*next_frame)(INPUT_SOURCE_T *source, long usec);
+	void (*print_stats)(INPUT_SOURCE_T *source);
+	void (*close)(INPUT_SOURCE_T *source);
+	//recordings only, NULL for live sources
+	int (*get_frame_num)(INPUT_SOURCE_T *source);
+	int (*get_position)(INPUT_SOURCE_T *source); //next frame to deliver
+	int (*find_frame)(INPUT_SOURCE_T *source, uint64_t usec);
+	void (*seek)(INPUT_SOURCE_T *source, int frame); //also restarts the clock
+};
+
+/* byte stream from a fifo or pipe, blocks until a writer opens it */
+INPUT_SOURCE_T *input_source_fifo_open(const char *path,
+		enum INPUT_CODEC codec, IMAGE_POOL_T *pool);
+
+/* frames of stream_id from a udp receiver */
+INPUT_SOURCE_T *input_source_udp_open(UDP_RECEIVER_T *receiver, int stream_id,
+		enum INPUT_CODEC codec, IMAGE_POOL_T *pool);
+
+/**
+ * raw recording, see raw_container.h. Frames are read into buffers of pool,
+ * or mapped from the file one by one if pool is NULL.
+ */
+INPUT_SOURCE_T *input_source_file_open(const char *path, IMAGE_POOL_T *pool);
+
+/**
+ * Test pattern at fps, see test_pattern.h. Frames are produced on ticks
+ * of a clock shared by all synthetic sources and passed through the same
+ * stream parser as fifo input.
+ */
+INPUT_SOURCE_T *input_source_synthetic_open(enum INPUT_CODEC codec,
+		int width, int height, int fps, int id, IMAGE_POOL_T *pool);
+
+/* see test_pattern_set_jpeg_options() */
+void input_source_synthetic_set_jpeg_options(INPUT_SOURCE_T *source,
+		int detail, int restart_interval);
+
+IMAGE_DATA *input_source_next_frame(INPUT_SOURCE_T *source, long usec);
+
+void input_source_print_stats(INPUT_SOURCE_T *source);
+
+void input_source_close(INPUT_SOURCE_T *source);
+
+#endif
@@ -0,0 +1,826 @@
+#include "jpeg_decoder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+#include <jpeglib.h>
+
+#define JPEG_SLICER_MAX_SLICES (JPEG_SLICER_MAX_THREADS + 1)
+//every decode thread of a decoder can have its slices queued at once
+#define JPEG_SLICER_MAX_JOBS (JPEG_DECODER_MAX_THREADS * JPEG_SLICER_MAX_SLICES)
+
+typedef struct {
+	struct jpeg_error_mgr pub;
+	jmp_buf jmp;
+} ERROR_MGR_T;
+
+//one per thread, libjpeg keeps its tables between frames
+typedef struct {
+	struct jpeg_decompress_struct cinfo;
+	ERROR_MGR_T err;
+	//restart marker offsets and rebuilt slices of the last sliced frame
+	int *rst;
+	int rst_size;
+	unsigned char *slice_buff;
+	int slice_buff_size;
+} DECODE_CONTEXT_T;
+
+//a band of mcu rows rebuilt as a jpeg of its own
+typedef struct {
+	const unsigned char *data;
+	int size;
+	int scale_denom;
+	unsigned char *out;
+	int stride;
+	int rows;
+	int ret;
+	int *remaining; //slices of the frame not decoded yet
+} SLICE_JOB_T;
+
+struct _JPEG_SLICER_T {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond; //a job was queued
+	pthread_cond_t done_cond; //a job was finished
+	bool stop;
+	SLICE_JOB_T *queue[JPEG_SLICER_MAX_JOBS];
+	int head;
+	int num;
+	int num_threads;
+	pthread_t thread[JPEG_SLICER_MAX_THREADS];
+};
+
+typedef struct {
+	JPEG_DECODER_T *decoder;
+	pthread_t thread;
+} WORKER_T;
+
+struct _JPEG_DECODER_T {
+	char name[32];
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool stop;
+	JPEG_DECODER_CALLBACK decoded;
+	void *user;
+	JPEG_SLICER_T *slicer; //NULL decodes every frame on one thread
+	IMAGE_DATA *pending; //waiting for a thread
+	uint32_t pending_seq;
+	int pending_scale_denom;
+	int scale_denom;
+	uint32_t push_seq;
+	uint32_t ready_seq; //newest frame that became ready
+	bool has_ready_seq;
+	int num_threads;
+	WORKER_T worker[JPEG_DECODER_MAX_THREADS];
+	int num_frames;
+	JPEG_DECODER_FRAME_T frame[JPEG_DECODER_MAX_FRAMES];
+	JPEG_DECODER_STATS_T stats;
+};
+
+static void error_exit(j_common_ptr cinfo) {
+	ERROR_MGR_T *err = (ERROR_MGR_T*) cinfo->err;
+	longjmp(err->jmp, 1);
+}
+
+static void output_message(j_common_ptr cinfo) {
+	//corrupt frames are counted, not printed at frame rate
+}
+
+static void context_init(DECODE_CONTEXT_T *ctx) {
+	memset(ctx, 0, sizeof(DECODE_CONTEXT_T));
+	ctx->cinfo.err = jpeg_std_error(&ctx->err.pub);
+	ctx->err.pub.error_exit = error_exit;
+	ctx->err.pub.output_message = output_message;
+	jpeg_create_decompress(&ctx->cinfo);
+}
+
+static void context_destroy(DECODE_CONTEXT_T *ctx) {
+	jpeg_destroy_decompress(&ctx->cinfo);
+	free(ctx->rst);
+	free(ctx->slice_buff);
+}
+
+static float elapsed_msec(struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000.0f
+			+ (now.tv_nsec - start->tv_nsec) / 1000000.0f;
+}
+
+static int valid_scale_denom(int scale_denom) {
+	switch (scale_denom) {
+	case 2:
+	case 4:
+	case 8:
+		return scale_denom;
+	default:
+		return 1;
+	}
+}
+
+/**
+ * sliced turns fancy upsampling off: it blends the chroma of a row with the
+ * rows around it, which a band decoded as a jpeg of its own does not have,
+ * and would leave seams where the bands join. Plain upsampling repeats the
+ * chroma of a row, bands then join exactly at slightly blockier chroma
+ * edges.
+ */
+static void set_output_options(struct jpeg_decompress_struct *cinfo,
+		int scale_denom, bool sliced) {
+#ifdef JCS_EXTENSIONS
+	cinfo->out_color_space = JCS_EXT_RGBA; //uploads without conversion
+#else
+	cinfo->out_color_space = JCS_RGB;
+#endif
+	cinfo->dct_method = JDCT_IFAST;
+	cinfo->do_fancy_upsampling = sliced ? FALSE : TRUE;
+	cinfo->scale_num = 1;
+	cinfo->scale_denom = scale_denom;
+}
+
+/* output size of a jpeg without decoding it */
+static int read_dimensions(DECODE_CONTEXT_T *ctx, const unsigned char *data,
+		int size, int scale_denom, JPEG_DECODER_FRAME_T *frame) {
+	struct jpeg_decompress_struct *cinfo = &ctx->cinfo;
+	if (setjmp(ctx->err.jmp)) {
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+	jpeg_mem_src(cinfo, (unsigned char*) data, size);
+	if (jpeg_read_header(cinfo, TRUE) != JPEG_HEADER_OK) {
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+	set_output_options(cinfo, scale_denom, false);
+	jpeg_calc_output_dimensions(cinfo);
+	frame->width = cinfo->output_width;
+	frame->height = cinfo->output_height;
+	frame->components = cinfo->output_components;
+	frame->scale_denom = scale_denom;
+	jpeg_abort_decompress(cinfo);
+	return 0;
+}
+
+/* decode into out, rows of stride bytes, at most rows of them */
+static int decode_into(DECODE_CONTEXT_T *ctx, const unsigned char *data,
+		int size, int scale_denom, bool sliced, unsigned char *out, int stride,
+		int rows) {
+	struct jpeg_decompress_struct *cinfo = &ctx->cinfo;
+	if (setjmp(ctx->err.jmp)) {
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+	jpeg_mem_src(cinfo, (unsigned char*) data, size);
+	if (jpeg_read_header(cinfo, TRUE) != JPEG_HEADER_OK) {
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+	set_output_options(cinfo, scale_denom, sliced);
+	jpeg_start_decompress(cinfo);
+	if (cinfo->output_width * cinfo->output_components != stride
+			|| cinfo->output_height > rows) {
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+	while (cinfo->output_scanline < cinfo->output_height) {
+		JSAMPROW row[8];
+		int num = 0;
+		for (; num < 8 && cinfo->output_scanline + num < cinfo->output_height;
+				num++) {
+			row[num] = out + (cinfo->output_scanline + num) * stride;
+		}
+		jpeg_read_scanlines(cinfo, row, num);
+	}
+	jpeg_finish_decompress(cinfo);
+	return 0;
+}
+
+static void slice_job_run(DECODE_CONTEXT_T *ctx, SLICE_JOB_T *job) {
+	job->ret = decode_into(ctx, job->data, job->size, job->scale_denom, true,
+			job->out, job->stride, job->rows);
+}
+
+//queued job or NULL, called with the slicer locked
+static SLICE_JOB_T *slicer_take(JPEG_SLICER_T *slicer) {
+	if (slicer->num == 0) {
+		return NULL;
+	}
+	SLICE_JOB_T *job = slicer->queue[slicer->head];
+	slicer->head = (slicer->head + 1) % JPEG_SLICER_MAX_JOBS;
+	slicer->num--;
+	return job;
+}
+
+//called with the slicer locked
+static void slicer_done(JPEG_SLICER_T *slicer, SLICE_JOB_T *job) {
+	(*job->remaining)--;
+	pthread_cond_broadcast(&slicer->done_cond);
+}
+
+static void *slice_thread(void *arg) {
+	JPEG_SLICER_T *slicer = (JPEG_SLICER_T*) arg;
+	DECODE_CONTEXT_T ctx;
+	context_init(&ctx);
+
+	pthread_mutex_lock(&slicer->mutex);
+	while (1) {
+		SLICE_JOB_T *job;
+		while (!slicer->stop && (job = slicer_take(slicer)) == NULL) {
+			pthread_cond_wait(&slicer->cond, &slicer->mutex);
+		}
+		if (slicer->stop) {
+			break;
+		}
+		pthread_mutex_unlock(&slicer->mutex);
+		slice_job_run(&ctx, job);
+		pthread_mutex_lock(&slicer->mutex);
+		slicer_done(slicer, job);
+	}
+	pthread_mutex_unlock(&slicer->mutex);
+
+	context_destroy(&ctx);
+	return NULL;
+}
+
+JPEG_SLICER_T *jpeg_slicer_create(int num_threads) {
+	JPEG_SLICER_T *slicer = calloc(1, sizeof(JPEG_SLICER_T));
+	if (slicer == NULL) {
+		return NULL;
+	}
+	if (num_threads > JPEG_SLICER_MAX_THREADS) {
+		num_threads = JPEG_SLICER_MAX_THREADS;
+	}
+	pthread_mutex_init(&slicer->mutex, 0);
+	pthread_cond_init(&slicer->cond, 0);
+	pthread_cond_init(&slicer->done_cond, 0);
+	for (int i = 0; i < num_threads; i++) {
+		if (pthread_create(&slicer->thread[i], NULL, slice_thread, slicer)
+				!= 0) {
+			printf("jpeg slicer : failed to start slice thread\n");
+			break;
+		}
+		slicer->num_threads++;
+	}
+	return slicer;
+}
+
+void jpeg_slicer_delete(JPEG_SLICER_T *slicer) {
+	if (slicer == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&slicer->mutex);
+	slicer->stop = true;
+	pthread_cond_broadcast(&slicer->cond);
+	pthread_mutex_unlock(&slicer->mutex);
+	for (int i = 0; i < slicer->num_threads; i++) {
+		pthread_join(slicer->thread[i], NULL);
+	}
+	pthread_cond_destroy(&slicer->done_cond);
+	pthread_cond_destroy(&slicer->cond);
+	pthread_mutex_destroy(&slicer->mutex);
+	free(slicer);
+}
+
+static int get16(const unsigned char *p) {
+	return (p[0] << 8) | p[1];
+}
+
+typedef struct {
+	int header_size; //up to the end of SOS
+	int sof; //offset of the SOF marker
+	int width;
+	int height;
+	int mcu_width;
+	int mcu_height;
+	int restart_interval;
+	int end; //of the entropy coded data
+	int num_rst;
+} SLICE_LAYOUT_T;
+
+/**
+ * Markers of a baseline single scan jpeg with restart intervals and the
+ * offsets of its RST markers in ctx->rst. Anything else can not be sliced.
+ */
+static int parse_layout(DECODE_CONTEXT_T *ctx, const unsigned char *data,
+		int size, SLICE_LAYOUT_T *layout) {
+	int pos = 2;
+	int num_comp = 0;
+	int hmax = 1;
+	int vmax = 1;
+
+	memset(layout, 0, sizeof(SLICE_LAYOUT_T));
+	if (size < 4 || data[0] != 0xff || data[1] != 0xd8) {
+		return -1;
+	}
+	while (layout->header_size == 0) {
+		if (pos + 4 > size || data[pos] != 0xff) {
+			return -1;
+		}
+		int marker = data[pos + 1];
+		if (marker == 0xff) { //fill byte
+			pos++;
+			continue;
+		}
+		int len = get16(data + pos + 2);
+		if (pos + 2 + len > size) {
+			return -1;
+		}
+		const unsigned char *p = data + pos + 4;
+		switch (marker) {
+		case 0xc0: //baseline
+		case 0xc1: //extended sequential, huffman
+			layout->sof = pos;
+			layout->height = get16(p + 1);
+			layout->width = get16(p + 3);
+			num_comp = p[5];
+			if (len < 8 + num_comp * 3) {
+				return -1;
+			}
+			for (int i = 0; i < num_comp; i++) {
+				int h = p[7 + i * 3] >> 4;
+				int v = p[7 + i * 3] & 0xf;
+				hmax = (h > hmax) ? h : hmax;
+				vmax = (v > vmax) ? v : vmax;
+			}
+			break;
+		case 0xc2 ... 0xc3: //progressive, lossless
+		case 0xc5 ... 0xc7:
+		case 0xc9 ... 0xcb:
+		case 0xcd ... 0xcf:
+			return -1;
+		case 0xdd: //DRI
+			layout->restart_interval = get16(p);
+			break;
+		case 0xda: //SOS
+			if (layout->sof == 0 || p[0] != num_comp) {
+				return -1; //a scan of its own per component
+			}
+			layout->header_size = pos + 2 + len;
+			break;
+		}
+		pos += 2 + len;
+	}
+	if (layout->restart_interval == 0 || layout->height == 0) {
+		return -1;
+	}
+	layout->mcu_width = (num_comp == 1) ? 8 : 8 * hmax;
+	layout->mcu_height = (num_comp == 1) ? 8 : 8 * vmax;
+
+	for (pos = layout->header_size; pos + 1 < size;) {
+		const unsigned char *ff = memchr(data + pos, 0xff, size - 1 - pos);
+		if (ff == NULL) {
+			break;
+		}
+		pos = ff - data;
+		int marker = data[pos + 1];
+		if (marker >= 0xd0 && marker <= 0xd7) {
+			if (layout->num_rst == ctx->rst_size) {
+				int rst_size = ctx->rst_size ? ctx->rst_size * 2 : 256;
+				int *rst = realloc(ctx->rst, rst_size * sizeof(int));
+				if (rst == NULL) {
+					return -1;
+				}
+				ctx->rst = rst;
+				ctx->rst_size = rst_size;
+			}
+			ctx->rst[layout->num_rst++] = pos;
+			pos += 2;
+		} else if (marker == 0xd9) {
+			layout->end = pos;
+			break;
+		} else if (marker == 0x00 || marker == 0xff) { //stuffing, fill
+			pos += (marker == 0x00) ? 2 : 1;
+		} else {
+			return -1; //DNL or another scan
+		}
+	}
+	if (layout->end == 0) {
+		layout->end = size; //truncated, the last interval is cut short
+	}
+	return 0;
+}
+
+/**
+ * Rebuilds bands of whole restart intervals as jpegs of their own and
+ * decodes them on the slicer threads and this one. The DC predictions
+ * restart at every RST marker, so bands decode independently.
+ * Returns non zero if the frame has to be decoded in one piece.
+ */
+static int decode_sliced(JPEG_SLICER_T *slicer, DECODE_CONTEXT_T *ctx,
+		const unsigned char *data, int size, int scale_denom,
+		JPEG_DECODER_FRAME_T *frame) {
+	SLICE_LAYOUT_T layout;
+	if (parse_layout(ctx, data, size, &layout) != 0) {
+		return -1;
+	}
+	int mcus_per_row = (layout.width + layout.mcu_width - 1)
+			/ layout.mcu_width;
+	int mcu_rows = (layout.height + layout.mcu_height - 1) / layout.mcu_height;
+	int num_intervals = (mcus_per_row * mcu_rows + layout.restart_interval - 1)
+			/ layout.restart_interval;
+	if (layout.num_rst + 1 != num_intervals) {
+		return -1; //lost or extra markers
+	}
+	//a band has to start on an mcu row
+	int unit_intervals; //intervals of the smallest band
+	int unit_rows; //mcu rows of the smallest band
+	if (mcus_per_row % layout.restart_interval == 0) {
+		unit_intervals = mcus_per_row / layout.restart_interval;
+		unit_rows = 1;
+	} else if (layout.restart_interval % mcus_per_row == 0) {
+		unit_intervals = 1;
+		unit_rows = layout.restart_interval / mcus_per_row;
+	} else {
+		return -1;
+	}
+	int num_units = (mcu_rows + unit_rows - 1) / unit_rows;
+	int num_slices = slicer->num_threads + 1;
+	if (num_slices > num_units) {
+		num_slices = num_units;
+	}
+	if (num_slices < 2) {
+		return -1;
+	}
+
+	//headers without APPn and COM, the thumbnails are not needed
+	int header_size = 2;
+	//the header, then every slice with a copy of it, its intervals and EOI
+	int needed = (num_slices + 1) * layout.header_size
+			+ (layout.end - layout.header_size) + 2 * num_slices;
+	if (ctx->slice_buff_size < needed) {
+		free(ctx->slice_buff);
+		ctx->slice_buff = malloc(needed);
+		if (ctx->slice_buff == NULL) {
+			ctx->slice_buff_size = 0;
+			return -1;
+		}
+		ctx->slice_buff_size = needed;
+	}
+	unsigned char *header = ctx->slice_buff;
+	int sof = 0; //in the rebuilt header
+	header[0] = 0xff;
+	header[1] = 0xd8;
+	for (int pos = 2; pos < layout.header_size;) {
+		if (data[pos + 1] == 0xff) {
+			pos++;
+			continue;
+		}
+		int len = 2 + get16(data + pos + 2);
+		int marker = data[pos + 1];
+		if (!(marker >= 0xe0 && marker <= 0xef) && marker != 0xfe) {
+			if (pos == layout.sof) {
+				sof = header_size;
+			}
+			memcpy(header + header_size, data + pos, len);
+			header_size += len;
+		}
+		pos += len;
+	}
+
+	SLICE_JOB_T job[JPEG_SLICER_MAX_SLICES];
+	int remaining = num_slices;
+	int stride = frame->width * frame->components;
+	unsigned char *p = header + header_size;
+	for (int s = 0; s < num_slices; s++) {
+		int unit0 = num_units * s / num_slices;
+		int unit1 = num_units * (s + 1) / num_slices;
+		int row0 = unit0 * unit_rows; //mcu rows
+		int row1 = (unit1 * unit_rows < mcu_rows) ? unit1 * unit_rows : mcu_rows;
+		int height = row1 * layout.mcu_height;
+		if (height > layout.height) {
+			height = layout.height;
+		}
+		height -= row0 * layout.mcu_height;
+		int interval0 = unit0 * unit_intervals;
+		int interval1 = unit1 * unit_intervals;
+		if (interval1 > num_intervals) {
+			interval1 = num_intervals;
+		}
+
+		job[s].data = p;
+		memcpy(p, header, header_size);
+		p[sof + 5] = height >> 8;
+		p[sof + 6] = height & 0xff;
+		p += header_size;
+		for (int i = interval0; i < interval1; i++) {
+			int start = (i == 0) ? layout.header_size : ctx->rst[i - 1] + 2;
+			int end = (i < layout.num_rst) ? ctx->rst[i] : layout.end;
+			if (i > interval0) { //renumbered from RST0
+				*p++ = 0xff;
+				*p++ = 0xd0 + ((i - interval0 - 1) & 7);
+			}
+			memcpy(p, data + start, end - start);
+			p += end - start;
+		}
+		*p++ = 0xff;
+		*p++ = 0xd9;
+		job[s].size = p - job[s].data;
+		job[s].scale_denom = scale_denom;
+		job[s].out = frame->pixels
+				+ (row0 * layout.mcu_height / scale_denom) * stride;
+		job[s].stride = stride;
+		job[s].rows = frame->height - row0 * layout.mcu_height / scale_denom;
+		job[s].ret = 0;
+		job[s].remaining = &remaining;
+	}
+
+	//the first band is decoded here, the others as threads come free
+	pthread_mutex_lock(&slicer->mutex);
+	for (int s = 1; s < num_slices; s++) {
+		if (slicer->num < JPEG_SLICER_MAX_JOBS) {
+			slicer->queue[(slicer->head + slicer->num) % JPEG_SLICER_MAX_JOBS] =
+					&job[s];
+			slicer->num++;
+		} else { //decode it here
+			pthread_mutex_unlock(&slicer->mutex);
+			slice_job_run(ctx, &job[s]);
+			pthread_mutex_lock(&slicer->mutex);
+			slicer_done(slicer, &job[s]);
+		}
+	}
+	pthread_cond_broadcast(&slicer->cond);
+	pthread_mutex_unlock(&slicer->mutex);
+
+	slice_job_run(ctx, &job[0]);
+
+	pthread_mutex_lock(&slicer->mutex);
+	slicer_done(slicer, &job[0]);
+	while (remaining > 0) {
+		//help out instead of waiting, the job may be of another frame
+		SLICE_JOB_T *other = slicer_take(slicer);
+		if (other) {
+			pthread_mutex_unlock(&slicer->mutex);
+			slice_job_run(ctx, other);
+			pthread_mutex_lock(&slicer->mutex);
+			slicer_done(slicer, other);
+		} else {
+			pthread_cond_wait(&slicer->done_cond, &slicer->mutex);
+		}
+	}
+	pthread_mutex_unlock(&slicer->mutex);
+
+	for (int s = 0; s < num_slices; s++) {
+		if (job[s].ret != 0) {
+			return -1;
+		}
+	}
+	frame->slices = num_slices;
+	return 0;
+}
+
+static int context_decode(DECODE_CONTEXT_T *ctx, JPEG_SLICER_T *slicer,
+		const unsigned char *data, int size, int scale_denom,
+		JPEG_DECODER_FRAME_T *frame) {
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (read_dimensions(ctx, data, size, scale_denom, frame) != 0) {
+		return -1;
+	}
+	int stride = frame->width * frame->components;
+	int needed = stride * frame->height;
+	if (frame->pixels_size < needed) {
+		free(frame->pixels);
+		frame->pixels = malloc(needed);
+		if (frame->pixels == NULL) {
+			frame->pixels_size = 0;
+			return -1;
+		}
+		frame->pixels_size = needed;
+	}
+	frame->slices = 1;
+	if (slicer == NULL || slicer->num_threads == 0
+			|| decode_sliced(slicer, ctx, data, size, scale_denom, frame)
+					!= 0) {
+		frame->slices = 1;
+		if (decode_into(ctx, data, size, scale_denom, false, frame->pixels,
+				stride, frame->height) != 0) {
+			return -1;
+		}
+	}
+
+	frame->decode_msec = elapsed_msec(&start);
+	return 0;
+}
+
+int jpeg_decode(const unsigned char *data, int size, int scale_denom,
+		JPEG_SLICER_T *slicer, JPEG_DECODER_FRAME_T *frame) {
+	DECODE_CONTEXT_T ctx;
+	context_init(&ctx);
+	int ret = context_decode(&ctx, slicer, data, size,
+			valid_scale_denom(scale_denom), frame);
+	context_destroy(&ctx);
+	return ret;
+}
+
+static JPEG_DECODER_FRAME_T *find_frame(JPEG_DECODER_T *decoder,
+		enum JPEG_DECODER_FRAME_STATE state) {
+	for (int i = 0; i < decoder->num_frames; i++) {
+		if (decoder->frame[i].state == state) {
+			return &decoder->frame[i];
+		}
+	}
+	return NULL;
+}
+
+static void *decode_thread(void *arg) {
+	JPEG_DECODER_T *decoder = ((WORKER_T*) arg)->decoder;
+	DECODE_CONTEXT_T ctx;
+	context_init(&ctx);
+
+	pthread_mutex_lock(&decoder->mutex);
+	while (1) {
+		while (!decoder->stop && decoder->pending == NULL) {
+			pthread_cond_wait(&decoder->cond, &decoder->mutex);
+		}
+		if (decoder->stop) {
+			break;
+		}
+		IMAGE_DATA *image_data = decoder->pending;
+		decoder->pending = NULL;
+		//never NULL, there is a frame per thread beyond ready and taken
+		JPEG_DECODER_FRAME_T *frame = find_frame(decoder,
+				JPEG_DECODER_FRAME_FREE);
+		frame->state = JPEG_DECODER_FRAME_DECODING;
+		frame->seq = decoder->pending_seq;
+		frame->timestamp = image_data->timestamp;
+		int scale_denom = decoder->pending_scale_denom;
+		pthread_mutex_unlock(&decoder->mutex);
+
+		int ret = context_decode(&ctx, decoder->slicer, image_data->image_buff,
+				image_data->image_size, scale_denom, frame);
+		release_image(image_data);
+
+		bool ready = false;
+		pthread_mutex_lock(&decoder->mutex);
+		if (ret != 0) {
+			decoder->stats.errors++;
+			frame->state = JPEG_DECODER_FRAME_FREE;
+		} else {
+			decoder->stats.frames++;
+			if (frame->slices > 1) {
+				decoder->stats.sliced++;
+			}
+			decoder->stats.decode_msec_sum += frame->decode_msec;
+			decoder->stats.decode_msec_last = frame->decode_msec;
+			if (frame->decode_msec > decoder->stats.decode_msec_max) {
+				decoder->stats.decode_msec_max = frame->decode_msec;
+			}
+			if (decoder->has_ready_seq
+					&& (int32_t) (frame->seq - decoder->ready_seq) < 0) {
+				decoder->stats.late++;
+				frame->state = JPEG_DECODER_FRAME_FREE;
+			} else {
+				JPEG_DECODER_FRAME_T *old = find_frame(decoder,
+						JPEG_DECODER_FRAME_READY);
+				if (old) {
+					decoder->stats.unshown++;
+					old->state = JPEG_DECODER_FRAME_FREE;
+				}
+				frame->state = JPEG_DECODER_FRAME_READY;
+				decoder->ready_seq = frame->seq;
+				decoder->has_ready_seq = true;
+				ready = true;
+			}
+		}
+		pthread_mutex_unlock(&decoder->mutex);
+
+		if (ready && decoder->decoded) {
+			decoder->decoded(decoder->user, frame);
+		}
+		pthread_mutex_lock(&decoder->mutex);
+	}
+	pthread_mutex_unlock(&decoder->mutex);
+
+	context_destroy(&ctx);
+	return NULL;
+}
+
+JPEG_DECODER_T *jpeg_decoder_create(const char *name, int num_threads,
+		int slice_threads, JPEG_DECODER_CALLBACK decoded, void *user) {
+	JPEG_DECODER_T *decoder = calloc(1, sizeof(JPEG_DECODER_T));
+	if (decoder == NULL) {
+		return NULL;
+	}
+	if (num_threads < 1) {
+		num_threads = 1;
+	} else if (num_threads > JPEG_DECODER_MAX_THREADS) {
+		num_threads = JPEG_DECODER_MAX_THREADS;
+	}
+	strncpy(decoder->name, name, sizeof(decoder->name) - 1);
+	pthread_mutex_init(&decoder->mutex, 0);
+	pthread_cond_init(&decoder->cond, 0);
+	decoder->decoded = decoded;
+	decoder->user = user;
+	decoder->scale_denom = 1;
+	if (slice_threads > 0) {
+		decoder->slicer = jpeg_slicer_create(slice_threads);
+	}
+	decoder->num_frames = num_threads + 2;
+	for (int i = 0; i < num_threads; i++) {
+		decoder->worker[i].decoder = decoder;
+		if (pthread_create(&decoder->worker[i].thread, NULL, decode_thread,
+				&decoder->worker[i]) != 0) {
+			printf("%s : failed to start decode thread\n", decoder->name);
+			break;
+		}
+		decoder->num_threads++;
+	}
+	if (decoder->num_threads == 0) {
+		jpeg_decoder_delete(decoder);
+		return NULL;
+	}
+	return decoder;
+}
+
+void jpeg_decoder_delete(JPEG_DECODER_T *decoder) {
+	if (decoder == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&decoder->mutex);
+	decoder->stop = true;
+	pthread_cond_broadcast(&decoder->cond);
+	pthread_mutex_unlock(&decoder->mutex);
+	for (int i = 0; i < decoder->num_threads; i++) {
+		pthread_join(decoder->worker[i].thread, NULL);
+	}
+	jpeg_slicer_delete(decoder->slicer);
+	release_image(decoder->pending);
+	for (int i = 0; i < decoder->num_frames; i++) {
+		free(decoder->frame[i].pixels);
+	}
+	pthread_cond_destroy(&decoder->cond);
+	pthread_mutex_destroy(&decoder->mutex);
+	free(decoder);
+}
+
+void jpeg_decoder_push(JPEG_DECODER_T *decoder, IMAGE_DATA *image_data) {
+	IMAGE_DATA *replaced;
+
+	addref_image(image_data);
+	pthread_mutex_lock(&decoder->mutex);
+	replaced = decoder->pending;
+	if (replaced) {
+		decoder->stats.replaced++;
+	}
+	decoder->pending = image_data;
+	decoder->pending_seq = decoder->push_seq++;
+	decoder->pending_scale_denom = decoder->scale_denom;
+	pthread_cond_signal(&decoder->cond);
+	pthread_mutex_unlock(&decoder->mutex);
+
+	release_image(replaced);
+}
+
+void jpeg_decoder_set_scale(JPEG_DECODER_T *decoder, int scale_denom) {
+	pthread_mutex_lock(&decoder->mutex);
+	decoder->scale_denom = valid_scale_denom(scale_denom);
+	pthread_mutex_unlock(&decoder->mutex);
+}
+
+JPEG_DECODER_FRAME_T *jpeg_decoder_get_frame(JPEG_DECODER_T *decoder) {
+	pthread_mutex_lock(&decoder->mutex);
+	JPEG_DECODER_FRAME_T *frame = find_frame(decoder, JPEG_DECODER_FRAME_READY);
+	if (frame) {
+		frame->state = JPEG_DECODER_FRAME_TAKEN;
+	}
+	pthread_mutex_unlock(&decoder->mutex);
+	return frame;
+}
+
+void jpeg_decoder_put_frame(JPEG_DECODER_T *decoder,
+		JPEG_DECODER_FRAME_T *frame) {
+	if (frame == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&decoder->mutex);
+	frame->state = JPEG_DECODER_FRAME_FREE;
+	pthread_mutex_unlock(&decoder->mutex);
+}
+
+void jpeg_decoder_get_stats(JPEG_DECODER_T *decoder,
+		JPEG_DECODER_STATS_T *stats) {
+	pthread_mutex_lock(&decoder->mutex);
+	*stats = decoder->stats;
+	pthread_mutex_unlock(&decoder->mutex);
+}
+
+void jpeg_decoder_print_stats(JPEG_DECODER_T *decoder) {
+	JPEG_DECODER_STATS_T stats;
+	jpeg_decoder_get_stats(decoder, &stats);
+	printf("%s : %d threads, %d slice threads, frames %llu, sliced %llu, "
+			"replaced %llu, unshown %llu, late %llu, errors %llu\n",
+			decoder->name, decoder->num_threads,
+			decoder->slicer ? decoder->slicer->num_threads : 0,
+			(unsigned long long) stats.frames,
+			(unsigned long long) stats.sliced,
+			(unsigned long long) stats.replaced,
+			(unsigned long long) stats.unshown,
+			(unsigned long long) stats.late,
+			(unsigned long long) stats.errors);
+	printf("%s : decode avg %.2fms, max %.2fms, last %.2fms, scale 1/%d\n",
+			decoder->name,
+			stats.frames ? stats.decode_msec_sum / stats.frames : 0,
+			stats.decode_msec_max, stats.decode_msec_last,
+			decoder->scale_denom);
+}
@@ -0,0 +1,102 @@
+#ifndef _JPEG_DECODER_H
+#define _JPEG_DECODER_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "image_data.h"
+
+#define JPEG_DECODER_MAX_THREADS 8
+#define JPEG_SLICER_MAX_THREADS 8
+//every thread decodes into its own frame, one is ready and one is uploaded
+#define JPEG_DECODER_MAX_FRAMES (JPEG_DECODER_MAX_THREADS + 2)
+
+enum JPEG_DECODER_FRAME_STATE {
+	JPEG_DECODER_FRAME_FREE,
+	JPEG_DECODER_FRAME_DECODING,
+	JPEG_DECODER_FRAME_READY,
+	JPEG_DECODER_FRAME_TAKEN
+};
+
+typedef struct {
+	enum JPEG_DECODER_FRAME_STATE state;
+	uint32_t seq; //order the compressed frames were pushed in
+	uint64_t timestamp; //of the compressed frame
+	int width;
+	int height;
+	int components; //bytes per pixel, 4 (RGBA) with libjpeg-turbo, else 3
+	int scale_denom; //width and height are 1/scale_denom of the jpeg
+	unsigned char *pixels; //rows of width * components bytes, no padding
+	int pixels_size; //allocated
+	float decode_msec;
+	int slices; //bands decoded in parallel, 1 if decoded in one piece
+} JPEG_DECODER_FRAME_T;
+
+typedef struct {
+	uint64_t frames; //decoded
+	uint64_t sliced; //of them decoded in parallel bands
+	uint64_t replaced; //dropped before a thread was free
+	uint64_t unshown; //decoded, a newer frame was ready before it was taken
+	uint64_t late; //finished after a newer frame, discarded
+	uint64_t errors;
+	double decode_msec_sum;
+	float decode_msec_max;
+	float decode_msec_last;
+} JPEG_DECODER_STATS_T;
+
+typedef struct _JPEG_DECODER_T JPEG_DECODER_T;
+typedef struct _JPEG_SLICER_T JPEG_SLICER_T;
+
+/* called on a decode thread when frame became the ready one */
+typedef void (*JPEG_DECODER_CALLBACK)(void *user, JPEG_DECODER_FRAME_T *frame);
+
+/**
+ * Software MJPEG decoder on a pool of threads.
+ * Frames are pushed as they arrive and handed to the next free thread, a
+ * frame still waiting when a newer one is pushed is dropped. With several
+ * threads consecutive frames are decoded in parallel, a frame that finishes
+ * after a newer one is discarded so the output never goes back in time.
+ * The consumer takes the latest decoded frame and gives it back when its
+ * pixels are no longer needed.
+ * With slice_threads a single frame is split too, see jpeg_slicer_create().
+ */
+JPEG_DECODER_T *jpeg_decoder_create(const char *name, int num_threads,
+		int slice_threads, JPEG_DECODER_CALLBACK decoded, void *user);
+
+void jpeg_decoder_delete(JPEG_DECODER_T *decoder);
+
+/* the decoder takes its own reference */
+void jpeg_decoder_push(JPEG_DECODER_T *decoder, IMAGE_DATA *image_data);
+
+/**
+ * Decode frames pushed from now on at 1/scale_denom of their size, 1, 2, 4
+ * or 8. libjpeg scales in the DCT domain, so the decode gets cheaper too.
+ */
+void jpeg_decoder_set_scale(JPEG_DECODER_T *decoder, int scale_denom);
+
+/* latest decoded frame, NULL if there is nothing new */
+JPEG_DECODER_FRAME_T *jpeg_decoder_get_frame(JPEG_DECODER_T *decoder);
+
+void jpeg_decoder_put_frame(JPEG_DECODER_T *decoder,
+		JPEG_DECODER_FRAME_T *frame);
+
+void jpeg_decoder_get_stats(JPEG_DECODER_T *decoder,
+		JPEG_DECODER_STATS_T *stats);
+
+void jpeg_decoder_print_stats(JPEG_DECODER_T *decoder);
+
+/**
+ * Threads that decode one frame in bands of mcu rows between restart
+ * markers, the thread decoding the frame takes a band itself.
+ * Only baseline frames with a DRI whose restart intervals line up with the
+ * mcu rows can be split, others are decoded in one piece.
+ */
+JPEG_SLICER_T *jpeg_slicer_create(int num_threads);
+
+void jpeg_slicer_delete(JPEG_SLICER_T *slicer);
+
+/* decode on the calling thread and slicer if not NULL, 0 on success */
+int jpeg_decode(const unsigned char *data, int size, int scale_denom,
+		JPEG_SLICER_T *slicer, JPEG_DECODER_FRAME_T *frame);
+
+#endif
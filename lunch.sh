@@ -23,6 +23,7 @@ FPS=30
 CODEC=H264
 STREAM=false
 STREAM_PARAM=
+UDP_PARAM=
 
 while getopts c:n:w:h:W:H:psCEFf:rDS OPT
 do
@@ -88,7 +89,9 @@ mkfifo cam1
 chmod 0666 cam1
 
 if [ $REMOTE = true ]; then
-	socat -u udp-recv:9000 - > cam0 & socat -u udp-recv:9001 - > cam1 &
+#	cam i is sent to port 9000 + i by tools/udp_sender on the camera side, e.g.
+#	raspivid -n -t 0 -ih -o - | udp_sender -a <this host> -c H264 -
+	UDP_PARAM="-u 9000"
 elif [ $DIRECT = ]; then
 	if [ $CODEC = "MJPEG" ]; then
 #		raspivid -cd MJPEG -n -t 0 -w $CAM_WIDTH -h $CAM_HEIGHT -ex sports -b $BITRATE -fps $FPS -o - > cam0 &
@@ -98,4 +101,4 @@ elif [ $DIRECT = ]; then
 	fi
 fi
 
-./picam360-capture.bin -c $CODEC -n $CAM_NUM -w $CAM_WIDTH -h $CAM_HEIGHT -W $RENDER_WIDTH -H $RENDER_HEIGHT $DIRECT $MODE $STEREO $STREAM_PARAM $PREVIEW
+./picam360-capture.bin -c $CODEC -n $CAM_NUM -w $CAM_WIDTH -h $CAM_HEIGHT -W $RENDER_WIDTH -H $RENDER_HEIGHT $DIRECT $MODE $STEREO $STREAM_PARAM $PREVIEW $UDP_PARAM
@@ -0,0 +1,363 @@
+#include "mjpeg_ring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+//below this much free space the writer waits for consumers
+#define MJPEG_RING_MIN_SPACE 4096
+
+typedef struct {
+	IMAGE_DATA image; //must be first, release callback casts back
+	uint64_t start;
+	bool in_use;
+} MJPEG_RING_FRAME_T;
+
+struct _MJPEG_RING_T {
+	unsigned char *buff;
+	uint64_t size;
+	//absolute stream offsets, buff + (pos % size) is the address
+	uint64_t write_pos;
+	uint64_t scan_pos;
+	MJPEG_SCANNER_T scanner;
+
+	pthread_mutex_t mlock;
+	pthread_cond_t released_cond;
+	MJPEG_RING_FRAME_T frames[MJPEG_RING_MAX_FRAMES];
+	int frame_head; //oldest outstanding frame
+	int frame_num; //outstanding frames
+
+	MJPEG_RING_STATS_T stats;
+};
+
+const unsigned char *mjpeg_find_marker(const unsigned char *p,
+		const unsigned char *end) {
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	const uint8x16_t ff = vdupq_n_u8(0xff);
+	while (end - p >= 16) {
+		uint64x2_t eq = vreinterpretq_u64_u8(vceqq_u8(vld1q_u8(p), ff));
+		if (vgetq_lane_u64(eq, 0) | vgetq_lane_u64(eq, 1)) {
+			break; //the match is within these 16 bytes
+		}
+		p += 16;
+	}
+#elif defined(__SSE2__)
+	const __m128i ff = _mm_set1_epi8((char) 0xff);
+	while (end - p >= 16) {
+		int mask = _mm_movemask_epi8(
+				_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) p), ff));
+		if (mask) {
+			return p + __builtin_ctz(mask);
+		}
+		p += 16;
+	}
+#endif
+	if (p >= end) {
+		return end;
+	}
+	p = memchr(p, 0xff, end - p);
+	return p ? p : end;
+}
+
+static unsigned char *map_mirrored(uint64_t size) {
+	char path[] = "/dev/shm/mjpeg_ring-XXXXXX";
+	unsigned char *buff;
+	int fd = mkstemp(path);
+	if (fd < 0) {
+		return NULL;
+	}
+	unlink(path);
+	if (ftruncate(fd, size) != 0) {
+		close(fd);
+		return NULL;
+	}
+	buff = mmap(NULL, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1,
+			0);
+	if (buff == MAP_FAILED) {
+		close(fd);
+		return NULL;
+	}
+	if (mmap(buff, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+			0) == MAP_FAILED
+			|| mmap(buff + size, size, PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(buff, size * 2);
+		close(fd);
+		return NULL;
+	}
+	close(fd);
+	return buff;
+}
+
+MJPEG_RING_T *mjpeg_ring_create(int size) {
+	long page_size = sysconf(_SC_PAGESIZE);
+	MJPEG_RING_T *ring = malloc(sizeof(MJPEG_RING_T));
+	memset(ring, 0, sizeof(MJPEG_RING_T));
+	if (size <= 0) {
+		size = MJPEG_RING_DEFAULT_SIZE;
+	}
+	ring->size = (size + page_size - 1) / page_size * page_size;
+	ring->buff = map_mirrored(ring->size);
+	if (ring->buff == NULL) {
+		printf("mjpeg_ring : failed to map %d bytes\n", (int) ring->size);
+		free(ring);
+		return NULL;
+	}
+	pthread_mutex_init(&ring->mlock, NULL);
+	pthread_cond_init(&ring->released_cond, NULL);
+	mjpeg_scanner_reset(&ring->scanner);
+	return ring;
+}
+
+void mjpeg_ring_delete(MJPEG_RING_T *ring) {
+	if (ring == NULL) {
+		return;
+	}
+	munmap(ring->buff, ring->size * 2);
+	pthread_cond_destroy(&ring->released_cond);
+	pthread_mutex_destroy(&ring->mlock);
+	free(ring);
+}
+
+void mjpeg_ring_reset(MJPEG_RING_T *ring) {
+	pthread_mutex_lock(&ring->mlock);
+	mjpeg_scanner_reset(&ring->scanner);
+	ring->scan_pos = ring->write_pos;
+	pthread_mutex_unlock(&ring->mlock);
+}
+
+static void ring_release_frame(IMAGE_DATA *image_data) {
+	MJPEG_RING_T *ring = (MJPEG_RING_T*) image_data->owner;
+	MJPEG_RING_FRAME_T *frame = (MJPEG_RING_FRAME_T*) image_data;
+
+	pthread_mutex_lock(&ring->mlock);
+	frame->in_use = false;
+	while (ring->frame_num > 0 && !ring->frames[ring->frame_head].in_use) {
+		ring->frame_head = (ring->frame_head + 1) % MJPEG_RING_MAX_FRAMES;
+		ring->frame_num--;
+	}
+	pthread_cond_broadcast(&ring->released_cond);
+	pthread_mutex_unlock(&ring->mlock);
+}
+
+//oldest byte that must not be overwritten, call with mlock held
+static uint64_t ring_tail(MJPEG_RING_T *ring) {
+	if (ring->frame_num > 0) {
+		return ring->frames[ring->frame_head].start;
+	}
+	return (ring->scanner.state == MJPEG_SCAN_SOI) ?
+			ring->scan_pos : ring->scanner.frame_start;
+}
+
+//free bytes at write_pos, waits for consumers if the ring is full
+static int ring_reserve(MJPEG_RING_T *ring) {
+	uint64_t space;
+	pthread_mutex_lock(&ring->mlock);
+	space = ring->size - (ring->write_pos - ring_tail(ring));
+	while (space < MJPEG_RING_MIN_SPACE) {
+		if (ring->frame_num == 0) {
+			//the frame being received alone does not fit
+			ring->stats.overflows++;
+			mjpeg_scanner_reset(&ring->scanner);
+			ring->scan_pos = ring->write_pos;
+		} else {
+			struct timeval now;
+			struct timespec timeout;
+			gettimeofday(&now, NULL);
+			timeout.tv_sec = now.tv_sec;
+			timeout.tv_nsec = (now.tv_usec + 100000) * 1000; //100msec
+			if (timeout.tv_nsec >= 1000000000) {
+				timeout.tv_sec++;
+				timeout.tv_nsec -= 1000000000;
+			}
+			ring->stats.stalls++;
+			pthread_cond_timedwait(&ring->released_cond, &ring->mlock,
+					&timeout);
+		}
+		space = ring->size - (ring->write_pos - ring_tail(ring));
+	}
+	pthread_mutex_unlock(&ring->mlock);
+	return (int) MIN(space, MJPEG_RING_READ_CHUNK);
+}
+
+static void ring_commit(MJPEG_RING_T *ring, int len) {
+	pthread_mutex_lock(&ring->mlock);
+	ring->write_pos += len;
+	ring->stats.bytes += len;
+	pthread_mutex_unlock(&ring->mlock);
+}
+
+int mjpeg_ring_fill(MJPEG_RING_T *ring, int fd) {
+	int len = ring_reserve(ring);
+	len = read(fd, ring->buff + ring->write_pos % ring->size, len);
+	if (len > 0) {
+		ring_commit(ring, len);
+	}
+	return len;
+}
+
+int mjpeg_ring_write(MJPEG_RING_T *ring, const unsigned char *data, int len) {
+	len = MIN(len, ring_reserve(ring));
+	memcpy(ring->buff + ring->write_pos % ring->size, data, len);
+	ring_commit(ring, len);
+	return len;
+}
+
+static uint64_t ring_now_usec() {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (uint64_t) now.tv_sec * 1000000 + now.tv_usec;
+}
+
+static IMAGE_DATA *ring_emit_frame(MJPEG_RING_T *ring, uint64_t start,
+		uint64_t end) {
+	IMAGE_DATA *image_data = NULL;
+	pthread_mutex_lock(&ring->mlock);
+	if (ring->frame_num < MJPEG_RING_MAX_FRAMES) {
+		MJPEG_RING_FRAME_T *frame = &ring->frames[(ring->frame_head
+				+ ring->frame_num) % MJPEG_RING_MAX_FRAMES];
+		frame->start = start;
+		frame->in_use = true;
+		image_data = &frame->image;
+		memset(image_data, 0, sizeof(IMAGE_DATA));
+		image_data->refcount = 1;
+		image_data->image_buff = ring->buff + start % ring->size;
+		image_data->image_size = (int) (end - start);
+		image_data->timestamp = ring_now_usec();
+		image_data->release = ring_release_frame;
+		image_data->owner = ring;
+		ring->frame_num++;
+		ring->stats.frames++;
+	} else {
+		ring->stats.dropped_frames++;
+	}
+	pthread_mutex_unlock(&ring->mlock);
+	return image_data;
+}
+
+void mjpeg_scanner_reset(MJPEG_SCANNER_T *scanner) {
+	scanner->state = MJPEG_SCAN_SOI;
+	scanner->frame_start = 0;
+	scanner->frame_end = 0;
+}
+
+/**
+ * Walks the JPEG marker structure instead of testing every byte.
+ * Segment payloads (including EXIF thumbnails with their own SOI/EOI) are
+ * skipped by length, and inside entropy coded data only 0xFF bytes are
+ * inspected: 0xFF00 stuffing, RSTn and fill bytes are passed over, any
+ * other marker ends the scan.
+ */
+bool mjpeg_scan(MJPEG_SCANNER_T *scanner, const unsigned char **pp,
+		const unsigned char *end, uint64_t pos) {
+	const unsigned char *base = *pp;
+	const unsigned char *p = base;
+	bool complete = false;
+
+	while (!complete) {
+		if (scanner->state == MJPEG_SCAN_SOI) {
+			p = mjpeg_find_marker(p, end);
+			if (end - p < 2) {
+				break;
+			}
+			if (p[1] == 0xd8) {
+				scanner->frame_start = pos + (p - base);
+				scanner->state = MJPEG_SCAN_SEGMENT;
+				p += 2;
+			} else {
+				p++;
+			}
+		} else if (scanner->state == MJPEG_SCAN_SEGMENT) {
+			if (end - p < 2) {
+				break;
+			}
+			if (p[0] != 0xff) { //lost sync
+				scanner->resyncs++;
+				scanner->state = MJPEG_SCAN_SOI;
+				continue;
+			}
+			unsigned char marker = p[1];
+			if (marker == 0xff) { //fill byte
+				p++;
+			} else if (marker == 0xd9) { //EOI
+				p += 2;
+				scanner->frame_end = pos + (p - base);
+				scanner->state = MJPEG_SCAN_SOI;
+				complete = true;
+			} else if (marker == 0xd8) { //SOI without EOI, restart frame
+				scanner->dropped_frames++;
+				scanner->frame_start = pos + (p - base);
+				p += 2;
+			} else if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7)) {
+				p += 2; //standalone marker
+			} else {
+				if (end - p < 4) {
+					break;
+				}
+				int len = (p[2] << 8) | p[3];
+				if (len < 2) {
+					scanner->resyncs++;
+					scanner->state = MJPEG_SCAN_SOI;
+					continue;
+				}
+				if (end - p < 2 + len) {
+					break; //wait for the whole segment
+				}
+				p += 2 + len;
+				if (marker == 0xda) { //SOS
+					scanner->state = MJPEG_SCAN_ENTROPY;
+				}
+			}
+		} else { //MJPEG_SCAN_ENTROPY
+			p = mjpeg_find_marker(p, end);
+			if (end - p < 2) {
+				break;
+			}
+			unsigned char marker = p[1];
+			if (marker == 0x00 || (marker >= 0xd0 && marker <= 0xd7)) {
+				p += 2; //byte stuffing or restart marker
+			} else if (marker == 0xff) {
+				p++;
+			} else {
+				scanner->state = MJPEG_SCAN_SEGMENT;
+			}
+		}
+	}
+	*pp = p;
+	return complete;
+}
+
+IMAGE_DATA *mjpeg_ring_get_frame(MJPEG_RING_T *ring) {
+	IMAGE_DATA *image_data = NULL;
+	const unsigned char *base = ring->buff + ring->scan_pos % ring->size;
+	const unsigned char *end = base + (ring->write_pos - ring->scan_pos);
+	const unsigned char *p = base;
+
+	while (image_data == NULL && mjpeg_scan(&ring->scanner, &p, end,
+			ring->scan_pos + (p - base))) {
+		image_data = ring_emit_frame(ring, ring->scanner.frame_start,
+				ring->scanner.frame_end);
+	}
+	ring->scan_pos += p - base;
+	return image_data;
+}
+
+void mjpeg_ring_get_stats(MJPEG_RING_T *ring, MJPEG_RING_STATS_T *stats) {
+	pthread_mutex_lock(&ring->mlock);
+	*stats = ring->stats;
+	stats->dropped_frames += ring->scanner.dropped_frames;
+	stats->resyncs += ring->scanner.resyncs;
+	pthread_mutex_unlock(&ring->mlock);
+}
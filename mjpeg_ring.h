@@ -0,0 +1,76 @@
+#ifndef _MJPEG_RING_H
+#define _MJPEG_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "image_data.h"
+
+#define MJPEG_RING_DEFAULT_SIZE (4 * 1024 * 1024)
+#define MJPEG_RING_READ_CHUNK (256 * 1024)
+#define MJPEG_RING_MAX_FRAMES 32
+
+typedef struct _MJPEG_RING_T MJPEG_RING_T;
+
+enum MJPEG_SCAN_STATE {
+	MJPEG_SCAN_SOI, MJPEG_SCAN_SEGMENT, MJPEG_SCAN_ENTROPY
+};
+
+typedef struct {
+	enum MJPEG_SCAN_STATE state;
+	//stream offsets of the last frame, frame_end is valid after a hit
+	uint64_t frame_start;
+	uint64_t frame_end;
+	uint64_t dropped_frames;
+	uint64_t resyncs;
+} MJPEG_SCANNER_T;
+
+typedef struct {
+	uint64_t bytes;
+	uint64_t frames;
+	uint64_t dropped_frames; //no free slot or truncated by a new SOI
+	uint64_t resyncs; //corrupt segment header
+	uint64_t overflows; //single frame larger than the ring
+	uint64_t stalls; //writer waited for consumers to release frames
+} MJPEG_RING_STATS_T;
+
+/**
+ * Contiguous ring buffer for MJPEG ingest.
+ * The buffer is mapped twice back to back so a frame that wraps around the
+ * end of the ring is still one contiguous block. Complete frames are handed
+ * out as IMAGE_DATA views into the ring; the space is reused once every view
+ * older than it has been released.
+ */
+MJPEG_RING_T *mjpeg_ring_create(int size);
+
+void mjpeg_ring_delete(MJPEG_RING_T *ring);
+
+/* drop any partially received frame, outstanding views stay valid */
+void mjpeg_ring_reset(MJPEG_RING_T *ring);
+
+/* read() up to MJPEG_RING_READ_CHUNK bytes from fd, returns read()'s result */
+int mjpeg_ring_fill(MJPEG_RING_T *ring, int fd);
+
+/* copy data into the ring, returns number of bytes accepted */
+int mjpeg_ring_write(MJPEG_RING_T *ring, const unsigned char *data, int len);
+
+/* next complete SOI..EOI frame or NULL, caller owns the returned reference */
+IMAGE_DATA *mjpeg_ring_get_frame(MJPEG_RING_T *ring);
+
+void mjpeg_ring_get_stats(MJPEG_RING_T *ring, MJPEG_RING_STATS_T *stats);
+
+void mjpeg_scanner_reset(MJPEG_SCANNER_T *scanner);
+
+/**
+ * Incremental SOI..EOI search over [*pp, end), pos is the stream offset
+ * of *pp. Stops after the first complete frame and returns true, *pp is
+ * left after the consumed bytes so the caller can continue from there once
+ * more data is available.
+ */
+bool mjpeg_scan(MJPEG_SCANNER_T *scanner, const unsigned char **pp,
+		const unsigned char *end, uint64_t pos);
+
+/* first 0xFF in [p, end) or end, vectorized where available */
+const unsigned char *mjpeg_find_marker(const unsigned char *p,
+		const unsigned char *end);
+
+#endif
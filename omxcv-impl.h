@@ -68,12 +68,14 @@ namespace omxcv {
      */
     class OmxCvImpl {
         public:
-            OmxCvImpl(const char *name, int width, int height, int bitrate, int fpsnum=-1, int fpsden=-1);
+            OmxCvImpl(const char *name, int width, int height, int bitrate, int fpsnum=-1, int fpsden=-1, bool i420=false);
             virtual ~OmxCvImpl();
 
             bool process(const unsigned char *in_data);
         private:
             int m_width, m_height, m_stride, m_bitrate, m_fpsnum, m_fpsden;
+            bool m_i420; //planes of m_stride and m_stride / 2 bytes per row
+            int m_slice_height;
 
             enum CODEC_TYPE mcodec_type;
             std::string m_filename;
@@ -51,11 +51,14 @@ using std::chrono::duration_cast;
  * @param [in] bitrate The bitrate, in Kbps.
  * @param [in] fpsnum The FPS numerator.
  * @param [in] fpsden The FPS denominator.
+ * @param [in] i420 Frames are I420 instead of RGB.
  */
 OmxCvImpl::OmxCvImpl(const char *name, int width, int height, int bitrate,
-		int fpsnum, int fpsden) :
-		m_width(width), m_height(height), m_stride(((width + 31) & ~31) * 3), m_bitrate(
-				bitrate), m_filename(name), m_stop { false } {
+		int fpsnum, int fpsden, bool i420) :
+		m_width(width), m_height(height), m_stride(
+				((width + 31) & ~31) * (i420 ? 1 : 3)), m_bitrate(bitrate), m_i420(
+				i420), m_slice_height((height + 15) & ~15), m_filename(name), m_stop {
+				false } {
 	int ret;
 	bcm_host_init();
 
@@ -107,12 +110,16 @@ OmxCvImpl::OmxCvImpl(const char *name, int width, int height, int bitrate,
 		def.format.video.xFramerate = 30 << 16;
 	}
 	//Must be a multiple of 16
-	def.format.video.nSliceHeight = (m_height + 15) & ~15;
+	def.format.video.nSliceHeight = m_slice_height;
 	//Must be a multiple of 32
 	def.format.video.nStride = m_stride;
-	def.format.video.eColorFormat = OMX_COLOR_Format24bitBGR888; //OMX_COLOR_Format32bitABGR8888;//OMX_COLOR_FormatYUV420PackedPlanar;
+	def.format.video.eColorFormat =
+			m_i420 ? OMX_COLOR_FormatYUV420PackedPlanar : OMX_COLOR_Format24bitBGR888; //OMX_COLOR_Format32bitABGR8888;
 	//Must be manually defined to ensure sufficient size if stride needs to be rounded up to multiple of 32.
 	def.nBufferSize = def.format.video.nStride * def.format.video.nSliceHeight;
+	if (m_i420) { //u and v planes of a quarter each
+		def.nBufferSize = def.nBufferSize * 3 / 2;
+	}
 	//We allocate 1 input buffers.
 	def.nBufferCountActual = 1;
 
@@ -394,6 +401,17 @@ bool OmxCvImpl::write_data(OMX_BUFFERHEADERTYPE *out, int64_t timestamp) {
 	out->nFilledLen = 0;
 }
 
+static void copy_plane(unsigned char *dst, int dst_stride,
+		const unsigned char *src, int src_stride, int width, int rows) {
+	if (dst_stride == src_stride) {
+		memcpy(dst, src, src_stride * rows);
+		return;
+	}
+	for (int i = 0; i < rows; i++) {
+		memcpy(dst + i * dst_stride, src + i * src_stride, width);
+	}
+}
+
 /**
  * Enqueue video to be encoded.
  * @param [in] mat The mat to be encoded.
@@ -404,7 +422,21 @@ bool OmxCvImpl::process(const unsigned char *in_data) {
 		return false;
 	}
 	auto now = steady_clock::now();
-	memcpy(input_buffer->pBuffer, in_data, m_stride * m_height);
+	if (m_i420) {
+		//tight planes into the padded ones of the port
+		unsigned char *dst = input_buffer->pBuffer;
+		copy_plane(dst, m_stride, in_data, m_width, m_width, m_height);
+		dst += m_stride * m_slice_height;
+		in_data += m_width * m_height;
+		for (int i = 0; i < 2; i++) {
+			copy_plane(dst, m_stride / 2, in_data, m_width / 2, m_width / 2,
+					m_height / 2);
+			dst += (m_stride / 2) * (m_slice_height / 2);
+			in_data += (m_width / 2) * (m_height / 2);
+		}
+	} else {
+		memcpy(input_buffer->pBuffer, in_data, m_stride * m_height);
+	}
 	//BGR2RGB(mat, in->pBuffer, m_stride);
 	input_buffer->nFilledLen = input_buffer->nAllocLen;
 	if (m_frame_count == 0) {
@@ -435,10 +467,11 @@ bool OmxCvImpl::process(const unsigned char *in_data) {
  * @param [in] bitrate The bitrate, in Kbps.
  * @param [in] fpsnum The FPS numerator.
  * @param [in] fpsden The FPS denominator.
+ * @param [in] i420 Frames are I420 instead of RGB.
  */
 OmxCv::OmxCv(const char *name, int width, int height, int bitrate, int fpsnum,
-		int fpsden) {
-	m_impl = new OmxCvImpl(name, width, height, bitrate, fpsnum, fpsden);
+		int fpsden, bool i420) {
+	m_impl = new OmxCvImpl(name, width, height, bitrate, fpsnum, fpsden, i420);
 }
 
 /**
@@ -19,7 +19,8 @@ namespace omxcv {
      */
     class OmxCv {
         public:
-            OmxCv(const char *name, int width, int height, int bitrate=3000, int fpsnum=25, int fpsden=1);
+            //in_data of Encode() is I420 if i420, else RGB
+            OmxCv(const char *name, int width, int height, int bitrate=3000, int fpsnum=25, int fpsden=1, bool i420=false);
             bool Encode(const unsigned char *in_data);
             virtual ~OmxCv();
         private:
@@ -51,7 +51,13 @@
 #include "video_direct.h"
 #include "picam360_tools.h"
 #include "gl_program.h"
+#include "gl_state.h"
 #include "device.h"
+#include "projection_lut.h"
+#include "i420.h"
+#include "window_mesh.h"
+#include "sharpen.h"
+#include "color_lut.h"
 
 #include <mat4/type.h>
 #include <mat4/create.h>
@@ -77,6 +83,14 @@
 #endif
 
 #define CONFIG_FILE "config.json"
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define LUT_TEXTURE_UNIT (MAX_CAM_NUM + 1) //after logo and cameras
+#define STITCH_TEXTURE_UNIT (LUT_TEXTURE_UNIT + 1)
+#define COLOR_LUT_TEXTURE_UNIT (STITCH_TEXTURE_UNIT + 1)
+#define STITCH_DEFAULT_WIDTH 2048
+#define WINDOW_MESH_DEFAULT_MAX_ERROR 0.5 //camera texels
+#define RENDER_TIMING_FRAMES 30 //preview frames timed per get_frame_stats
 
 typedef struct {
 	float sharpness_gain;
@@ -89,14 +103,71 @@ typedef struct {
 } OPTIONS_T;
 OPTIONS_T lg_options = { };
 
+//bits of shader_variant(), in the order of lg_shader_defines
+enum SHADER_DEFINE {
+	SHADER_SHARPEN = 1 << 0, //sharpness_gain is not 0
+	SHADER_TWO_CAMERAS = 1 << 1, //the *_sphere shaders of old
+	SHADER_CHROMA = 1 << 2, //chroma correction of one camera
+	SHADER_TILE = 1 << 3, //full sphere frame over the gl limits
+	SHADER_VERTEX_UV = 1 << 4, //window fisheye mapping per vertex
+	SHADER_EQUI_ANGULAR = 1 << 5, //cubemap faces of even angles, EAC
+	SHADER_COLOR_LUT = 1 << 6, //graded by color_lut_texture
+	//cells of the plain shaders that only show cam0 or the one camera, cam1,
+	//the logo or black, see frame_coverage()
+	SHADER_ONLY_CAM0 = 1 << 7,
+	SHADER_ONLY_CAM1 = 1 << 8,
+	SHADER_ONLY_LOGO = 1 << 9,
+	SHADER_ONLY_BLACK = 1 << 10,
+};
+#define SHADER_DEFINE_NUM 11
+static const char *lg_shader_defines[SHADER_DEFINE_NUM] = { "SHARPEN",
+		"TWO_CAMERAS", "CHROMA", "TILE", "VERTEX_UV", "EQUI_ANGULAR",
+		"COLOR_LUT", "ONLY_CAM0", "ONLY_CAM1", "ONLY_LOGO", "ONLY_BLACK" };
+//added to shader_variant() per enum COVERAGE_CLASS
+static const unsigned int lg_coverage_defines[COVERAGE_CLASS_NUM] = { 0,
+		SHADER_ONLY_CAM0, SHADER_ONLY_CAM1, SHADER_ONLY_LOGO,
+		SHADER_ONLY_BLACK };
+
+//uniforms of the shaders that take both cameras
+typedef struct {
+	const char *offset_yaw;
+	const char *offset_x;
+	const char *offset_y;
+	const char *horizon_r;
+	const char *center;
+	const char *rot;
+	const char *texture;
+} CAM_UNIFORM_NAMES_T;
+static const CAM_UNIFORM_NAMES_T lg_cam_uniform_names[MAX_CAM_NUM] = { {
+		"cam0_offset_yaw", "cam0_offset_x", "cam0_offset_y", "cam0_horizon_r",
+		"cam0_center", "cam0_rot", "cam0_texture" }, { "cam1_offset_yaw",
+		"cam1_offset_x", "cam1_offset_y", "cam1_horizon_r", "cam1_center",
+		"cam1_rot", "cam1_texture" } };
+
 static void init_ogl(PICAM360CAPTURE_T *state);
 static void init_model_proj(PICAM360CAPTURE_T *state);
 static void init_textures(PICAM360CAPTURE_T *state);
+static void load_color_lut(PICAM360CAPTURE_T *state);
 static void init_options(PICAM360CAPTURE_T *state);
 static void save_options(PICAM360CAPTURE_T *state);
 static void exit_func(void);
+static unsigned int shader_variant(PICAM360CAPTURE_T *state, FRAME_T *frame);
+static bool frame_uses_stitch(PICAM360CAPTURE_T *state, FRAME_T *frame);
+static bool frame_uses_sharpen(PICAM360CAPTURE_T *state, FRAME_T *frame);
+static bool frame_uses_coverage(PICAM360CAPTURE_T *state, FRAME_T *frame);
+static const COVERAGE_CAMERA_T *coverage_cameras(PICAM360CAPTURE_T *state,
+		FRAME_T *frame, COVERAGE_CAMERA_T cameras[MAX_CAM_NUM]);
+static void *frame_program(PICAM360CAPTURE_T *state, FRAME_T *frame);
+static WINDOW_MESH_T *window_mesh(PICAM360CAPTURE_T *state, FRAME_T *frame);
+static void *render_setup(PICAM360CAPTURE_T *state, FRAME_T *frame,
+		MODEL_T *model);
+static void render_frame(PICAM360CAPTURE_T *state, FRAME_T *frame,
+		MODEL_T *model, void *program);
 static void redraw_render_texture(PICAM360CAPTURE_T *state, FRAME_T *frame,
 		MODEL_T *model);
+static void render_texture(PICAM360CAPTURE_T *state, FRAME_T *frame);
+static void redraw_i420(PICAM360CAPTURE_T *state, FRAME_T *frame,
+		FRAME_FBO_T *fbo);
 static void redraw_scene(PICAM360CAPTURE_T *state, FRAME_T *frame,
 		MODEL_T *model);
 
@@ -208,6 +279,16 @@ static void init_ogl(PICAM360CAPTURE_T *state) {
 
 	// Enable back face culling.
 	glEnable(GL_CULL_FACE);
+
+	//frames over this are drawn in bands
+	GLint max_texture_size, max_renderbuffer_size, max_viewport_dims[2];
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+	glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_renderbuffer_size);
+	glGetIntegerv(GL_MAX_VIEWPORT_DIMS, max_viewport_dims);
+	state->max_fbo_size = MIN(MIN(max_texture_size, max_renderbuffer_size),
+			MIN(max_viewport_dims[0], max_viewport_dims[1]));
+	//bands are read back into their place in the frame, rows unpadded
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
 }
 
 int load_texture(const char *filename, GLuint *tex_out) {
@@ -215,7 +296,7 @@ int load_texture(const char *filename, GLuint *tex_out) {
 	IplImage *iplImage = cvLoadImage(filename, CV_LOAD_IMAGE_COLOR);
 
 	glGenTextures(1, &tex);
-	glBindTexture(GL_TEXTURE_2D, tex);
+	gl_state_bind_texture(0, tex);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, iplImage->width, iplImage->height, 0,
@@ -223,7 +304,6 @@ int load_texture(const char *filename, GLuint *tex_out) {
 	if (glGetError() != GL_NO_ERROR) {
 		printf("glTexImage2D failed. Could not allocate texture buffer.");
 	}
-	glBindTexture(GL_TEXTURE_2D, 0);
 	if (tex_out != NULL)
 		*tex_out = tex;
 
@@ -237,10 +317,9 @@ int board_mesh(GLuint *vbo_out, GLuint *n_out) {
 			1.0f };
 
 	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	gl_state_bind_array_buffer(vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertex_positions),
 			quad_vertex_positions, GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	if (vbo_out != NULL)
 		*vbo_out = vbo;
 	if (n_out != NULL)
@@ -249,69 +328,6 @@ int board_mesh(GLuint *vbo_out, GLuint *n_out) {
 	return 0;
 }
 
-int spherewindow_mesh(float theta_degree, int phi_degree, int num_of_steps,
-		GLuint *vbo_out, GLuint *n_out) {
-	GLuint vbo;
-
-	int n = 2 * (num_of_steps + 1) * num_of_steps;
-	float points[4 * n];
-
-	float theta = theta_degree * M_PI / 180.0;
-	float phi = phi_degree * M_PI / 180.0;
-
-	float start_x = -tan(theta / 2);
-	float start_y = -tan(phi / 2);
-
-	float end_x = tan(theta / 2);
-	float end_y = tan(phi / 2);
-
-	float step_x = (end_x - start_x) / num_of_steps;
-	float step_y = (end_y - start_y) / num_of_steps;
-
-	int idx = 0;
-	int i, j;
-	for (i = 0; i < num_of_steps; i++) {	//x
-		for (j = 0; j <= num_of_steps; j++) {	//y
-			{
-				float x = start_x + step_x * i;
-				float y = start_y + step_y * j;
-				float z = 1.0;
-				float len = sqrt(x * x + y * y + z * z);
-				points[idx++] = x / len;
-				points[idx++] = y / len;
-				points[idx++] = z / len;
-				points[idx++] = 1.0;
-				//printf("x=%f,y=%f,z=%f,w=%f\n", points[idx - 4],
-				//		points[idx - 3], points[idx - 2], points[idx - 1]);
-			}
-			{
-				float x = start_x + step_x * (i + 1);
-				float y = start_y + step_y * j;
-				float z = 1.0;
-				float len = sqrt(x * x + y * y + z * z);
-				points[idx++] = x / len;
-				points[idx++] = y / len;
-				points[idx++] = z / len;
-				points[idx++] = 1.0;
-				//printf("x=%f,y=%f,z=%f,w=%f\n", points[idx - 4],
-				//		points[idx - 3], points[idx - 2], points[idx - 1]);
-			}
-		}
-	}
-
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 4 * n, points,
-			GL_STATIC_DRAW);
-
-	if (vbo_out != NULL)
-		*vbo_out = vbo;
-	if (n_out != NULL)
-		*n_out = n;
-
-	return 0;
-}
-
 /***********************************************************
  * Name: init_model_proj
  *
@@ -324,43 +340,91 @@ int spherewindow_mesh(float theta_degree, int phi_degree, int num_of_steps,
  *
  ***********************************************************/
 static void init_model_proj(PICAM360CAPTURE_T *state) {
-	float maxfov = 150.0;
-
 	board_mesh(&state->model_data[EQUIRECTANGULAR].vbo,
 			&state->model_data[EQUIRECTANGULAR].vbo_nop);
-	if (state->num_of_cam == 1) {
-		state->model_data[EQUIRECTANGULAR].program = GLProgram_new(
-				"shader/equirectangular.vert", "shader/equirectangular.frag");
-	} else {
-		state->model_data[EQUIRECTANGULAR].program = GLProgram_new(
-				"shader/equirectangular.vert",
-				"shader/equirectangular_sphere.frag");
+	state->model_data[EQUIRECTANGULAR].program = GLProgramVariants_new(
+			"shader/equirectangular.vert", "shader/equirectangular.frag",
+			lg_shader_defines, SHADER_DEFINE_NUM);
+	state->model_data[EQUIRECTANGULAR].lut_program = GLProgramVariants_new(
+			"shader/equirectangular.vert", "shader/equirectangular_lut.frag",
+			lg_shader_defines, SHADER_DEFINE_NUM);
+	state->model_data[EQUIRECTANGULAR].stitched_program =
+			GLProgramVariants_new("shader/equirectangular.vert",
+					"shader/equirectangular_stitched.frag", lg_shader_defines,
+					SHADER_DEFINE_NUM);
+
+	//EAC is the EQUI_ANGULAR variant of the same shaders
+	for (int mode = CUBEMAP; mode <= EAC; mode++) {
+		board_mesh(&state->model_data[mode].vbo,
+				&state->model_data[mode].vbo_nop);
+		state->model_data[mode].program = GLProgramVariants_new(
+				"shader/equirectangular.vert", "shader/cubemap.frag",
+				lg_shader_defines, SHADER_DEFINE_NUM);
+		state->model_data[mode].stitched_program = GLProgramVariants_new(
+				"shader/equirectangular.vert", "shader/cubemap_stitched.frag",
+				lg_shader_defines, SHADER_DEFINE_NUM);
 	}
 
 	board_mesh(&state->model_data[FISHEYE].vbo,
 			&state->model_data[FISHEYE].vbo_nop);
-	state->model_data[FISHEYE].program = GLProgram_new("shader/fisheye.vert",
-			"shader/fisheye.frag");
+	state->model_data[FISHEYE].program = GLProgramVariants_new(
+			"shader/fisheye.vert", "shader/fisheye.frag", lg_shader_defines,
+			SHADER_DEFINE_NUM);
 
 	board_mesh(&state->model_data[CALIBRATION].vbo,
 			&state->model_data[CALIBRATION].vbo_nop);
-	state->model_data[CALIBRATION].program = GLProgram_new(
-			"shader/calibration.vert", "shader/calibration.frag");
-
-	spherewindow_mesh(maxfov, maxfov, 128, &state->model_data[WINDOW].vbo,
-			&state->model_data[WINDOW].vbo_nop);
-	if (state->num_of_cam == 1) {
-		state->model_data[WINDOW].program = GLProgram_new("shader/window.vert",
-				"shader/window.frag");
-	} else {
-		state->model_data[WINDOW].program = GLProgram_new("shader/window.vert",
-				"shader/window_sphere.frag");
-	}
+	state->model_data[CALIBRATION].program = GLProgramVariants_new(
+			"shader/calibration.vert", "shader/calibration.frag",
+			lg_shader_defines, SHADER_DEFINE_NUM);
+
+	//meshes are made per fov, see window_mesh()
+	state->model_data[WINDOW].program = GLProgramVariants_new(
+			"shader/window.vert", "shader/window.frag", lg_shader_defines,
+			SHADER_DEFINE_NUM);
+	state->model_data[WINDOW].lut_program = GLProgramVariants_new(
+			"shader/window.vert", "shader/window_lut.frag", lg_shader_defines,
+			SHADER_DEFINE_NUM);
+	state->model_data[WINDOW].stitched_program = GLProgramVariants_new(
+			"shader/window.vert", "shader/window_stitched.frag",
+			lg_shader_defines, SHADER_DEFINE_NUM);
 
 	board_mesh(&state->model_data[BOARD].vbo,
 			&state->model_data[BOARD].vbo_nop);
-	state->model_data[BOARD].program = GLProgram_new("shader/board.vert",
-			"shader/board.frag");
+	state->model_data[BOARD].program = GLProgramVariants_new(
+			"shader/board.vert", "shader/board.frag", lg_shader_defines,
+			SHADER_DEFINE_NUM);
+	state->i420_program = GLProgram_new("shader/board.vert",
+			"shader/i420.frag");
+	state->sharpen_program = GLProgramVariants_new("shader/board.vert",
+			"shader/sharpen.frag", lg_shader_defines, SHADER_DEFINE_NUM);
+
+	load_color_lut(state); //before the variants that look it up
+
+	//the variants of the configuration, others are compiled when needed
+	for (int i = 0; i < MAX_OPERATION_NUM; i++) {
+		FRAME_T frame = { };
+		frame.operation_mode = i;
+		frame.width = 512; //as create_frame()
+		frame.height = 512;
+		frame.fov = 120;
+		frame_program(state, &frame);
+		if (!frame_uses_coverage(state, &frame)) {
+			continue;
+		}
+		for (int c = COVERAGE_CAM0; c <= COVERAGE_BLACK; c++) {
+			//cam1 comes with two cameras, the logo with one
+			if (c == ((state->num_of_cam > 1) ? COVERAGE_LOGO : COVERAGE_CAM1)) {
+				continue;
+			}
+			COVERAGE_CAMERA_T cameras[MAX_CAM_NUM];
+			if (c == COVERAGE_BLACK
+					&& coverage_cameras(state, &frame, cameras) == NULL) {
+				continue;
+			}
+			GLProgramVariants_Get(state->model_data[i].program,
+					shader_variant(state, &frame) | lg_coverage_defines[c]);
+		}
+	}
 }
 
 /***********************************************************
@@ -380,11 +444,27 @@ static void init_textures(PICAM360CAPTURE_T *state) {
 	load_texture("img/calibration_img.png", &state->calibration_texture);
 	load_texture("img/logo_img.png", &state->logo_texture);
 
+	{ //the calibration is applied by uniforms, the lut is built once
+		unsigned char *lut = (unsigned char*) malloc(
+				PROJECTION_LUT_WIDTH * PROJECTION_LUT_ROWS * 4);
+		projection_lut_build((state->num_of_cam == 1) ? 1 : 2, lut);
+		glGenTextures(1, &state->lut_texture);
+		gl_state_bind_texture(0, state->lut_texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, PROJECTION_LUT_WIDTH,
+				PROJECTION_LUT_ROWS, 0, GL_RGBA, GL_UNSIGNED_BYTE, lut);
+		//16 bit values are split over two channels, the shaders interpolate
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		free(lut);
+	}
+
 	for (int i = 0; i < state->num_of_cam; i++) {
 		//// load three texture buffers but use them on six OGL|ES texture surfaces
 		glGenTextures(1, &state->cam_texture[i]);
 
-		glBindTexture(GL_TEXTURE_2D, state->cam_texture[i]);
+		gl_state_bind_texture(0, state->cam_texture[i]);
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, state->cam_width,
 				state->cam_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
 
@@ -393,14 +473,18 @@ static void init_textures(PICAM360CAPTURE_T *state) {
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-		/* Create EGL Image */
-		state->egl_image[i] = eglCreateImageKHR(state->display, state->context,
-				EGL_GL_TEXTURE_2D_KHR, (EGLClientBuffer) state->cam_texture[i],
-				0);
-
-		if (state->egl_image[i] == EGL_NO_IMAGE_KHR) {
-			printf("eglCreateImageKHR failed.\n");
-			exit(1);
+		if (state->sw_decode_threads > 0) { //filled by video_mjpeg_sw_upload()
+			state->egl_image[i] = NULL;
+		} else {
+			/* Create EGL Image */
+			state->egl_image[i] = eglCreateImageKHR(state->display,
+					state->context, EGL_GL_TEXTURE_2D_KHR,
+					(EGLClientBuffer) state->cam_texture[i], 0);
+
+			if (state->egl_image[i] == EGL_NO_IMAGE_KHR) {
+				printf("eglCreateImageKHR failed.\n");
+				exit(1);
+			}
 		}
 
 		// Start rendering
@@ -410,11 +494,78 @@ static void init_textures(PICAM360CAPTURE_T *state) {
 		args[2] = (void*) state;
 		pthread_create(&state->thread[i], NULL,
 				(state->video_direct) ? video_direct :
-				(state->codec_type == H264) ?
-						video_decode_test : video_mjpeg_decode, args);
+				(state->codec_type == H264) ? video_decode_test :
+				(state->sw_decode_threads > 0) ?
+						video_mjpeg_sw_decode : video_mjpeg_decode, args);
 
 		// Bind texture surface to current vertices
-		glBindTexture(GL_TEXTURE_2D, state->cam_texture[i]);
+		gl_state_bind_texture(0, state->cam_texture[i]);
+	}
+}
+
+/**
+ * The grading of color_lut_file into color_lut_texture, or if there is
+ * none or it can not be read, the offset the shaders had built in for one
+ * camera and nothing for two. The shaders look it up once per pixel, the
+ * sharpen pass once per camera texel instead.
+ */
+static void load_color_lut(PICAM360CAPTURE_T *state) {
+	unsigned char *lut = NULL;
+	if (state->color_lut_file[0] != '\0') {
+		lut = color_lut_load_cube(state->color_lut_file);
+	}
+	if (lut == NULL && state->num_of_cam == 1) {
+		lut = color_lut_offset(COLOR_LUT_OFFSET);
+	}
+	for (int i = 0; i < MAX_CAM_NUM; i++) {
+		state->sharpen_source[i] = 0; //graded anew
+		state->stitch_source[i] = 0;
+	}
+	if (lut == NULL) {
+		if (state->color_lut_texture) {
+			gl_state_delete_texture(state->color_lut_texture);
+			state->color_lut_texture = 0;
+		}
+		return;
+	}
+	if (state->color_lut_texture == 0) {
+		glGenTextures(1, &state->color_lut_texture);
+	}
+	gl_state_bind_texture(0, state->color_lut_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, COLOR_LUT_WIDTH, COLOR_LUT_WIDTH,
+			0, GL_RGBA, GL_UNSIGNED_BYTE, lut);
+	//red and green are filtered, the shaders fetch blue from slice centers
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	free(lut);
+}
+//------------------------------------------------------------------------------
+
+INPUT_SOURCE_T *open_input_source(PICAM360CAPTURE_T *state, int index) {
+	enum INPUT_CODEC codec =
+			(state->codec_type == MJPEG) ? INPUT_CODEC_MJPEG : INPUT_CODEC_H264;
+	if (state->test_pattern_fps > 0) {
+		INPUT_SOURCE_T *source = input_source_synthetic_open(codec,
+				state->cam_width, state->cam_height, state->test_pattern_fps,
+				index, state->image_pool[index]);
+		if (source != NULL) {
+			//a restart interval per mcu row lets the slicer split frames
+			input_source_synthetic_set_jpeg_options(source,
+					state->test_pattern_detail,
+					(state->sw_decode_slice_threads > 0) ?
+							(state->cam_width + 15) / 16 : 0);
+		}
+		return source;
+	} else if (state->udp_receiver[index] != NULL) {
+		return input_source_udp_open(state->udp_receiver[index],
+				state->udp_multiplex ? index : UDP_STREAM_ANY, codec,
+				state->image_pool[index]);
+	} else {
+		char buff[256];
+		sprintf(buff, "cam%d", index);
+		return input_source_fifo_open(buff, codec, state->image_pool[index]);
 	}
 }
 //------------------------------------------------------------------------------
@@ -463,6 +614,41 @@ static void init_options(PICAM360CAPTURE_T *state) {
 				lg_options.cam_horizon_r[i] = 0.8;
 			}
 		}
+		state->image_pool_max_bytes = (uint64_t) json_number_value(
+				json_object_get(options, "image_pool_max_kb")) * 1024;
+		state->frame_pairing_tolerance = (uint64_t) (json_number_value(
+				json_object_get(options, "frame_pairing_tolerance_ms")) * 1000);
+		state->h264_low_latency = json_is_true(
+				json_object_get(options, "h264_low_latency"));
+		state->test_pattern_detail = (int) json_number_value(
+				json_object_get(options, "test_pattern_detail"));
+		state->sw_decode_threads = (int) json_number_value(
+				json_object_get(options, "sw_decode_threads"));
+		state->sw_decode_slice_threads = (int) json_number_value(
+				json_object_get(options, "sw_decode_slice_threads"));
+		state->projection_lut = json_is_true(
+				json_object_get(options, "projection_lut"));
+		if (json_is_false(json_object_get(options, "chroma_correction"))) {
+			state->chroma_correction = false;
+		}
+		state->stitch = json_is_true(json_object_get(options, "stitch"));
+		state->sharpen_pass = json_is_true(
+				json_object_get(options, "sharpen_pass"));
+		state->coverage_mask = json_is_true(
+				json_object_get(options, "coverage_mask"));
+		if (json_string_value(json_object_get(options, "color_lut"))) {
+			strncpy(state->color_lut_file,
+					json_string_value(json_object_get(options, "color_lut")),
+					sizeof(state->color_lut_file) - 1);
+		}
+		if (json_number_value(json_object_get(options, "stitch_width")) > 0) {
+			state->stitch_width = (int) json_number_value(
+					json_object_get(options, "stitch_width"));
+		}
+		if (json_is_number(json_object_get(options, "window_mesh_max_error"))) {
+			state->window_mesh_max_error = json_number_value(
+					json_object_get(options, "window_mesh_max_error"));
+		}
 
 		json_decref(options);
 	}
@@ -507,6 +693,70 @@ static void save_options(PICAM360CAPTURE_T *state) {
 				json_real(lg_options.cam_horizon_r[i]));
 	}
 
+	if (state->image_pool_max_bytes > 0) {
+		json_object_set_new(options, "image_pool_max_kb",
+				json_real(state->image_pool_max_bytes / 1024));
+	}
+
+	if (state->frame_pairing_tolerance > 0) {
+		json_object_set_new(options, "frame_pairing_tolerance_ms",
+				json_real(state->frame_pairing_tolerance / 1000.0));
+	}
+
+	if (state->h264_low_latency) {
+		json_object_set_new(options, "h264_low_latency", json_true());
+	}
+
+	if (state->sw_decode_threads > 0) {
+		json_object_set_new(options, "sw_decode_threads",
+				json_integer(state->sw_decode_threads));
+	}
+
+	if (state->sw_decode_slice_threads > 0) {
+		json_object_set_new(options, "sw_decode_slice_threads",
+				json_integer(state->sw_decode_slice_threads));
+	}
+
+	if (state->projection_lut) {
+		json_object_set_new(options, "projection_lut", json_true());
+	}
+
+	if (!state->chroma_correction) {
+		json_object_set_new(options, "chroma_correction", json_false());
+	}
+
+	if (state->stitch) {
+		json_object_set_new(options, "stitch", json_true());
+	}
+
+	if (state->sharpen_pass) {
+		json_object_set_new(options, "sharpen_pass", json_true());
+	}
+
+	if (state->coverage_mask) {
+		json_object_set_new(options, "coverage_mask", json_true());
+	}
+
+	if (state->color_lut_file[0] != '\0') {
+		json_object_set_new(options, "color_lut",
+				json_string(state->color_lut_file));
+	}
+
+	if (state->stitch_width != STITCH_DEFAULT_WIDTH) {
+		json_object_set_new(options, "stitch_width",
+				json_integer(state->stitch_width));
+	}
+
+	if (state->window_mesh_max_error != WINDOW_MESH_DEFAULT_MAX_ERROR) {
+		json_object_set_new(options, "window_mesh_max_error",
+				json_real(state->window_mesh_max_error));
+	}
+
+	if (state->test_pattern_detail > 0) {
+		json_object_set_new(options, "test_pattern_detail",
+				json_integer(state->test_pattern_detail));
+	}
+
 	json_dump_file(options, CONFIG_FILE, 0);
 
 	json_decref(options);
@@ -526,6 +776,7 @@ static void exit_func(void)
 	}
 
 	// clear screen
+	gl_state_bind_framebuffer(0);
 	glClear(GL_COLOR_BUFFER_BIT);
 	eglSwapBuffers(state->display, state->surface);
 
@@ -554,6 +805,79 @@ bool inputAvailable() {
 
 static int next_frame_id = 0;
 
+//modes whose shaders draw the whole sphere with frame_coord()
+static bool is_full_sphere(enum OPERATION_MODE mode) {
+	return mode == EQUIRECTANGULAR || mode == CUBEMAP || mode == EAC;
+}
+
+/**
+ * Fits a frame into fbos of at most max_size.
+ * Equirectangular and cubemap frames wider than that have their columns
+ * folded into rows, row y of column c is row y * tile_columns + c of the
+ * folded frame, which is then drawn in bands of fbo_height rows. A band read
+ * back as is lands where it belongs in the frame, so a frame of any size
+ * takes one render and one glReadPixels() per band and no copy. The shaders of other
+ * modes draw the viewport as a whole and get frames of max_size at most.
+ */
+static void frame_tile_layout(FRAME_T *frame, int max_size) {
+	if (!is_full_sphere(frame->operation_mode)) {
+		if (frame->width > max_size || frame->height > max_size) {
+			printf("frame %dx%d over the gl limit of %d, reduced\n",
+					frame->width, frame->height, max_size);
+			frame->width = MIN(frame->width, max_size);
+			frame->height = MIN(frame->height, max_size);
+		}
+		frame->tile_columns = 1;
+		frame->fbo_width = frame->width;
+		frame->fbo_height = frame->height;
+		return;
+	}
+	int columns = (frame->width + max_size - 1) / max_size;
+	if (frame->width % columns != 0) {
+		printf("frame width %d reduced to %d columns of %d\n", frame->width,
+				columns, frame->width / columns);
+		frame->width -= frame->width % columns;
+	}
+	int rows = frame->height * columns;
+	int bands = (rows + max_size - 1) / max_size;
+	frame->tile_columns = columns;
+	frame->fbo_width = frame->width / columns;
+	frame->fbo_height = (rows + bands - 1) / bands;
+}
+
+static void create_fbo(GLuint *framebuffer, GLuint *texture, GLenum format,
+		int width, int height) {
+	glGenFramebuffers(1, framebuffer);
+
+	glGenTextures(1, texture);
+	gl_state_bind_texture(0, *texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	//npot sizes are only complete clamped, i420.frag samples the frames
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
+			GL_UNSIGNED_BYTE, NULL);
+	if (glGetError() != GL_NO_ERROR) {
+		printf("glTexImage2D failed. Could not allocate texture buffer.\n");
+	}
+
+	gl_state_bind_framebuffer(*framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+			*texture, 0);
+	if (glGetError() != GL_NO_ERROR) {
+		printf(
+				"glFramebufferTexture2D failed. Could not allocate framebuffer.\n");
+	}
+
+	gl_state_bind_framebuffer(0);
+}
+
+static void create_frame_fbo(FRAME_T *frame, FRAME_FBO_T *fbo) {
+	create_fbo(&fbo->framebuffer, &fbo->texture, GL_RGB, frame->fbo_width,
+			frame->fbo_height);
+}
+
 FRAME_T *create_frame(PICAM360CAPTURE_T *state, int argc, char *argv[]) {
 	int opt;
 	int render_width = 512;
@@ -567,7 +891,7 @@ FRAME_T *create_frame(PICAM360CAPTURE_T *state, int argc, char *argv[]) {
 	frame->fov = 120;
 
 	optind = 1; // reset getopt
-	while ((opt = getopt(argc, argv, "c:w:h:n:psW:H:ECFDo:i:r:")) != -1) {
+	while ((opt = getopt(argc, argv, "c:w:h:n:psS:u:U:T:j:J:W:H:EMQCFDLlo:i:r:")) != -1) {
 		switch (opt) {
 		case 'W':
 			sscanf(optarg, "%d", &render_width);
@@ -578,6 +902,12 @@ FRAME_T *create_frame(PICAM360CAPTURE_T *state, int argc, char *argv[]) {
 		case 'E':
 			frame->operation_mode = EQUIRECTANGULAR;
 			break;
+		case 'M': //cubemap, 3x2 faces
+			frame->operation_mode = CUBEMAP;
+			break;
+		case 'Q': //equi-angular cubemap
+			frame->operation_mode = EAC;
+			break;
 		case 'C':
 			frame->operation_mode = CALIBRATION;
 			break;
@@ -593,68 +923,582 @@ FRAME_T *create_frame(PICAM360CAPTURE_T *state, int argc, char *argv[]) {
 			break;
 		}
 	}
-	if (render_width > 2048) {
-		frame->double_size = true;
-		frame->width = render_width / 2;
-		frame->height = render_height;
+	frame->width = render_width;
+	frame->height = render_height;
+	frame_tile_layout(frame, state->max_fbo_size);
+
+	//texture rendering
+	create_frame_fbo(frame, &frame->fbo[0]);
+	frame->fbo_num = 1;
+
+	// Set background color and clear buffers
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+	return frame;
+}
+
+static double now_msec() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+//reads the band drawn into fbo back, the image is encoded once complete
+static void frame_fbo_read(FRAME_T *frame, FRAME_FBO_T *fbo) {
+	if (fbo->image == NULL) {
+		return;
+	}
+	int rows = frame->height * frame->tile_columns;
+	double start = now_msec();
+	if (frame->i420) { //one band
+		gl_state_bind_framebuffer(fbo->i420_framebuffer);
+		glReadPixels(0, 0, frame->width / 4, frame->height * 3 / 2, GL_RGBA,
+				GL_UNSIGNED_BYTE, fbo->image);
 	} else {
-		frame->width = render_width;
-		frame->height = render_height;
+		gl_state_bind_framebuffer(fbo->framebuffer);
+		glReadPixels(0, 0, frame->fbo_width,
+				MIN(frame->fbo_height, rows - fbo->tile_row), GL_RGB,
+				GL_UNSIGNED_BYTE,
+				fbo->image + fbo->tile_row * frame->fbo_width * 3);
 	}
+	frame->readback_msec += now_msec() - start;
+	if (fbo->last_band) {
+		frame_encoder_submit(frame->encoder);
+	}
+	fbo->image = NULL;
+}
 
-	//texture rendering
-	glGenFramebuffers(1, &frame->framebuffer);
+//reads back what is left in the ring, oldest first
+static void frame_fbo_flush(FRAME_T *frame) {
+	for (int i = 1; i <= frame->fbo_num; i++) {
+		frame_fbo_read(frame,
+				&frame->fbo[(frame->fbo_cur + i) % frame->fbo_num]);
+	}
+}
 
-	glGenTextures(1, &frame->texture);
-	glBindTexture(GL_TEXTURE_2D, frame->texture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, frame->width, frame->height, 0,
-			GL_RGB, GL_UNSIGNED_BYTE, NULL);
-	if (glGetError() != GL_NO_ERROR) {
-		printf("glTexImage2D failed. Could not allocate texture buffer.\n");
+/**
+ * Draws the bands of an output frame into the fbos in turn.
+ * Nothing waits for the gpu here: an fbo is read back right before it is
+ * drawn again, FRAME_FBO_NUM - 1 draws later, so the gpu draws the next
+ * bands while the cpu reads this one back and the encoder thread compresses
+ * the one before. Frames reach the encoder FRAME_FBO_NUM - 1 draws late.
+ */
+static void frame_fbo_render(PICAM360CAPTURE_T *state, FRAME_T *frame) {
+	unsigned char *image = frame_encoder_acquire(frame->encoder);
+	int rows = frame->height * frame->tile_columns;
+	for (int row = 0; row < rows; row += frame->fbo_height) {
+		frame->fbo_cur = (frame->fbo_cur + 1) % frame->fbo_num;
+		FRAME_FBO_T *fbo = &frame->fbo[frame->fbo_cur];
+		frame_fbo_read(frame, fbo);
+
+		double start = now_msec();
+		frame->tile_row = row;
+		redraw_render_texture(state, frame,
+				&state->model_data[frame->operation_mode]);
+		if (frame->i420) {
+			redraw_i420(state, frame, fbo);
+		}
+		glFlush();
+		frame->render_msec += now_msec() - start;
+
+		fbo->image = image;
+		fbo->tile_row = row;
+		fbo->last_band = (row + frame->fbo_height >= rows);
 	}
-	glBindTexture(GL_TEXTURE_2D, 0);
+	frame->tile_row = 0;
+	frame->stage_frames++;
+}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, frame->framebuffer);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-			frame->texture, 0);
-	if (glGetError() != GL_NO_ERROR) {
-		printf(
-				"glFramebufferTexture2D failed. Could not allocate framebuffer.\n");
+static void encode_still(void *user_data, unsigned char *image) {
+	FRAME_T *frame = (FRAME_T*) user_data;
+	SaveJpeg(image, frame->width, frame->height, frame->output_filepath, 70);
+	printf("snap saved to %s\n", frame->output_filepath);
+}
+
+static void encode_video(void *user_data, unsigned char *image) {
+	FRAME_T *frame = (FRAME_T*) user_data;
+	AddFrame(frame->recorder, image);
+}
+
+//the ring and the encoder thread, images for each fbo and one encoding,
+//views draw into the atlas instead of a ring, false if out of memory
+static bool start_output(FRAME_T *frame, FRAME_ENCODER_FUNC encode_func) {
+	for (; !frame->is_view && frame->fbo_num < FRAME_FBO_NUM;
+			frame->fbo_num++) {
+		create_frame_fbo(frame, &frame->fbo[frame->fbo_num]);
 	}
+	if (frame->i420) {
+		for (int i = 0; i < frame->fbo_num; i++) {
+			create_fbo(&frame->fbo[i].i420_framebuffer,
+					&frame->fbo[i].i420_texture, GL_RGBA, frame->width / 4,
+					frame->height * 3 / 2);
+		}
+	}
+	frame->encoder = frame_encoder_create(FRAME_FBO_NUM + 1,
+			frame->i420 ?
+					I420_SIZE(frame->width, frame->height) :
+					frame->width * frame->height * 3, encode_func, frame);
+	if (frame->encoder == NULL) {
+		printf("can not start output of frame %d\n", frame->id);
+		return false;
+	}
+	frame->stage_frames = 0;
+	frame->stage_start_msec = now_msec();
+	frame->render_msec = 0;
+	frame->readback_msec = 0;
+	return true;
+}
 
-	// Set background color and clear buffers
-	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+static void stop_output(FRAME_T *frame) {
+	frame_fbo_flush(frame);
+	frame_encoder_delete(frame->encoder);
+	frame->encoder = NULL;
+}
+
+/**
+ * Per frame time of each stage since the last call. The stages run side
+ * by side, so their sum exceeding the interval between frames is the
+ * overlap gained; a wait for the encoder means it is the bottleneck.
+ */
+static void print_frame_stats(FRAME_T *frame) {
+	FRAME_ENCODER_STATS_T stats;
+	if (frame->encoder == NULL || frame->stage_frames == 0) {
+		return;
+	}
+	frame_encoder_get_stats(frame->encoder, &stats);
+	double now = now_msec();
+	int n = frame->stage_frames;
+	printf("frame %d : %d frames, %.3fms apart : render %.3fms, readback "
+			"%.3fms, encode %.3fms (%llu), waited for the encoder %.3fms, "
+			"dropped %llu\n", frame->id, n,
+			(now - frame->stage_start_msec) / n, frame->render_msec / n,
+			frame->readback_msec / n,
+			stats.encoded ? stats.encode_msec / stats.encoded : 0,
+			(unsigned long long) stats.encoded, stats.acquire_wait_msec / n,
+			(unsigned long long) stats.dropped);
+	frame->stage_frames = 0;
+	frame->stage_start_msec = now;
+	frame->render_msec = 0;
+	frame->readback_msec = 0;
+}
+
+//equirectangular in camera coordinates, power of two wide so the seam wraps
+static FRAME_T *create_stitch_frame(PICAM360CAPTURE_T *state) {
+	FRAME_T *frame = malloc(sizeof(FRAME_T));
+	memset(frame, 0, sizeof(FRAME_T));
+	frame->id = -1;
+	frame->operation_mode = EQUIRECTANGULAR;
+	frame->output_mode = OUTPUT_MODE_NONE;
+	frame->is_stitch = true;
+	frame->width = 256;
+	while (frame->width * 2 <= MIN(state->stitch_width, state->max_fbo_size)) {
+		frame->width *= 2;
+	}
+	frame->height = frame->width / 2;
+	frame_tile_layout(frame, state->max_fbo_size);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	create_frame_fbo(frame, &frame->fbo[0]);
+	frame->fbo_num = 1;
+	gl_state_bind_texture(0, frame->fbo[0].texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	printf("stitching into %dx%d\n", frame->width, frame->height);
 
 	return frame;
 }
 
 bool delete_frame(FRAME_T *frame) {
 
-	if (frame->framebuffer) {
-		glDeleteFramebuffers(1, &frame->framebuffer);
+	if (frame->encoder) {
+		stop_output(frame);
+	}
+	for (int i = 0; i < frame->fbo_num; i++) {
+		gl_state_delete_framebuffer(frame->fbo[i].framebuffer);
+		gl_state_delete_texture(frame->fbo[i].texture);
+		if (frame->fbo[i].i420_framebuffer) {
+			gl_state_delete_framebuffer(frame->fbo[i].i420_framebuffer);
+			gl_state_delete_texture(frame->fbo[i].i420_texture);
+		}
 	}
-	if (frame->texture) {
-		glDeleteTextures(1, &frame->texture);
+	for (int c = 0; c < COVERAGE_CLASS_NUM; c++) {
+		if (frame->coverage.vbo[c]) {
+			gl_state_delete_array_buffer(frame->coverage.vbo[c]);
+		}
 	}
 	free(frame);
 
 	return true;
 }
 
+//camera texture width the frame can make use of
+static float frame_texture_demand(PICAM360CAPTURE_T *state, FRAME_T *frame) {
+	float horizon_r = 1.0;
+	for (int i = 0; i < state->num_of_cam; i++) {
+		horizon_r = fminf(horizon_r, lg_options.cam_horizon_r[i]);
+	}
+	//the camera texture holds horizon_r * cam_width / pi pixels per radian
+	float texture_per_rad = M_PI / horizon_r;
+	switch (frame->operation_mode) {
+	case WINDOW: {
+		//rectilinear view is densest at the center
+		float fov_rad = frame->fov * M_PI / 180.0;
+		return (frame->width / 2.0) / tan(fov_rad / 2) * texture_per_rad;
+	}
+	case EQUIRECTANGULAR:
+		return fmaxf(frame->width / (2 * M_PI), frame->height / M_PI)
+				* texture_per_rad;
+	case CUBEMAP:
+	case EAC: //a face is pi / 2 across, the cubemap denser at its edges
+		return (frame->width / 3.0) / (M_PI / 2) * texture_per_rad;
+	default: //camera texture drawn as is
+		return fmaxf(frame->width,
+				(float) frame->height * state->cam_width / state->cam_height);
+	}
+}
+
+/**
+ * Largest libjpeg scale_denom that still gives every frame, recording or
+ * not, a texel per output pixel, 1 as soon as a frame needs full resolution.
+ */
+static int sw_decode_scale_denom(PICAM360CAPTURE_T *state) {
+	float demand = 0;
+	for (FRAME_T *frame = state->frame; frame != NULL; frame = frame->next) {
+		demand = fmaxf(demand,
+				frame_texture_demand(state,
+						(frame_uses_stitch(state, frame) && state->stitch_frame) ?
+								state->stitch_frame : frame));
+	}
+	int scale_denom = 8;
+	while (scale_denom > 1 && state->cam_width / scale_denom < demand) {
+		scale_denom /= 2;
+	}
+	return scale_denom;
+}
+
+//the gain map of camera i for its calibration, see sharpen_gain_map()
+static void sharpen_gain_texture(PICAM360CAPTURE_T *state, int i) {
+	unsigned char *map = malloc(SHARPEN_GAIN_MAP_SIZE * SHARPEN_GAIN_MAP_SIZE);
+	sharpen_gain_map(lg_options.cam_offset_x[i], lg_options.cam_offset_y[i],
+			lg_options.cam_horizon_r[i], map);
+	if (state->sharpen_gain_texture[i] == 0) {
+		glGenTextures(1, &state->sharpen_gain_texture[i]);
+	}
+	gl_state_bind_texture(0, state->sharpen_gain_texture[i]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, SHARPEN_GAIN_MAP_SIZE,
+			SHARPEN_GAIN_MAP_SIZE, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, map);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	free(map);
+}
+
+/**
+ * With sharpen_pass, each new camera frame is sharpened and graded once
+ * into state->sharpen_texture by shader/sharpen.frag, the projections then
+ * take one texel per sample instead of five and no color lut lookup,
+ * however many frames and pixels they draw. A camera texture swapped by
+ * video_mjpeg_sw_upload() tells a new frame, the decoders writing through
+ * egl images do not, those are sharpened every loop.
+ */
+static void redraw_sharpen(PICAM360CAPTURE_T *state) {
+	if (!state->sharpen_pass
+			|| (lg_options.sharpness_gain == 0.0 && !state->color_lut_texture)) {
+		return;
+	}
+	bool needed = false;
+	for (FRAME_T *frame = state->frame; frame != NULL; frame = frame->next) {
+		//the stitch frame draws the cameras for those that use it
+		needed = needed || frame_uses_sharpen(state, frame)
+				|| frame_uses_stitch(state, frame);
+	}
+	if (!needed) {
+		return;
+	}
+	int width = state->cam_width / state->sw_decode_scale_denom;
+	int height = state->cam_height / state->sw_decode_scale_denom;
+	if (width != state->sharpen_width || height != state->sharpen_height) {
+		for (int i = 0; i < state->num_of_cam; i++) {
+			if (state->sharpen_framebuffer[i]) {
+				gl_state_delete_framebuffer(state->sharpen_framebuffer[i]);
+				gl_state_delete_texture(state->sharpen_texture[i]);
+			}
+			create_fbo(&state->sharpen_framebuffer[i],
+					&state->sharpen_texture[i], GL_RGBA, width, height);
+			//sampled as the cameras are
+			gl_state_bind_texture(0, state->sharpen_texture[i]);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			state->sharpen_source[i] = 0;
+		}
+		state->sharpen_width = width;
+		state->sharpen_height = height;
+	}
+
+	unsigned int key = 0;
+	if (lg_options.sharpness_gain != 0.0) {
+		key |= SHADER_SHARPEN;
+	}
+	if (state->color_lut_texture) {
+		key |= SHADER_COLOR_LUT;
+		gl_state_bind_texture(COLOR_LUT_TEXTURE_UNIT,
+				state->color_lut_texture);
+	}
+	void *program = GLProgramVariants_Get(state->sharpen_program, key);
+	MODEL_T *model = &state->model_data[BOARD]; //a quad over the viewport
+	gl_state_use_program(GLProgram_GetId(program));
+	gl_state_bind_array_buffer(model->vbo);
+	GLuint loc = GLProgram_GetAttribLocation(program, "vPosition");
+	glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(loc);
+	glViewport(0, 0, width, height);
+	GLProgram_Uniform1i(program, "cam_texture", 0);
+	GLProgram_Uniform1i(program, "gain_texture", 1);
+	GLProgram_Uniform1i(program, "color_lut_texture", COLOR_LUT_TEXTURE_UNIT);
+	GLProgram_Uniform1f(program, "pixel_size", 1.0 / width);
+	GLProgram_Uniform1f(program, "sharpness_gain", lg_options.sharpness_gain);
+	for (int i = 0; i < state->num_of_cam; i++) {
+		float gain_options[3] = { lg_options.cam_offset_x[i],
+				lg_options.cam_offset_y[i], lg_options.cam_horizon_r[i] };
+		if (state->sharpen_gain_texture[i] == 0
+				|| memcmp(gain_options, state->sharpen_gain_options[i],
+						sizeof(gain_options)) != 0) {
+			sharpen_gain_texture(state, i);
+			memcpy(state->sharpen_gain_options[i], gain_options,
+					sizeof(gain_options));
+			state->sharpen_source[i] = 0;
+		}
+		if (state->sharpen_gain != lg_options.sharpness_gain) {
+			state->sharpen_source[i] = 0;
+		}
+		if (state->egl_image[i] == NULL
+				&& state->sharpen_source[i] == state->cam_texture[i]) {
+			continue; //no new frame
+		}
+		gl_state_bind_framebuffer(state->sharpen_framebuffer[i]);
+		gl_state_bind_texture(0, state->cam_texture[i]);
+		gl_state_bind_texture(1, state->sharpen_gain_texture[i]);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, model->vbo_nop);
+		state->sharpen_source[i] = state->cam_texture[i];
+		state->sharpen_frames++;
+	}
+	state->sharpen_gain = lg_options.sharpness_gain;
+	state->sharpen_loops++;
+}
+
+/**
+ * With stitch, the cameras are unwarped, sharpened and blended once per
+ * loop into state->stitch_frame. WINDOW and EQUIRECTANGULAR frames are
+ * then a rotation and one lookup per pixel into it, so every further view
+ * costs the same however complex the stitching. As with redraw_sharpen(),
+ * the loops with no new camera frame and no new calibration keep the last
+ * stitch.
+ */
+static void redraw_stitch(PICAM360CAPTURE_T *state) {
+	bool needed = false;
+	for (FRAME_T *frame = state->frame; frame != NULL; frame = frame->next) {
+		needed = needed || frame_uses_stitch(state, frame);
+	}
+	if (!needed) {
+		return;
+	}
+	if (state->stitch_frame == NULL) {
+		state->stitch_frame = create_stitch_frame(state);
+		memset(state->stitch_source, 0, sizeof(state->stitch_source));
+	}
+	state->stitch_loops++;
+	bool updated = (state->stitch_gain != lg_options.sharpness_gain);
+	for (int i = 0; i < state->num_of_cam; i++) {
+		float options[4] = { lg_options.cam_offset_yaw[i],
+				lg_options.cam_offset_x[i], lg_options.cam_offset_y[i],
+				lg_options.cam_horizon_r[i] };
+		if (memcmp(options, state->stitch_options[i], sizeof(options)) != 0) {
+			memcpy(state->stitch_options[i], options, sizeof(options));
+			updated = true;
+		}
+		//the egl image decoders tell no new frame, see redraw_sharpen()
+		if (state->egl_image[i] != NULL
+				|| state->stitch_source[i] != state->cam_texture[i]) {
+			state->stitch_source[i] = state->cam_texture[i];
+			updated = true;
+		}
+	}
+	if (!updated) {
+		return; //no new frame
+	}
+	redraw_render_texture(state, state->stitch_frame,
+			&state->model_data[EQUIRECTANGULAR]);
+	state->stitch_gain = lg_options.sharpness_gain;
+	state->stitch_frames++;
+}
+
+//reads the views drawn into atlas back and hands them to their encoders
+static void view_atlas_read(PICAM360CAPTURE_T *state, VIEW_ATLAS_FBO_T *atlas) {
+	if (atlas->num_views == 0) {
+		return;
+	}
+	double start = now_msec();
+	gl_state_bind_framebuffer(atlas->framebuffer);
+	glReadPixels(0, 0, atlas->width, atlas->height, GL_RGB, GL_UNSIGNED_BYTE,
+			state->view_atlas_image);
+	for (int i = 0; i < atlas->num_views; i++) {
+		view_atlas_copy(state->view_atlas_image, atlas->width,
+				&atlas->cell[i], atlas->image[i]);
+		frame_encoder_submit(atlas->frame[i]->encoder);
+	}
+	atlas->num_views = 0;
+	state->view_atlas_readback_msec += now_msec() - start;
+}
+
+//reads back every view drawn, before a view stops or the fbos change
+static void view_atlas_flush(PICAM360CAPTURE_T *state) {
+	for (int i = 1; i <= VIEW_ATLAS_FBO_NUM; i++) {
+		view_atlas_read(state,
+				&state->view_atlas[(state->view_atlas_cur + i)
+						% VIEW_ATLAS_FBO_NUM]);
+	}
+}
+
+//fbos of at least width x height, they only grow
+static void view_atlas_reserve(PICAM360CAPTURE_T *state, int width,
+		int height) {
+	if (width <= state->view_atlas_width
+			&& height <= state->view_atlas_height) {
+		return;
+	}
+	view_atlas_flush(state);
+	width = MAX(width, state->view_atlas_width);
+	height = MAX(height, state->view_atlas_height);
+	for (int i = 0; i < VIEW_ATLAS_FBO_NUM; i++) {
+		VIEW_ATLAS_FBO_T *atlas = &state->view_atlas[i];
+		if (atlas->framebuffer) {
+			gl_state_delete_framebuffer(atlas->framebuffer);
+			gl_state_delete_texture(atlas->texture);
+		}
+		create_fbo(&atlas->framebuffer, &atlas->texture, GL_RGB, width,
+				height);
+	}
+	free(state->view_atlas_image);
+	state->view_atlas_image = malloc(width * height * 3);
+	state->view_atlas_width = width;
+	state->view_atlas_height = height;
+	printf("view atlas %dx%d\n", width, height);
+}
+
+/**
+ * Draws the views side by side into one fbo of the atlas ring, the
+ * program and what the views share set once, and reads that fbo back in
+ * one glReadPixels() the next loop, as the gpu draws the next. The views
+ * are then copied out to their own encoders. A view whose encoder is still
+ * busy with its earlier frames misses this one instead of holding the
+ * other views back.
+ */
+static void view_atlas_render(PICAM360CAPTURE_T *state) {
+	FRAME_T *frames[VIEW_ATLAS_MAX_VIEWS];
+	VIEW_ATLAS_CELL_T cells[VIEW_ATLAS_MAX_VIEWS];
+	int num = 0;
+	for (FRAME_T *frame = state->frame; frame != NULL; frame = frame->next) {
+		if (frame->is_view && frame->is_recording
+				&& num < VIEW_ATLAS_MAX_VIEWS) {
+			frames[num++] = frame;
+		}
+	}
+	if (num == 0) {
+		view_atlas_flush(state);
+		return;
+	}
+	//oldest first, a new view goes where there is room left
+	for (int i = 0; i < num; i++) {
+		FRAME_T *frame = frames[num - 1 - i];
+		cells[i].width = frame->width;
+		cells[i].height = frame->height;
+	}
+	int width, height;
+	int placed = view_atlas_layout(cells, num, state->max_fbo_size, &width,
+			&height);
+	view_atlas_reserve(state, width, height);
+
+	state->view_atlas_cur = (state->view_atlas_cur + 1) % VIEW_ATLAS_FBO_NUM;
+	VIEW_ATLAS_FBO_T *atlas = &state->view_atlas[state->view_atlas_cur];
+	view_atlas_read(state, atlas);
+
+	double start = now_msec();
+	MODEL_T *model = &state->model_data[WINDOW];
+	void *program = NULL;
+	gl_state_bind_framebuffer(atlas->framebuffer);
+	for (int i = 0; i < num; i++) {
+		FRAME_T *frame = frames[num - 1 - i];
+		if (!cells[i].placed) {
+			continue;
+		}
+		unsigned char *image = frame_encoder_try_acquire(frame->encoder);
+		if (image == NULL) {
+			continue;
+		}
+		if (frame_program(state, frame) != program) {
+			program = render_setup(state, frame, model);
+		}
+		glViewport(cells[i].x, cells[i].y, cells[i].width, cells[i].height);
+		render_frame(state, frame, model, program);
+
+		atlas->frame[atlas->num_views] = frame;
+		atlas->cell[atlas->num_views] = cells[i];
+		atlas->image[atlas->num_views] = image;
+		atlas->num_views++;
+		frame->frame_num++;
+		frame->stage_frames++;
+	}
+	atlas->width = width;
+	atlas->height = height;
+	glFlush();
+	double elapsed = now_msec() - start;
+	for (int i = 0; i < num; i++) {
+		frames[i]->frame_elapsed += elapsed;
+	}
+	state->view_atlas_render_msec += elapsed;
+	state->view_atlas_views += atlas->num_views;
+	state->view_atlas_unplaced += num - placed;
+	state->view_atlas_loops++;
+}
+
+//views per second the atlas sustained and its cost per loop
+static void print_view_atlas_stats(PICAM360CAPTURE_T *state) {
+	double now = now_msec();
+	int n = state->view_atlas_loops;
+	if (n > 0) {
+		printf("view atlas : %d loops, %d views, %.1f views/s, %d left out : "
+				"render %.3fms, readback %.3fms\n", n,
+				state->view_atlas_views,
+				state->view_atlas_views * 1000.0
+						/ (now - state->view_atlas_start_msec),
+				state->view_atlas_unplaced, state->view_atlas_render_msec / n,
+				state->view_atlas_readback_msec / n);
+	}
+	state->view_atlas_loops = 0;
+	state->view_atlas_views = 0;
+	state->view_atlas_unplaced = 0;
+	state->view_atlas_start_msec = now;
+	state->view_atlas_render_msec = 0;
+	state->view_atlas_readback_msec = 0;
+}
+
 void frame_handler() {
 	struct timeval s, f;
 	double elapsed_ms;
 	FRAME_T **frame_pp = &state->frame;
+	redraw_sharpen(state);
+	redraw_stitch(state);
 	while (*frame_pp) {
 		FRAME_T *frame = *frame_pp;
 		gettimeofday(&s, NULL);
 
 		//start & stop recording
 		if (frame->is_recording && frame->output_mode == OUTPUT_MODE_NONE) { //stop record
+			print_frame_stats(frame);
+			if (frame->is_view) {
+				view_atlas_flush(state);
+			}
+			stop_output(frame); //what is left in the ring goes in first
 			StopRecord(frame->recorder);
 			frame->recorder = NULL;
 
@@ -667,97 +1511,53 @@ void frame_handler() {
 			frame->delete_after_processed = true;
 		}
 		if (!frame->is_recording && frame->output_mode == OUTPUT_MODE_VIDEO) {
-			int ratio = frame->double_size ? 2 : 1;
-			frame->recorder = StartRecord(frame->width * ratio, frame->height,
-					frame->output_filepath, 4000 * ratio);
-			frame->output_mode = OUTPUT_MODE_VIDEO;
-			frame->frame_num = 0;
-			frame->frame_elapsed = 0;
-			frame->is_recording = true;
-			printf("start_record saved to %s\n", frame->output_filepath);
+			//the encoder takes I420 as is, packed in one band of its own
+			frame->i420 = (!frame->is_view && frame->tile_columns == 1
+					&& frame->fbo_height == frame->height
+					&& i420_supported(frame->width, frame->height)
+					&& frame->height * 3 / 2 <= state->max_fbo_size);
+			if (start_output(frame, encode_video)) {
+				frame->recorder = StartRecord(frame->width, frame->height,
+						frame->output_filepath, 4000 * frame->tile_columns,
+						frame->i420);
+				frame->frame_num = 0;
+				frame->frame_elapsed = 0;
+				frame->is_recording = true;
+				printf("start_record saved to %s\n", frame->output_filepath);
+			} else { //not recorded, the frame goes as a stop_record would
+				frame->output_mode = OUTPUT_MODE_NONE;
+				frame->delete_after_processed = true;
+			}
 		}
 
 		//rendering to buffer
-		if (frame->output_mode == OUTPUT_MODE_STILL
-				|| frame->output_mode == OUTPUT_MODE_VIDEO) {
-			int img_width;
-			int img_height;
-			unsigned char *img_buff = NULL;
-			if (frame->double_size) {
-				int size = frame->width * frame->height * 3;
-				unsigned char *image_buffer = (unsigned char*) malloc(size);
-				unsigned char *image_buffer_double = (unsigned char*) malloc(
-						size * 2);
-				img_width = frame->width * 2;
-				img_height = frame->height;
-				img_buff = image_buffer_double;
-				for (int split = 0; split < 2; split++) {
-					state->split = split + 1;
-					redraw_render_texture(state, frame,
-							&state->model_data[frame->operation_mode]);
-					glFinish();
-					glBindFramebuffer(GL_FRAMEBUFFER, frame->framebuffer);
-					glReadPixels(0, 0, frame->width, frame->height, GL_RGB,
-							GL_UNSIGNED_BYTE, image_buffer);
-					glBindFramebuffer(GL_FRAMEBUFFER, 0);
-					for (int y = 0; y < frame->height; y++) {
-						memcpy(
-								image_buffer_double + frame->width * 2 * 3 * y
-										+ frame->width * 3 * split,
-								image_buffer + frame->width * 3 * y,
-								frame->width * 3);
-					}
-				}
-				free(image_buffer);
-			} else {
-				int size = frame->width * frame->height * 3;
-				unsigned char *image_buffer = (unsigned char*) malloc(size);
-				img_width = frame->width;
-				img_height = frame->height;
-				img_buff = image_buffer;
-				state->split = 0;
-				redraw_render_texture(state, frame,
-						&state->model_data[frame->operation_mode]);
-				glFinish();
-				glBindFramebuffer(GL_FRAMEBUFFER, frame->framebuffer);
-				glReadPixels(0, 0, frame->width, frame->height, GL_RGB,
-						GL_UNSIGNED_BYTE, image_buffer);
-				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		switch (frame->output_mode) {
+		case OUTPUT_MODE_STILL:
+			//one image, written by the encoder thread before delete_frame()
+			if (start_output(frame, encode_still)) {
+				frame_fbo_render(state, frame);
 			}
 
-			switch (frame->output_mode) {
-			case OUTPUT_MODE_STILL:
-				SaveJpeg(img_buff, img_width, img_height,
-						frame->output_filepath, 70);
-				printf("snap saved to %s\n", frame->output_filepath);
-
-				gettimeofday(&f, NULL);
-				elapsed_ms = (f.tv_sec - s.tv_sec) * 1000.0
-						+ (f.tv_usec - s.tv_usec) / 1000.0;
-				printf("elapsed %.3lf ms\n", elapsed_ms);
-
-				frame->output_mode = OUTPUT_MODE_NONE;
-				frame->delete_after_processed = true;
-				break;
-			case OUTPUT_MODE_VIDEO:
-				AddFrame(frame->recorder, img_buff);
-
-				gettimeofday(&f, NULL);
-				elapsed_ms = (f.tv_sec - s.tv_sec) * 1000.0
-						+ (f.tv_usec - s.tv_usec) / 1000.0;
-				frame->frame_num++;
-				frame->frame_elapsed += elapsed_ms;
-				break;
-			default:
+			frame->output_mode = OUTPUT_MODE_NONE;
+			frame->delete_after_processed = true;
+			break;
+		case OUTPUT_MODE_VIDEO:
+			if (frame->is_view) { //by view_atlas_render()
 				break;
 			}
-			if (img_buff) {
-				free(img_buff);
+			frame_fbo_render(state, frame);
+
+			gettimeofday(&f, NULL);
+			elapsed_ms = (f.tv_sec - s.tv_sec) * 1000.0
+					+ (f.tv_usec - s.tv_usec) / 1000.0;
+			frame->frame_num++;
+			frame->frame_elapsed += elapsed_ms;
+			break;
+		default:
+			if (frame == state->frame && state->preview) {
+				render_texture(state, frame);
 			}
-		} else if (frame == state->frame && state->preview) {
-			redraw_render_texture(state, frame,
-					&state->model_data[frame->operation_mode]);
-			glFinish();
+			break;
 		}
 		//next rendering
 		if (frame->delete_after_processed) {
@@ -772,6 +1572,7 @@ void frame_handler() {
 			redraw_scene(state, frame, &state->model_data[BOARD]);
 		}
 	}
+	view_atlas_render(state);
 }
 
 static double calib_step = 0.01;
@@ -813,7 +1614,10 @@ void command_handler() {
 				frame->view_coordinate_from_device = false;
 				state->frame = frame;
 			}
-		} else if (strncmp(cmd, "start_record", sizeof(buff)) == 0) {
+		} else if (strncmp(cmd, "start_record", sizeof(buff)) == 0
+				|| strncmp(cmd, "start_view", sizeof(buff)) == 0) {
+			//a view is a WINDOW frame of one viewer, drawn and read back
+			//with the other views, stop_record stops it
 			char *param = strtok(NULL, "\n");
 			if (param != NULL) {
 				const int kMaxArgs = 10;
@@ -833,8 +1637,16 @@ void command_handler() {
 				frame->view_yaw = 0;
 				frame->view_roll = 0;
 				frame->view_coordinate_from_device = false;
+				if (strncmp(cmd, "start_view", sizeof(buff)) == 0) {
+					frame->is_view = true;
+					if (frame->operation_mode != WINDOW) {
+						printf("a view is a WINDOW frame\n");
+						frame->operation_mode = WINDOW;
+						frame_tile_layout(frame, state->max_fbo_size);
+					}
+				}
 				state->frame = frame;
-				printf("start_record id=%d\n", frame->id);
+				printf("%s id=%d\n", cmd, frame->id);
 			}
 		} else if (strncmp(cmd, "stop_record", sizeof(buff)) == 0) {
 			char *param = strtok(NULL, " \n");
@@ -869,8 +1681,40 @@ void command_handler() {
 				state->input_mode = INPUT_MODE_FILE;
 				state->input_file_cur = -1;
 				state->input_file_size = 0;
+				state->input_file_pause = false;
 				printf("load_file from %s\n", param);
 			}
+		} else if (strncmp(cmd, "seek_frame", sizeof(buff)) == 0) {
+			char *param = strtok(NULL, " \n");
+			if (param != NULL) {
+				state->input_file_seek_frame = atoi(param);
+				state->input_file_seek_msec = -1;
+				state->input_file_seek_id++;
+				printf("seek_frame %s\n", param);
+			}
+		} else if (strncmp(cmd, "seek_time", sizeof(buff)) == 0) {
+			char *param = strtok(NULL, " \n");
+			if (param != NULL) {
+				int msec = atoi(param);
+				state->input_file_seek_msec = (msec > 0) ? msec : 0;
+				state->input_file_seek_id++;
+				printf("seek_time %s\n", param);
+			}
+		} else if (strncmp(cmd, "step_frame", sizeof(buff)) == 0) {
+			char *param = strtok(NULL, " \n");
+			int step = (param != NULL) ? atoi(param) : 1;
+			//input_file_cur is the next frame, the one on screen is before it
+			int cur = state->input_file_cur - 1;
+			state->input_file_seek_frame = ((cur > 0) ? cur : 0) + step;
+			state->input_file_seek_msec = -1;
+			state->input_file_seek_id++;
+			printf("step_frame %d\n", step);
+		} else if (strncmp(cmd, "pause_file", sizeof(buff)) == 0) {
+			char *param = strtok(NULL, " \n");
+			if (param != NULL) {
+				state->input_file_pause = (param[0] == '1');
+				printf("pause_file %s\n", param);
+			}
 		} else if (strncmp(cmd, "cam_mode", sizeof(buff)) == 0) {
 			state->input_mode = INPUT_MODE_CAM;
 		} else if (strncmp(cmd, "get_loading_pos", sizeof(buff)) == 0) {
@@ -949,6 +1793,111 @@ void command_handler() {
 					}
 				}
 			}
+		} else if (strncmp(cmd, "get_frame_stats", sizeof(buff)) == 0) {
+			video_mjpeg_print_stats();
+			for (int i = 0; i < state->num_of_cam; i++) {
+				if (state->udp_receiver[i] != NULL
+						&& (i == 0
+								|| state->udp_receiver[i]
+										!= state->udp_receiver[0])) {
+					udp_receiver_print_stats(state->udp_receiver[i]);
+				}
+			}
+			if (state->num_of_cam > 1) {
+				frame_pairing_print_stats(&state->pairing);
+			}
+			for (FRAME_T *frame = state->frame; frame != NULL;
+					frame = frame->next) {
+				print_frame_stats(frame);
+			}
+			print_view_atlas_stats(state);
+			if (state->sharpen_loops > 0) {
+				printf("sharpen pass : %d loops, %d camera frames sharpened\n",
+						state->sharpen_loops, state->sharpen_frames);
+				state->sharpen_loops = 0;
+				state->sharpen_frames = 0;
+			}
+			if (state->stitch_loops > 0) {
+				printf("stitch : %d loops, %d stitched\n",
+						state->stitch_loops, state->stitch_frames);
+				state->stitch_loops = 0;
+				state->stitch_frames = 0;
+			}
+			for (int i = 0; i < MAX_OPERATION_NUM; i++) {
+				if (state->render_count[i] == 0) {
+					continue;
+				}
+				printf("render mode %d%s : %d frames, %.3fms\n", i,
+						(state->projection_lut
+								&& state->model_data[i].lut_program) ?
+								" lut" : "", state->render_count[i],
+						state->render_msec_sum[i] / state->render_count[i]);
+				state->render_msec_sum[i] = 0;
+				state->render_count[i] = 0;
+			}
+			state->render_timing = RENDER_TIMING_FRAMES; //for the next call
+			for (int i = 0; i < MAX_OPERATION_NUM; i++) {
+				int n = state->coverage_frames[i];
+				double *area = state->coverage_area_sum[i];
+				if (n == 0) {
+					continue;
+				}
+				printf("coverage mode %d : %d frames, %.1f%% full, %.1f%% "
+						"cam0, %.1f%% cam1, %.1f%% logo, %.1f%% black\n", i, n,
+						100 * area[COVERAGE_FULL] / n,
+						100 * area[COVERAGE_CAM0] / n,
+						100 * area[COVERAGE_CAM1] / n,
+						100 * area[COVERAGE_LOGO] / n,
+						100 * area[COVERAGE_BLACK] / n);
+				state->coverage_frames[i] = 0;
+				memset(area, 0, sizeof(double) * COVERAGE_CLASS_NUM);
+			}
+		} else if (strncmp(cmd, "set_chroma_correction", sizeof(buff)) == 0) {
+			char *param = strtok(NULL, " \n");
+			if (param != NULL) {
+				state->chroma_correction = (param[0] == '1');
+				printf("set_chroma_correction %s\n", param);
+			}
+		} else if (strncmp(cmd, "set_stitch", sizeof(buff)) == 0) {
+			char *param = strtok(NULL, " \n");
+			if (param != NULL) {
+				state->stitch = (param[0] == '1');
+				if (!state->stitch && state->stitch_frame) {
+					delete_frame(state->stitch_frame);
+					state->stitch_frame = NULL;
+				}
+				printf("set_stitch %s\n", param);
+			}
+		} else if (strncmp(cmd, "set_sharpen_pass", sizeof(buff)) == 0) {
+			char *param = strtok(NULL, " \n");
+			if (param != NULL) {
+				state->sharpen_pass = (param[0] == '1');
+				printf("set_sharpen_pass %s\n", param);
+			}
+		} else if (strncmp(cmd, "set_coverage_mask", sizeof(buff)) == 0) {
+			char *param = strtok(NULL, " \n");
+			if (param != NULL) {
+				state->coverage_mask = (param[0] == '1');
+				printf("set_coverage_mask %s\n", param);
+			}
+		} else if (strncmp(cmd, "set_color_lut", sizeof(buff)) == 0) {
+			char *param = strtok(NULL, " \n");
+			if (param != NULL) { //a .cube file, - for the grading of old
+				memset(state->color_lut_file, 0,
+						sizeof(state->color_lut_file));
+				if (strcmp(param, "-") != 0) {
+					strncpy(state->color_lut_file, param,
+							sizeof(state->color_lut_file) - 1);
+				}
+				load_color_lut(state);
+				printf("set_color_lut %s\n", param);
+			}
+		} else if (strncmp(cmd, "set_projection_lut", sizeof(buff)) == 0) {
+			char *param = strtok(NULL, " \n");
+			if (param != NULL) {
+				state->projection_lut = (param[0] == '1');
+				printf("set_projection_lut %s\n", param);
+			}
 		} else if (strncmp(cmd, "set_stereo", sizeof(buff)) == 0) {
 			char *param = strtok(NULL, " \n");
 			if (param != NULL) {
@@ -967,6 +1916,20 @@ void command_handler() {
 				state->frame_sync = (param[0] == '1');
 				printf("set_frame_sync %s\n", param);
 			}
+		} else if (strncmp(cmd, "set_frame_pairing", sizeof(buff)) == 0) {
+			char *param = strtok(NULL, " \n");
+			if (param != NULL) { //tolerance in msec, 0 turns it off
+				float msec;
+				sscanf(param, "%f", &msec);
+				state->frame_pairing = (msec > 0 && state->num_of_cam > 1
+						&& state->codec_type == MJPEG && !state->video_direct);
+				if (state->frame_pairing) {
+					state->frame_pairing_tolerance = (uint64_t) (msec * 1000);
+				}
+				frame_pairing_reset(&state->pairing,
+						state->frame_pairing_tolerance);
+				printf("set_frame_pairing %s\n", param);
+			}
 		} else if (state->frame->operation_mode == CALIBRATION) {
 			if (strncmp(cmd, "step", sizeof(buff)) == 0) {
 				char *param = strtok(NULL, " \n");
@@ -1015,13 +1978,17 @@ int main(int argc, char *argv[]) {
 	state->video_direct = false;
 	state->input_mode = INPUT_MODE_CAM;
 	state->output_raw = false;
+	state->sw_decode_scale_denom = 1;
+	state->chroma_correction = true;
+	state->stitch_width = STITCH_DEFAULT_WIDTH;
+	state->window_mesh_max_error = WINDOW_MESH_DEFAULT_MAX_ERROR;
 
 	umask(0000);
 
 	//init options
 	init_options(state);
 
-	while ((opt = getopt(argc, argv, "c:w:h:n:psW:H:ECFDo:i:r:")) != -1) {
+	while ((opt = getopt(argc, argv, "c:w:h:n:psS:u:U:T:j:J:W:H:EMQCFDLlo:i:r:")) != -1) {
 		switch (opt) {
 		case 'c':
 			if (strcmp(optarg, "MJPEG") == 0) {
@@ -1043,9 +2010,41 @@ int main(int argc, char *argv[]) {
 		case 's':
 			state->stereo = true;
 			break;
+		case 'S': {
+			float msec;
+			sscanf(optarg, "%f", &msec);
+			state->frame_pairing = (msec > 0);
+			if (state->frame_pairing) {
+				state->frame_pairing_tolerance = (uint64_t) (msec * 1000);
+			}
+			break;
+		}
 		case 'D':
 			state->video_direct = true;
 			break;
+		case 'L':
+			state->h264_low_latency = true;
+			break;
+		case 'l':
+			state->projection_lut = true;
+			break;
+		case 'u':
+			sscanf(optarg, "%d", &state->udp_port);
+			state->udp_multiplex = false;
+			break;
+		case 'U':
+			sscanf(optarg, "%d", &state->udp_port);
+			state->udp_multiplex = true;
+			break;
+		case 'T':
+			sscanf(optarg, "%d", &state->test_pattern_fps);
+			break;
+		case 'j':
+			sscanf(optarg, "%d", &state->sw_decode_threads);
+			break;
+		case 'J':
+			sscanf(optarg, "%d", &state->sw_decode_slice_threads);
+			break;
 		case 'r':
 			state->output_raw = true;
 			strncpy(state->output_raw_filepath, optarg,
@@ -1063,6 +2062,8 @@ int main(int argc, char *argv[]) {
 		case 'W':
 		case 'H':
 		case 'E':
+		case 'M':
+		case 'Q':
 		case 'C':
 		case 'F':
 		case 'o':
@@ -1070,17 +2071,54 @@ int main(int argc, char *argv[]) {
 		default:
 			/* '?' */
 			printf(
-					"Usage: %s [-w width] [-h height] [-n num_of_cam] [-p] [-s]\n",
+					"Usage: %s [-w width] [-h height] [-n num_of_cam] [-p] [-s] [-S pairing_tolerance_msec] [-u base_port | -U port] [-T test_pattern_fps] [-j sw_decode_threads] [-J sw_decode_slice_threads] [-L] [-l]\n",
 					argv[0]);
 			return -1;
 		}
 	}
 
+	if (state->sw_decode_threads > 0
+			&& (state->codec_type != MJPEG || state->video_direct)) {
+		printf("software decode is for MJPEG only, using omx\n");
+		state->sw_decode_threads = 0;
+	}
+	if (state->frame_pairing_tolerance == 0) {
+		state->frame_pairing_tolerance = FRAME_PAIRING_DEFAULT_TOLERANCE;
+	}
+	if (state->num_of_cam < 2 || state->codec_type != MJPEG
+			|| state->video_direct) { //only the mjpeg decoder reports sets
+		state->frame_pairing = false;
+	}
+	frame_pairing_init(&state->pairing, state->num_of_cam,
+			state->frame_pairing_tolerance);
+
 	for (int i = 0; i < MAX_CAM_NUM; i++) {
 		mrevent_init(&state->request_frame_event[i]);
 		mrevent_trigger(&state->request_frame_event[i]);
 		mrevent_init(&state->arrived_frame_event[i]);
 		mrevent_reset(&state->arrived_frame_event[i]);
+
+		char name[32];
+		sprintf(name, "cam%d pool", i);
+		state->image_pool[i] = image_pool_create(name,
+				state->image_pool_max_bytes);
+	}
+
+	if (state->udp_port > 0 && !state->video_direct
+			&& state->test_pattern_fps <= 0) {
+		for (int i = 0; i < state->num_of_cam; i++) {
+			if (state->udp_multiplex && i > 0) {
+				state->udp_receiver[i] = state->udp_receiver[0];
+				continue;
+			}
+			char name[32];
+			sprintf(name, state->udp_multiplex ? "udp" : "cam%d udp", i);
+			state->udp_receiver[i] = udp_receiver_create(name,
+					state->udp_port + (state->udp_multiplex ? 0 : i));
+			if (state->udp_receiver[i] == NULL) {
+				exit(-1);
+			}
+		}
 	}
 
 	bcm_host_init();
@@ -1102,7 +2140,12 @@ int main(int argc, char *argv[]) {
 
 	while (!terminate) {
 		command_handler();
-		if (state->frame_sync) {
+		if (state->frame_pairing) {
+			//textures are updated in sets, nothing new until one is ready
+			if (frame_pairing_wait(&state->pairing, 1000) != 0) { //wait 1msec
+				continue;
+			}
+		} else if (state->frame_sync) {
 			int res = 0;
 			for (int i = 0; i < state->num_of_cam; i++) {
 				int res = mrevent_wait(&state->arrived_frame_event[i], 1000); //wait 1msec
@@ -1114,7 +2157,14 @@ int main(int argc, char *argv[]) {
 				continue; // skip
 			}
 		}
+		if (state->sw_decode_threads > 0) {
+			state->sw_decode_scale_denom = sw_decode_scale_denom(state);
+			video_mjpeg_sw_upload(state);
+		}
 		frame_handler();
+		if (state->frame_pairing) {
+			frame_pairing_rendered(&state->pairing);
+		}
 		if (state->frame) {
 			for (int i = 0; i < state->num_of_cam; i++) {
 				mrevent_reset(&state->arrived_frame_event[i]);
@@ -1142,27 +2192,387 @@ int main(int argc, char *argv[]) {
  * Returns: void
  *
  ***********************************************************/
-static void redraw_render_texture(PICAM360CAPTURE_T *state, FRAME_T *frame,
-		MODEL_T *model) {
-	int program = GLProgram_GetId(model->program);
-	glUseProgram(program);
+//frame is a lookup into state->stitch_frame instead of the cameras
+static bool frame_uses_stitch(PICAM360CAPTURE_T *state, FRAME_T *frame) {
+	return state->stitch && !frame->is_stitch
+			&& state->model_data[frame->operation_mode].stitched_program;
+}
+
+//frame samples the cameras redraw_sharpen() sharpened instead of
+//sharpening around each sample itself
+static bool frame_uses_sharpen(PICAM360CAPTURE_T *state, FRAME_T *frame) {
+	enum OPERATION_MODE mode = frame->operation_mode;
+	return state->sharpen_pass
+			&& (lg_options.sharpness_gain != 0.0 || state->color_lut_texture)
+			&& (mode == WINDOW || is_full_sphere(mode))
+			&& !frame_uses_stitch(state, frame);
+}
+
+//the #defines the shader of frame needs, only those it looks at
+static unsigned int shader_variant(PICAM360CAPTURE_T *state, FRAME_T *frame) {
+	enum OPERATION_MODE mode = frame->operation_mode;
+	unsigned int key = 0;
+	if (mode == BOARD) {
+		return 0;
+	}
+	if (is_full_sphere(mode)
+			&& (frame->tile_columns > 1 || frame->fbo_height < frame->height)) {
+		key |= SHADER_TILE;
+	}
+	if (mode == EAC) {
+		key |= SHADER_EQUI_ANGULAR;
+	}
+	if (frame_uses_stitch(state, frame)) { //the cameras are done with
+		return key;
+	}
+	if (mode == WINDOW && window_mesh(state, frame)->vertex_uv) {
+		key |= SHADER_VERTEX_UV;
+	}
+	if (lg_options.sharpness_gain != 0.0 && !frame_uses_sharpen(state, frame)) {
+		key |= SHADER_SHARPEN;
+	}
+	if (mode == WINDOW || is_full_sphere(mode)) {
+		if (state->num_of_cam > 1) {
+			key |= SHADER_TWO_CAMERAS;
+		} else if (state->chroma_correction) {
+			key |= SHADER_CHROMA;
+		}
+		if (state->color_lut_texture && !frame_uses_sharpen(state, frame)) {
+			key |= SHADER_COLOR_LUT;
+		}
+	}
+	return key;
+}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, frame->framebuffer);
+/**
+ * The patch a WINDOW frame is drawn with, just covering its fov, kept per
+ * fov and aspect ratio. When frame can map the fisheye per vertex (the
+ * plain shaders) the patch is made just dense enough for window.vert to
+ * stay within window_mesh_max_error camera texels, which a 60 degree view
+ * gets with a fraction of the vertices of old. If that takes over
+ * WINDOW_MESH_MAX_STEPS, or the lut or stitched shaders map each fragment,
+ * it is as dense as the fixed 150 degree mesh was.
+ */
+static WINDOW_MESH_T *window_mesh(PICAM360CAPTURE_T *state, FRAME_T *frame) {
+	int fov = (int) ceilf(frame->fov);
+	int aspect_ratio = frame->width * 100 / frame->height;
+	bool vertex_uv = (state->window_mesh_max_error > 0
+			&& !frame_uses_stitch(state, frame) && !state->projection_lut);
+	WINDOW_MESH_T *mesh = NULL; //free or used longest ago
+	state->window_mesh_clock++;
+	for (int i = 0; i < WINDOW_MESH_CACHE_NUM; i++) {
+		WINDOW_MESH_T *entry = &state->window_mesh[i];
+		if (entry->fov == fov && entry->aspect_ratio == aspect_ratio
+				&& entry->vertex_uv_asked == vertex_uv) {
+			entry->last_used = state->window_mesh_clock;
+			return entry;
+		}
+		if (mesh == NULL || (mesh->fov != 0 && (entry->fov == 0
+				|| entry->last_used < mesh->last_used))) {
+			mesh = entry;
+		}
+	}
+	if (mesh->fov != 0) {
+		gl_state_delete_array_buffer(mesh->vbo);
+	}
 
-	glViewport(0, 0, frame->width, frame->height);
+	float tan_x, tan_y;
+	window_mesh_extent(fov, aspect_ratio / 100.0, &tan_x, &tan_y);
+	int steps = 0;
+	if (vertex_uv) {
+		float horizon_r = 0;
+		for (int i = 0; i < state->num_of_cam; i++) {
+			horizon_r = fmaxf(horizon_r, lg_options.cam_horizon_r[i]);
+		}
+		if (horizon_r > 0) {
+			steps = window_mesh_steps(state->num_of_cam, tan_x, tan_y,
+					state->window_mesh_max_error
+							/ (horizon_r * state->cam_width));
+		}
+	}
+	mesh->vertex_uv = (steps > 0);
+	if (steps == 0) {
+		steps = MIN(WINDOW_MESH_MAX_STEPS,
+				(int) ceilf(2 * fmaxf(tan_x, tan_y) / WINDOW_MESH_FRAGMENT_STEP));
+	}
+	int n = window_mesh_vertices(steps);
+	float *points = malloc(sizeof(float) * 4 * n);
+	window_mesh_build(tan_x, tan_y, steps, points);
+	glGenBuffers(1, &mesh->vbo);
+	gl_state_bind_array_buffer(mesh->vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 4 * n, points,
+			GL_STATIC_DRAW);
+	free(points);
+
+	mesh->vbo_nop = n;
+	mesh->tan_x = tan_x;
+	mesh->tan_y = tan_y;
+	mesh->steps = steps;
+	mesh->fov = fov;
+	mesh->aspect_ratio = aspect_ratio;
+	mesh->vertex_uv_asked = vertex_uv;
+	mesh->last_used = state->window_mesh_clock;
+	printf("window mesh for %d degrees, aspect %.2f : %d steps, %s\n", fov,
+			aspect_ratio / 100.0, steps,
+			mesh->vertex_uv ? "mapped per vertex" : "mapped per fragment");
+	return mesh;
+}
+
+//the variant of the stitched, lut or plain shaders frame is drawn with
+static void *frame_program(PICAM360CAPTURE_T *state, FRAME_T *frame) {
+	MODEL_T *model = &state->model_data[frame->operation_mode];
+	void *variants = model->program;
+	if (frame_uses_stitch(state, frame)) {
+		variants = model->stitched_program;
+	} else if (state->projection_lut && model->lut_program) {
+		variants = model->lut_program;
+	}
+	return GLProgramVariants_Get(variants, shader_variant(state, frame));
+}
+
+//render_setup() for program, frame_program() or a variant of it
+static void render_setup_program(PICAM360CAPTURE_T *state, FRAME_T *frame,
+		MODEL_T *model, void *program) {
+	bool use_stitch = frame_uses_stitch(state, frame);
+	bool use_lut = (!use_stitch && state->projection_lut
+			&& model->lut_program != NULL);
+	gl_state_use_program(GLProgram_GetId(program));
 
-	glBindBuffer(GL_ARRAY_BUFFER, model->vbo);
-	glActiveTexture(GL_TEXTURE0);
 	if (frame->operation_mode == CALIBRATION) {
-		glBindTexture(GL_TEXTURE_2D, state->calibration_texture);
+		gl_state_bind_texture(0, state->calibration_texture);
 	} else {
-		glBindTexture(GL_TEXTURE_2D, state->logo_texture);
+		gl_state_bind_texture(0, state->logo_texture);
 	}
 	for (int i = 0; i < state->num_of_cam; i++) {
-		glActiveTexture(GL_TEXTURE1 + i);
-		glBindTexture(GL_TEXTURE_2D, state->cam_texture[i]);
+		gl_state_bind_texture(1 + i,
+				frame_uses_sharpen(state, frame) ?
+						state->sharpen_texture[i] : state->cam_texture[i]);
+	}
+	if (use_lut) {
+		gl_state_bind_texture(LUT_TEXTURE_UNIT, state->lut_texture);
+	}
+	if (use_stitch) {
+		gl_state_bind_texture(STITCH_TEXTURE_UNIT,
+				state->stitch_frame->fbo[0].texture);
+	}
+	if (shader_variant(state, frame) & SHADER_COLOR_LUT) {
+		gl_state_bind_texture(COLOR_LUT_TEXTURE_UNIT,
+				state->color_lut_texture);
 	}
 
+	GLProgram_Uniform1f(program, "pixel_size",
+			(float) state->sw_decode_scale_denom / state->cam_width);
+	GLProgram_Uniform1i(program, "active_cam", state->active_cam);
+
+	//options start
+	GLProgram_Uniform1f(program, "sharpness_gain", lg_options.sharpness_gain);
+	for (int i = 0; i < state->num_of_cam; i++) {
+		const CAM_UNIFORM_NAMES_T *names = &lg_cam_uniform_names[i];
+		GLProgram_Uniform1f(program, names->offset_yaw,
+				lg_options.cam_offset_yaw[i]);
+		GLProgram_Uniform1f(program, names->offset_x,
+				lg_options.cam_offset_x[i]);
+		GLProgram_Uniform1f(program, names->offset_y,
+				lg_options.cam_offset_y[i]);
+		GLProgram_Uniform1f(program, names->horizon_r,
+				lg_options.cam_horizon_r[i]);
+	}
+	GLProgram_Uniform1f(program, "cam_offset_yaw",
+			lg_options.cam_offset_yaw[state->active_cam]);
+	GLProgram_Uniform1f(program, "cam_offset_x",
+			lg_options.cam_offset_x[state->active_cam]);
+	GLProgram_Uniform1f(program, "cam_offset_y",
+			lg_options.cam_offset_y[state->active_cam]);
+	GLProgram_Uniform1f(program, "cam_horizon_r",
+			lg_options.cam_horizon_r[state->active_cam]);
+	if (use_lut) {
+		for (int i = 0; i < state->num_of_cam; i++) {
+			const CAM_UNIFORM_NAMES_T *names = &lg_cam_uniform_names[i];
+			float center[2], rot[2];
+			projection_lut_camera(lg_options.cam_offset_yaw[i],
+					lg_options.cam_offset_x[i], lg_options.cam_offset_y[i],
+					lg_options.cam_horizon_r[i], center, rot);
+			GLProgram_Uniform2fv(program, names->center, center);
+			GLProgram_Uniform2fv(program, names->rot, rot);
+			if (i == state->active_cam) {
+				GLProgram_Uniform2fv(program, "cam_center", center);
+				GLProgram_Uniform2fv(program, "cam_rot", rot);
+			}
+		}
+	}
+	//options end
+
+	//texture start
+	GLProgram_Uniform1i(program, "logo_texture", 0);
+	for (int i = 0; i < state->num_of_cam; i++) {
+		GLProgram_Uniform1i(program, lg_cam_uniform_names[i].texture, i + 1);
+	}
+	GLProgram_Uniform1i(program, "cam_texture", state->active_cam + 1);
+	GLProgram_Uniform1i(program, "lut_texture", LUT_TEXTURE_UNIT);
+	GLProgram_Uniform1i(program, "stitch_texture", STITCH_TEXTURE_UNIT);
+	GLProgram_Uniform1i(program, "color_lut_texture", COLOR_LUT_TEXTURE_UNIT);
+	//texture end
+}
+
+/**
+ * Program, buffers, textures and uniforms frame shares with every frame of
+ * its mode and program, views drawn side by side set them once.
+ */
+static void *render_setup(PICAM360CAPTURE_T *state, FRAME_T *frame,
+		MODEL_T *model) {
+	void *program = frame_program(state, frame);
+	render_setup_program(state, frame, model, program);
+	return program;
+}
+
+//the uniforms of frame itself
+static void render_frame_uniforms(FRAME_T *frame, void *program,
+		float *unif_matrix) {
+	//Load in the texture and thresholding parameters.
+	{
+		float tile[4] = { frame->width, frame->height, frame->tile_columns,
+				frame->tile_row };
+		GLProgram_Uniform4fv(program, "tile", tile);
+	}
+	{
+		float fov_rad = frame->fov * M_PI / 180.0;
+		float scale = 1.0 / tan(fov_rad / 2);
+		GLProgram_Uniform1f(program, "scale", scale);
+	}
+	{
+		float aspect_ratio = (float) frame->width / (float) frame->height;
+		GLProgram_Uniform1f(program, "aspect_ratio", aspect_ratio);
+	}
+	GLProgram_UniformMatrix4fv(program, "unif_matrix", (GLfloat*) unif_matrix);
+}
+
+//frame is drawn from the plain shaders, unbanded, and may go per cell class
+static bool frame_uses_coverage(PICAM360CAPTURE_T *state, FRAME_T *frame) {
+	enum OPERATION_MODE mode = frame->operation_mode;
+	return state->coverage_mask && (mode == WINDOW || is_full_sphere(mode))
+			&& !frame_uses_stitch(state, frame)
+			&& !(state->projection_lut && state->model_data[mode].lut_program)
+			&& !(shader_variant(state, frame) & SHADER_TILE);
+}
+
+/**
+ * The calibration of the cameras in cameras, zero and NULL returned if the
+ * shader of frame does not draw black off the camera images.
+ */
+static const COVERAGE_CAMERA_T *coverage_cameras(PICAM360CAPTURE_T *state,
+		FRAME_T *frame, COVERAGE_CAMERA_T cameras[MAX_CAM_NUM]) {
+	memset(cameras, 0, sizeof(COVERAGE_CAMERA_T) * MAX_CAM_NUM);
+	if (frame->operation_mode == WINDOW && state->num_of_cam == 1) {
+		return NULL; //clamped to the image edge
+	}
+	for (int i = 0; i < state->num_of_cam; i++) {
+		cameras[i].offset_yaw = lg_options.cam_offset_yaw[i];
+		cameras[i].offset_x = lg_options.cam_offset_x[i];
+		cameras[i].offset_y = lg_options.cam_offset_y[i];
+		cameras[i].horizon_r = lg_options.cam_horizon_r[i];
+	}
+	return cameras;
+}
+
+/**
+ * The cells of frame for the view of unif_matrix, made again when the
+ * camera axis moves past COVERAGE_MASK_SLACK, the view does with black
+ * cells, the calibration changes or the frame changes shape.
+ * NULL if it could not be made.
+ */
+static FRAME_COVERAGE_T *frame_coverage(PICAM360CAPTURE_T *state,
+		FRAME_T *frame, const float *unif_matrix) {
+	FRAME_COVERAGE_T *coverage = &frame->coverage;
+	enum OPERATION_MODE mode = frame->operation_mode;
+	float geometry[5] = { frame->width, frame->height };
+	if (mode == WINDOW) {
+		WINDOW_MESH_T *mesh = window_mesh(state, frame);
+		geometry[2] = mesh->tan_x;
+		geometry[3] = mesh->tan_y;
+		geometry[4] = mesh->steps;
+	}
+	COVERAGE_CAMERA_T cameras[MAX_CAM_NUM];
+	const COVERAGE_CAMERA_T *black = coverage_cameras(state, frame, cameras);
+	if (coverage->made && coverage->mode == mode
+			&& coverage->num_of_cam == state->num_of_cam
+			&& memcmp(coverage->geometry, geometry, sizeof(geometry)) == 0
+			&& memcmp(coverage->cameras, cameras, sizeof(cameras)) == 0
+			&& coverage_mask_holds(&coverage->mask, unif_matrix)) {
+		return coverage;
+	}
+
+	int ret;
+	if (mode == WINDOW) {
+		ret = coverage_mask_window(&coverage->mask, state->num_of_cam, black,
+				unif_matrix, geometry[2], geometry[3], (int) geometry[4],
+				frame->width, frame->height);
+	} else {
+		ret = coverage_mask_board(&coverage->mask,
+				(mode == EQUIRECTANGULAR) ? CPU_REMAP_EQUIRECTANGULAR :
+				(mode == CUBEMAP) ? CPU_REMAP_CUBEMAP : CPU_REMAP_EAC,
+				state->num_of_cam, black, unif_matrix, frame->width,
+				frame->height);
+	}
+	if (ret != 0) {
+		printf("coverage mask of frame %d : out of memory\n", frame->id);
+		coverage->made = false;
+		return NULL;
+	}
+	for (int c = 0; c < COVERAGE_CLASS_NUM; c++) {
+		if (coverage->mask.num_vertices[c] == 0) {
+			continue;
+		}
+		if (coverage->vbo[c] == 0) {
+			glGenBuffers(1, &coverage->vbo[c]);
+		}
+		gl_state_bind_array_buffer(coverage->vbo[c]);
+		glBufferData(GL_ARRAY_BUFFER,
+				sizeof(float) * 4 * coverage->mask.num_vertices[c],
+				coverage->mask.vertices[c], GL_STATIC_DRAW);
+	}
+	coverage_mask_free(&coverage->mask);
+	coverage->made = true;
+	coverage->mode = mode;
+	coverage->num_of_cam = state->num_of_cam;
+	memcpy(coverage->geometry, geometry, sizeof(geometry));
+	memcpy(coverage->cameras, cameras, sizeof(cameras));
+	return coverage;
+}
+
+/**
+ * frame drawn a cell class at a time, the cells that only show one camera,
+ * the logo or black by the variant of program that only does that. program
+ * is in use again after.
+ */
+static void render_coverage(PICAM360CAPTURE_T *state, FRAME_T *frame,
+		MODEL_T *model, void *program, float *unif_matrix,
+		FRAME_COVERAGE_T *coverage) {
+	unsigned int key = shader_variant(state, frame);
+	for (int c = 0; c < COVERAGE_CLASS_NUM; c++) {
+		if (coverage->mask.num_vertices[c] == 0) {
+			continue;
+		}
+		void *variant = program;
+		if (c != COVERAGE_FULL) {
+			variant = GLProgramVariants_Get(model->program,
+					key | lg_coverage_defines[c]);
+			render_setup_program(state, frame, model, variant);
+			render_frame_uniforms(frame, variant, unif_matrix);
+		}
+		gl_state_use_program(GLProgram_GetId(variant));
+		gl_state_bind_array_buffer(coverage->vbo[c]);
+		GLuint loc = GLProgram_GetAttribLocation(variant, "vPosition");
+		glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 0, 0);
+		glEnableVertexAttribArray(loc);
+
+		glDrawArrays(GL_TRIANGLES, 0, coverage->mask.num_vertices[c]);
+	}
+	gl_state_use_program(GLProgram_GetId(program));
+}
+
+//the uniforms of frame itself after render_setup(), then the draw
+static void render_frame(PICAM360CAPTURE_T *state, FRAME_T *frame,
+		MODEL_T *model, void *program) {
 	//depth axis is z, vertical asis is y
 	float unif_matrix[16];
 	float camera_offset_matrix[16];
@@ -1211,93 +2621,121 @@ static void redraw_render_texture(PICAM360CAPTURE_T *state, FRAME_T *frame,
 	mat4_multiply(unif_matrix, unif_matrix, camera_offset_matrix); // RcoRcRvRw
 
 	mat4_transpose(unif_matrix, unif_matrix); // this mat4 library is row primary, opengl is column primary
-
-	//Load in the texture and thresholding parameters.
-	glUniform1f(glGetUniformLocation(program, "split"), state->split);
-	glUniform1f(glGetUniformLocation(program, "pixel_size"),
-			1.0 / state->cam_width);
-	{
-		float fov_rad = frame->fov * M_PI / 180.0;
-		float scale = 1.0 / tan(fov_rad / 2);
-		glUniform1f(glGetUniformLocation(program, "scale"), scale);
-	}
-	{
-		float aspect_ratio = (float) frame->width / (float) frame->height;
-		glUniform1f(glGetUniformLocation(program, "aspect_ratio"),
-				aspect_ratio);
+	if (frame->is_stitch) { //camera coordinates, frames apply the rest
+		mat4_identity(unif_matrix);
 	}
 
-	glUniform1i(glGetUniformLocation(program, "active_cam"), state->active_cam);
+	render_frame_uniforms(frame, program, unif_matrix);
 
-	//options start
-	glUniform1f(glGetUniformLocation(program, "sharpness_gain"),
-			lg_options.sharpness_gain);
-	for (int i = 0; i < state->num_of_cam; i++) {
-		char buff[256];
-		sprintf(buff, "cam%d_offset_yaw", i);
-		glUniform1f(glGetUniformLocation(program, buff),
-				lg_options.cam_offset_yaw[i]);
-		sprintf(buff, "cam%d_offset_x", i);
-		glUniform1f(glGetUniformLocation(program, buff),
-				lg_options.cam_offset_x[i]);
-		sprintf(buff, "cam%d_offset_y", i);
-		glUniform1f(glGetUniformLocation(program, buff),
-				lg_options.cam_offset_y[i]);
-		sprintf(buff, "cam%d_horizon_r", i);
-		glUniform1f(glGetUniformLocation(program, buff),
-				lg_options.cam_horizon_r[i]);
+	if (frame_uses_coverage(state, frame)) {
+		FRAME_COVERAGE_T *coverage = frame_coverage(state, frame,
+				unif_matrix);
+		if (coverage != NULL) {
+			enum OPERATION_MODE mode = frame->operation_mode;
+			state->coverage_frames[mode]++;
+			for (int c = 0; c < COVERAGE_CLASS_NUM; c++) {
+				state->coverage_area_sum[mode][c] += coverage->mask.area[c];
+			}
+			if (coverage->mask.area[COVERAGE_FULL] < 1) {
+				render_coverage(state, frame, model, program, unif_matrix,
+						coverage);
+				return;
+			}
+		}
 	}
-	glUniform1f(glGetUniformLocation(program, "cam_offset_yaw"),
-			lg_options.cam_offset_yaw[state->active_cam]);
-	glUniform1f(glGetUniformLocation(program, "cam_offset_x"),
-			lg_options.cam_offset_x[state->active_cam]);
-	glUniform1f(glGetUniformLocation(program, "cam_offset_y"),
-			lg_options.cam_offset_y[state->active_cam]);
-	glUniform1f(glGetUniformLocation(program, "cam_horizon_r"),
-			lg_options.cam_horizon_r[state->active_cam]);
-	//options end
 
-	//texture start
-	glUniform1i(glGetUniformLocation(program, "logo_texture"), 0);
-	for (int i = 0; i < state->num_of_cam; i++) {
-		char buff[256];
-		sprintf(buff, "cam%d_texture", i);
-		glUniform1i(glGetUniformLocation(program, buff), i + 1);
+	GLuint vbo = model->vbo;
+	GLuint vbo_nop = model->vbo_nop;
+	if (frame->operation_mode == WINDOW) {
+		WINDOW_MESH_T *mesh = window_mesh(state, frame);
+		vbo = mesh->vbo;
+		vbo_nop = mesh->vbo_nop;
 	}
-	glUniform1i(glGetUniformLocation(program, "cam_texture"),
-			state->active_cam + 1);
-	//texture end
+	gl_state_bind_array_buffer(vbo);
+	GLuint loc = GLProgram_GetAttribLocation(program, "vPosition");
+	glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(loc);
+
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, vbo_nop);
+}
+
+static void redraw_render_texture(PICAM360CAPTURE_T *state, FRAME_T *frame,
+		MODEL_T *model) {
+	void *program = render_setup(state, frame, model);
 
-	glUniformMatrix4fv(glGetUniformLocation(program, "unif_matrix"), 1,
-			GL_FALSE, (GLfloat*) unif_matrix);
+	gl_state_bind_framebuffer(frame->fbo[frame->fbo_cur].framebuffer);
 
-	GLuint loc = glGetAttribLocation(program, "vPosition");
+	glViewport(0, 0, frame->fbo_width,
+			MIN(frame->fbo_height,
+					frame->height * frame->tile_columns - frame->tile_row));
+
+	render_frame(state, frame, model, program);
+}
+
+//the frame drawn into fbo packed into its i420 fbo by shader/i420.frag
+static void redraw_i420(PICAM360CAPTURE_T *state, FRAME_T *frame,
+		FRAME_FBO_T *fbo) {
+	MODEL_T *model = &state->model_data[BOARD]; //a quad over the viewport
+	void *program = state->i420_program;
+	gl_state_use_program(GLProgram_GetId(program));
+	gl_state_bind_framebuffer(fbo->i420_framebuffer);
+	glViewport(0, 0, frame->width / 4, frame->height * 3 / 2);
+
+	gl_state_bind_array_buffer(model->vbo);
+	gl_state_bind_texture(0, fbo->texture);
+	GLProgram_Uniform1i(program, "tex", 0);
+	{
+		float frame_size[2] = { frame->width, frame->height };
+		GLProgram_Uniform2fv(program, "frame_size", frame_size);
+	}
+
+	GLuint loc = GLProgram_GetAttribLocation(program, "vPosition");
 	glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 0, 0);
 	glEnableVertexAttribArray(loc);
 
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, model->vbo_nop);
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+/**
+ * redraw_render_texture(), for the render_timing frames get_frame_stats
+ * asks for also waited for and timed per operation mode. Waiting on every
+ * frame would hold the loop up on the gpu.
+ */
+static void render_texture(PICAM360CAPTURE_T *state, FRAME_T *frame) {
+	struct timeval s, f;
+	if (state->render_timing <= 0) {
+		redraw_render_texture(state, frame,
+				&state->model_data[frame->operation_mode]);
+		return;
+	}
+	glFinish(); //the work queued before is not this frame's
+	gettimeofday(&s, NULL);
+	redraw_render_texture(state, frame,
+			&state->model_data[frame->operation_mode]);
+	glFinish();
+	gettimeofday(&f, NULL);
+	state->render_msec_sum[frame->operation_mode] += (f.tv_sec - s.tv_sec)
+			* 1000.0 + (f.tv_usec - s.tv_usec) / 1000.0;
+	state->render_count[frame->operation_mode]++;
+	state->render_timing--;
 }
 
 static void redraw_scene(PICAM360CAPTURE_T *state, FRAME_T *frame,
 		MODEL_T *model) {
-	int program = GLProgram_GetId(model->program);
-	glUseProgram(program);
+	void *program = GLProgramVariants_Get(model->program, 0); //no variants
+	gl_state_use_program(GLProgram_GetId(program));
+	gl_state_bind_framebuffer(0);
 
 	// Start with a clear screen
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	glBindBuffer(GL_ARRAY_BUFFER, model->vbo);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, frame->texture);
+	gl_state_bind_array_buffer(model->vbo);
+	gl_state_bind_texture(0, frame->fbo[frame->fbo_cur].texture);
 
 	//Load in the texture and thresholding parameters.
-	glUniform1i(glGetUniformLocation(program, "tex"), 0);
+	GLProgram_Uniform1i(program, "tex", 0);
 
-	GLuint loc = glGetAttribLocation(program, "vPosition");
+	GLuint loc = GLProgram_GetAttribLocation(program, "vPosition");
 	glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 0, 0);
 	glEnableVertexAttribArray(loc);
 
@@ -1306,25 +2744,22 @@ static void redraw_scene(PICAM360CAPTURE_T *state, FRAME_T *frame,
 				(GLsizei) state->screen_height, (GLsizei) state->screen_height);
 		glDrawArrays(GL_TRIANGLE_STRIP, 0, model->vbo_nop);
 	} else if (state->stereo) {
-		int offset_x = (state->screen_width / 2 - frame->width) / 2;
-		int offset_y = (state->screen_height - frame->height) / 2;
+		int offset_x = (state->screen_width / 2 - frame->fbo_width) / 2;
+		int offset_y = (state->screen_height - frame->fbo_height) / 2;
 		for (int i = 0; i < 2; i++) {
 			//glViewport(0, 0, (GLsizei)state->screen_width/2, (GLsizei)state->screen_height);
 			glViewport(offset_x + i * state->screen_width / 2, offset_y,
-					(GLsizei) frame->width, (GLsizei) frame->height);
+					(GLsizei) frame->fbo_width, (GLsizei) frame->fbo_height);
 			glDrawArrays(GL_TRIANGLE_STRIP, 0, model->vbo_nop);
 		}
 	} else {
-		int offset_x = (state->screen_width - frame->width) / 2;
-		int offset_y = (state->screen_height - frame->height) / 2;
-		glViewport(offset_x, offset_y, (GLsizei) frame->width,
-				(GLsizei) frame->height);
+		int offset_x = (state->screen_width - frame->fbo_width) / 2;
+		int offset_y = (state->screen_height - frame->fbo_height) / 2;
+		glViewport(offset_x, offset_y, (GLsizei) frame->fbo_width,
+				(GLsizei) frame->fbo_height);
 		glDrawArrays(GL_TRIANGLE_STRIP, 0, model->vbo_nop);
 	}
 
 	eglSwapBuffers(state->display, state->surface);
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
@@ -32,9 +32,16 @@
 #include "EGL/eglext.h"
 #include <pthread.h>
 #include "mrevent.h"
+#include "image_pool.h"
+#include "frame_pairing.h"
+#include "udp_receiver.h"
+#include "input_source.h"
+#include "frame_encoder.h"
+#include "view_atlas.h"
+#include "coverage_mask.h"
 
 #define MAX_CAM_NUM 2
-#define MAX_OPERATION_NUM 5
+#define MAX_OPERATION_NUM 7
 
 enum INPUT_MODE {
 	INPUT_MODE_NONE, INPUT_MODE_CAM, INPUT_MODE_FILE
@@ -43,15 +50,43 @@ enum OUTPUT_MODE {
 	OUTPUT_MODE_NONE, OUTPUT_MODE_STILL, OUTPUT_MODE_VIDEO
 };
 enum OPERATION_MODE {
-	BOARD, WINDOW, EQUIRECTANGULAR, FISHEYE, CALIBRATION
+	BOARD, WINDOW, EQUIRECTANGULAR, FISHEYE, CALIBRATION, CUBEMAP, EAC
 };
 enum CODEC_TYPE {
 	H264, MJPEG
 };
-typedef struct _FRAME_T {
-	int id;
+//fbos a recording frame draws into in turn, a band is read back after the
+//next FRAME_FBO_NUM - 1 are drawn
+#define FRAME_FBO_NUM 3
+typedef struct {
 	GLuint framebuffer;
 	GLuint texture;
+	//the frame packed by shader/i420.frag if the frame is recorded as I420
+	GLuint i420_framebuffer;
+	GLuint i420_texture;
+	unsigned char *image; //the band is to be read into, NULL once read
+	int tile_row; //first folded row drawn into it
+	bool last_band; //of image, which goes to the encoder once read
+} FRAME_FBO_T;
+//cells of a frame drawn by the variants for one camera, the logo or black,
+//see frame_coverage()
+typedef struct {
+	COVERAGE_MASK_T mask; //the vertices are in vbo
+	GLuint vbo[COVERAGE_CLASS_NUM]; //0 if none
+	bool made;
+	//what it was made for: width, height and for WINDOW tan_x, tan_y and
+	//steps of the mesh
+	enum OPERATION_MODE mode;
+	int num_of_cam;
+	float geometry[5];
+	COVERAGE_CAMERA_T cameras[MAX_CAM_NUM]; //see coverage_cameras()
+} FRAME_COVERAGE_T;
+typedef struct _FRAME_T {
+	int id;
+	FRAME_FBO_T fbo[FRAME_FBO_NUM];
+	int fbo_num; //created, 1 until the frame is output
+	int fbo_cur; //drawn last, shown by the preview
+	FRAME_ENCODER_T *encoder; //SaveJpeg() or AddFrame() of the images
 	uint32_t width;
 	uint32_t height;
 	bool delete_after_processed;
@@ -63,7 +98,22 @@ typedef struct _FRAME_T {
 	enum OPERATION_MODE operation_mode;
 	enum OUTPUT_MODE output_mode;
 	char output_filepath[256];
-	bool double_size;
+	//the fbo is this size, frames over the gl limits are drawn in bands of
+	//it, see frame_tile_layout()
+	uint32_t fbo_width;
+	uint32_t fbo_height;
+	int tile_columns; //columns of the frame folded into rows of the fbo
+	int tile_row; //first folded row of the band being drawn
+	//recorded as I420 packed by the gpu, RGB if drawn in bands or the size
+	//does not suit i420.frag
+	bool i420;
+	bool is_stitch; //state->stitch_frame, drawn in camera coordinates
+	bool is_view; //started by start_view, drawn into state->view_atlas
+	//per stage timings since the last get_frame_stats, see print_frame_stats()
+	int stage_frames;
+	double stage_start_msec;
+	double render_msec; //draw calls issued, the gpu is not waited for
+	double readback_msec; //glReadPixels(), waits for the band if not done
 
 	float fov;
 	//for unif matrix
@@ -73,18 +123,56 @@ typedef struct _FRAME_T {
 	float view_roll;
 	bool view_coordinate_from_device;
 
+	FRAME_COVERAGE_T coverage;
+
 	struct _FRAME_T *next;
 } FRAME_T;
+//window meshes kept for the fov and aspect ratios in use, see window_mesh()
+#define WINDOW_MESH_CACHE_NUM 8
 typedef struct {
-	void *program;
+	int fov; //degrees rounded up, 0 if the entry is free
+	int aspect_ratio; //width / height in 1/100, rounded down
+	bool vertex_uv_asked; //key as well
+	bool vertex_uv; //dense enough for VERTEX_UV
+	float tan_x; //window_mesh_build() of
+	float tan_y;
+	int steps;
+	GLuint vbo;
+	GLuint vbo_nop;
+	int last_used; //window_mesh_clock
+} WINDOW_MESH_T;
+//atlas fbos the views draw into in turn, one is read back a loop later
+#define VIEW_ATLAS_FBO_NUM 2
+typedef struct {
+	GLuint framebuffer;
+	GLuint texture;
+	//drawn into it and not read back yet, the images are of their encoders
+	int num_views;
+	FRAME_T *frame[VIEW_ATLAS_MAX_VIEWS];
+	VIEW_ATLAS_CELL_T cell[VIEW_ATLAS_MAX_VIEWS];
+	unsigned char *image[VIEW_ATLAS_MAX_VIEWS];
+	int width; //taken up by the cells, read back in one
+	int height;
+} VIEW_ATLAS_FBO_T;
+typedef struct {
+	void *program; //GLProgramVariants_new()
+	void *lut_program; //with projection_lut, NULL if the mode has no lut
+	void *stitched_program; //with stitch, NULL if the mode draws the cameras
 	GLuint vbo;
 	GLuint vbo_nop;
 } MODEL_T;
 typedef struct {
-	int split;
 	bool preview;
 	bool stereo;
 	bool video_direct;
+	//h264 decoder feeds egl_render directly, no clock and video_scheduler
+	bool h264_low_latency;
+	//mjpeg decoded by libjpeg on this many threads per camera instead of omx
+	int sw_decode_threads;
+	//extra threads that decode bands between restart markers of one frame
+	int sw_decode_slice_threads;
+	//set by the renderer from the frames it draws, 1 with omx
+	int sw_decode_scale_denom;
 	enum CODEC_TYPE codec_type;
 	uint32_t screen_width;
 	uint32_t screen_height;
@@ -101,6 +189,72 @@ typedef struct {
 	GLuint cam_texture[MAX_CAM_NUM];
 	GLuint logo_texture;
 	GLuint calibration_texture;
+	//fisheye mapping looked up instead of computed per pixel
+	bool projection_lut;
+	int max_fbo_size; //of the gl implementation
+	bool chroma_correction;
+	GLuint lut_texture; //see projection_lut.h
+	void *i420_program; //GLProgram_new(), packs recorded frames
+	//cameras stitched once per loop into stitch_frame, stitch_width x
+	//stitch_width / 2 in camera coordinates, frames are drawn from that
+	bool stitch;
+	int stitch_width;
+	FRAME_T *stitch_frame; //created when a frame needs it
+	GLuint stitch_source[MAX_CAM_NUM]; //cam_texture stitched last
+	float stitch_options[MAX_CAM_NUM][4]; //offset yaw, x, y, horizon_r
+	float stitch_gain; //sharpness_gain stitched with last
+	//since the last get_frame_stats
+	int stitch_loops;
+	int stitch_frames; //loops a camera frame was new and stitched
+	//cameras sharpened once per camera frame for the projections instead
+	//of around every sample, see sharpen.h and redraw_sharpen()
+	bool sharpen_pass;
+	void *sharpen_program; //GLProgramVariants_new()
+	int sharpen_width; //of the textures, the cameras as decoded
+	int sharpen_height;
+	GLuint sharpen_framebuffer[MAX_CAM_NUM];
+	GLuint sharpen_texture[MAX_CAM_NUM];
+	GLuint sharpen_gain_texture[MAX_CAM_NUM];
+	float sharpen_gain_options[MAX_CAM_NUM][3]; //offset x, y, horizon_r
+	GLuint sharpen_source[MAX_CAM_NUM]; //cam_texture sharpened last
+	float sharpen_gain; //sharpness_gain sharpened with last
+	//since the last get_frame_stats
+	int sharpen_loops;
+	int sharpen_frames; //camera frames sharpened
+	//colour grading of the cameras by the shaders or the sharpen pass, see
+	//load_color_lut()
+	char color_lut_file[256]; //.cube, the grading of old if empty
+	GLuint color_lut_texture; //0 for none
+	//view frames drawn together each loop, see view_atlas_render()
+	VIEW_ATLAS_FBO_T view_atlas[VIEW_ATLAS_FBO_NUM];
+	int view_atlas_cur;
+	int view_atlas_width; //of the fbos, 0 until a view is drawn
+	int view_atlas_height;
+	unsigned char *view_atlas_image; //read back into, copied out per view
+	//since the last get_frame_stats
+	int view_atlas_loops;
+	int view_atlas_views;
+	int view_atlas_unplaced; //views left out, the atlas was full
+	double view_atlas_start_msec;
+	double view_atlas_render_msec;
+	double view_atlas_readback_msec; //including the copies
+	WINDOW_MESH_T window_mesh[WINDOW_MESH_CACHE_NUM];
+	int window_mesh_clock;
+	//camera texels the fisheye mapping may be off by when window.vert
+	//interpolates it, 0 maps every fragment
+	float window_mesh_max_error;
+	//the cells of WINDOW and full sphere frames that only show one camera
+	//or the logo drawn by variants that only do that, see frame_coverage()
+	bool coverage_mask;
+	//area of the frames per operation mode and cell class since the last
+	//get_frame_stats
+	int coverage_frames[MAX_OPERATION_NUM];
+	double coverage_area_sum[MAX_OPERATION_NUM][COVERAGE_CLASS_NUM];
+	//render time per operation mode since the last get_frame_stats, of the
+	//render_timing preview frames it asked to be timed
+	double render_msec_sum[MAX_OPERATION_NUM];
+	int render_count[MAX_OPERATION_NUM];
+	int render_timing;
 // model rotation vector and direction
 	GLfloat rot_angle_x_inc;
 	GLfloat rot_angle_y_inc;
@@ -113,15 +267,36 @@ typedef struct {
 	GLfloat distance;
 	GLfloat distance_inc;
 
+	//camera streams from udp instead of the cam%d fifos if udp_port > 0
+	int udp_port;
+	bool udp_multiplex; //all cameras on udp_port, stream id = cam index
+	UDP_RECEIVER_T *udp_receiver[MAX_CAM_NUM];
+	//synthetic cameras instead of any input if test_pattern_fps > 0
+	int test_pattern_fps;
+	int test_pattern_detail; //see test_pattern_set_jpeg_options()
+
 	MREVENT_T request_frame_event[MAX_CAM_NUM];
 	MREVENT_T arrived_frame_event[MAX_CAM_NUM];
 	enum INPUT_MODE input_mode;
 	char input_filepath[256];
+	//in frames, updated by cam0's receiver
 	int input_file_size;
 	int input_file_cur;
+	bool input_file_pause;
+	//seek requests, each receiver applies a new seek_id once
+	int input_file_seek_id;
+	int input_file_seek_frame;
+	int input_file_seek_msec; //used instead of seek_frame if >= 0
 	bool frame_sync;
+	//render only frame sets captured within frame_pairing_tolerance
+	bool frame_pairing;
+	uint64_t frame_pairing_tolerance; //usec
+	FRAME_PAIRING_T pairing;
 	bool output_raw;
 	char output_raw_filepath[256];
+	//compressed frame buffers per camera, of the file, udp and h264 inputs
+	IMAGE_POOL_T *image_pool[MAX_CAM_NUM];
+	uint64_t image_pool_max_bytes;
 
 	//for unif matrix
 	//euler angles
@@ -132,3 +307,6 @@ typedef struct {
 	FRAME_T *frame;
 	MODEL_T model_data[MAX_OPERATION_NUM];
 } PICAM360CAPTURE_T;
+
+/* compressed input of camera index as selected by the options */
+INPUT_SOURCE_T *open_input_source(PICAM360CAPTURE_T *state, int index);
@@ -28,8 +28,9 @@ using std::chrono::duration_cast;
 //global variables
 
 void* StartRecord(const int width, const int height, const char *filename,
-		int bitrate_kbps) {
-	OmxCv *recorder = new OmxCv(filename, width, height, bitrate_kbps);
+		int bitrate_kbps, bool i420) {
+	OmxCv *recorder = new OmxCv(filename, width, height, bitrate_kbps, 25, 1,
+			i420);
 	return (void*)recorder;
 }
 
@@ -1,12 +1,14 @@
 #ifndef PICAM360_TOOLS_H
 #define PICAM360_TOOLS_H
 
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-void *StartRecord(const int width, const int height, const char *filename, int bitrate_kbps);
+//in_data of AddFrame() is I420 if i420, else RGB
+void *StartRecord(const int width, const int height, const char *filename, int bitrate_kbps, bool i420);
 int StopRecord(void *);
 int AddFrame(void *, const unsigned char *in_data);
 int SaveJpeg(const unsigned char *in_data, const int width, const int height, const char *out_filename, int quality);
@@ -0,0 +1,111 @@
+#include "projection_lut.h"
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.141592654
+#endif
+
+#define LOGO_R 0.65 //one camera shows the logo beyond this radius
+
+//window.frag and equirectangular.frag
+static double remap_one(double r) {
+	if (r >= 0.55) {
+		return pow(r - 0.55, 1.2) + pow(0.05, 1.1) + pow(0.10, 1.09) + 0.4;
+	} else if (r >= 0.50) {
+		return pow(r - 0.50, 1.1) + pow(0.10, 1.09) + 0.4;
+	} else if (r >= 0.40) {
+		return pow(r - 0.4, 1.09) + 0.4;
+	}
+	return r;
+}
+
+//TWO_CAMERAS shaders
+static double remap_two(double r) {
+	if (r >= 0.40) {
+		return pow(r - 0.4, 1.09) + 0.4;
+	}
+	return r;
+}
+
+static double chroma_scale(double r, double e) {
+	if (r < 0.45) {
+		return 1.0;
+	}
+	return (pow(r - 0.45, e) + 0.45) / r;
+}
+
+void projection_lut_entry(int num_of_cam, double y,
+		PROJECTION_LUT_ENTRY_T *entry) {
+	//radius / rho is smooth at the poles, stay just off the 0 / 0
+	y = fmin(fmax(y, -1.0 + 1e-12), 1.0 - 1e-12);
+	double r = acos(y) / M_PI; //(pi / 2 - asin(y)) / pi
+	double rho = sqrt(1.0 - y * y);
+	double r0, r1;
+	if (num_of_cam == 1) {
+		r0 = remap_one(r);
+		r1 = (1.0 - r) / 0.35 * 0.5;
+		entry->chroma_scale[0] = chroma_scale(r0, 1.015);
+		entry->chroma_scale[1] = chroma_scale(r0, 1.0075);
+		entry->weight = (r > LOGO_R) ? 1.0 : 0.0;
+		entry->r = r0;
+	} else {
+		r0 = remap_two(r);
+		r1 = remap_two(1.0 - r);
+		entry->chroma_scale[0] = 1.0;
+		entry->chroma_scale[1] = 1.0;
+		entry->weight = fmin(fmax(
+				(r - (0.5 - PROJECTION_LUT_OVERLAP))
+						/ (PROJECTION_LUT_OVERLAP * 2.0), 0.0), 1.0);
+		entry->r = r;
+	}
+	//the side that is not drawn grows without bound, it is clamped
+	entry->gain[0] = r0 / rho;
+	entry->gain[1] = r1 / rho;
+}
+
+static void put16(unsigned char *p, double v) {
+	int q = (int) lround(fmin(fmax(v, 0.0), 1.0) * 65535);
+	p[0] = q >> 8;
+	p[1] = q & 0xff;
+}
+
+static unsigned char put8(double v) {
+	return (unsigned char) lround(fmin(fmax(v, 0.0), 1.0) * 255);
+}
+
+void projection_lut_build(int num_of_cam, unsigned char *pixels) {
+	const int stride = PROJECTION_LUT_WIDTH * 4;
+	for (int i = 0; i < PROJECTION_LUT_WIDTH; i++) {
+		double t = (double) i / (PROJECTION_LUT_WIDTH - 1);
+		PROJECTION_LUT_ENTRY_T entry;
+		projection_lut_entry(num_of_cam, t * 2.0 - 1.0, &entry);
+
+		unsigned char *p = pixels + PROJECTION_LUT_ROW_GAIN * stride + i * 4;
+		put16(p, entry.gain[0] / PROJECTION_LUT_GAIN_MAX);
+		put16(p + 2, entry.gain[1] / PROJECTION_LUT_GAIN_MAX);
+
+		p = pixels + PROJECTION_LUT_ROW_AUX * stride + i * 4;
+		p[0] = put8((1.0 - entry.chroma_scale[0]) / PROJECTION_LUT_CHROMA_RANGE);
+		p[1] = put8((1.0 - entry.chroma_scale[1]) / PROJECTION_LUT_CHROMA_RANGE);
+		p[2] = put8(entry.weight);
+		p[3] = put8(entry.r);
+
+		double yaw = 2.0 * M_PI * t - M_PI;
+		p = pixels + PROJECTION_LUT_ROW_YAW * stride + i * 4;
+		put16(p, (sin(yaw) + 1.0) / 2.0);
+		put16(p + 2, (cos(yaw) + 1.0) / 2.0);
+
+		double pitch = M_PI * t - M_PI / 2.0;
+		p = pixels + PROJECTION_LUT_ROW_PITCH * stride + i * 4;
+		put16(p, (sin(pitch) + 1.0) / 2.0);
+		put16(p + 2, (cos(pitch) + 1.0) / 2.0);
+	}
+}
+
+void projection_lut_camera(float offset_yaw, float offset_x, float offset_y,
+		float horizon_r, float center[2], float rot[2]) {
+	center[0] = 0.5 + offset_x;
+	center[1] = 0.5 - offset_y; //cordinate is different
+	rot[0] = horizon_r * cos(offset_yaw + M_PI);
+	rot[1] = horizon_r * sin(offset_yaw + M_PI);
+}
@@ -0,0 +1,56 @@
+#ifndef _PROJECTION_LUT_H
+#define _PROJECTION_LUT_H
+
+#define PROJECTION_LUT_WIDTH 2048
+//gains are stored as 16 bit fractions of this
+#define PROJECTION_LUT_GAIN_MAX 1.0
+//chroma scales are stored as 8 bit fractions of 1 - scale over this range
+#define PROJECTION_LUT_CHROMA_RANGE (1.0 / 64)
+#define PROJECTION_LUT_OVERLAP 0.03 //two cameras are blended r 0.5 +- this
+
+/**
+ * Rows of the lookup texture, PROJECTION_LUT_WIDTH RGBA texels each.
+ * The fisheye mapping of a direction (x, y, z) depends on its angle from
+ * the camera axis only, which is a function of y. With rho = sqrt(x^2+z^2)
+ * a camera texture coordinate is
+ *   center + horizon_r * gain(y) * rotate(offset_yaw + pi) * (z, +-x)
+ * so GAIN and AUX are indexed by y * 0.5 + 0.5 and hold all the pow()
+ * remaps, asin() and atan() of the shaders as gain = radius(y) / rho.
+ * YAW and PITCH give equirectangular frames their direction without trig.
+ */
+enum PROJECTION_LUT_ROW {
+	//16 bit hi,lo: camera gain (cam0 with two cameras), nadir logo gain
+	//(cam1 with two cameras)
+	PROJECTION_LUT_ROW_GAIN,
+	//8 bit: blue and green chroma scale, weight of the second gain (logo
+	//or cam1), radius for the sharpness gain
+	PROJECTION_LUT_ROW_AUX,
+	//16 bit hi,lo of (v + 1) / 2: sin and cos of 2 * pi * x - pi
+	PROJECTION_LUT_ROW_YAW,
+	//16 bit hi,lo of (v + 1) / 2: sin and cos of pi * y - pi / 2
+	PROJECTION_LUT_ROW_PITCH,
+	PROJECTION_LUT_ROWS
+};
+
+typedef struct {
+	float gain[2];
+	float chroma_scale[2]; //blue, green
+	float weight; //of gain[1]
+	float r; //radius the sharpness gain goes up with
+} PROJECTION_LUT_ENTRY_T;
+
+/**
+ * Mapping of direction y (-1 to 1) as the shaders compute it, one camera
+ * with the nadir logo or two cameras blended at the horizon.
+ */
+void projection_lut_entry(int num_of_cam, double y,
+		PROJECTION_LUT_ENTRY_T *entry);
+
+/* PROJECTION_LUT_WIDTH * PROJECTION_LUT_ROWS * 4 bytes */
+void projection_lut_build(int num_of_cam, unsigned char *pixels);
+
+/* center and horizon_r * (cos, sin) of offset_yaw + pi for the shaders */
+void projection_lut_camera(float offset_yaw, float offset_x, float offset_y,
+		float horizon_r, float center[2], float rot[2]);
+
+#endif
@@ -0,0 +1,425 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE //fallocate
+#endif
+#include "raw_container.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mjpeg_ring.h"
+
+//writes are collected and issued in blocks of this size
+#define RAW_WRITE_BUFF_SIZE (2 * 1024 * 1024)
+//disk space is reserved ahead in steps of this size
+#define RAW_PREALLOC_SIZE (64 * 1024 * 1024)
+//read size for scanning legacy files
+#define RAW_SCAN_CHUNK (1024 * 1024)
+
+#define RAW_PAD(size) (((size) + 7) & ~7)
+
+//the structs are written as is, this only works on little endian targets
+_Static_assert(sizeof(RAW_FILE_HEADER_T) == 32, "RAW_FILE_HEADER_T");
+_Static_assert(sizeof(RAW_FRAME_HEADER_T) == 40, "RAW_FRAME_HEADER_T");
+_Static_assert(sizeof(RAW_INDEX_ENTRY_T) == 24, "RAW_INDEX_ENTRY_T");
+_Static_assert(sizeof(RAW_FILE_TRAILER_T) == 24, "RAW_FILE_TRAILER_T");
+
+struct _RAW_WRITER_T {
+	int fd;
+	int cam_id;
+	unsigned char *buff;
+	int buff_len;
+	uint64_t file_pos; //logical end of file including buff
+	uint64_t alloc_end;
+	RAW_INDEX_ENTRY_T *index;
+	int frame_num;
+	int index_size;
+	bool error;
+};
+
+struct _RAW_READER_T {
+	int fd;
+	bool legacy;
+	uint64_t file_size;
+	RAW_INDEX_ENTRY_T *index;
+	int frame_num;
+	long page_size;
+};
+
+typedef struct {
+	IMAGE_DATA image; //must be first, release callback casts back
+	void *map;
+	size_t map_size;
+} RAW_MAPPED_FRAME_T;
+
+static int write_fully(int fd, const void *data, size_t len) {
+	const unsigned char *p = data;
+	while (len > 0) {
+		ssize_t res = write(fd, p, len);
+		if (res <= 0) {
+			return -1;
+		}
+		p += res;
+		len -= res;
+	}
+	return 0;
+}
+
+static int writer_flush(RAW_WRITER_T *writer) {
+	if (writer->buff_len > 0
+			&& write_fully(writer->fd, writer->buff, writer->buff_len) != 0) {
+		writer->error = true;
+	}
+	writer->buff_len = 0;
+	return writer->error ? -1 : 0;
+}
+
+static void writer_append(RAW_WRITER_T *writer, const void *data, int len) {
+	if (writer->buff_len + len > RAW_WRITE_BUFF_SIZE) {
+		writer_flush(writer);
+	}
+	if (len >= RAW_WRITE_BUFF_SIZE) { //no point in copying
+		if (write_fully(writer->fd, data, len) != 0) {
+			writer->error = true;
+		}
+	} else {
+		memcpy(writer->buff + writer->buff_len, data, len);
+		writer->buff_len += len;
+	}
+	writer->file_pos += len;
+}
+
+static void writer_prealloc(RAW_WRITER_T *writer, uint64_t end) {
+	if (end <= writer->alloc_end) {
+		return;
+	}
+#ifdef FALLOC_FL_KEEP_SIZE
+	//best effort, not every filesystem supports it
+	fallocate(writer->fd, FALLOC_FL_KEEP_SIZE, writer->alloc_end,
+			RAW_PREALLOC_SIZE);
+#endif
+	writer->alloc_end += RAW_PREALLOC_SIZE;
+}
+
+RAW_WRITER_T *raw_writer_open(const char *path, int cam_id) {
+	RAW_WRITER_T *writer;
+	RAW_FILE_HEADER_T header = { };
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0) {
+		return NULL;
+	}
+	writer = malloc(sizeof(RAW_WRITER_T));
+	memset(writer, 0, sizeof(RAW_WRITER_T));
+	writer->fd = fd;
+	writer->cam_id = cam_id;
+	writer->buff = malloc(RAW_WRITE_BUFF_SIZE);
+	writer_prealloc(writer, 1);
+
+	memcpy(header.magic, RAW_FILE_MAGIC, sizeof(header.magic));
+	header.version = RAW_FILE_VERSION;
+	header.header_size = sizeof(RAW_FILE_HEADER_T);
+	header.cam_id = cam_id;
+	writer_append(writer, &header, sizeof(header));
+	return writer;
+}
+
+int raw_writer_write(RAW_WRITER_T *writer, IMAGE_DATA *image_data,
+		const float *quaternion) {
+	static const unsigned char padding[8] = { };
+	RAW_FRAME_HEADER_T header = { };
+	RAW_INDEX_ENTRY_T *entry;
+	int padded = RAW_PAD(image_data->image_size);
+
+	if (writer->frame_num == writer->index_size) {
+		writer->index_size = (writer->index_size == 0) ?
+				1024 : writer->index_size * 2;
+		writer->index = realloc(writer->index,
+				writer->index_size * sizeof(RAW_INDEX_ENTRY_T));
+	}
+	writer_prealloc(writer, writer->file_pos + sizeof(header) + padded);
+
+	header.magic = RAW_FRAME_MAGIC;
+	header.size = image_data->image_size;
+	header.timestamp = image_data->timestamp;
+	header.cam_id = writer->cam_id;
+	if (quaternion) {
+		header.flags |= RAW_FRAME_FLAG_QUATERNION;
+		memcpy(header.quaternion, quaternion, sizeof(header.quaternion));
+	}
+	writer_append(writer, &header, sizeof(header));
+
+	entry = &writer->index[writer->frame_num++];
+	entry->offset = writer->file_pos;
+	entry->timestamp = header.timestamp;
+	entry->size = header.size;
+	entry->flags = header.flags;
+
+	writer_append(writer, image_data->image_buff, image_data->image_size);
+	writer_append(writer, padding, padded - image_data->image_size);
+	return writer->error ? -1 : 0;
+}
+
+int raw_writer_close(RAW_WRITER_T *writer) {
+	RAW_FILE_TRAILER_T trailer = { };
+	int ret;
+
+	memcpy(trailer.magic, RAW_INDEX_MAGIC, sizeof(trailer.magic));
+	trailer.index_offset = writer->file_pos;
+	trailer.frame_num = writer->frame_num;
+	writer_append(writer, writer->index,
+			writer->frame_num * sizeof(RAW_INDEX_ENTRY_T));
+	writer_append(writer, &trailer, sizeof(trailer));
+	ret = writer_flush(writer);
+	//give back what was reserved but not used
+	ftruncate(writer->fd, writer->file_pos);
+	close(writer->fd);
+
+	free(writer->index);
+	free(writer->buff);
+	free(writer);
+	return ret;
+}
+
+static void reader_add_entry(RAW_READER_T *reader, int *index_size,
+		RAW_INDEX_ENTRY_T *entry) {
+	if (reader->frame_num == *index_size) {
+		*index_size = (*index_size == 0) ? 1024 : *index_size * 2;
+		reader->index = realloc(reader->index,
+				*index_size * sizeof(RAW_INDEX_ENTRY_T));
+	}
+	reader->index[reader->frame_num++] = *entry;
+}
+
+static bool reader_load_index(RAW_READER_T *reader) {
+	RAW_FILE_TRAILER_T trailer;
+	uint64_t pos;
+	size_t len;
+
+	if (reader->file_size < sizeof(RAW_FILE_HEADER_T) + sizeof(trailer)) {
+		return false;
+	}
+	pos = reader->file_size - sizeof(trailer);
+	if (pread(reader->fd, &trailer, sizeof(trailer), pos) != sizeof(trailer)
+			|| memcmp(trailer.magic, RAW_INDEX_MAGIC, sizeof(trailer.magic))
+					!= 0) {
+		return false;
+	}
+	len = (size_t) trailer.frame_num * sizeof(RAW_INDEX_ENTRY_T);
+	if (trailer.index_offset + len != pos) {
+		return false;
+	}
+	reader->index = malloc(len + 1);
+	if (pread(reader->fd, reader->index, len, trailer.index_offset)
+			!= (ssize_t) len) {
+		free(reader->index);
+		reader->index = NULL;
+		return false;
+	}
+	reader->frame_num = trailer.frame_num;
+	return true;
+}
+
+//walk the frame headers of a file that was not closed properly
+static void reader_rebuild_index(RAW_READER_T *reader, uint64_t pos) {
+	RAW_FRAME_HEADER_T header;
+	RAW_INDEX_ENTRY_T entry;
+	int index_size = 0;
+
+	while (pread(reader->fd, &header, sizeof(header), pos) == sizeof(header)) {
+		if (header.magic != RAW_FRAME_MAGIC
+				|| pos + sizeof(header) + header.size > reader->file_size) {
+			break;
+		}
+		entry.offset = pos + sizeof(header);
+		entry.timestamp = header.timestamp;
+		entry.size = header.size;
+		entry.flags = header.flags;
+		reader_add_entry(reader, &index_size, &entry);
+		pos = entry.offset + RAW_PAD(header.size);
+	}
+	printf("raw_reader : index rebuilt, %d frames\n", reader->frame_num);
+}
+
+//one pass over a bare JPEG concatenation
+static void reader_scan_legacy(RAW_READER_T *reader) {
+	MJPEG_SCANNER_T scanner = { };
+	RAW_INDEX_ENTRY_T entry = { };
+	unsigned char *buff = malloc(RAW_SCAN_CHUNK);
+	uint64_t buff_pos = 0; //file offset of buff[0]
+	int buff_len = 0;
+	int index_size = 0;
+
+	mjpeg_scanner_reset(&scanner);
+	while (1) {
+		ssize_t len = pread(reader->fd, buff + buff_len,
+				RAW_SCAN_CHUNK - buff_len, buff_pos + buff_len);
+		if (len <= 0) {
+			break;
+		}
+		buff_len += len;
+
+		const unsigned char *p = buff;
+		const unsigned char *end = buff + buff_len;
+		while (mjpeg_scan(&scanner, &p, end, buff_pos + (p - buff))) {
+			entry.offset = scanner.frame_start;
+			entry.size = scanner.frame_end - scanner.frame_start;
+			entry.timestamp = (uint64_t) reader->frame_num
+					* RAW_LEGACY_FRAME_USEC;
+			reader_add_entry(reader, &index_size, &entry);
+		}
+		//keep the unconsumed tail, it holds an incomplete segment header
+		int consumed = p - buff;
+		memmove(buff, p, buff_len - consumed);
+		buff_len -= consumed;
+		buff_pos += consumed;
+	}
+	free(buff);
+}
+
+RAW_READER_T *raw_reader_open(const char *path) {
+	RAW_READER_T *reader;
+	RAW_FILE_HEADER_T header = { };
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+	fstat(fd, &st);
+	reader = malloc(sizeof(RAW_READER_T));
+	memset(reader, 0, sizeof(RAW_READER_T));
+	reader->fd = fd;
+	reader->file_size = st.st_size;
+	reader->page_size = sysconf(_SC_PAGESIZE);
+
+	pread(fd, &header, sizeof(header), 0);
+	if (memcmp(header.magic, RAW_FILE_MAGIC, sizeof(header.magic)) != 0) {
+		reader->legacy = true;
+		reader_scan_legacy(reader);
+	} else if (!reader_load_index(reader)) {
+		reader_rebuild_index(reader, header.header_size);
+	}
+	return reader;
+}
+
+void raw_reader_close(RAW_READER_T *reader) {
+	if (reader == NULL) {
+		return;
+	}
+	close(reader->fd); //mappings keep their own reference to the file
+	free(reader->index);
+	free(reader);
+}
+
+int raw_reader_get_frame_num(RAW_READER_T *reader) {
+	return reader->frame_num;
+}
+
+bool raw_reader_is_legacy(RAW_READER_T *reader) {
+	return reader->legacy;
+}
+
+uint64_t raw_reader_get_time(RAW_READER_T *reader, int n) {
+	if (n < 0 || n >= reader->frame_num) {
+		return 0;
+	}
+	return reader->index[n].timestamp - reader->index[0].timestamp;
+}
+
+int raw_reader_find_frame(RAW_READER_T *reader, uint64_t usec) {
+	int last = reader->frame_num - 1;
+	uint64_t duration;
+	int n;
+
+	if (last <= 0) {
+		return 0;
+	}
+	duration = raw_reader_get_time(reader, last);
+	if (usec >= duration) {
+		return last;
+	}
+	//the frame rate is close to constant, the guess is off by a few frames
+	n = (int) (usec * last / duration);
+	while (n > 0 && raw_reader_get_time(reader, n) > usec) {
+		n--;
+	}
+	while (n < last && raw_reader_get_time(reader, n + 1) <= usec) {
+		n++;
+	}
+	return n;
+}
+
+static void release_mapped_frame(IMAGE_DATA *image_data) {
+	RAW_MAPPED_FRAME_T *frame = (RAW_MAPPED_FRAME_T*) image_data;
+	munmap(frame->map, frame->map_size);
+	free(frame);
+}
+
+IMAGE_DATA *raw_reader_get_frame(RAW_READER_T *reader, int n) {
+	RAW_INDEX_ENTRY_T *entry;
+	RAW_MAPPED_FRAME_T *frame;
+	uint64_t map_offset;
+	void *map;
+
+	if (n < 0 || n >= reader->frame_num) {
+		return NULL;
+	}
+	entry = &reader->index[n];
+	//mapping per frame keeps the address space use small on 32bit targets
+	map_offset = entry->offset / reader->page_size * reader->page_size;
+	map = mmap(NULL, entry->size + (entry->offset - map_offset), PROT_READ,
+			MAP_SHARED, reader->fd, map_offset);
+	if (map == MAP_FAILED) {
+		return NULL;
+	}
+	frame = malloc(sizeof(RAW_MAPPED_FRAME_T));
+	memset(frame, 0, sizeof(RAW_MAPPED_FRAME_T));
+	frame->map = map;
+	frame->map_size = entry->size + (entry->offset - map_offset);
+	frame->image.refcount = 1;
+	frame->image.image_buff = (unsigned char*) map
+			+ (entry->offset - map_offset);
+	frame->image.image_size = entry->size;
+	frame->image.timestamp = entry->timestamp;
+	frame->image.release = release_mapped_frame;
+	return &frame->image;
+}
+
+IMAGE_DATA *raw_reader_read_frame(RAW_READER_T *reader, int n,
+		IMAGE_POOL_T *pool) {
+	RAW_INDEX_ENTRY_T *entry;
+	IMAGE_DATA *image_data;
+
+	if (n < 0 || n >= reader->frame_num) {
+		return NULL;
+	}
+	entry = &reader->index[n];
+	image_data = image_pool_alloc(pool, entry->size);
+	if (image_data == NULL) {
+		return NULL;
+	}
+	if (pread(reader->fd, image_data->image_buff, entry->size, entry->offset)
+			!= (ssize_t) entry->size) {
+		release_image(image_data);
+		return NULL;
+	}
+	image_data->timestamp = entry->timestamp;
+	return image_data;
+}
+
+bool raw_reader_get_quaternion(RAW_READER_T *reader, int n, float *quaternion) {
+	RAW_FRAME_HEADER_T header;
+
+	if (n < 0 || n >= reader->frame_num
+			|| !(reader->index[n].flags & RAW_FRAME_FLAG_QUATERNION)) {
+		return false;
+	}
+	if (pread(reader->fd, &header, sizeof(header),
+			reader->index[n].offset - sizeof(header)) != sizeof(header)) {
+		return false;
+	}
+	memcpy(quaternion, header.quaternion, sizeof(header.quaternion));
+	return true;
+}
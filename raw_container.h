@@ -0,0 +1,106 @@
+#ifndef _RAW_CONTAINER_H
+#define _RAW_CONTAINER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "image_data.h"
+#include "image_pool.h"
+
+/**
+ * Raw recording container, all fields little endian.
+ *
+ *   RAW_FILE_HEADER_T
+ *   { RAW_FRAME_HEADER_T, jpeg payload padded to 8 bytes } * frame_num
+ *   RAW_INDEX_ENTRY_T * frame_num
+ *   RAW_FILE_TRAILER_T
+ *
+ * The trailer is written on close. A file without it (power loss while
+ * recording) is still readable, the index is rebuilt from the frame headers.
+ * Files without RAW_FILE_MAGIC are read as legacy concatenated JPEGs.
+ */
+#define RAW_FILE_MAGIC "P360RAW1"
+#define RAW_INDEX_MAGIC "P360IDX1"
+#define RAW_FRAME_MAGIC 0x4d415246 //"FRAM"
+#define RAW_FILE_VERSION 1
+
+#define RAW_FRAME_FLAG_QUATERNION 0x1
+
+//frame rate assumed for legacy files, they carry no timestamps
+#define RAW_LEGACY_FRAME_USEC 33333
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t cam_id;
+	uint32_t reserved[3];
+} RAW_FILE_HEADER_T;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t size; //payload bytes without padding
+	uint64_t timestamp; //capture time in usec
+	uint32_t cam_id;
+	uint32_t flags;
+	float quaternion[4]; //x, y, z, w
+} RAW_FRAME_HEADER_T;
+
+typedef struct {
+	uint64_t offset; //of the payload
+	uint64_t timestamp;
+	uint32_t size;
+	uint32_t flags;
+} RAW_INDEX_ENTRY_T;
+
+typedef struct {
+	char magic[8];
+	uint64_t index_offset;
+	uint32_t frame_num;
+	uint32_t reserved;
+} RAW_FILE_TRAILER_T;
+
+typedef struct _RAW_WRITER_T RAW_WRITER_T;
+typedef struct _RAW_READER_T RAW_READER_T;
+
+RAW_WRITER_T *raw_writer_open(const char *path, int cam_id);
+
+/* quaternion can be NULL, returns 0 or -1 on a write error */
+int raw_writer_write(RAW_WRITER_T *writer, IMAGE_DATA *image_data,
+		const float *quaternion);
+
+/* flushes, appends the index and closes the file */
+int raw_writer_close(RAW_WRITER_T *writer);
+
+RAW_READER_T *raw_reader_open(const char *path);
+
+/* frames already handed out stay valid after close */
+void raw_reader_close(RAW_READER_T *reader);
+
+int raw_reader_get_frame_num(RAW_READER_T *reader);
+
+bool raw_reader_is_legacy(RAW_READER_T *reader);
+
+/* usec relative to the first frame */
+uint64_t raw_reader_get_time(RAW_READER_T *reader, int n);
+
+/* last frame at or before usec (relative to the first frame) */
+int raw_reader_find_frame(RAW_READER_T *reader, uint64_t usec);
+
+/**
+ * Frame n mapped from the file, caller owns the returned reference.
+ * image_data->timestamp is the recorded capture time.
+ */
+IMAGE_DATA *raw_reader_get_frame(RAW_READER_T *reader, int n);
+
+/**
+ * Frame n read into a buffer of pool, caller owns the returned reference.
+ * Once the pool holds enough buffers nothing is mapped or allocated per
+ * frame. NULL if the pool refuses the size or the read fails.
+ */
+IMAGE_DATA *raw_reader_read_frame(RAW_READER_T *reader, int n,
+		IMAGE_POOL_T *pool);
+
+/* false if frame n was recorded without orientation */
+bool raw_reader_get_quaternion(RAW_READER_T *reader, int n, float *quaternion);
+
+#endif
@@ -16,22 +16,21 @@ void main(void) {
 	if (fc.g == 0.0) {
 		float u = tcoord.x + cam_offset_x;
 		float v = tcoord.y - cam_offset_y;
-		if (sharpness_gain == 0.0) {
-			fc = texture2D(cam_texture, vec2(u, v));
-		} else {
-			//sharpness
-			float gain = sharpness_gain;
-			fc = texture2D(cam_texture, vec2(u, v))
-					* (1.0 + 4.0 * gain);
-			fc -= texture2D(cam_texture, vec2(u - 1.0 * pixel_size, v))
-					* gain;
-			fc -= texture2D(cam_texture, vec2(u, v - 1.0 * pixel_size))
-					* gain;
-			fc -= texture2D(cam_texture, vec2(u, v + 1.0 * pixel_size))
-					* gain;
-			fc -= texture2D(cam_texture, vec2(u + 1.0 * pixel_size, v))
-					* gain;
-		}
+#ifdef SHARPEN
+		float gain = sharpness_gain;
+		fc = texture2D(cam_texture, vec2(u, v))
+				* (1.0 + 4.0 * gain);
+		fc -= texture2D(cam_texture, vec2(u - 1.0 * pixel_size, v))
+				* gain;
+		fc -= texture2D(cam_texture, vec2(u, v - 1.0 * pixel_size))
+				* gain;
+		fc -= texture2D(cam_texture, vec2(u, v + 1.0 * pixel_size))
+				* gain;
+		fc -= texture2D(cam_texture, vec2(u + 1.0 * pixel_size, v))
+				* gain;
+#else
+		fc = texture2D(cam_texture, vec2(u, v));
+#endif
 	}
 	gl_FragColor = fc;
 }
@@ -0,0 +1,227 @@
+varying vec2 tcoord;
+uniform mat4 unif_matrix;
+uniform float pixel_size;
+#ifdef TILE
+uniform vec4 tile; //frame width, height, columns folded, first folded row
+#endif
+#ifdef TWO_CAMERAS
+uniform sampler2D cam0_texture;
+uniform sampler2D cam1_texture;
+#else
+uniform sampler2D cam_texture;
+uniform sampler2D logo_texture;
+#endif
+//options start
+uniform float sharpness_gain;
+#ifdef TWO_CAMERAS
+uniform float cam0_offset_yaw;
+uniform float cam0_offset_x;
+uniform float cam0_offset_y;
+uniform float cam0_horizon_r;
+uniform float cam1_offset_yaw;
+uniform float cam1_offset_x;
+uniform float cam1_offset_y;
+uniform float cam1_horizon_r;
+#else
+uniform float cam_offset_yaw;
+uniform float cam_offset_x;
+uniform float cam_offset_y;
+uniform float cam_horizon_r;
+#endif
+//options end
+
+const float overlap = 0.03;
+const float M_PI = 3.1415926535;
+#ifdef COLOR_LUT
+uniform sampler2D color_lut_texture; //see color_lut.h
+
+//64 slices of blue, 8 to a row, red and green filtered, the two nearest
+//slices mixed
+vec4 graded(vec4 fc) {
+	vec3 c = clamp(fc.rgb, 0.0, 1.0) * 63.0;
+	float b0 = floor(c.b);
+	float b1 = min(b0 + 1.0, 63.0);
+	vec2 slice0 = vec2(mod(b0, 8.0), floor(b0 / 8.0));
+	vec2 slice1 = vec2(mod(b1, 8.0), floor(b1 / 8.0));
+	vec2 uv0 = (slice0 * 64.0 + c.rg + 0.5) / 512.0;
+	vec2 uv1 = (slice1 * 64.0 + c.rg + 0.5) / 512.0;
+	return vec4(mix(texture2D(color_lut_texture, uv0).rgb,
+			texture2D(color_lut_texture, uv1).rgb, c.b - b0), fc.a);
+}
+#else
+vec4 graded(vec4 fc) {
+	return fc;
+}
+#endif
+
+vec4 camera(sampler2D tex, float u, float v, float gain) {
+#ifdef SHARPEN
+	vec4 fc = texture2D(tex, vec2(u, v)) * (1.0 + 4.0 * gain);
+	fc -= texture2D(tex, vec2(u - 1.0 * pixel_size, v)) * gain;
+	fc -= texture2D(tex, vec2(u, v - 1.0 * pixel_size)) * gain;
+	fc -= texture2D(tex, vec2(u, v + 1.0 * pixel_size)) * gain;
+	fc -= texture2D(tex, vec2(u + 1.0 * pixel_size, v)) * gain;
+	return fc;
+#else
+	return texture2D(tex, vec2(u, v));
+#endif
+}
+
+#ifdef TILE
+//tcoord of the pixel in the whole frame, whose columns are folded into rows
+//of width / columns and drawn in bands, see frame_tile_layout()
+vec2 frame_coord() {
+	float row = tile.w + floor(gl_FragCoord.y);
+	float y = floor((row + 0.5) / tile.z);
+	float x = floor(gl_FragCoord.x) + (row - y * tile.z) * tile.x / tile.z;
+	return 1.0 - (vec2(x, y) + 0.5) / tile.xy; //flipped as by the vert
+}
+#else
+vec2 frame_coord() {
+	return tcoord;
+}
+#endif
+
+//direction of the pixel, the faces are laid out 3 by 2 from the top left:
+//left, front, right, then bottom, back, top turned a quarter so the three
+//run on from each other, as the equi-angular cubemap of youtube
+vec3 cube_direction(vec2 coord) {
+	vec2 p = (1.0 - coord) * vec2(3.0, 2.0); //from the top left, in faces
+	vec2 face = min(floor(p), vec2(2.0, 1.0));
+	vec2 ab = (p - face) * 2.0 - 1.0; //to the right and down on the face
+#ifdef EQUI_ANGULAR
+	ab = tan(ab * (M_PI / 4.0)); //even angles instead of even tangents
+#endif
+	if (face.y < 1.0) {
+		if (face.x < 1.0) {
+			return vec3(1.0, -ab.y, ab.x); //left
+		} else if (face.x < 2.0) {
+			return vec3(-ab.x, -ab.y, 1.0); //front, yaw starts from z
+		} else {
+			return vec3(-1.0, -ab.y, -ab.x); //right
+		}
+	} else {
+		if (face.x < 1.0) {
+			return vec3(ab.y, -1.0, -ab.x); //bottom
+		} else if (face.x < 2.0) {
+			return vec3(ab.y, ab.x, -1.0); //back
+		} else {
+			return vec3(ab.y, 1.0, ab.x); //top
+		}
+	}
+}
+
+void main(void) {
+#ifdef ONLY_BLACK
+	//cells off the camera images, see coverage_mask.h
+#ifdef TWO_CAMERAS
+	gl_FragColor = graded(vec4(0.0, 0.0, 0.0, 1.0));
+#else
+	gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+#endif
+	return;
+#endif
+	float u = 0.0;
+	float v = 0.0;
+	vec4 pos = vec4(normalize(cube_direction(frame_coord())), 1.0);
+	pos = unif_matrix * pos;
+	float pitch = asin(pos.y);
+	float yaw = atan(pos.x, pos.z); //yaw starts from z
+
+	float r = (M_PI / 2.0 - pitch) / M_PI;
+#ifdef TWO_CAMERAS
+	vec4 fc0;
+	vec4 fc1;
+#ifndef ONLY_CAM1
+	if (r < 0.5 + overlap) {
+		float r2 = r;
+		if (r2 >= 0.40) {
+			r2 = pow(r2 - 0.4, 1.09) + 0.4;
+		}
+		float yaw2 = yaw + M_PI + cam0_offset_yaw;
+		u = cam0_horizon_r * r2 * cos(yaw2) + 0.5 + cam0_offset_x;
+		v = cam0_horizon_r * r2 * sin(yaw2) + 0.5 - cam0_offset_y; //cordinate is different
+		if (u <= 0.0 || u > 1.0 || v <= 0.0 || v > 1.0) {
+			fc0 = vec4(0.0, 0.0, 0.0, 1.0);
+		} else {
+			fc0 = camera(cam0_texture, u, v, sharpness_gain + r2);
+		}
+	}
+#endif
+#ifndef ONLY_CAM0
+	if (r > 0.5 - overlap) {
+		float r2 = 1.0 - r;
+		if (r2 >= 0.40) {
+			r2 = pow(r2 - 0.4, 1.09) + 0.4;
+		}
+		float yaw2 = -yaw + M_PI + cam1_offset_yaw;
+		u = cam1_horizon_r * r2 * cos(yaw2) + 0.5 + cam1_offset_x;
+		v = cam1_horizon_r * r2 * sin(yaw2) + 0.5 - cam1_offset_y; //cordinate is different
+		if (u <= 0.0 || u > 1.0 || v <= 0.0 || v > 1.0) {
+			fc1 = vec4(0.0, 0.0, 0.0, 1.0);
+		} else {
+			fc1 = camera(cam1_texture, u, v, sharpness_gain + r2);
+		}
+	}
+#endif
+#if defined(ONLY_CAM0)
+	gl_FragColor = graded(fc0);
+#elif defined(ONLY_CAM1)
+	gl_FragColor = graded(fc1);
+#else
+	if (r < 0.5 - overlap) {
+		gl_FragColor = graded(fc0);
+	} else if (r < 0.5 + overlap) {
+		gl_FragColor = graded((fc0 * ((0.5 + overlap) - r)
+				+ fc1 * (r - (0.5 - overlap))) / (overlap * 2.0));
+	} else {
+		gl_FragColor = graded(fc1);
+	}
+#endif
+#else
+#ifndef ONLY_CAM0
+	if (r > 0.65) {
+		float yaw2 = -yaw;
+		r = (1.0 - r) / 0.35 * 0.5;
+		u = r * cos(yaw2) + 0.5;
+		v = r * sin(yaw2) + 0.5;
+		gl_FragColor = texture2D(logo_texture, vec2(u, v));
+		return;
+	}
+#endif
+#ifndef ONLY_LOGO
+	if (r >= 0.55) {
+		r = pow(r - 0.55, 1.2) + pow(0.05, 1.1) + pow(0.10, 1.09) + 0.4;
+	} else if (r >= 0.50) {
+		r = pow(r - 0.50, 1.1) + pow(0.10, 1.09) + 0.4;
+	} else if (r >= 0.40) {
+		r = pow(r - 0.4, 1.09) + 0.4;
+	}
+
+	float yaw2 = yaw + M_PI + cam_offset_yaw;
+	u = cam_horizon_r * r * cos(yaw2) + 0.5 + cam_offset_x;
+	v = cam_horizon_r * r * sin(yaw2) + 0.5 - cam_offset_y; //cordinate is different
+	if (u <= 0.0 || u > 1.0 || v <= 0.0 || v > 1.0) {
+		gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+	} else {
+		vec4 fc = camera(cam_texture, u, v, sharpness_gain + r);
+#ifdef CHROMA
+		if (r >= 0.45) {
+			float r_r = pow(r - 0.45, 1.015) + 0.45;
+			u = cam_horizon_r * r_r * cos(yaw2) + 0.5 + cam_offset_x;
+			v = cam_horizon_r * r_r * sin(yaw2) + 0.5 - cam_offset_y; //cordinate is different
+			vec4 fc_b = texture2D(cam_texture, vec2(u, v));
+			fc.z = fc_b.z;
+
+			r_r = pow(r - 0.45, 1.0075) + 0.45;
+			u = cam_horizon_r * r_r * cos(yaw2) + 0.5 + cam_offset_x;
+			v = cam_horizon_r * r_r * sin(yaw2) + 0.5 - cam_offset_y; //cordinate is different
+			fc_b = texture2D(cam_texture, vec2(u, v));
+			fc.y = fc_b.y;
+		}
+#endif
+		gl_FragColor = graded(fc);
+	}
+#endif
+#endif
+}
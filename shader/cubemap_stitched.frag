@@ -0,0 +1,61 @@
+varying vec2 tcoord;
+uniform mat4 unif_matrix;
+#ifdef TILE
+uniform vec4 tile; //frame width, height, columns folded, first folded row
+#endif
+//equirectangular frame of the cameras in camera coordinates, drawn once
+//per loop by equirectangular.frag, see redraw_stitch()
+uniform sampler2D stitch_texture;
+
+const float M_PI = 3.1415926535;
+
+#ifdef TILE
+//tcoord of the pixel in the whole frame, whose columns are folded into rows
+//of width / columns and drawn in bands, see frame_tile_layout()
+vec2 frame_coord() {
+	float row = tile.w + floor(gl_FragCoord.y);
+	float y = floor((row + 0.5) / tile.z);
+	float x = floor(gl_FragCoord.x) + (row - y * tile.z) * tile.x / tile.z;
+	return 1.0 - (vec2(x, y) + 0.5) / tile.xy; //flipped as by the vert
+}
+#else
+vec2 frame_coord() {
+	return tcoord;
+}
+#endif
+
+//as cubemap.frag
+vec3 cube_direction(vec2 coord) {
+	vec2 p = (1.0 - coord) * vec2(3.0, 2.0); //from the top left, in faces
+	vec2 face = min(floor(p), vec2(2.0, 1.0));
+	vec2 ab = (p - face) * 2.0 - 1.0; //to the right and down on the face
+#ifdef EQUI_ANGULAR
+	ab = tan(ab * (M_PI / 4.0)); //even angles instead of even tangents
+#endif
+	if (face.y < 1.0) {
+		if (face.x < 1.0) {
+			return vec3(1.0, -ab.y, ab.x); //left
+		} else if (face.x < 2.0) {
+			return vec3(-ab.x, -ab.y, 1.0); //front, yaw starts from z
+		} else {
+			return vec3(-1.0, -ab.y, -ab.x); //right
+		}
+	} else {
+		if (face.x < 1.0) {
+			return vec3(ab.y, -1.0, -ab.x); //bottom
+		} else if (face.x < 2.0) {
+			return vec3(ab.y, ab.x, -1.0); //back
+		} else {
+			return vec3(ab.y, 1.0, ab.x); //top
+		}
+	}
+}
+
+void main(void) {
+	vec4 pos = vec4(normalize(cube_direction(frame_coord())), 1.0);
+	pos = unif_matrix * pos;
+	float pitch = asin(pos.y);
+	float yaw = atan(pos.x, pos.z); //yaw starts from z
+	gl_FragColor = texture2D(stitch_texture,
+			vec2(0.5 - yaw / (2.0 * M_PI), 0.5 - pitch / M_PI));
+}
@@ -0,0 +1,40 @@
+varying vec2 tcoord;
+uniform mat4 unif_matrix;
+#ifdef TILE
+uniform vec4 tile; //frame width, height, columns folded, first folded row
+#endif
+//equirectangular frame of the cameras in camera coordinates, drawn once
+//per loop by equirectangular.frag, see redraw_stitch()
+uniform sampler2D stitch_texture;
+
+const float M_PI = 3.1415926535;
+
+#ifdef TILE
+//tcoord of the pixel in the whole frame, whose columns are folded into rows
+//of width / columns and drawn in bands, see frame_tile_layout()
+vec2 frame_coord() {
+	float row = tile.w + floor(gl_FragCoord.y);
+	float y = floor((row + 0.5) / tile.z);
+	float x = floor(gl_FragCoord.x) + (row - y * tile.z) * tile.x / tile.z;
+	return 1.0 - (vec2(x, y) + 0.5) / tile.xy; //flipped as by the vert
+}
+#else
+vec2 frame_coord() {
+	return tcoord;
+}
+#endif
+
+void main(void) {
+	vec4 pos = vec4(0.0, 0.0, 0.0, 1.0);
+	vec2 coord = frame_coord();
+	float pitch_orig = -M_PI / 2.0 + M_PI * coord.y;
+	float yaw_orig = 2.0 * M_PI * coord.x - M_PI;
+	pos.x = cos(pitch_orig) * sin(yaw_orig); //yaw starts from z
+	pos.y = sin(pitch_orig);
+	pos.z = cos(pitch_orig) * cos(yaw_orig); //yaw starts from z
+	pos = unif_matrix * pos;
+	float pitch = asin(pos.y);
+	float yaw = atan(pos.x, pos.z); //yaw starts from z
+	gl_FragColor = texture2D(stitch_texture,
+			vec2(0.5 - yaw / (2.0 * M_PI), 0.5 - pitch / M_PI));
+}
@@ -0,0 +1,43 @@
+uniform sampler2D tex; //the frame as drawn, row 0 on top
+uniform vec2 frame_size; //width, height
+
+//the target is width / 4 rgba pixels wide and height * 3 / 2 high, read
+//back it is I420: the y plane, then u and v with two of their rows in one
+//BT.601 limited range like video_encode expects, see i420_from_rgb()
+const vec3 y_coef = vec3(65.481, 128.553, 24.966);
+const vec3 u_coef = vec3(-37.797, -74.203, 112.0);
+const vec3 v_coef = vec3(112.0, -93.786, -18.214);
+
+float luma(float x, float y) {
+	vec3 rgb = texture2D(tex, (vec2(x, y) + 0.5) / frame_size).rgb;
+	return 16.0 + dot(rgb, y_coef);
+}
+
+//the 2x2 pixels of chroma sample x, y averaged by the linear filter
+float chroma(float x, float y, vec3 coef) {
+	vec3 rgb = texture2D(tex, (vec2(x, y) * 2.0 + 1.0) / frame_size).rgb;
+	return 128.0 + dot(rgb, coef);
+}
+
+void main(void) {
+	float x = floor(gl_FragCoord.x) * 4.0;
+	float y = floor(gl_FragCoord.y);
+	if (y < frame_size.y) {
+		gl_FragColor = vec4(luma(x, y), luma(x + 1.0, y), luma(x + 2.0, y),
+				luma(x + 3.0, y)) / 255.0;
+		return;
+	}
+	vec3 coef = u_coef;
+	y -= frame_size.y;
+	if (y >= frame_size.y / 4.0) {
+		coef = v_coef;
+		y -= frame_size.y / 4.0;
+	}
+	y *= 2.0;
+	if (x >= frame_size.x / 2.0) {
+		x -= frame_size.x / 2.0;
+		y += 1.0;
+	}
+	gl_FragColor = vec4(chroma(x, y, coef), chroma(x + 1.0, y, coef),
+			chroma(x + 2.0, y, coef), chroma(x + 3.0, y, coef)) / 255.0;
+}
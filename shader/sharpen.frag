@@ -0,0 +1,42 @@
+varying vec2 tcoord;
+uniform sampler2D cam_texture;
+uniform sampler2D gain_texture; //r of sharpen_gain_map()
+uniform float pixel_size;
+uniform float sharpness_gain;
+#ifdef COLOR_LUT
+uniform sampler2D color_lut_texture; //see color_lut.h
+
+//graded() of the projection shaders
+vec4 graded(vec4 fc) {
+	vec3 c = clamp(fc.rgb, 0.0, 1.0) * 63.0;
+	float b0 = floor(c.b);
+	float b1 = min(b0 + 1.0, 63.0);
+	vec2 slice0 = vec2(mod(b0, 8.0), floor(b0 / 8.0));
+	vec2 slice1 = vec2(mod(b1, 8.0), floor(b1 / 8.0));
+	vec2 uv0 = (slice0 * 64.0 + c.rg + 0.5) / 512.0;
+	vec2 uv1 = (slice1 * 64.0 + c.rg + 0.5) / 512.0;
+	return vec4(mix(texture2D(color_lut_texture, uv0).rgb,
+			texture2D(color_lut_texture, uv1).rgb, c.b - b0), fc.a);
+}
+#else
+vec4 graded(vec4 fc) {
+	return fc;
+}
+#endif
+
+//camera() and graded() of the projection shaders at each texel of the
+//camera, drawn once per camera frame so the projections fetch one texel,
+//see sharpen.h
+void main(void) {
+#ifdef SHARPEN
+	float gain = sharpness_gain + texture2D(gain_texture, tcoord).x;
+	vec4 fc = texture2D(cam_texture, tcoord) * (1.0 + 4.0 * gain);
+	fc -= texture2D(cam_texture, tcoord - vec2(pixel_size, 0.0)) * gain;
+	fc -= texture2D(cam_texture, tcoord - vec2(0.0, pixel_size)) * gain;
+	fc -= texture2D(cam_texture, tcoord + vec2(0.0, pixel_size)) * gain;
+	fc -= texture2D(cam_texture, tcoord + vec2(pixel_size, 0.0)) * gain;
+#else
+	vec4 fc = texture2D(cam_texture, tcoord);
+#endif
+	gl_FragColor = graded(fc);
+}
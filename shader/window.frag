@@ -1,89 +1,285 @@
 varying vec4 position;
 
+#ifdef VERTEX_UV
+varying vec4 fisheye; //window.vert
+#else
 uniform mat4 unif_matrix;
+#endif
+uniform float pixel_size;
+#ifdef TWO_CAMERAS
+uniform sampler2D cam0_texture;
+uniform sampler2D cam1_texture;
+#else
 uniform sampler2D cam_texture;
 uniform sampler2D logo_texture;
-uniform float pixel_size;
+#endif
 //options start
 uniform float sharpness_gain;
+#ifdef TWO_CAMERAS
+#ifndef VERTEX_UV
+uniform float cam0_offset_yaw;
+uniform float cam1_offset_yaw;
+#endif
+uniform float cam0_offset_x;
+uniform float cam0_offset_y;
+uniform float cam0_horizon_r;
+uniform float cam1_offset_x;
+uniform float cam1_offset_y;
+uniform float cam1_horizon_r;
+#else
+#ifndef VERTEX_UV
 uniform float cam_offset_yaw;
+#endif
 uniform float cam_offset_x;
 uniform float cam_offset_y;
 uniform float cam_horizon_r;
+#endif
 //options end
 
+const float overlap = 0.03;
 const float M_PI = 3.1415926535;
-const float color_offset = 0.15;
-const float color_factor = 1.0 / (1.0 - color_offset);
+#ifdef COLOR_LUT
+uniform sampler2D color_lut_texture; //see color_lut.h
+
+//64 slices of blue, 8 to a row, red and green filtered, the two nearest
+//slices mixed
+vec4 graded(vec4 fc) {
+	vec3 c = clamp(fc.rgb, 0.0, 1.0) * 63.0;
+	float b0 = floor(c.b);
+	float b1 = min(b0 + 1.0, 63.0);
+	vec2 slice0 = vec2(mod(b0, 8.0), floor(b0 / 8.0));
+	vec2 slice1 = vec2(mod(b1, 8.0), floor(b1 / 8.0));
+	vec2 uv0 = (slice0 * 64.0 + c.rg + 0.5) / 512.0;
+	vec2 uv1 = (slice1 * 64.0 + c.rg + 0.5) / 512.0;
+	return vec4(mix(texture2D(color_lut_texture, uv0).rgb,
+			texture2D(color_lut_texture, uv1).rgb, c.b - b0), fc.a);
+}
+#else
+vec4 graded(vec4 fc) {
+	return fc;
+}
+#endif
+
+vec4 camera(sampler2D tex, float u, float v, float gain) {
+#ifdef SHARPEN
+	vec4 fc = texture2D(tex, vec2(u, v)) * (1.0 + 4.0 * gain);
+	fc -= texture2D(tex, vec2(u - 1.0 * pixel_size, v)) * gain;
+	fc -= texture2D(tex, vec2(u, v - 1.0 * pixel_size)) * gain;
+	fc -= texture2D(tex, vec2(u, v + 1.0 * pixel_size)) * gain;
+	fc -= texture2D(tex, vec2(u + 1.0 * pixel_size, v)) * gain;
+	return fc;
+#else
+	return texture2D(tex, vec2(u, v));
+#endif
+}
+
+#ifdef VERTEX_UV
+//the radial remaps below are kinked, they stay per fragment, q * remapped
+//radius / r is where the per fragment code would sample
+vec2 remapped(vec2 q, float r, float r_remapped) {
+	return (r > 0.0) ? q * (r_remapped / r) : q;
+}
 
 void main(void) {
-	float u = 0.0;
-	float v = 0.0;
-	vec4 pos = unif_matrix * position;
-	float pitch = asin(pos.y);
-	float yaw = atan(pos.x, pos.z);
-	float r = (M_PI / 2.0 - pitch) / M_PI;
-	//gl_FragColor = vec4(1.0, 0.0, 0.0, 1.0);
+#ifdef ONLY_BLACK
+	//cells off the camera images, see coverage_mask.h
+#ifdef TWO_CAMERAS
+	gl_FragColor = graded(vec4(0.0, 0.0, 0.0, 1.0));
+#else
+	gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+#endif
+	return;
+#endif
+#ifdef TWO_CAMERAS
+	vec4 fc0;
+	vec4 fc1;
+	float r = length(fisheye.xy);
+#ifndef ONLY_CAM1
+	if (r < 0.5 + overlap) {
+		float r2 = r;
+		if (r2 >= 0.40) {
+			r2 = pow(r2 - 0.4, 1.09) + 0.4;
+		}
+		vec2 uv = cam0_horizon_r * remapped(fisheye.xy, r, r2)
+				+ vec2(0.5 + cam0_offset_x, 0.5 - cam0_offset_y);
+		if (uv.x <= 0.0 || uv.x > 1.0 || uv.y <= 0.0 || uv.y > 1.0) {
+			fc0 = vec4(0.0, 0.0, 0.0, 1.0);
+		} else {
+			fc0 = camera(cam0_texture, uv.x, uv.y, sharpness_gain + r);
+		}
+	}
+#endif
+#ifndef ONLY_CAM0
+	if (r > 0.5 - overlap) {
+		float r1 = length(fisheye.zw);
+		float r2 = r1;
+		if (r2 >= 0.40) {
+			r2 = pow(r2 - 0.4, 1.09) + 0.4;
+		}
+		vec2 uv = cam1_horizon_r * remapped(fisheye.zw, r1, r2)
+				+ vec2(0.5 + cam1_offset_x, 0.5 - cam1_offset_y);
+		if (uv.x <= 0.0 || uv.x > 1.0 || uv.y <= 0.0 || uv.y > 1.0) {
+			fc1 = vec4(0.0, 0.0, 0.0, 1.0);
+		} else {
+			fc1 = camera(cam1_texture, uv.x, uv.y, sharpness_gain + r2);
+		}
+	}
+#endif
+#if defined(ONLY_CAM0)
+	gl_FragColor = graded(fc0);
+#elif defined(ONLY_CAM1)
+	gl_FragColor = graded(fc1);
+#else
+	if (r < 0.5 - overlap) {
+		gl_FragColor = graded(fc0);
+	} else if (r < 0.5 + overlap) {
+		gl_FragColor = graded((fc0 * ((0.5 + overlap) - r) + fc1 * (r - (0.5 - overlap))) / (overlap * 2.0));
+	} else {
+		gl_FragColor = graded(fc1);
+	}
+#endif
+#else
+	float r0 = length(fisheye.xy);
+	float r = r0;
+#ifndef ONLY_CAM0
 	if (r > 0.65) {
-	} else if (r >= 0.55) {
+		gl_FragColor = texture2D(logo_texture, fisheye.zw / 0.35 * 0.5 + 0.5);
+		return;
+	}
+#endif
+#ifndef ONLY_LOGO
+	if (r >= 0.55) {
 		r = pow(r - 0.55, 1.2) + pow(0.05, 1.1) + pow(0.10, 1.09) + 0.4;
 	} else if (r >= 0.50) {
 		r = pow(r - 0.50, 1.1) + pow(0.10, 1.09) + 0.4;
 	} else if (r >= 0.40) {
 		r = pow(r - 0.4, 1.09) + 0.4;
 	}
-	if (r < 0.65) {
-		float yaw2 = yaw + M_PI + cam_offset_yaw;
-		u = cam_horizon_r * r * cos(yaw2) + 0.5 + cam_offset_x;
-		v = cam_horizon_r * r * sin(yaw2) + 0.5 - cam_offset_y;
-		vec4 fc;
-		
-		if (sharpness_gain == 0.0) {
-			fc = texture2D(cam_texture, vec2(u, v));
+	vec2 center = vec2(0.5 + cam_offset_x, 0.5 - cam_offset_y);
+	vec2 uv = cam_horizon_r * remapped(fisheye.xy, r0, r) + center;
+	vec4 fc = camera(cam_texture, uv.x, uv.y, sharpness_gain + r / 2.0);
+#ifdef CHROMA
+	if (r >= 0.45) {
+		float r_r = pow(r - 0.45, 1.015) + 0.45;
+		uv = cam_horizon_r * remapped(fisheye.xy, r0, r_r) + center;
+		vec4 fc_b = texture2D(cam_texture, uv);
+		fc.z = fc_b.z;
+
+		r_r = pow(r - 0.45, 1.0075) + 0.45;
+		uv = cam_horizon_r * remapped(fisheye.xy, r0, r_r) + center;
+		fc_b = texture2D(cam_texture, uv);
+		fc.y = fc_b.y;
+	}
+#endif
+	gl_FragColor = graded(fc);
+#endif
+#endif
+}
+#else
+void main(void) {
+#ifdef ONLY_BLACK
+	//cells off the camera images, see coverage_mask.h
+#ifdef TWO_CAMERAS
+	gl_FragColor = graded(vec4(0.0, 0.0, 0.0, 1.0));
+#else
+	gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+#endif
+	return;
+#endif
+	float u = 0.0;
+	float v = 0.0;
+	vec4 pos = unif_matrix * position;
+	float pitch = asin(pos.y);
+	float yaw = atan(pos.x, pos.z);
+	float r = (M_PI / 2.0 - pitch) / M_PI;
+#ifdef TWO_CAMERAS
+	vec4 fc0;
+	vec4 fc1;
+#ifndef ONLY_CAM1
+	if (r < 0.5 + overlap) {
+		float r2 = r;
+		if (r2 >= 0.40) {
+			r2 = pow(r2 - 0.4, 1.09) + 0.4;
+		}
+		float yaw2 = yaw + M_PI + cam0_offset_yaw;
+		u = cam0_horizon_r * r2 * cos(yaw2) + 0.5 + cam0_offset_x;
+		v = cam0_horizon_r * r2 * sin(yaw2) + 0.5 - cam0_offset_y; //cordinate is different
+		if (u <= 0.0 || u > 1.0 || v <= 0.0 || v > 1.0) {
+			fc0 = vec4(0.0, 0.0, 0.0, 1.0);
 		} else {
-			//sharpness
-			float gain = sharpness_gain + r/2.0;
-			fc = texture2D(cam_texture, vec2(u, v))
-					* (1.0 + 4.0 * gain);
-			fc -= texture2D(cam_texture, vec2(u - 1.0 * pixel_size, v))
-					* gain;
-			fc -= texture2D(cam_texture, vec2(u, v - 1.0 * pixel_size))
-					* gain;
-			fc -= texture2D(cam_texture, vec2(u, v + 1.0 * pixel_size))
-					* gain;
-			fc -= texture2D(cam_texture, vec2(u + 1.0 * pixel_size, v))
-					* gain;
+			fc0 = camera(cam0_texture, u, v, sharpness_gain + r);
 		}
-
-		fc = (fc - color_offset) * color_factor;
-		if (r >= 0.45) {
-			float r_r = pow(r - 0.45, 1.015) + 0.45;
-			u = cam_horizon_r * r_r * cos(yaw2) + 0.5 + cam_offset_x;
-			v = cam_horizon_r * r_r * sin(yaw2) + 0.5 - cam_offset_y; //cordinate is different
-			vec4 fc_b = texture2D(cam_texture, vec2(u, v));
-
-			fc_b = (fc_b - color_offset) * color_factor;
-			fc.z = fc_b.z;
-
-			r_r = pow(r - 0.45, 1.0075) + 0.45;
-			u = cam_horizon_r * r_r * cos(yaw2) + 0.5 + cam_offset_x;
-			v = cam_horizon_r * r_r * sin(yaw2) + 0.5 - cam_offset_y; //cordinate is different
-			fc_b = texture2D(cam_texture, vec2(u, v));
-
-			fc_b = (fc_b - color_offset) * color_factor;
-			fc.y = fc_b.y;
+	}
+#endif
+#ifndef ONLY_CAM0
+	if (r > 0.5 - overlap) {
+		float r2 = 1.0 - r;
+		if (r2 >= 0.40) {
+			r2 = pow(r2 - 0.4, 1.09) + 0.4;
 		}
-        gl_FragColor = fc;
+		float yaw2 = -yaw + M_PI + cam1_offset_yaw;
+		u = cam1_horizon_r * r2 * cos(yaw2) + 0.5 + cam1_offset_x;
+		v = cam1_horizon_r * r2 * sin(yaw2) + 0.5 - cam1_offset_y; //cordinate is different
+		if (u <= 0.0 || u > 1.0 || v <= 0.0 || v > 1.0) {
+			fc1 = vec4(0.0, 0.0, 0.0, 1.0);
+		} else {
+			fc1 = camera(cam1_texture, u, v, sharpness_gain + r2);
+		}
+	}
+#endif
+#if defined(ONLY_CAM0)
+	gl_FragColor = graded(fc0);
+#elif defined(ONLY_CAM1)
+	gl_FragColor = graded(fc1);
+#else
+	if (r < 0.5 - overlap) {
+		gl_FragColor = graded(fc0);
+	} else if (r < 0.5 + overlap) {
+		gl_FragColor = graded((fc0 * ((0.5 + overlap) - r) + fc1 * (r - (0.5 - overlap))) / (overlap * 2.0));
 	} else {
+		gl_FragColor = graded(fc1);
+	}
+#endif
+#else
+#ifndef ONLY_CAM0
+	if (r > 0.65) {
 		float yaw2 = -yaw;
 		r = (1.0 - r) / 0.35 * 0.5;
 		u = r * cos(yaw2) + 0.5;
 		v = r * sin(yaw2) + 0.5;
-//	    } else {
-//	    	u = pos.x / pos.y * 0.2;
-//	    	v = pos.z / pos.y * 0.2;
-//	    	u = (-u + 1.0) / 2.0;
-//	    	v = (-v + 1.0) / 2.0;
 		gl_FragColor = texture2D(logo_texture, vec2(u, v));
+		return;
+	}
+#endif
+#ifndef ONLY_LOGO
+	if (r >= 0.55) {
+		r = pow(r - 0.55, 1.2) + pow(0.05, 1.1) + pow(0.10, 1.09) + 0.4;
+	} else if (r >= 0.50) {
+		r = pow(r - 0.50, 1.1) + pow(0.10, 1.09) + 0.4;
+	} else if (r >= 0.40) {
+		r = pow(r - 0.4, 1.09) + 0.4;
+	}
+	float yaw2 = yaw + M_PI + cam_offset_yaw;
+	u = cam_horizon_r * r * cos(yaw2) + 0.5 + cam_offset_x;
+	v = cam_horizon_r * r * sin(yaw2) + 0.5 - cam_offset_y;
+	vec4 fc = camera(cam_texture, u, v, sharpness_gain + r / 2.0);
+#ifdef CHROMA
+	if (r >= 0.45) {
+		float r_r = pow(r - 0.45, 1.015) + 0.45;
+		u = cam_horizon_r * r_r * cos(yaw2) + 0.5 + cam_offset_x;
+		v = cam_horizon_r * r_r * sin(yaw2) + 0.5 - cam_offset_y; //cordinate is different
+		vec4 fc_b = texture2D(cam_texture, vec2(u, v));
+		fc.z = fc_b.z;
+
+		r_r = pow(r - 0.45, 1.0075) + 0.45;
+		u = cam_horizon_r * r_r * cos(yaw2) + 0.5 + cam_offset_x;
+		v = cam_horizon_r * r_r * sin(yaw2) + 0.5 - cam_offset_y; //cordinate is different
+		fc_b = texture2D(cam_texture, vec2(u, v));
+		fc.y = fc_b.y;
 	}
+#endif
+	gl_FragColor = graded(fc);
+#endif
+#endif
 }
+#endif
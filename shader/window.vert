@@ -2,9 +2,42 @@ attribute vec4 vPosition;
 varying vec4 position;
 uniform float scale;
 uniform float aspect_ratio;
+#ifdef VERTEX_UV
+//the fisheye coordinates window.frag takes its camera and logo texels from,
+//computed per vertex of a mesh dense enough to interpolate them, see
+//window_mesh.h
+uniform mat4 unif_matrix;
+#ifdef TWO_CAMERAS
+uniform float cam0_offset_yaw;
+uniform float cam1_offset_yaw;
+#else
+uniform float cam_offset_yaw;
+#endif
+//radius r (0 to 1 from the camera axis) times the direction around it:
+//xy of cam0 or the camera, zw of cam1 or the logo
+varying vec4 fisheye;
+
+const float M_PI = 3.1415926535;
+#endif
 
 void main(void) {
 	position = vPosition;
+#ifdef VERTEX_UV
+	vec4 pos = unif_matrix * vPosition;
+	float pitch = asin(pos.y);
+	float yaw = atan(pos.x, pos.z);
+	float r = (M_PI / 2.0 - pitch) / M_PI;
+#ifdef TWO_CAMERAS
+	float yaw0 = yaw + M_PI + cam0_offset_yaw;
+	float yaw1 = -yaw + M_PI + cam1_offset_yaw;
+	fisheye = vec4(r * vec2(cos(yaw0), sin(yaw0)),
+			(1.0 - r) * vec2(cos(yaw1), sin(yaw1)));
+#else
+	float yaw2 = yaw + M_PI + cam_offset_yaw;
+	fisheye = vec4(r * vec2(cos(yaw2), sin(yaw2)),
+			(1.0 - r) * vec2(cos(-yaw), sin(-yaw)));
+#endif
+#endif
 	gl_Position = vec4(-vPosition.x / vPosition.z * scale,
 			-vPosition.y / vPosition.z * scale * aspect_ratio, 1.0, 1.0); //negative is for jpeg coordinate
 }
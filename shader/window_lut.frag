@@ -0,0 +1,136 @@
+varying vec4 position;
+
+uniform mat4 unif_matrix;
+uniform sampler2D lut_texture;
+uniform float pixel_size;
+#ifdef TWO_CAMERAS
+uniform sampler2D cam0_texture;
+uniform sampler2D cam1_texture;
+#else
+uniform sampler2D cam_texture;
+uniform sampler2D logo_texture;
+#endif
+//options start
+uniform float sharpness_gain;
+#ifdef TWO_CAMERAS
+uniform vec2 cam0_center; //projection_lut_camera()
+uniform vec2 cam0_rot;
+uniform vec2 cam1_center;
+uniform vec2 cam1_rot;
+#else
+uniform vec2 cam_center; //projection_lut_camera()
+uniform vec2 cam_rot;
+#endif
+//options end
+
+const float lut_width = 2048.0; //projection_lut.h
+const float lut_rows = 4.0;
+const float lut_gain_max = 1.0;
+const float lut_chroma_range = 1.0 / 64.0;
+
+//row of the lut at x from 0 to 1, linear between texels
+vec4 lut(float row, float x) {
+	float t = x * (lut_width - 1.0);
+	float i = floor(t);
+	float v = (row + 0.5) / lut_rows;
+	vec4 a = texture2D(lut_texture, vec2((i + 0.5) / lut_width, v));
+	vec4 b = texture2D(lut_texture, vec2((i + 1.5) / lut_width, v));
+	return mix(a, b, t - i);
+}
+
+//two 16 bit values stored hi,lo
+vec2 lut16(vec4 c) {
+	return vec2(dot(c.xy, vec2(256.0, 1.0)), dot(c.zw, vec2(256.0, 1.0)))
+			/ 257.0;
+}
+
+vec2 fisheye(vec2 center, vec2 rot, float gain, vec2 zx) {
+	return center
+			+ gain * vec2(rot.x * zx.x - rot.y * zx.y,
+					rot.y * zx.x + rot.x * zx.y);
+}
+
+vec4 camera(sampler2D tex, vec2 uv, float gain) {
+	if (uv.x <= 0.0 || uv.x > 1.0 || uv.y <= 0.0 || uv.y > 1.0) {
+		return vec4(0.0, 0.0, 0.0, 1.0);
+	}
+#ifdef SHARPEN
+	vec4 fc = texture2D(tex, uv) * (1.0 + 4.0 * gain);
+	fc -= texture2D(tex, uv - vec2(pixel_size, 0.0)) * gain;
+	fc -= texture2D(tex, uv - vec2(0.0, pixel_size)) * gain;
+	fc -= texture2D(tex, uv + vec2(0.0, pixel_size)) * gain;
+	fc -= texture2D(tex, uv + vec2(pixel_size, 0.0)) * gain;
+	return fc;
+#else
+	return texture2D(tex, uv);
+#endif
+}
+
+#ifdef COLOR_LUT
+uniform sampler2D color_lut_texture; //see color_lut.h
+
+//64 slices of blue, 8 to a row, red and green filtered, the two nearest
+//slices mixed
+vec4 graded(vec4 fc) {
+	vec3 c = clamp(fc.rgb, 0.0, 1.0) * 63.0;
+	float b0 = floor(c.b);
+	float b1 = min(b0 + 1.0, 63.0);
+	vec2 slice0 = vec2(mod(b0, 8.0), floor(b0 / 8.0));
+	vec2 slice1 = vec2(mod(b1, 8.0), floor(b1 / 8.0));
+	vec2 uv0 = (slice0 * 64.0 + c.rg + 0.5) / 512.0;
+	vec2 uv1 = (slice1 * 64.0 + c.rg + 0.5) / 512.0;
+	return vec4(mix(texture2D(color_lut_texture, uv0).rgb,
+			texture2D(color_lut_texture, uv1).rgb, c.b - b0), fc.a);
+}
+#else
+vec4 graded(vec4 fc) {
+	return fc;
+}
+#endif
+
+void main(void) {
+	vec4 pos = unif_matrix * position;
+	//the lut takes unit vectors, position is shorter between mesh vertices
+	pos.xyz = normalize(pos.xyz);
+	float y = pos.y * 0.5 + 0.5;
+	vec2 gain = lut16(lut(0.0, y)) * lut_gain_max;
+	vec4 aux = lut(1.0, y);
+#ifdef TWO_CAMERAS
+	vec4 fc0;
+	vec4 fc1;
+	if (aux.z < 1.0) {
+		vec2 uv = fisheye(cam0_center, cam0_rot, gain.x, pos.zx);
+		fc0 = camera(cam0_texture, uv, sharpness_gain + aux.w);
+	}
+	if (aux.z > 0.0) {
+		vec2 uv = fisheye(cam1_center, cam1_rot, gain.y, vec2(pos.z, -pos.x));
+		fc1 = camera(cam1_texture, uv, sharpness_gain + 1.0 - aux.w);
+	}
+	if (aux.z == 0.0) {
+		gl_FragColor = graded(fc0);
+	} else if (aux.z == 1.0) {
+		gl_FragColor = graded(fc1);
+	} else {
+		gl_FragColor = graded(mix(fc0, fc1, aux.z));
+	}
+#else
+	if (aux.z > 0.5) {
+		vec2 uv = fisheye(vec2(0.5, 0.5), vec2(1.0, 0.0), gain.y,
+				vec2(pos.z, -pos.x));
+		gl_FragColor = texture2D(logo_texture, uv);
+		return;
+	}
+	vec2 uv = fisheye(cam_center, cam_rot, gain.x, pos.zx);
+	vec4 fc = camera(cam_texture, uv, sharpness_gain + aux.w / 2.0);
+#ifdef CHROMA
+	if (aux.x > 0.0) {
+		vec2 scale = 1.0 - aux.xy * lut_chroma_range;
+		vec4 fc_b = texture2D(cam_texture, cam_center + (uv - cam_center) * scale.x);
+		fc.z = fc_b.z;
+		fc_b = texture2D(cam_texture, cam_center + (uv - cam_center) * scale.y);
+		fc.y = fc_b.y;
+	}
+#endif
+	gl_FragColor = graded(fc);
+#endif
+}
@@ -0,0 +1,17 @@
+varying vec4 position;
+
+uniform mat4 unif_matrix;
+//equirectangular frame of the cameras in camera coordinates, drawn once
+//per loop by equirectangular.frag, see redraw_stitch()
+uniform sampler2D stitch_texture;
+
+const float M_PI = 3.1415926535;
+
+void main(void) {
+	vec4 pos = unif_matrix * position;
+	float pitch = asin(pos.y);
+	float yaw = atan(pos.x, pos.z);
+	//equirectangular.vert flips its tcoord
+	gl_FragColor = texture2D(stitch_texture,
+			vec2(0.5 - yaw / (2.0 * M_PI), 0.5 - pitch / M_PI));
+}
@@ -0,0 +1,72 @@
+#include "sharpen.h"
+#include <math.h>
+
+static inline int clamp_int(int x, int max) {
+	return (x < 0) ? 0 : (x > max ? max : x);
+}
+
+void sharpen_gain_map(float offset_x, float offset_y, float horizon_r,
+		unsigned char *map) {
+	//center of the fisheye as the projection shaders put it
+	float cu = 0.5f + offset_x;
+	float cv = 0.5f - offset_y;
+	for (int y = 0; y < SHARPEN_GAIN_MAP_SIZE; y++) {
+		float dv = (y + 0.5f) / SHARPEN_GAIN_MAP_SIZE - cv;
+		for (int x = 0; x < SHARPEN_GAIN_MAP_SIZE; x++) {
+			float du = (x + 0.5f) / SHARPEN_GAIN_MAP_SIZE - cu;
+			float r = sqrtf(du * du + dv * dv) / horizon_r;
+			map[y * SHARPEN_GAIN_MAP_SIZE + x] = (unsigned char) (fminf(r,
+					1.0f) * 255.0f + 0.5f);
+		}
+	}
+}
+
+//texture2D() of the gain map, LINEAR and CLAMP_TO_EDGE
+static float sample_gain(const unsigned char *map, float u, float v) {
+	const int max = SHARPEN_GAIN_MAP_SIZE - 1;
+	float x = u * SHARPEN_GAIN_MAP_SIZE - 0.5f;
+	float y = v * SHARPEN_GAIN_MAP_SIZE - 0.5f;
+	float x0f = floorf(x);
+	float y0f = floorf(y);
+	float fx = x - x0f;
+	float fy = y - y0f;
+	int x0 = clamp_int((int) x0f, max);
+	int x1 = clamp_int((int) x0f + 1, max);
+	int y0 = clamp_int((int) y0f, max);
+	int y1 = clamp_int((int) y0f + 1, max);
+	const unsigned char *r0 = map + y0 * SHARPEN_GAIN_MAP_SIZE;
+	const unsigned char *r1 = map + y1 * SHARPEN_GAIN_MAP_SIZE;
+	float top = r0[x0] + (r0[x1] - r0[x0]) * fx;
+	float bottom = r1[x0] + (r1[x1] - r1[x0]) * fx;
+	return (top + (bottom - top) * fy) / 255.0f;
+}
+
+void sharpen_image(const unsigned char *src, int width, int height,
+		int stride, const unsigned char *map, float sharpness_gain,
+		float pixel_size, unsigned char *dst, int dst_stride) {
+	for (int y = 0; y < height; y++) {
+		float v = (y + 0.5f) / height;
+		int up = clamp_int((int) floorf((v - pixel_size) * height), height - 1);
+		int down = clamp_int((int) floorf((v + pixel_size) * height),
+				height - 1);
+		for (int x = 0; x < width; x++) {
+			float u = (x + 0.5f) / width;
+			int left = clamp_int((int) floorf((u - pixel_size) * width),
+					width - 1);
+			int right = clamp_int((int) floorf((u + pixel_size) * width),
+					width - 1);
+			float gain = sharpness_gain + sample_gain(map, u, v);
+			const unsigned char *row = src + y * stride;
+			unsigned char *out = dst + y * dst_stride + x * 4;
+			for (int c = 0; c < 4; c++) {
+				float fc = row[x * 4 + c] * (1.0f + 4.0f * gain);
+				fc -= row[left * 4 + c] * gain;
+				fc -= src[up * stride + x * 4 + c] * gain;
+				fc -= src[down * stride + x * 4 + c] * gain;
+				fc -= row[right * 4 + c] * gain;
+				//unorm conversion of the framebuffer
+				out[c] = (unsigned char) (fminf(fmaxf(fc, 0.0f), 255.0f) + 0.5f);
+			}
+		}
+	}
+}
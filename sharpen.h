@@ -0,0 +1,27 @@
+#ifndef _SHARPEN_H
+#define _SHARPEN_H
+
+#define SHARPEN_GAIN_MAP_SIZE 256
+
+/**
+ * The unsharp mask the projection shaders used to do around every camera
+ * sample, done once per camera frame at camera resolution instead by
+ * shader/sharpen.frag. Its gain grows away from the optical axis,
+ * sharpness_gain + r with r 1 at horizon_r; r is baked into a gain map of
+ * SHARPEN_GAIN_MAP_SIZE squared, stretched linearly over the camera.
+ */
+
+/* r of each texel of map, 255 for 1 and beyond */
+void sharpen_gain_map(float offset_x, float offset_y, float horizon_r,
+		unsigned char *map);
+
+/**
+ * CPU reference of sharpen.frag: RGBA src to dst, both width x height.
+ * Texels are nearest, clamped at the edges and pixel_size apart in texture
+ * coordinates like the pixel_size uniform, the gain map is linear.
+ */
+void sharpen_image(const unsigned char *src, int width, int height,
+		int stride, const unsigned char *map, float sharpness_gain,
+		float pixel_size, unsigned char *dst, int dst_stride);
+
+#endif
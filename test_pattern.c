@@ -0,0 +1,445 @@
+#include "test_pattern.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+#define JPEG_QUANT 8 //every coefficient, a flat block's DC is then sample - 128
+#define COUNTER_BITS 16
+
+//75% colour bars, BT.601 YCbCr
+static const unsigned char lg_bars[8][3] = { { 180, 128, 128 }, //white
+		{ 162, 44, 142 }, //yellow
+		{ 131, 156, 44 }, //cyan
+		{ 112, 72, 58 }, //green
+		{ 84, 184, 198 }, //magenta
+		{ 65, 100, 212 }, //red
+		{ 35, 212, 114 }, //blue
+		{ 16, 128, 128 } //black
+};
+
+struct _TEST_PATTERN_T {
+	int width;
+	int height;
+	int mb_width;
+	int mb_height;
+	int id;
+	//jpeg
+	int detail;
+	int restart_interval;
+	//h264
+	int gop;
+	bool coded; //a previous frame exists
+	uint32_t prev_n;
+	int frames_since_idr;
+	int idr_count;
+};
+
+enum ESCAPE {
+	ESCAPE_NONE, ESCAPE_JPEG, ESCAPE_H264
+};
+
+typedef struct {
+	unsigned char *p;
+	uint32_t acc;
+	int bits; //pending bits in acc, less than 8 between calls
+	int zeros; //zero bytes written in a row, for h264 emulation prevention
+	enum ESCAPE escape;
+} BIT_WRITER_T;
+
+static void put_byte(BIT_WRITER_T *w, unsigned char c) {
+	if (w->escape == ESCAPE_H264) {
+		if (w->zeros >= 2 && c <= 3) {
+			*w->p++ = 3;
+			w->zeros = 0;
+		}
+		w->zeros = (c == 0) ? w->zeros + 1 : 0;
+	}
+	*w->p++ = c;
+	if (w->escape == ESCAPE_JPEG && c == 0xff) {
+		*w->p++ = 0;
+	}
+}
+
+//n <= 24
+static void put_bits(BIT_WRITER_T *w, uint32_t value, int n) {
+	w->acc = (w->acc << n) | (value & ((1u << n) - 1));
+	w->bits += n;
+	while (w->bits >= 8) {
+		w->bits -= 8;
+		put_byte(w, w->acc >> w->bits);
+	}
+	w->acc &= (1u << w->bits) - 1;
+}
+
+static void put_raw(BIT_WRITER_T *w, const unsigned char *data, int len) {
+	memcpy(w->p, data, len);
+	w->p += len;
+}
+
+static void put_marker(BIT_WRITER_T *w, int marker, int len) {
+	unsigned char header[4] = { 0xff, marker, len >> 8, len };
+	put_raw(w, header, (len > 0) ? 4 : 2);
+}
+
+static int bit_length(uint32_t v) {
+	return (v == 0) ? 0 : 32 - __builtin_clz(v);
+}
+
+static void put_ue(BIT_WRITER_T *w, uint32_t v) {
+	int len = bit_length(v + 1);
+	put_bits(w, 0, len - 1);
+	put_bits(w, v + 1, len);
+}
+
+static void put_se(BIT_WRITER_T *w, int v) {
+	put_ue(w, (v > 0) ? 2 * v - 1 : -2 * v);
+}
+
+static void put_trailing_bits(BIT_WRITER_T *w) {
+	put_bits(w, 1, 1);
+	if (w->bits > 0) {
+		put_bits(w, 0, 8 - w->bits);
+	}
+}
+
+static uint32_t hash(uint32_t x) {
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+	return x;
+}
+
+TEST_PATTERN_T *test_pattern_create(int width, int height, int id) {
+	TEST_PATTERN_T *pattern = calloc(1, sizeof(TEST_PATTERN_T));
+	pattern->width = MAX(width & ~1, 16);
+	pattern->height = MAX(height & ~1, 16);
+	pattern->mb_width = (pattern->width + 15) / 16;
+	pattern->mb_height = (pattern->height + 15) / 16;
+	pattern->id = id;
+	pattern->gop = TEST_PATTERN_DEFAULT_GOP;
+	return pattern;
+}
+
+void test_pattern_delete(TEST_PATTERN_T *pattern) {
+	free(pattern);
+}
+
+void test_pattern_set_jpeg_options(TEST_PATTERN_T *pattern, int detail,
+		int restart_interval) {
+	pattern->detail = MAX(0, MIN(detail, 63));
+	pattern->restart_interval = MAX(0, MIN(restart_interval, 0xffff));
+}
+
+void test_pattern_set_gop(TEST_PATTERN_T *pattern, int gop) {
+	pattern->gop = MAX(gop, 1);
+	pattern->coded = false; //start over with an IDR
+}
+
+int test_pattern_max_size(TEST_PATTERN_T *pattern) {
+	int mbs = pattern->mb_width * pattern->mb_height;
+	//dc and eob up to 20 bits, noise up to 10 bits per coefficient
+	int jpeg = 1024 + mbs * 6 * (20 + 10 * pattern->detail) / 8 * 2
+			+ ((pattern->restart_interval > 0) ?
+					(mbs / pattern->restart_interval + 1) * 3 : 0);
+	//mb_type, alignment and samples, up to 1.5x for emulation prevention
+	int h264 = 256 + mbs * (2 + 384) * 3 / 2;
+	return MAX(jpeg, h264);
+}
+
+static void mb_color(TEST_PATTERN_T *pattern, int mbx, int mby, uint32_t n,
+		unsigned char yuv[3]) {
+	int side = MAX(1, pattern->mb_height / 6);
+	int x0 = n % pattern->mb_width;
+	int y0 = (pattern->mb_height - side) / 2;
+
+	if (mby == 0) { //frame counter, msb first
+		int bits = MIN(COUNTER_BITS, pattern->mb_width);
+		int bit = mbx * bits / pattern->mb_width;
+		yuv[0] = ((n >> (bits - 1 - bit)) & 1) ? 235 : 16;
+		yuv[1] = yuv[2] = 128;
+	} else if ((mbx - x0 + pattern->mb_width) % pattern->mb_width < side
+			&& mby >= y0 && mby < y0 + side) { //moving square
+		yuv[0] = 235;
+		yuv[1] = yuv[2] = 128;
+	} else {
+		const unsigned char *bar = lg_bars[(mbx * 8 / pattern->mb_width
+				+ pattern->id) % 8];
+		memcpy(yuv, bar, 3);
+	}
+}
+
+//symbols of the jpeg ac table: eob, zrl, then run 0..15 x size 1..10
+static int ac_code(int run, int size) {
+	return 2 + run * 10 + size - 1;
+}
+
+static void jpeg_block(BIT_WRITER_T *w, int dc, int *pred, uint32_t seed,
+		int detail) {
+	int diff = dc - *pred;
+	int size = bit_length(abs(diff));
+	*pred = dc;
+
+	put_bits(w, size, 4); //dc code of size is size itself
+	if (size > 0) {
+		put_bits(w, (diff < 0) ? diff - 1 : diff, size);
+	}
+	for (int k = 1; k <= detail; k++) {
+		static const int values[6] = { -3, -2, -1, 1, 2, 3 };
+		int v = values[hash(seed * 64 + k) % 6];
+		size = bit_length(abs(v));
+		put_bits(w, ac_code(0, size), 8);
+		put_bits(w, (v < 0) ? v - 1 : v, size);
+	}
+	if (detail < 63) {
+		put_bits(w, 0, 8); //eob
+	}
+}
+
+static void jpeg_flush(BIT_WRITER_T *w) {
+	if (w->bits > 0) {
+		put_bits(w, 0xff, 8 - w->bits); //pad with ones
+	}
+}
+
+int test_pattern_jpeg(TEST_PATTERN_T *pattern, uint32_t n,
+		unsigned char *buff) {
+	BIT_WRITER_T w = { buff };
+	unsigned char table[1 + 16 + 162];
+	int pred[3] = { };
+	int mcu = 0;
+
+	put_marker(&w, 0xd8, 0); //SOI
+	put_marker(&w, 0xe0, 16); //APP0
+	put_raw(&w, (const unsigned char*) "JFIF\0\1\1\0\0\1\0\1\0\0", 14);
+
+	put_marker(&w, 0xdb, 2 + 2 * 65); //DQT
+	for (int i = 0; i < 2; i++) {
+		table[0] = i;
+		memset(table + 1, JPEG_QUANT, 64);
+		put_raw(&w, table, 65);
+	}
+
+	put_marker(&w, 0xc0, 17); //SOF0, 4:2:0
+	{
+		unsigned char sof[15] = { 8, pattern->height >> 8, pattern->height,
+				pattern->width >> 8, pattern->width, 3, 1, 0x22, 0, 2, 0x11,
+				1, 3, 0x11, 1 };
+		put_raw(&w, sof, sizeof(sof));
+	}
+
+	//every dc symbol has a 4 bit code, every ac symbol an 8 bit code
+	put_marker(&w, 0xc4, 2 + 2 * (17 + 12) + 2 * (17 + 162)); //DHT
+	for (int i = 0; i < 2; i++) {
+		memset(table, 0, sizeof(table));
+		table[0] = i;
+		table[1 + 3] = 12;
+		for (int s = 0; s < 12; s++) {
+			table[17 + s] = s;
+		}
+		put_raw(&w, table, 17 + 12);
+	}
+	for (int i = 0; i < 2; i++) {
+		memset(table, 0, sizeof(table));
+		table[0] = 0x10 | i;
+		table[1 + 7] = 162;
+		table[17] = 0x00;
+		table[18] = 0xf0;
+		for (int run = 0; run < 16; run++) {
+			for (int size = 1; size <= 10; size++) {
+				table[17 + ac_code(run, size)] = (run << 4) | size;
+			}
+		}
+		put_raw(&w, table, 17 + 162);
+	}
+
+	if (pattern->restart_interval > 0) {
+		put_marker(&w, 0xdd, 4); //DRI
+		put_bits(&w, pattern->restart_interval, 16);
+	}
+
+	put_marker(&w, 0xda, 12); //SOS
+	{
+		unsigned char sos[10] = { 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0 };
+		put_raw(&w, sos, sizeof(sos));
+	}
+
+	w.escape = ESCAPE_JPEG;
+	for (int mby = 0; mby < pattern->mb_height; mby++) {
+		for (int mbx = 0; mbx < pattern->mb_width; mbx++, mcu++) {
+			unsigned char yuv[3];
+			uint32_t seed = (mby * pattern->mb_width + mbx) * 6;
+			if (pattern->restart_interval > 0 && mcu > 0
+					&& mcu % pattern->restart_interval == 0) {
+				jpeg_flush(&w);
+				put_marker(&w,
+						0xd0 + (mcu / pattern->restart_interval - 1) % 8, 0);
+				memset(pred, 0, sizeof(pred));
+			}
+			mb_color(pattern, mbx, mby, n, yuv);
+			for (int i = 0; i < 4; i++) {
+				jpeg_block(&w, yuv[0] - 128, &pred[0], seed + i,
+						pattern->detail);
+			}
+			jpeg_block(&w, yuv[1] - 128, &pred[1], seed + 4, pattern->detail);
+			jpeg_block(&w, yuv[2] - 128, &pred[2], seed + 5, pattern->detail);
+		}
+	}
+	jpeg_flush(&w);
+	w.escape = ESCAPE_NONE;
+	put_marker(&w, 0xd9, 0); //EOI
+
+	return w.p - buff;
+}
+
+static void nal_start(BIT_WRITER_T *w, int ref_idc, int type) {
+	static const unsigned char start_code[4] = { 0, 0, 0, 1 };
+	w->escape = ESCAPE_NONE;
+	put_raw(w, start_code, 4);
+	w->escape = ESCAPE_H264;
+	w->zeros = 0;
+	put_bits(w, (ref_idc << 5) | type, 8);
+}
+
+static void h264_sps(TEST_PATTERN_T *pattern, BIT_WRITER_T *w) {
+	int mbs = pattern->mb_width * pattern->mb_height;
+	int crop_right = (pattern->mb_width * 16 - pattern->width) / 2;
+	int crop_bottom = (pattern->mb_height * 16 - pattern->height) / 2;
+
+	nal_start(w, 3, 7);
+	put_bits(w, 66, 8); //baseline
+	put_bits(w, 0xc0, 8); //constraint_set0, constraint_set1
+	put_bits(w, (mbs <= 8192) ? 40 : 51, 8); //level by frame size
+	put_ue(w, 0); //seq_parameter_set_id
+	put_ue(w, 0); //log2_max_frame_num_minus4
+	put_ue(w, 2); //pic_order_cnt_type
+	put_ue(w, 1); //max_num_ref_frames
+	put_bits(w, 0, 1); //gaps_in_frame_num_value_allowed_flag
+	put_ue(w, pattern->mb_width - 1);
+	put_ue(w, pattern->mb_height - 1);
+	put_bits(w, 1, 1); //frame_mbs_only_flag
+	put_bits(w, 1, 1); //direct_8x8_inference_flag
+	if (crop_right > 0 || crop_bottom > 0) {
+		put_bits(w, 1, 1); //frame_cropping_flag
+		put_ue(w, 0);
+		put_ue(w, crop_right);
+		put_ue(w, 0);
+		put_ue(w, crop_bottom);
+	} else {
+		put_bits(w, 0, 1);
+	}
+	put_bits(w, 0, 1); //vui_parameters_present_flag
+	put_trailing_bits(w);
+}
+
+static void h264_pps(BIT_WRITER_T *w) {
+	nal_start(w, 3, 8);
+	put_ue(w, 0); //pic_parameter_set_id
+	put_ue(w, 0); //seq_parameter_set_id
+	put_bits(w, 0, 1); //entropy_coding_mode_flag, cavlc
+	put_bits(w, 0, 1); //bottom_field_pic_order_in_frame_present_flag
+	put_ue(w, 0); //num_slice_groups_minus1
+	put_ue(w, 0); //num_ref_idx_l0_default_active_minus1
+	put_ue(w, 0); //num_ref_idx_l1_default_active_minus1
+	put_bits(w, 0, 1); //weighted_pred_flag
+	put_bits(w, 0, 2); //weighted_bipred_idc
+	put_se(w, 0); //pic_init_qp_minus26
+	put_se(w, 0); //pic_init_qs_minus26
+	put_se(w, 0); //chroma_qp_index_offset
+	put_bits(w, 1, 1); //deblocking_filter_control_present_flag
+	put_bits(w, 0, 1); //constrained_intra_pred_flag
+	put_bits(w, 0, 1); //redundant_pic_cnt_present_flag
+	put_trailing_bits(w);
+}
+
+static void h264_pcm_mb(BIT_WRITER_T *w, const unsigned char yuv[3]) {
+	if (w->bits > 0) {
+		put_bits(w, 0, 8 - w->bits); //pcm_alignment_zero_bit
+	}
+	//zero samples are avoided, early decoders reject them
+	for (int i = 0; i < 256; i++) {
+		put_byte(w, MAX(yuv[0], 1));
+	}
+	for (int c = 1; c <= 2; c++) {
+		for (int i = 0; i < 64; i++) {
+			put_byte(w, MAX(yuv[c], 1));
+		}
+	}
+}
+
+int test_pattern_h264(TEST_PATTERN_T *pattern, uint32_t n,
+		unsigned char *buff) {
+	BIT_WRITER_T w = { buff };
+	bool idr = !pattern->coded || pattern->frames_since_idr >= pattern->gop;
+	unsigned char yuv[3];
+
+	if (idr) {
+		pattern->frames_since_idr = 0;
+	}
+
+	nal_start(&w, 0, 9); //access unit delimiter
+	put_bits(&w, idr ? 0 : 1, 3); //primary_pic_type I or I/P
+	put_trailing_bits(&w);
+
+	if (idr) {
+		h264_sps(pattern, &w);
+		h264_pps(&w);
+	}
+
+	nal_start(&w, idr ? 3 : 2, idr ? 5 : 1);
+	put_ue(&w, 0); //first_mb_in_slice
+	put_ue(&w, idr ? 7 : 5); //slice_type, all I or all P
+	put_ue(&w, 0); //pic_parameter_set_id
+	put_bits(&w, pattern->frames_since_idr % 16, 4); //frame_num
+	if (idr) {
+		put_ue(&w, pattern->idr_count++ % 2); //idr_pic_id
+		put_bits(&w, 0, 1); //no_output_of_prior_pics_flag
+		put_bits(&w, 0, 1); //long_term_reference_flag
+	} else {
+		put_bits(&w, 0, 1); //num_ref_idx_active_override_flag
+		put_bits(&w, 0, 1); //ref_pic_list_modification_flag_l0
+		put_bits(&w, 0, 1); //adaptive_ref_pic_marking_mode_flag
+	}
+	put_se(&w, 0); //slice_qp_delta
+	put_ue(&w, 1); //disable_deblocking_filter_idc
+
+	if (idr) {
+		for (int mby = 0; mby < pattern->mb_height; mby++) {
+			for (int mbx = 0; mbx < pattern->mb_width; mbx++) {
+				mb_color(pattern, mbx, mby, n, yuv);
+				put_ue(&w, 25); //I_PCM
+				h264_pcm_mb(&w, yuv);
+			}
+		}
+	} else {
+		int skip_run = 0;
+		for (int mby = 0; mby < pattern->mb_height; mby++) {
+			for (int mbx = 0; mbx < pattern->mb_width; mbx++) {
+				unsigned char prev[3];
+				mb_color(pattern, mbx, mby, n, yuv);
+				mb_color(pattern, mbx, mby, pattern->prev_n, prev);
+				if (memcmp(yuv, prev, 3) == 0) { //P_Skip, mv is 0 here
+					skip_run++;
+					continue;
+				}
+				put_ue(&w, skip_run);
+				skip_run = 0;
+				put_ue(&w, 5 + 25); //I_PCM in a P slice
+				h264_pcm_mb(&w, yuv);
+			}
+		}
+		if (skip_run > 0) {
+			put_ue(&w, skip_run);
+		}
+	}
+	put_trailing_bits(&w);
+
+	pattern->coded = true;
+	pattern->prev_n = n;
+	pattern->frames_since_idr++;
+	return w.p - buff;
+}
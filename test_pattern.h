@@ -0,0 +1,49 @@
+#ifndef _TEST_PATTERN_H
+#define _TEST_PATTERN_H
+
+#include <stdint.h>
+
+#define TEST_PATTERN_DEFAULT_GOP 30
+
+typedef struct _TEST_PATTERN_T TEST_PATTERN_T;
+
+/**
+ * Synthetic camera frames for load tests without a camera.
+ * The picture is built from flat 16x16 blocks: colour bars (rotated by id
+ * so cameras can be told apart), a square that moves one block per frame
+ * and the frame number in binary along the top row. Frame n of every
+ * pattern with the same size shows the same counter, so paired cameras
+ * can be checked by eye.
+ * JPEG frames are baseline 4:2:0. detail adds that many AC coefficients
+ * of static noise to every block to bring frame size and decode cost
+ * closer to camera output, restart_interval adds RST markers every that
+ * many MCUs.
+ * H.264 frames are constrained baseline access units of I_PCM macroblocks:
+ * an IDR with SPS and PPS every gop frames, P frames that skip everything
+ * but the blocks that changed.
+ */
+TEST_PATTERN_T *test_pattern_create(int width, int height, int id);
+
+void test_pattern_delete(TEST_PATTERN_T *pattern);
+
+void test_pattern_set_jpeg_options(TEST_PATTERN_T *pattern, int detail,
+		int restart_interval);
+
+void test_pattern_set_gop(TEST_PATTERN_T *pattern, int gop);
+
+/* buffer size that holds any frame of this pattern */
+int test_pattern_max_size(TEST_PATTERN_T *pattern);
+
+/* frame n as a JPEG, returns its size */
+int test_pattern_jpeg(TEST_PATTERN_T *pattern, uint32_t n,
+		unsigned char *buff);
+
+/**
+ * Frame n as an H.264 access unit, returns its size.
+ * P frames are coded against the previous call, the first call and every
+ * gop-th frame after it are IDR frames.
+ */
+int test_pattern_h264(TEST_PATTERN_T *pattern, uint32_t n,
+		unsigned char *buff);
+
+#endif
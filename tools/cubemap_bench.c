@@ -0,0 +1,473 @@
+/**
+ * What the full sphere layouts cost and weigh.
+ * Draws an equirectangular frame and the 3x2 cubemap and EAC frames of the
+ * same resolution at the equator (faces of width / 4) with the shaders of
+ * ../shader, for one camera and for two, checks them against cpu_remap.h
+ * and reports the time per frame, the pixels and the JPEG size at a fixed
+ * quality, as snap saves them. The cameras are a synthetic texture or a
+ * fisheye JPEG of the footage given with -i, square like the cameras. Run
+ * it from tools/ on the target, any EGL with pbuffers and GLES2 will do.
+ *
+ * usage: cubemap_bench [-w equirectangular_width] [-c cam_width]
+ *                      [-n loops] [-q jpeg_quality] [-i fisheye.jpg]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <jpeglib.h>
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#if __has_include(<bcm_host.h>)
+#include <bcm_host.h>
+#define HAVE_BCM_HOST
+#endif
+
+#include "cpu_remap.h"
+#include "color_lut.h"
+
+#define SHADER_PATH "../shader/"
+
+enum LAYOUT {
+	LAYOUT_EQUIRECTANGULAR, LAYOUT_CUBEMAP, LAYOUT_EAC, LAYOUT_NUM
+};
+
+static const struct {
+	const char *name;
+	const char *frag;
+	const char *defines;
+	enum CPU_REMAP_MODE cpu_mode;
+} lg_layout[LAYOUT_NUM] = { { "equirectangular", "equirectangular.frag", "",
+		CPU_REMAP_EQUIRECTANGULAR }, { "cubemap", "cubemap.frag", "",
+		CPU_REMAP_CUBEMAP }, { "eac", "cubemap.frag",
+		"#define EQUI_ANGULAR\n", CPU_REMAP_EAC } };
+
+typedef struct {
+	float offset_yaw;
+	float offset_x;
+	float offset_y;
+	float horizon_r;
+} CAM_T;
+
+static CAM_T lg_cam[2] = { { 0.1, 0.01, -0.02, 0.8 }, { -0.2, -0.015, 0.01,
+		0.78 } };
+
+static double now_ms() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static char *read_file(const char *path) {
+	FILE *fp = fopen(path, "rb");
+	if (fp == NULL) {
+		printf("can not open %s\n", path);
+		exit(1);
+	}
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	char *buff = malloc(size + 1);
+	buff[fread(buff, 1, size, fp)] = '\0';
+	fclose(fp);
+	return buff;
+}
+
+static GLuint load_shader(GLenum type, const char *file, const char *defines) {
+	char path[256];
+	sprintf(path, SHADER_PATH "%s", file);
+	char *source = read_file(path);
+	//the shaders rely on the firmware compiler's default float precision
+	const GLchar *sources[3] = { defines,
+			(type == GL_FRAGMENT_SHADER) ?
+					"#ifdef GL_FRAGMENT_PRECISION_HIGH\nprecision highp float;\n#endif\n" :
+					"", source };
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 3, sources, NULL);
+	glCompileShader(shader);
+	free(source);
+	GLint ok;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+	if (!ok) {
+		char log[1024];
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		printf("%s : %s\n", file, log);
+		exit(1);
+	}
+	return shader;
+}
+
+//defines as GLProgramVariants puts them in front of the sources
+static GLuint load_program(const char *vert, const char *frag,
+		const char *defines) {
+	GLuint program = glCreateProgram();
+	glAttachShader(program, load_shader(GL_VERTEX_SHADER, vert, defines));
+	glAttachShader(program, load_shader(GL_FRAGMENT_SHADER, frag, defines));
+	glLinkProgram(program);
+	GLint ok;
+	glGetProgramiv(program, GL_LINK_STATUS, &ok);
+	if (!ok) {
+		printf("%s %s : link failed\n", vert, frag);
+		exit(1);
+	}
+	return program;
+}
+
+static GLuint create_texture(int width, int height, GLint filter,
+		const unsigned char *pixels) {
+	GLuint tex;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+			GL_UNSIGNED_BYTE, pixels);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return tex;
+}
+
+//smooth gradients with a grid every 64 texels, different per camera
+static unsigned char *camera_image(int width, int id) {
+	unsigned char *pixels = malloc(width * width * 4);
+	for (int y = 0; y < width; y++) {
+		for (int x = 0; x < width; x++) {
+			unsigned char *p = pixels + (y * width + x) * 4;
+			bool grid = (x % 64 == 0 || y % 64 == 0);
+			p[0] = grid ? 255 : x * 255 / width;
+			p[1] = grid ? 255 : y * 255 / width;
+			p[2] = grid ? 255 : (id ? 64 : 192);
+			p[3] = 255;
+		}
+	}
+	return pixels;
+}
+
+//the centered square of a JPEG scaled to width, nearest texel
+static unsigned char *camera_jpeg(const char *path, int width) {
+	FILE *fp = fopen(path, "rb");
+	if (fp == NULL) {
+		printf("can not open %s\n", path);
+		exit(1);
+	}
+	struct jpeg_decompress_struct cinfo;
+	struct jpeg_error_mgr jerr;
+	cinfo.err = jpeg_std_error(&jerr);
+	jpeg_create_decompress(&cinfo);
+	jpeg_stdio_src(&cinfo, fp);
+	jpeg_read_header(&cinfo, TRUE);
+	cinfo.out_color_space = JCS_RGB;
+	jpeg_start_decompress(&cinfo);
+	int w = cinfo.output_width, h = cinfo.output_height;
+	unsigned char *rgb = malloc(w * h * 3);
+	while (cinfo.output_scanline < h) {
+		JSAMPROW row = rgb + cinfo.output_scanline * w * 3;
+		jpeg_read_scanlines(&cinfo, &row, 1);
+	}
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+	fclose(fp);
+
+	int side = (w < h) ? w : h;
+	unsigned char *pixels = malloc(width * width * 4);
+	for (int y = 0; y < width; y++) {
+		int sy = (h - side) / 2 + y * side / width;
+		for (int x = 0; x < width; x++) {
+			int sx = (w - side) / 2 + x * side / width;
+			memcpy(pixels + (y * width + x) * 4, rgb + (sy * w + sx) * 3, 3);
+			pixels[(y * width + x) * 4 + 3] = 255;
+		}
+	}
+	free(rgb);
+	return pixels;
+}
+
+static void cpu_image(CPU_REMAP_IMAGE_T *img, const unsigned char *pixels,
+		int width) {
+	img->pixels = pixels;
+	img->width = width;
+	img->height = width;
+	img->stride = width * 4;
+}
+
+//mean difference of the color channels, percentage of pixels off by more
+//than 8
+static double compare(const unsigned char *a, const unsigned char *b,
+		int num_pixels, double *off_percent) {
+	double diff_sum = 0;
+	int diff_pixels = 0;
+	for (int i = 0; i < num_pixels; i++) {
+		int max_diff = 0;
+		for (int c = 0; c < 3; c++) {
+			int d = abs(a[i * 4 + c] - b[i * 4 + c]);
+			diff_sum += d;
+			max_diff = (d > max_diff) ? d : max_diff;
+		}
+		if (max_diff > 8) {
+			diff_pixels++;
+		}
+	}
+	*off_percent = 100.0 * diff_pixels / num_pixels;
+	return diff_sum / (num_pixels * 3);
+}
+
+//bytes of the RGBA frame as a JPEG, first row at the top as read back
+static unsigned long jpeg_size(const unsigned char *image, int width,
+		int height, int quality) {
+	struct jpeg_compress_struct cinfo;
+	struct jpeg_error_mgr jerr;
+	unsigned char *buff = NULL;
+	unsigned long size = 0;
+	cinfo.err = jpeg_std_error(&jerr);
+	jpeg_create_compress(&cinfo);
+	jpeg_mem_dest(&cinfo, &buff, &size);
+	cinfo.image_width = width;
+	cinfo.image_height = height;
+	cinfo.input_components = 3;
+	cinfo.in_color_space = JCS_RGB;
+	jpeg_set_defaults(&cinfo);
+	jpeg_set_quality(&cinfo, quality, TRUE);
+	jpeg_start_compress(&cinfo, TRUE);
+	unsigned char *rgb = malloc(width * 3);
+	while (cinfo.next_scanline < height) {
+		const unsigned char *src = image + cinfo.next_scanline * width * 4;
+		for (int x = 0; x < width; x++) {
+			memcpy(rgb + x * 3, src + x * 4, 3);
+		}
+		JSAMPROW row = rgb;
+		jpeg_write_scanlines(&cinfo, &row, 1);
+	}
+	jpeg_finish_compress(&cinfo);
+	jpeg_destroy_compress(&cinfo);
+	free(rgb);
+	free(buff);
+	return size;
+}
+
+//a tilted view
+static void view_matrix(float m[16]) {
+	float a = 0.3, b = 0.5;
+	float view[16] = { cos(b), 0, -sin(b), 0, sin(a) * sin(b), cos(a), sin(a)
+			* cos(b), 0, cos(a) * sin(b), -sin(a), cos(a) * cos(b), 0, 0, 0,
+			0, 1 };
+	memcpy(m, view, sizeof(view));
+}
+
+//uniforms redraw_render_texture() sets
+static void set_uniforms(GLuint program, int num_of_cam, int cam_width) {
+	float m[16];
+	view_matrix(m);
+	glUniformMatrix4fv(glGetUniformLocation(program, "unif_matrix"), 1,
+			GL_FALSE, m);
+	glUniform1f(glGetUniformLocation(program, "pixel_size"), 1.0 / cam_width);
+	glUniform1f(glGetUniformLocation(program, "sharpness_gain"), 0);
+	for (int i = 0; i < num_of_cam; i++) {
+		char prefix[8], name[64];
+		if (num_of_cam == 1) {
+			strcpy(prefix, "cam");
+		} else {
+			sprintf(prefix, "cam%d", i);
+		}
+		sprintf(name, "%s_offset_yaw", prefix);
+		glUniform1f(glGetUniformLocation(program, name), lg_cam[i].offset_yaw);
+		sprintf(name, "%s_offset_x", prefix);
+		glUniform1f(glGetUniformLocation(program, name), lg_cam[i].offset_x);
+		sprintf(name, "%s_offset_y", prefix);
+		glUniform1f(glGetUniformLocation(program, name), lg_cam[i].offset_y);
+		sprintf(name, "%s_horizon_r", prefix);
+		glUniform1f(glGetUniformLocation(program, name), lg_cam[i].horizon_r);
+		sprintf(name, "%s_texture", prefix);
+		glUniform1i(glGetUniformLocation(program, name), i + 1);
+	}
+	glUniform1i(glGetUniformLocation(program, "logo_texture"), 0);
+	glUniform1i(glGetUniformLocation(program, "color_lut_texture"), 5);
+}
+
+int main(int argc, char *argv[]) {
+	int equirect_width = 2048;
+	int cam_width = 1024;
+	int loops = 10;
+	int quality = 70; //of snap
+	const char *input = NULL;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "w:c:n:q:i:")) != -1) {
+		switch (opt) {
+		case 'w':
+			sscanf(optarg, "%d", &equirect_width);
+			break;
+		case 'c':
+			sscanf(optarg, "%d", &cam_width);
+			break;
+		case 'n':
+			sscanf(optarg, "%d", &loops);
+			break;
+		case 'q':
+			sscanf(optarg, "%d", &quality);
+			break;
+		case 'i':
+			input = optarg;
+			break;
+		default:
+			printf(
+					"usage: %s [-w equirectangular_width] [-c cam_width] [-n loops] [-q jpeg_quality] [-i fisheye.jpg]\n",
+					argv[0]);
+			return -1;
+		}
+	}
+	equirect_width -= equirect_width % 12; //faces of whole pixels
+	int size[LAYOUT_NUM][2] = { { equirect_width, equirect_width / 2 }, {
+			equirect_width * 3 / 4, equirect_width / 2 }, { equirect_width * 3
+			/ 4, equirect_width / 2 } };
+
+#ifdef HAVE_BCM_HOST
+	bcm_host_init();
+#endif
+	static const EGLint config_attribs[] = { EGL_RED_SIZE, 8, EGL_GREEN_SIZE,
+			8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8, EGL_SURFACE_TYPE,
+			EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT, EGL_NONE };
+	static const EGLint context_attribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2,
+			EGL_NONE };
+	static const EGLint pbuffer_attribs[] = { EGL_WIDTH, 16, EGL_HEIGHT, 16,
+			EGL_NONE };
+	EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLConfig config;
+	EGLint num_config;
+	if (!eglInitialize(display, NULL, NULL)
+			|| !eglChooseConfig(display, config_attribs, &config, 1,
+					&num_config) || num_config < 1) {
+		printf("no egl pbuffer config\n");
+		return -1;
+	}
+	eglBindAPI(EGL_OPENGL_ES_API);
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT,
+			context_attribs);
+	EGLSurface surface = eglCreatePbufferSurface(display, config,
+			pbuffer_attribs);
+	if (context == EGL_NO_CONTEXT || surface == EGL_NO_SURFACE
+			|| !eglMakeCurrent(display, surface, surface, context)) {
+		printf("can not make an egl context current\n");
+		return -1;
+	}
+	printf("%s, %dx%d cameras of %s\n", glGetString(GL_RENDERER), cam_width,
+			cam_width, input ? input : "synthetic gradients");
+
+	unsigned char *logo_pixels = camera_image(256, 1);
+	unsigned char *cam_pixels[2];
+	for (int i = 0; i < 2; i++) {
+		cam_pixels[i] = input ?
+				camera_jpeg(input, cam_width) : camera_image(cam_width, i);
+	}
+	GLuint logo_texture = create_texture(256, 256, GL_LINEAR, logo_pixels);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	GLuint cam_texture[2];
+	for (int i = 0; i < 2; i++) {
+		cam_texture[i] = create_texture(cam_width, cam_width, GL_NEAREST,
+				cam_pixels[i]);
+	}
+
+	//one camera is graded as picam360-capture does by default
+	unsigned char *color_lut = color_lut_offset(COLOR_LUT_OFFSET);
+	glActiveTexture(GL_TEXTURE5);
+	GLuint color_lut_texture = create_texture(COLOR_LUT_WIDTH,
+			COLOR_LUT_WIDTH, GL_LINEAR, color_lut);
+	glActiveTexture(GL_TEXTURE0);
+
+	//the quad of board_mesh()
+	static float quad[] = { 0, 0, 1, 1, 1, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1 };
+	GLuint vbo;
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+
+	CPU_REMAP_T *remap = cpu_remap_create(sysconf(_SC_NPROCESSORS_ONLN) - 1);
+	CPU_REMAP_PARAMS_T params = { };
+	cpu_image(&params.cam[0], cam_pixels[0], cam_width);
+	cpu_image(&params.cam[1], cam_pixels[1], cam_width);
+	cpu_image(&params.logo, logo_pixels, 256);
+	memcpy(params.cam_options, lg_cam, sizeof(lg_cam));
+	params.filter = CPU_REMAP_NEAREST;
+	view_matrix(params.unif_matrix);
+	for (int num_of_cam = 1; num_of_cam <= 2; num_of_cam++) {
+		unsigned long equirect_bytes = 0;
+		for (int layout = 0; layout < LAYOUT_NUM; layout++) {
+			int width = size[layout][0], height = size[layout][1];
+			GLuint frame_texture, framebuffer;
+			glGenTextures(1, &frame_texture);
+			glBindTexture(GL_TEXTURE_2D, frame_texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+					GL_UNSIGNED_BYTE, NULL);
+			glGenFramebuffers(1, &framebuffer);
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+					GL_TEXTURE_2D, frame_texture, 0);
+			glViewport(0, 0, width, height);
+
+			char defines[128];
+			sprintf(defines, "#define %s\n%s",
+					(num_of_cam == 1) ?
+							"CHROMA\n#define COLOR_LUT" : "TWO_CAMERAS",
+					lg_layout[layout].defines);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, logo_texture);
+			for (int i = 0; i < num_of_cam; i++) {
+				glActiveTexture(GL_TEXTURE1 + i);
+				glBindTexture(GL_TEXTURE_2D, cam_texture[i]);
+			}
+			GLuint program = load_program("equirectangular.vert",
+					lg_layout[layout].frag, defines);
+			glUseProgram(program);
+			set_uniforms(program, num_of_cam, cam_width);
+			GLuint loc = glGetAttribLocation(program, "vPosition");
+			glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 0, 0);
+			glEnableVertexAttribArray(loc);
+
+			//first draw compiles on some drivers
+			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+			glFinish();
+			double start = now_ms();
+			for (int l = 0; l < loops; l++) {
+				glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+			}
+			glFinish();
+			double ms = (now_ms() - start) / loops;
+			unsigned char *image[2] = { malloc(width * height * 4), malloc(
+					width * height * 4) };
+			glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+					image[0]);
+
+			params.mode = lg_layout[layout].cpu_mode;
+			params.num_of_cam = num_of_cam;
+			params.color_lut = (num_of_cam == 1) ? color_lut : NULL;
+			cpu_remap(remap, &params, image[1], width, height, width * 4);
+			double off;
+			double diff = compare(image[0], image[1], width * height, &off);
+
+			unsigned long bytes = jpeg_size(image[0], width, height, quality);
+			if (layout == LAYOUT_EQUIRECTANGULAR) {
+				equirect_bytes = bytes;
+			}
+			printf(
+					"%s %d cam : %dx%d, %.2fms, jpeg q%d %lu bytes (%.1f%% of equirectangular), cpu mean diff %.3f, %.2f%% pixels off by more than 8\n",
+					lg_layout[layout].name, num_of_cam, width, height, ms,
+					quality, bytes, 100.0 * bytes / equirect_bytes, diff, off);
+
+			free(image[0]);
+			free(image[1]);
+			glDeleteProgram(program);
+			glDeleteFramebuffers(1, &framebuffer);
+			glDeleteTextures(1, &frame_texture);
+		}
+	}
+
+	cpu_remap_delete(remap);
+	glDeleteTextures(1, &color_lut_texture);
+	free(color_lut);
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglTerminate(display);
+	return 0;
+}
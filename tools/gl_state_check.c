@@ -0,0 +1,131 @@
+/**
+ * Checks gl_state.c against the bindings gl reports, on a pbuffer context.
+ * Exits 0 if every check passes, 1 otherwise.
+ *
+ *   gl_state_check
+ *
+ * Any EGL with pbuffers and GLES2 will do, EGL_PLATFORM=surfaceless for
+ * mesa without a display.
+ */
+#include <stdio.h>
+#include <stdbool.h>
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#ifdef HAVE_BCM_HOST
+#include <bcm_host.h>
+#endif
+
+#include "gl_state.h"
+
+static int lg_failures = 0;
+
+static void check(bool ok, const char *what) {
+	printf("%s : %s\n", ok ? "ok" : "FAILED", what);
+	if (!ok) {
+		lg_failures++;
+	}
+}
+
+static GLint get_integer(GLenum name) {
+	GLint value = 0;
+	glGetIntegerv(name, &value);
+	return value;
+}
+
+//a 1x1 texture of rgba on unit
+static GLuint new_texture(int unit, const unsigned char rgba[4]) {
+	GLuint texture;
+	glGenTextures(1, &texture);
+	gl_state_bind_texture(unit, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA,
+			GL_UNSIGNED_BYTE, rgba);
+	return texture;
+}
+
+//red of the texel of a 1x1 texture, read back through an fbo
+static int texture_red(GLuint texture) {
+	GLuint fbo;
+	unsigned char pixel[4] = { };
+	glGenFramebuffers(1, &fbo);
+	gl_state_bind_framebuffer(fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			GL_TEXTURE_2D, texture, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) {
+		glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+	}
+	gl_state_bind_framebuffer(0);
+	gl_state_delete_framebuffer(fbo);
+	return pixel[0];
+}
+
+static void check_bind_texture() {
+	gl_state_reset();
+	static const unsigned char black[4] = { 0, 0, 0, 255 };
+	static const unsigned char red[4] = { 255, 0, 0, 255 };
+	GLuint a = new_texture(0, black);
+	GLuint b = new_texture(1, black);
+
+	//a is cached on unit 0, unit 1 is active
+	gl_state_bind_texture(0, a);
+	check(get_integer(GL_ACTIVE_TEXTURE) == GL_TEXTURE0,
+			"binding a cached texture makes its unit active");
+	check(get_integer(GL_TEXTURE_BINDING_2D) == (GLint) a,
+			"the cached texture is bound on the active unit");
+
+	//what the callers do: bind, then edit what they bound
+	gl_state_bind_texture(1, b);
+	gl_state_bind_texture(0, a);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA,
+			GL_UNSIGNED_BYTE, red);
+	check(texture_red(a) == 255 && texture_red(b) == 0,
+			"an edit after binding a cached texture goes to that texture");
+
+	gl_state_bind_texture(1, b);
+	gl_state_bind_texture(1, b);
+	check(get_integer(GL_ACTIVE_TEXTURE) == GL_TEXTURE1
+			&& get_integer(GL_TEXTURE_BINDING_2D) == (GLint) b,
+			"binding the same texture twice keeps it bound");
+
+	gl_state_delete_texture(a);
+	gl_state_delete_texture(b);
+}
+
+int main(int argc, char *argv[]) {
+#ifdef HAVE_BCM_HOST
+	bcm_host_init();
+#endif
+	static const EGLint config_attribs[] = { EGL_RED_SIZE, 8, EGL_GREEN_SIZE,
+			8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8, EGL_SURFACE_TYPE,
+			EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT, EGL_NONE };
+	static const EGLint context_attribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2,
+			EGL_NONE };
+	static const EGLint pbuffer_attribs[] = { EGL_WIDTH, 16, EGL_HEIGHT, 16,
+			EGL_NONE };
+	EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLConfig config;
+	EGLint num_config;
+	if (!eglInitialize(display, NULL, NULL)
+			|| !eglChooseConfig(display, config_attribs, &config, 1,
+					&num_config) || num_config < 1) {
+		printf("no egl pbuffer config\n");
+		return 1;
+	}
+	eglBindAPI(EGL_OPENGL_ES_API);
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT,
+			context_attribs);
+	EGLSurface surface = eglCreatePbufferSurface(display, config,
+			pbuffer_attribs);
+	if (context == EGL_NO_CONTEXT || surface == EGL_NO_SURFACE
+			|| !eglMakeCurrent(display, surface, surface, context)) {
+		printf("can not make an egl context current\n");
+		return 1;
+	}
+
+	check_bind_texture();
+
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroySurface(display, surface);
+	eglDestroyContext(display, context);
+	eglTerminate(display);
+	return (lg_failures == 0) ? 0 : 1;
+}
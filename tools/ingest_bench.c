@@ -0,0 +1,297 @@
+/**
+ * Ingest benchmark without a camera or GPU.
+ * Runs the capture input path, input sources, image pools, frame pairing
+ * and channels, with one receiver and one stand-in decoder thread per
+ * camera and the main thread in place of the renderer. By default the
+ * cameras are synthetic test patterns, -i plays raw recordings and -p reads
+ * fifos instead (path formats with %d for the camera index), -u receives
+ * camera i on udp port base_port + i as the capture binary does, fed by
+ * udp_sender. With -j the decoders run the software MJPEG decoder on that
+ * many threads per camera, -s scales its output down by 2, 4 or 8 and -J
+ * splits every frame over that many more threads. Synthetic frames then get
+ * a restart interval per MCU row.
+ *
+ * usage: ingest_bench [-c MJPEG|H264] [-w width] [-h height] [-n num_of_cam]
+ *                     [-f fps] [-d detail] [-S pairing_tolerance_msec]
+ *                     [-t seconds] [-i raw_path | -p fifo_path |
+ *                     -u base_port] [-j decode_threads] [-s scale_denom]
+ *                     [-J slice_threads]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "input_source.h"
+#include "image_pool.h"
+#include "frame_channel.h"
+#include "frame_pairing.h"
+#include "jpeg_decoder.h"
+
+typedef struct {
+	int index;
+	INPUT_SOURCE_T *source;
+	FRAME_CHANNEL_T channel;
+	FRAME_PAIRING_T *pairing; //NULL with a single camera
+	JPEG_DECODER_T *jpeg_decoder; //NULL without -j
+	uint64_t frames;
+	uint64_t bytes;
+	uint64_t latency_sum; //usec from the frame timestamp to the decoder
+	uint64_t latency_max;
+} CAM_T;
+
+static volatile bool lg_stop = false;
+
+static uint64_t now_usec() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void *receiver(void *arg) {
+	CAM_T *cam = (CAM_T*) arg;
+	while (!lg_stop) {
+		IMAGE_DATA *image_data = input_source_next_frame(cam->source, 10000);
+		if (image_data == NULL) {
+			if (cam->source->eos) {
+				break;
+			}
+			continue;
+		}
+		if (cam->pairing) {
+			frame_pairing_push(cam->pairing, cam->index, image_data);
+		} else {
+			frame_channel_publish(&cam->channel, image_data);
+		}
+		release_image(image_data);
+	}
+	return NULL;
+}
+
+static void jpeg_decoded(void *user, JPEG_DECODER_FRAME_T *frame) {
+	CAM_T *cam = (CAM_T*) user;
+	if (cam->pairing) {
+		frame_pairing_decoded(cam->pairing, cam->index);
+	}
+}
+
+static void *decoder(void *arg) {
+	CAM_T *cam = (CAM_T*) arg;
+	while (!lg_stop) {
+		IMAGE_DATA *image_data = frame_channel_wait(&cam->channel, 10000);
+		if (image_data == NULL) {
+			continue;
+		}
+		//recordings carry their capture time, only live latency means much
+		uint64_t now = now_usec();
+		if (image_data->timestamp > 0 && image_data->timestamp <= now) {
+			uint64_t latency = now - image_data->timestamp;
+			cam->latency_sum += latency;
+			if (latency > cam->latency_max) {
+				cam->latency_max = latency;
+			}
+		}
+		cam->frames++;
+		cam->bytes += image_data->image_size;
+		if (cam->jpeg_decoder) { //reports to the pairing when decoded
+			jpeg_decoder_push(cam->jpeg_decoder, image_data);
+			release_image(image_data);
+			continue;
+		}
+		release_image(image_data);
+		if (cam->pairing) {
+			frame_pairing_decoded(cam->pairing, cam->index);
+		}
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[]) {
+	enum INPUT_CODEC codec = INPUT_CODEC_MJPEG;
+	int width = 1024;
+	int height = 1024;
+	int num_of_cam = 2;
+	int fps = 30;
+	int detail = 0;
+	float tolerance_msec = FRAME_PAIRING_DEFAULT_TOLERANCE / 1000.0;
+	int seconds = 10;
+	char *raw_path = NULL;
+	char *fifo_path = NULL;
+	int udp_port = 0;
+	int decode_threads = 0;
+	int scale_denom = 1;
+	int slice_threads = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "c:w:h:n:f:d:S:t:i:p:u:j:s:J:")) != -1) {
+		switch (opt) {
+		case 'c':
+			codec = (strcmp(optarg, "H264") == 0) ?
+					INPUT_CODEC_H264 : INPUT_CODEC_MJPEG;
+			break;
+		case 'w':
+			sscanf(optarg, "%d", &width);
+			break;
+		case 'h':
+			sscanf(optarg, "%d", &height);
+			break;
+		case 'n':
+			sscanf(optarg, "%d", &num_of_cam);
+			break;
+		case 'f':
+			sscanf(optarg, "%d", &fps);
+			break;
+		case 'd':
+			sscanf(optarg, "%d", &detail);
+			break;
+		case 'S':
+			sscanf(optarg, "%f", &tolerance_msec);
+			break;
+		case 't':
+			sscanf(optarg, "%d", &seconds);
+			break;
+		case 'i':
+			raw_path = optarg;
+			break;
+		case 'p':
+			fifo_path = optarg;
+			break;
+		case 'u':
+			sscanf(optarg, "%d", &udp_port);
+			break;
+		case 'j':
+			sscanf(optarg, "%d", &decode_threads);
+			break;
+		case 's':
+			sscanf(optarg, "%d", &scale_denom);
+			break;
+		case 'J':
+			sscanf(optarg, "%d", &slice_threads);
+			break;
+		default:
+			printf(
+					"usage: %s [-c MJPEG|H264] [-w width] [-h height] [-n num_of_cam] [-f fps] [-d detail] [-S pairing_tolerance_msec] [-t seconds] [-i raw_path | -p fifo_path | -u base_port] [-j decode_threads] [-s scale_denom] [-J slice_threads]\n",
+					argv[0]);
+			return -1;
+		}
+	}
+	if (num_of_cam < 1 || num_of_cam > FRAME_PAIRING_MAX_CAM) {
+		printf("num_of_cam must be 1 to %d\n", FRAME_PAIRING_MAX_CAM);
+		return -1;
+	}
+
+	FRAME_PAIRING_T pairing;
+	frame_pairing_init(&pairing, num_of_cam,
+			(uint64_t) (tolerance_msec * 1000));
+	CAM_T cam[FRAME_PAIRING_MAX_CAM] = { };
+	IMAGE_POOL_T *pool[FRAME_PAIRING_MAX_CAM];
+	UDP_RECEIVER_T *udp_receiver[FRAME_PAIRING_MAX_CAM] = { };
+	pthread_t receiver_thread[FRAME_PAIRING_MAX_CAM];
+	pthread_t decoder_thread[FRAME_PAIRING_MAX_CAM];
+	for (int i = 0; i < num_of_cam; i++) {
+		char name[256];
+		sprintf(name, "cam%d pool", i);
+		pool[i] = image_pool_create(name, 0);
+
+		cam[i].index = i;
+		if (raw_path) {
+			sprintf(name, raw_path, i);
+			cam[i].source = input_source_file_open(name, pool[i]);
+		} else if (fifo_path) {
+			sprintf(name, fifo_path, i);
+			cam[i].source = input_source_fifo_open(name, codec, pool[i]);
+		} else if (udp_port > 0) {
+			sprintf(name, "cam%d udp", i);
+			udp_receiver[i] = udp_receiver_create(name, udp_port + i);
+			if (udp_receiver[i] == NULL) {
+				return -1;
+			}
+			cam[i].source = input_source_udp_open(udp_receiver[i],
+					UDP_STREAM_ANY, codec, pool[i]);
+		} else {
+			cam[i].source = input_source_synthetic_open(codec, width, height,
+					fps, i, pool[i]);
+			if (cam[i].source) {
+				input_source_synthetic_set_jpeg_options(cam[i].source, detail,
+						(slice_threads > 0) ? (width + 15) / 16 : 0);
+			}
+		}
+		if (cam[i].source == NULL) {
+			return -1;
+		}
+		if (decode_threads > 0) {
+			sprintf(name, "cam%d jpeg", i);
+			cam[i].jpeg_decoder = jpeg_decoder_create(name, decode_threads,
+					slice_threads, jpeg_decoded, &cam[i]);
+			if (cam[i].jpeg_decoder == NULL) {
+				return -1;
+			}
+			jpeg_decoder_set_scale(cam[i].jpeg_decoder, scale_denom);
+		}
+		sprintf(name, "cam%d decode", i);
+		frame_channel_init(&cam[i].channel, name,
+				(codec == INPUT_CODEC_H264) ? FRAME_CHANNEL_MAX_DEPTH : 1);
+		if (num_of_cam > 1) {
+			cam[i].pairing = &pairing;
+			frame_pairing_set_output(&pairing, i, &cam[i].channel);
+		}
+	}
+	for (int i = 0; i < num_of_cam; i++) {
+		pthread_create(&decoder_thread[i], NULL, decoder, &cam[i]);
+		pthread_create(&receiver_thread[i], NULL, receiver, &cam[i]);
+	}
+
+	//stand-in renderer, draws a set as soon as it is decoded
+	uint64_t start = now_usec();
+	while (now_usec() - start < (uint64_t) seconds * 1000000) {
+		if (num_of_cam > 1) {
+			if (frame_pairing_wait(&pairing, 10000) != 0) {
+				continue;
+			}
+		} else {
+			usleep(1000);
+		}
+		for (int i = 0; i < num_of_cam && decode_threads > 0; i++) {
+			jpeg_decoder_put_frame(cam[i].jpeg_decoder,
+					jpeg_decoder_get_frame(cam[i].jpeg_decoder));
+		}
+		if (num_of_cam > 1) {
+			frame_pairing_rendered(&pairing);
+		}
+	}
+	lg_stop = true;
+	double elapsed = (now_usec() - start) / 1000000.0;
+
+	for (int i = 0; i < num_of_cam; i++) {
+		pthread_join(receiver_thread[i], NULL);
+		pthread_join(decoder_thread[i], NULL);
+		printf("cam%d : %.1f fps, %.1f Mbps, latency avg %.2fms max %.2fms\n",
+				i, cam[i].frames / elapsed,
+				cam[i].bytes * 8 / elapsed / 1000000,
+				cam[i].frames ?
+						cam[i].latency_sum / 1000.0 / cam[i].frames : 0,
+				cam[i].latency_max / 1000.0);
+		input_source_print_stats(cam[i].source);
+		frame_channel_print_stats(&cam[i].channel);
+		if (cam[i].jpeg_decoder) {
+			jpeg_decoder_print_stats(cam[i].jpeg_decoder);
+		}
+		if (udp_receiver[i]) {
+			udp_receiver_print_stats(udp_receiver[i]);
+		}
+		image_pool_print_stats(pool[i]);
+	}
+	if (num_of_cam > 1) {
+		frame_pairing_print_stats(&pairing);
+	}
+	for (int i = 0; i < num_of_cam; i++) {
+		frame_channel_flush(&cam[i].channel);
+		jpeg_decoder_delete(cam[i].jpeg_decoder);
+		input_source_close(cam[i].source);
+		udp_receiver_delete(udp_receiver[i]);
+	}
+
+	return 0;
+}
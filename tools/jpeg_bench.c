@@ -0,0 +1,133 @@
+/**
+ * Serial against restart-marker parallel JPEG decode.
+ * Encodes a test pattern frame per resolution with a restart interval of
+ * one MCU row (or -r MCUs), decodes it in one piece and then in bands on
+ * 1 to max_threads slice threads plus the calling thread. The bands are
+ * upsampled without fancy upsampling, the largest difference to the one
+ * piece decode is printed for each, at chroma edges only.
+ *
+ * usage: jpeg_bench [-n loops] [-t max_threads] [-d detail]
+ *                   [-r restart_interval] [-s scale_denom] [WxH ...]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "jpeg_decoder.h"
+#include "test_pattern.h"
+
+static double now_ms() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static double bench(const unsigned char *data, int size, int scale_denom,
+		JPEG_SLICER_T *slicer, int loops, JPEG_DECODER_FRAME_T *frame) {
+	double start = now_ms();
+	for (int i = 0; i < loops; i++) {
+		if (jpeg_decode(data, size, scale_denom, slicer, frame) != 0) {
+			printf("decode failed\n");
+			exit(1);
+		}
+	}
+	return (now_ms() - start) / loops;
+}
+
+int main(int argc, char *argv[]) {
+	int loops = 20;
+	int max_threads = 3;
+	int detail = 8;
+	int restart_interval = 0; //one mcu row
+	int scale_denom = 1;
+	int opt;
+	const char *default_sizes[] = { "640x480", "1296x972", "1920x1080",
+			"2592x1944", "4096x2048" };
+
+	while ((opt = getopt(argc, argv, "n:t:d:r:s:")) != -1) {
+		switch (opt) {
+		case 'n':
+			sscanf(optarg, "%d", &loops);
+			break;
+		case 't':
+			sscanf(optarg, "%d", &max_threads);
+			break;
+		case 'd':
+			sscanf(optarg, "%d", &detail);
+			break;
+		case 'r':
+			sscanf(optarg, "%d", &restart_interval);
+			break;
+		case 's':
+			sscanf(optarg, "%d", &scale_denom);
+			break;
+		default:
+			printf(
+					"usage: %s [-n loops] [-t max_threads] [-d detail] [-r restart_interval] [-s scale_denom] [WxH ...]\n",
+					argv[0]);
+			return -1;
+		}
+	}
+	if (max_threads > JPEG_SLICER_MAX_THREADS) {
+		max_threads = JPEG_SLICER_MAX_THREADS;
+	}
+	JPEG_SLICER_T *slicer[JPEG_SLICER_MAX_THREADS + 1] = { };
+	for (int t = 1; t <= max_threads; t++) {
+		slicer[t] = jpeg_slicer_create(t);
+	}
+
+	int num_sizes = (optind < argc) ? argc - optind : 5;
+	for (int i = 0; i < num_sizes; i++) {
+		int width, height;
+		const char *size_str =
+				(optind < argc) ? argv[optind + i] : default_sizes[i];
+		if (sscanf(size_str, "%dx%d", &width, &height) != 2) {
+			printf("bad size %s\n", size_str);
+			continue;
+		}
+		TEST_PATTERN_T *pattern = test_pattern_create(width, height, 0);
+		test_pattern_set_jpeg_options(pattern, detail,
+				restart_interval ? restart_interval : (width + 15) / 16);
+		unsigned char *data = malloc(test_pattern_max_size(pattern));
+		int size = test_pattern_jpeg(pattern, 1, data);
+
+		JPEG_DECODER_FRAME_T serial = { };
+		double serial_ms = bench(data, size, scale_denom, NULL, loops, &serial);
+		printf("%s %dKB : serial %.2fms", size_str, size / 1024, serial_ms);
+		for (int t = 1; t <= max_threads; t++) {
+			JPEG_DECODER_FRAME_T frame = { };
+			double ms = bench(data, size, scale_denom, slicer[t], loops,
+					&frame);
+			int max_diff = 0;
+			bool same = frame.width == serial.width
+					&& frame.height == serial.height;
+			for (int p = 0;
+					same && p < serial.width * serial.height * serial.components;
+					p++) {
+				int diff = abs(frame.pixels[p] - serial.pixels[p]);
+				if (diff > max_diff) {
+					max_diff = diff;
+				}
+			}
+			printf(", %d cores %.2fms x%.2f%s", t + 1, ms, serial_ms / ms,
+					(frame.slices > 1) ? "" : " (serial)");
+			if (same) {
+				printf(" max diff %d", max_diff);
+			} else {
+				printf(" MISMATCH");
+			}
+			free(frame.pixels);
+		}
+		printf("\n");
+		free(serial.pixels);
+		free(data);
+		test_pattern_delete(pattern);
+	}
+
+	for (int t = 1; t <= max_threads; t++) {
+		jpeg_slicer_delete(slicer[t]);
+	}
+	return 0;
+}
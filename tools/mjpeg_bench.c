@@ -0,0 +1,220 @@
+/**
+ * Throughput benchmark for the MJPEG ingest ring.
+ * Builds a synthetic MJPEG stream in memory (EXIF thumbnail with nested
+ * SOI/EOI, byte stuffed entropy data, restart markers), pushes it through a
+ * pipe like the camN FIFOs and compares the ring against the legacy per byte
+ * marker loop.
+ *
+ * usage: mjpeg_bench [-w width] [-h height] [-n frames] [-l loops]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "mjpeg_ring.h"
+
+typedef struct {
+	unsigned char *data;
+	int size;
+	int loops;
+	int fd;
+} WRITER_ARGS_T;
+
+static double now_ms() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static unsigned char *put_segment(unsigned char *p, int marker, int len) {
+	*p++ = 0xff;
+	*p++ = marker;
+	*p++ = (len + 2) >> 8;
+	*p++ = (len + 2) & 0xff;
+	memset(p, 0x11, len);
+	return p + len;
+}
+
+static unsigned char *put_frame(unsigned char *p, int entropy_size) {
+	*p++ = 0xff;
+	*p++ = 0xd8;
+	{ //APP1 with a thumbnail
+		unsigned char *app1 = p;
+		p = put_segment(p, 0xe1, 1024);
+		app1[100] = 0xff;
+		app1[101] = 0xd8;
+		app1[900] = 0xff;
+		app1[901] = 0xd9;
+	}
+	p = put_segment(p, 0xdb, 130); //DQT
+	p = put_segment(p, 0xc0, 15); //SOF0
+	p = put_segment(p, 0xc4, 400); //DHT
+	p = put_segment(p, 0xdd, 2); //DRI
+	p = put_segment(p, 0xda, 10); //SOS
+	for (int i = 0, rst = 0; i < entropy_size; i++) {
+		unsigned char c = rand() & 0xff;
+		*p++ = c;
+		if (c == 0xff) {
+			*p++ = 0x00; //byte stuffing
+		}
+		if (i % 4096 == 4095) {
+			*p++ = 0xff;
+			*p++ = 0xd0 + (rst++ & 7);
+		}
+	}
+	*p++ = 0xff;
+	*p++ = 0xd9;
+	return p;
+}
+
+static void *writer(void *arg) {
+	WRITER_ARGS_T *args = (WRITER_ARGS_T*) arg;
+	for (int loop = 0; loop < args->loops; loop++) {
+		int cur = 0;
+		while (cur < args->size) {
+			int len = write(args->fd, args->data + cur, args->size - cur);
+			if (len <= 0) {
+				return NULL;
+			}
+			cur += len;
+		}
+	}
+	close(args->fd);
+	return NULL;
+}
+
+//the byte loop image_receiver used before the ring
+static int legacy_scan(const unsigned char *buff, int data_len, int chunk) {
+	int frames = 0;
+	int marker = 0;
+	int soicount = 0;
+	int image_start = -1;
+	int data_len_total = 0;
+	for (int cur = 0; cur < data_len; cur += chunk) {
+		int len = (data_len - cur < chunk) ? data_len - cur : chunk;
+		const unsigned char *b = buff + cur;
+		for (int i = 0; i < len; i++) {
+			if (marker) {
+				marker = 0;
+				if (b[i] == 0xd8) {
+					if (soicount == 0) {
+						image_start = data_len_total + (i - 1);
+					}
+					soicount++;
+				}
+				if (b[i] == 0xd9 && image_start >= 0) {
+					soicount--;
+					if (soicount == 0) {
+						frames++;
+						image_start = -1;
+					}
+				}
+			} else if (b[i] == 0xff) {
+				marker = 1;
+			}
+		}
+		data_len_total += len;
+	}
+	return frames;
+}
+
+int main(int argc, char *argv[]) {
+	int width = 1024;
+	int height = 1024;
+	int num_of_frames = 30;
+	int loops = 20;
+	int opt;
+	while ((opt = getopt(argc, argv, "w:h:n:l:")) != -1) {
+		switch (opt) {
+		case 'w':
+			sscanf(optarg, "%d", &width);
+			break;
+		case 'h':
+			sscanf(optarg, "%d", &height);
+			break;
+		case 'n':
+			sscanf(optarg, "%d", &num_of_frames);
+			break;
+		case 'l':
+			sscanf(optarg, "%d", &loops);
+			break;
+		default:
+			printf("usage: %s [-w width] [-h height] [-n frames] [-l loops]\n",
+					argv[0]);
+			return -1;
+		}
+	}
+
+	//roughly 1.5 bits per pixel, similar to raspivid MJPEG at 8Mbps
+	int entropy_size = width * height * 3 / 16;
+	int stream_size = num_of_frames * (entropy_size * 2 + 4096);
+	unsigned char *stream = malloc(stream_size);
+	unsigned char *p = stream;
+	for (int i = 0; i < num_of_frames; i++) {
+		p = put_frame(p, entropy_size);
+	}
+	stream_size = p - stream;
+	double total_mb = (double) stream_size * loops / (1024 * 1024);
+	printf("stream : %d frames, %.1f KB/frame, %.1f MB total\n", num_of_frames,
+			stream_size / 1024.0 / num_of_frames, total_mb);
+
+	{ //legacy byte loop, in memory without copies
+		double start = now_ms();
+		int frames = 0;
+		for (int loop = 0; loop < loops; loop++) {
+			frames += legacy_scan(stream, stream_size, 4096);
+		}
+		double elapsed = now_ms() - start;
+		printf("legacy scan : %d frames, %.1f MB/s, %.1f fps\n", frames,
+				total_mb / elapsed * 1000, frames / elapsed * 1000);
+	}
+	{ //ring over a pipe
+		int fds[2];
+		if (pipe(fds) != 0) {
+			perror("pipe");
+			return -1;
+		}
+		MJPEG_RING_T *ring = mjpeg_ring_create(MJPEG_RING_DEFAULT_SIZE);
+		if (ring == NULL) {
+			return -1;
+		}
+		WRITER_ARGS_T args = { stream, stream_size, loops, fds[1] };
+		pthread_t writer_thread;
+		double start = now_ms();
+		pthread_create(&writer_thread, NULL, writer, &args);
+		int frames = 0;
+		int bad_frames = 0;
+		while (mjpeg_ring_fill(ring, fds[0]) > 0) {
+			IMAGE_DATA *image_data;
+			while ((image_data = mjpeg_ring_get_frame(ring)) != NULL) {
+				const unsigned char *b = image_data->image_buff;
+				int n = image_data->image_size;
+				if (b[0] != 0xff || b[1] != 0xd8 || b[n - 2] != 0xff
+						|| b[n - 1] != 0xd9) {
+					bad_frames++;
+				}
+				frames++;
+				release_image(image_data);
+			}
+		}
+		double elapsed = now_ms() - start;
+		pthread_join(writer_thread, NULL);
+		close(fds[0]);
+
+		MJPEG_RING_STATS_T stats;
+		mjpeg_ring_get_stats(ring, &stats);
+		printf("ring via pipe : %d frames (%d bad), %.1f MB/s, %.1f fps\n",
+				frames, bad_frames, total_mb / elapsed * 1000,
+				frames / elapsed * 1000);
+		printf("ring stats : dropped %llu, resyncs %llu, overflows %llu\n",
+				(unsigned long long) stats.dropped_frames,
+				(unsigned long long) stats.resyncs,
+				(unsigned long long) stats.overflows);
+		mjpeg_ring_delete(ring);
+	}
+	free(stream);
+	return 0;
+}
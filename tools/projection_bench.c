@@ -0,0 +1,1197 @@
+/**
+ * Fragment cost of the projection shaders with and without the lookup
+ * texture of projection_lut.h.
+ * Renders equirectangular and window frames off screen with the shaders of
+ * ../shader, for one camera and for two, once with the shaders that
+ * evaluate the mapping per pixel and once with the *_lut.frag ones, and
+ * reports the time per frame and how far the two pictures are apart.
+ * The frames of cpu_remap.h are compared with the shader ones as well, and
+ * so are those looked up from the cameras stitched once (-> stitch) and
+ * the window frames mapped per vertex of a patch of window_mesh.h (-> mesh).
+ * With -g, the cameras are also sharpened once by sharpen.frag, checked
+ * against sharpen_image(), and the frames drawn from them with one fetch
+ * per sample (-> sharpen pass).
+ * Every frame is graded by the 3D lut of the .cube file given with -l as
+ * COLOR_LUT, or by the color offset of old without, the cpu frames and the
+ * sharpen pass by color_lut.h.
+ * The cells of coverage_mask.h that only show one camera, the logo or black
+ * are drawn by the ONLY_* variants, against all cells drawn by the plain
+ * shaders (-> masked). -H sets the horizon_r of the cameras, above about
+ * 1.1 the camera images end inside the frames and there are black cells.
+ * The last frame is then packed to I420 by i420.frag, checked against
+ * i420_from_rgb() and its readback timed against reading RGBA.
+ * Last, the views of the start_view command: how many VIEW_SIZE window
+ * frames a second are drawn and read back one by one, and how many side
+ * by side in a view atlas.
+ * The cameras are a synthetic texture, the view is tilted so the mapping
+ * does not line up with the frame. Run it from tools/ on the target, any
+ * EGL with pbuffers and GLES2 will do.
+ *
+ * usage: projection_bench [-w frame_width] [-h frame_height]
+ *                         [-c cam_width] [-n loops] [-g sharpness_gain]
+ *                         [-v num_views] [-l color_lut.cube] [-H horizon_r]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#if __has_include(<bcm_host.h>)
+#include <bcm_host.h>
+#define HAVE_BCM_HOST
+#endif
+
+#include "projection_lut.h"
+#include "cpu_remap.h"
+#include "i420.h"
+#include "view_atlas.h"
+#include "window_mesh.h"
+#include "sharpen.h"
+#include "color_lut.h"
+#include "coverage_mask.h"
+
+#define SHADER_PATH "../shader/"
+#define STITCH_WIDTH 2048 //as the default of picam360-capture
+#define VIEW_SIZE 640
+#define MESH_MAX_ERROR 0.5 //camera texels, as the default of picam360-capture
+#define COLOR_LUT_TEXTURE_UNIT 5 //as picam360-capture
+
+enum MODE {
+	MODE_EQUIRECTANGULAR, MODE_WINDOW, MODE_NUM
+};
+
+typedef struct {
+	float offset_yaw;
+	float offset_x;
+	float offset_y;
+	float horizon_r;
+} CAM_T;
+
+static const char *lg_mode_name[MODE_NUM] = { "equirectangular", "window" };
+static CAM_T lg_cam[2] = { { 0.1, 0.01, -0.02, 0.8 }, { -0.2, -0.015, 0.01,
+		0.78 } };
+
+static double now_ms() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static char *read_file(const char *path) {
+	FILE *fp = fopen(path, "rb");
+	if (fp == NULL) {
+		printf("can not open %s\n", path);
+		exit(1);
+	}
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	char *buff = malloc(size + 1);
+	buff[fread(buff, 1, size, fp)] = '\0';
+	fclose(fp);
+	return buff;
+}
+
+static GLuint load_shader(GLenum type, const char *file, const char *defines) {
+	char path[256];
+	sprintf(path, SHADER_PATH "%s", file);
+	char *source = read_file(path);
+	//the shaders rely on the firmware compiler's default float precision
+	const GLchar *sources[3] = { defines,
+			(type == GL_FRAGMENT_SHADER) ?
+					"#ifdef GL_FRAGMENT_PRECISION_HIGH\nprecision highp float;\n#endif\n" :
+					"", source };
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 3, sources, NULL);
+	glCompileShader(shader);
+	free(source);
+	GLint ok;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+	if (!ok) {
+		char log[1024];
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		printf("%s : %s\n", file, log);
+		exit(1);
+	}
+	return shader;
+}
+
+//defines as GLProgramVariants puts them in front of the sources
+static GLuint load_program(const char *vert, const char *frag,
+		const char *defines) {
+	GLuint program = glCreateProgram();
+	glAttachShader(program, load_shader(GL_VERTEX_SHADER, vert, defines));
+	glAttachShader(program, load_shader(GL_FRAGMENT_SHADER, frag, defines));
+	glLinkProgram(program);
+	GLint ok;
+	glGetProgramiv(program, GL_LINK_STATUS, &ok);
+	if (!ok) {
+		printf("%s %s : link failed\n", vert, frag);
+		exit(1);
+	}
+	return program;
+}
+
+static GLuint create_texture(int width, int height, GLint filter,
+		const unsigned char *pixels) {
+	GLuint tex;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+			GL_UNSIGNED_BYTE, pixels);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return tex;
+}
+
+//smooth gradients with a grid every 64 texels, different per camera
+static unsigned char *camera_image(int width, int id) {
+	unsigned char *pixels = malloc(width * width * 4);
+	for (int y = 0; y < width; y++) {
+		for (int x = 0; x < width; x++) {
+			unsigned char *p = pixels + (y * width + x) * 4;
+			bool grid = (x % 64 == 0 || y % 64 == 0);
+			p[0] = grid ? 255 : x * 255 / width;
+			p[1] = grid ? 255 : y * 255 / width;
+			p[2] = grid ? 255 : (id ? 64 : 192);
+			p[3] = 255;
+		}
+	}
+	return pixels;
+}
+
+static void cpu_image(CPU_REMAP_IMAGE_T *img, const unsigned char *pixels,
+		int width) {
+	img->pixels = pixels;
+	img->width = width;
+	img->height = width;
+	img->stride = width * 4;
+}
+
+//mean difference of the color channels, percentage of pixels off by more
+//than 8
+static double compare(const unsigned char *a, const unsigned char *b,
+		int num_pixels, double *off_percent) {
+	double diff_sum = 0;
+	int diff_pixels = 0;
+	for (int i = 0; i < num_pixels; i++) {
+		int max_diff = 0;
+		for (int c = 0; c < 3; c++) {
+			int d = abs(a[i * 4 + c] - b[i * 4 + c]);
+			diff_sum += d;
+			max_diff = (d > max_diff) ? d : max_diff;
+		}
+		if (max_diff > 8) {
+			diff_pixels++;
+		}
+	}
+	*off_percent = 100.0 * diff_pixels / num_pixels;
+	return diff_sum / (num_pixels * 3);
+}
+
+//same geometry as init_model_proj(), window columns are drawn one by one
+static GLuint mesh(enum MODE mode, int *n_out, int *strips_out) {
+	float *points;
+	int n;
+	if (mode == MODE_EQUIRECTANGULAR) {
+		static float quad[] = { 0, 0, 1, 1, 1, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1 };
+		n = 4;
+		*strips_out = 1;
+		points = malloc(sizeof(quad));
+		memcpy(points, quad, sizeof(quad));
+	} else {
+		const int steps = 128;
+		float end = tan(150.0 * M_PI / 180.0 / 2);
+		float step = 2 * end / steps;
+		n = 2 * (steps + 1) * steps;
+		*strips_out = steps;
+		points = malloc(sizeof(float) * 4 * n);
+		int idx = 0;
+		for (int i = 0; i < steps; i++) {
+			for (int j = 0; j <= steps; j++) {
+				for (int k = 0; k < 2; k++) {
+					float x = -end + step * (i + k);
+					float y = -end + step * j;
+					float len = sqrt(x * x + y * y + 1.0);
+					points[idx++] = x / len;
+					points[idx++] = y / len;
+					points[idx++] = 1.0 / len;
+					points[idx++] = 1.0;
+				}
+			}
+		}
+	}
+	GLuint vbo;
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 4 * n, points,
+			GL_STATIC_DRAW);
+	free(points);
+	*n_out = n;
+	return vbo;
+}
+
+static void draw(int n, int strips) {
+	for (int i = 0; i < strips; i++) {
+		glDrawArrays(GL_TRIANGLE_STRIP, i * n / strips, n / strips);
+	}
+}
+
+//a tilted view, turned by yaw
+static void view_matrix(float m[16], float yaw) {
+	float a = 0.3, b = yaw;
+	float view[16] = { cos(b), 0, -sin(b), 0, sin(a) * sin(b), cos(a), sin(a)
+			* cos(b), 0, cos(a) * sin(b), -sin(a), cos(a) * cos(b), 0, 0, 0,
+			0, 1 };
+	memcpy(m, view, sizeof(view));
+}
+
+//uniforms redraw_render_texture() sets
+static void set_uniforms(GLuint program, int num_of_cam, int cam_width,
+		float aspect_ratio, float sharpness_gain) {
+	float m[16];
+	view_matrix(m, 0.5);
+	glUniformMatrix4fv(glGetUniformLocation(program, "unif_matrix"), 1,
+			GL_FALSE, m);
+	glUniform1f(glGetUniformLocation(program, "pixel_size"), 1.0 / cam_width);
+	glUniform1f(glGetUniformLocation(program, "scale"),
+			1.0 / tan(120.0 * M_PI / 180.0 / 2));
+	glUniform1f(glGetUniformLocation(program, "aspect_ratio"), aspect_ratio);
+	glUniform1f(glGetUniformLocation(program, "sharpness_gain"),
+			sharpness_gain);
+	for (int i = 0; i < num_of_cam; i++) {
+		char prefix[8], name[64];
+		float center[2], rot[2];
+		if (num_of_cam == 1) {
+			strcpy(prefix, "cam");
+		} else {
+			sprintf(prefix, "cam%d", i);
+		}
+		sprintf(name, "%s_offset_yaw", prefix);
+		glUniform1f(glGetUniformLocation(program, name), lg_cam[i].offset_yaw);
+		sprintf(name, "%s_offset_x", prefix);
+		glUniform1f(glGetUniformLocation(program, name), lg_cam[i].offset_x);
+		sprintf(name, "%s_offset_y", prefix);
+		glUniform1f(glGetUniformLocation(program, name), lg_cam[i].offset_y);
+		sprintf(name, "%s_horizon_r", prefix);
+		glUniform1f(glGetUniformLocation(program, name), lg_cam[i].horizon_r);
+		projection_lut_camera(lg_cam[i].offset_yaw, lg_cam[i].offset_x,
+				lg_cam[i].offset_y, lg_cam[i].horizon_r, center, rot);
+		sprintf(name, "%s_center", prefix);
+		glUniform2fv(glGetUniformLocation(program, name), 1, center);
+		sprintf(name, "%s_rot", prefix);
+		glUniform2fv(glGetUniformLocation(program, name), 1, rot);
+		sprintf(name, "%s_texture", prefix);
+		glUniform1i(glGetUniformLocation(program, name), i + 1);
+	}
+	glUniform1i(glGetUniformLocation(program, "logo_texture"), 0);
+	glUniform1i(glGetUniformLocation(program, "lut_texture"), 3);
+	glUniform1i(glGetUniformLocation(program, "color_lut_texture"),
+			COLOR_LUT_TEXTURE_UNIT);
+}
+
+/**
+ * The stitch option of picam360-capture: the cameras are drawn once into
+ * an equirectangular texture in camera coordinates, then the frame is
+ * looked up from it. Returns the time per frame of the lookup and in
+ * stitch_ms that of drawing the cameras, leaves framebuffer bound.
+ */
+static double draw_stitched(enum MODE mode, const char *defines,
+		int num_of_cam, int cam_width, float sharpness_gain,
+		GLuint framebuffer, int width, int height, int loops,
+		unsigned char *image, double *stitch_ms) {
+	GLuint stitch_texture = create_texture(STITCH_WIDTH, STITCH_WIDTH / 2,
+			GL_LINEAR, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	GLuint stitch_framebuffer;
+	glGenFramebuffers(1, &stitch_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, stitch_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+			stitch_texture, 0);
+	glViewport(0, 0, STITCH_WIDTH, STITCH_WIDTH / 2);
+
+	int n, strips;
+	GLuint vbo = mesh(MODE_EQUIRECTANGULAR, &n, &strips);
+	GLuint program = load_program("equirectangular.vert",
+			"equirectangular.frag", defines);
+	glUseProgram(program);
+	set_uniforms(program, num_of_cam, cam_width, 2.0, sharpness_gain);
+	static const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0,
+			0, 0, 0, 1 };
+	glUniformMatrix4fv(glGetUniformLocation(program, "unif_matrix"), 1,
+			GL_FALSE, identity);
+	GLuint loc = glGetAttribLocation(program, "vPosition");
+	glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(loc);
+	draw(n, strips);
+	glFinish();
+	double start = now_ms();
+	for (int l = 0; l < loops; l++) {
+		draw(n, strips);
+	}
+	glFinish();
+	*stitch_ms = (now_ms() - start) / loops;
+	glDeleteProgram(program);
+	glDeleteBuffers(1, &vbo);
+
+	char vert[64], frag[64];
+	sprintf(vert, "%s.vert", lg_mode_name[mode]);
+	sprintf(frag, "%s_stitched.frag", lg_mode_name[mode]);
+	vbo = mesh(mode, &n, &strips);
+	program = load_program(vert, frag, "");
+	glUseProgram(program);
+	set_uniforms(program, num_of_cam, cam_width, (float) width / height,
+			sharpness_gain);
+	glActiveTexture(GL_TEXTURE4);
+	glBindTexture(GL_TEXTURE_2D, stitch_texture);
+	glUniform1i(glGetUniformLocation(program, "stitch_texture"), 4);
+	loc = glGetAttribLocation(program, "vPosition");
+	glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(loc);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+	draw(n, strips);
+	glFinish();
+	start = now_ms();
+	for (int l = 0; l < loops; l++) {
+		draw(n, strips);
+	}
+	glFinish();
+	double ms = (now_ms() - start) / loops;
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, image);
+
+	glDeleteProgram(program);
+	glDeleteBuffers(1, &vbo);
+	glDeleteFramebuffers(1, &stitch_framebuffer);
+	glDeleteTextures(1, &stitch_texture);
+	return ms;
+}
+
+/**
+ * The window frame drawn with the patch window_mesh() of picam360-capture
+ * makes for it, with the fisheye mapping per vertex if the patch can be
+ * dense enough for MESH_MAX_ERROR. Returns the time per frame.
+ */
+static double draw_window_mesh(const char *defines, int num_of_cam,
+		int cam_width, float sharpness_gain, int width, int height,
+		int loops, unsigned char *image, int *steps_out, bool *vertex_uv) {
+	float tan_x, tan_y;
+	window_mesh_extent(120, (float) width / height, &tan_x, &tan_y);
+	float horizon_r = fmaxf(lg_cam[0].horizon_r,
+			(num_of_cam > 1) ? lg_cam[1].horizon_r : 0);
+	int steps = window_mesh_steps(num_of_cam, tan_x, tan_y,
+			MESH_MAX_ERROR / (horizon_r * cam_width));
+	*vertex_uv = (steps > 0);
+	if (steps == 0) {
+		steps = WINDOW_MESH_MAX_STEPS;
+	}
+	int n = window_mesh_vertices(steps);
+	float *points = malloc(sizeof(float) * 4 * n);
+	window_mesh_build(tan_x, tan_y, steps, points);
+	GLuint vbo;
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 4 * n, points,
+			GL_STATIC_DRAW);
+	free(points);
+
+	char vertex_defines[128];
+	sprintf(vertex_defines, "%s%s", defines,
+			*vertex_uv ? "#define VERTEX_UV\n" : "");
+	GLuint program = load_program("window.vert", "window.frag",
+			vertex_defines);
+	glUseProgram(program);
+	set_uniforms(program, num_of_cam, cam_width, (float) width / height,
+			sharpness_gain);
+	GLuint loc = glGetAttribLocation(program, "vPosition");
+	glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(loc);
+	draw(n, steps);
+	glFinish();
+	double start = now_ms();
+	for (int l = 0; l < loops; l++) {
+		draw(n, steps);
+	}
+	glFinish();
+	double ms = (now_ms() - start) / loops;
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, image);
+
+	glDeleteProgram(program);
+	glDeleteBuffers(1, &vbo);
+	*steps_out = steps;
+	return ms;
+}
+
+//the cells of each class, with the ONLY_* variants if masked
+static void draw_cells(const GLuint program[COVERAGE_CLASS_NUM],
+		const GLuint vbo[COVERAGE_CLASS_NUM],
+		const int num_vertices[COVERAGE_CLASS_NUM], bool masked) {
+	for (int c = 0; c < COVERAGE_CLASS_NUM; c++) {
+		if (num_vertices[c] == 0) {
+			continue;
+		}
+		GLuint p = masked ? program[c] : program[COVERAGE_FULL];
+		glUseProgram(p);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo[c]);
+		GLuint loc = glGetAttribLocation(p, "vPosition");
+		glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 0, 0);
+		glEnableVertexAttribArray(loc);
+		glDrawArrays(GL_TRIANGLES, 0, num_vertices[c]);
+	}
+}
+
+/**
+ * The coverage_mask of picam360-capture: the frame cut into the cells of
+ * coverage_mask.h, drawn with the plain shaders and then with the cells
+ * that only show one camera, the logo or black drawn by the ONLY_*
+ * variants. Window frames are cut from the patch window_mesh() makes.
+ * Returns the time per frame masked, in full_ms unmasked, in cheap the
+ * fraction of the frame the variants take and in black that of the black
+ * cells, the masked frame in image and the unmasked one in full_image.
+ */
+static double draw_masked(enum MODE mode, const char *defines,
+		int num_of_cam, int cam_width, float sharpness_gain,
+		GLuint framebuffer, int width, int height, int loops,
+		unsigned char *image, unsigned char *full_image, double *full_ms,
+		double *cheap, double *black) {
+	static const char *only[COVERAGE_CLASS_NUM] = { "",
+			"#define ONLY_CAM0\n", "#define ONLY_CAM1\n",
+			"#define ONLY_LOGO\n", "#define ONLY_BLACK\n" };
+	float m[16];
+	view_matrix(m, 0.5);
+	//as coverage_cameras() of picam360-capture
+	COVERAGE_CAMERA_T cameras[2];
+	for (int i = 0; i < 2; i++) {
+		cameras[i].offset_yaw = lg_cam[i].offset_yaw;
+		cameras[i].offset_x = lg_cam[i].offset_x;
+		cameras[i].offset_y = lg_cam[i].offset_y;
+		cameras[i].horizon_r = lg_cam[i].horizon_r;
+	}
+	COVERAGE_MASK_T mask;
+	char mesh_defines[128];
+	strcpy(mesh_defines, defines);
+	if (mode == MODE_EQUIRECTANGULAR) {
+		coverage_mask_board(&mask, CPU_REMAP_EQUIRECTANGULAR, num_of_cam,
+				cameras, m, width, height);
+	} else {
+		float tan_x, tan_y;
+		window_mesh_extent(120, (float) width / height, &tan_x, &tan_y);
+		float horizon_r = fmaxf(lg_cam[0].horizon_r,
+				(num_of_cam > 1) ? lg_cam[1].horizon_r : 0);
+		int steps = window_mesh_steps(num_of_cam, tan_x, tan_y,
+				MESH_MAX_ERROR / (horizon_r * cam_width));
+		if (steps > 0) {
+			strcat(mesh_defines, "#define VERTEX_UV\n");
+		} else {
+			steps = WINDOW_MESH_MAX_STEPS;
+		}
+		coverage_mask_window(&mask, num_of_cam,
+				(num_of_cam > 1) ? cameras : NULL, m, tan_x, tan_y, steps,
+				width, height);
+	}
+	*cheap = 1 - mask.area[COVERAGE_FULL];
+	*black = mask.area[COVERAGE_BLACK];
+
+	char vert[64], frag[64];
+	sprintf(vert, "%s.vert", lg_mode_name[mode]);
+	sprintf(frag, "%s.frag", lg_mode_name[mode]);
+	GLuint program[COVERAGE_CLASS_NUM] = { };
+	GLuint vbo[COVERAGE_CLASS_NUM] = { };
+	for (int c = 0; c < COVERAGE_CLASS_NUM; c++) {
+		if (c != COVERAGE_FULL && mask.num_vertices[c] == 0) {
+			continue;
+		}
+		char class_defines[160];
+		sprintf(class_defines, "%s%s", mesh_defines, only[c]);
+		program[c] = load_program(vert, frag, class_defines);
+		glUseProgram(program[c]);
+		set_uniforms(program[c], num_of_cam, cam_width,
+				(float) width / height, sharpness_gain);
+		glGenBuffers(1, &vbo[c]);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo[c]);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 4 * mask.num_vertices[c],
+				mask.vertices[c], GL_STATIC_DRAW);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+
+	double ms[2];
+	for (int k = 0; k < 2; k++) {
+		draw_cells(program, vbo, mask.num_vertices, k == 1);
+		glFinish();
+		double start = now_ms();
+		for (int l = 0; l < loops; l++) {
+			draw_cells(program, vbo, mask.num_vertices, k == 1);
+		}
+		glFinish();
+		ms[k] = (now_ms() - start) / loops;
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+				(k == 1) ? image : full_image);
+	}
+
+	for (int c = 0; c < COVERAGE_CLASS_NUM; c++) {
+		if (program[c]) {
+			glDeleteProgram(program[c]);
+			glDeleteBuffers(1, &vbo[c]);
+		}
+	}
+	coverage_mask_free(&mask);
+	*full_ms = ms[0];
+	return ms[1];
+}
+
+/**
+ * The sharpen_pass of picam360-capture: each camera sharpened and graded
+ * once by sharpen.frag into a texture of its own. Returns the time per
+ * camera and in cpu_diff how far the first is from sharpen_image() and
+ * color_lut_apply().
+ */
+static double sharpen_cameras(const unsigned char *cam_pixels[2],
+		GLuint cam_texture[2], int cam_width, float sharpness_gain,
+		const unsigned char *color_lut, int loops, GLuint sharpened[2],
+		double *cpu_diff) {
+	GLuint program = load_program("board.vert", "sharpen.frag",
+			"#define SHARPEN\n#define COLOR_LUT\n");
+	glUseProgram(program);
+	static float quad[] = { 0, 0, 1, 1, 1, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1 };
+	GLuint vbo;
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+	GLuint loc = glGetAttribLocation(program, "vPosition");
+	glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(loc);
+	glUniform1i(glGetUniformLocation(program, "cam_texture"), 0);
+	glUniform1i(glGetUniformLocation(program, "gain_texture"), 1);
+	glUniform1i(glGetUniformLocation(program, "color_lut_texture"),
+			COLOR_LUT_TEXTURE_UNIT);
+	glUniform1f(glGetUniformLocation(program, "pixel_size"), 1.0 / cam_width);
+	glUniform1f(glGetUniformLocation(program, "sharpness_gain"),
+			sharpness_gain);
+
+	unsigned char *map[2];
+	GLuint gain_texture[2], framebuffer[2];
+	for (int i = 0; i < 2; i++) {
+		map[i] = malloc(SHARPEN_GAIN_MAP_SIZE * SHARPEN_GAIN_MAP_SIZE);
+		sharpen_gain_map(lg_cam[i].offset_x, lg_cam[i].offset_y,
+				lg_cam[i].horizon_r, map[i]);
+		glGenTextures(1, &gain_texture[i]);
+		glBindTexture(GL_TEXTURE_2D, gain_texture[i]);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, SHARPEN_GAIN_MAP_SIZE,
+				SHARPEN_GAIN_MAP_SIZE, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE,
+				map[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		sharpened[i] = create_texture(cam_width, cam_width, GL_NEAREST, NULL);
+		glGenFramebuffers(1, &framebuffer[i]);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+				GL_TEXTURE_2D, sharpened[i], 0);
+	}
+	glViewport(0, 0, cam_width, cam_width);
+	double start = 0;
+	for (int l = -1; l < loops; l++) { //first draw compiles on some drivers
+		if (l == 0) {
+			glFinish();
+			start = now_ms();
+		}
+		for (int i = 0; i < 2; i++) {
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer[i]);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, cam_texture[i]);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, gain_texture[i]);
+			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+		}
+	}
+	glFinish();
+	double ms = (now_ms() - start) / loops / 2;
+
+	unsigned char *gpu = malloc(cam_width * cam_width * 4);
+	unsigned char *cpu = malloc(cam_width * cam_width * 4);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer[0]);
+	glReadPixels(0, 0, cam_width, cam_width, GL_RGBA, GL_UNSIGNED_BYTE, gpu);
+	sharpen_image(cam_pixels[0], cam_width, cam_width, cam_width * 4, map[0],
+			sharpness_gain, 1.0 / cam_width, cpu, cam_width * 4);
+	color_lut_apply(color_lut, cpu, cam_width, cam_width, cam_width * 4);
+	double off;
+	*cpu_diff = compare(gpu, cpu, cam_width * cam_width, &off);
+
+	free(gpu);
+	free(cpu);
+	for (int i = 0; i < 2; i++) {
+		free(map[i]);
+		glDeleteTextures(1, &gain_texture[i]);
+		glDeleteFramebuffers(1, &framebuffer[i]);
+	}
+	glDeleteBuffers(1, &vbo);
+	glDeleteProgram(program);
+	glActiveTexture(GL_TEXTURE0);
+	return ms;
+}
+
+/**
+ * The frame drawn with the plain shaders from the cameras sharpen_cameras()
+ * sharpened, without SHARPEN. Returns the time per frame, leaves
+ * framebuffer bound.
+ */
+static double draw_sharpened(enum MODE mode, int num_of_cam, int cam_width,
+		float sharpness_gain, GLuint sharpened[2], GLuint cam_texture[2],
+		GLuint framebuffer, int width, int height, int loops,
+		unsigned char *image) {
+	char frag[64], vert[64];
+	sprintf(frag, "%s.frag", lg_mode_name[mode]);
+	sprintf(vert, "%s.vert", lg_mode_name[mode]);
+	GLuint program = load_program(vert, frag,
+			(num_of_cam == 1) ? "#define CHROMA\n" : "#define TWO_CAMERAS\n");
+	glUseProgram(program);
+	set_uniforms(program, num_of_cam, cam_width, (float) width / height,
+			sharpness_gain);
+	int n, strips;
+	GLuint vbo = mesh(mode, &n, &strips);
+	GLuint loc = glGetAttribLocation(program, "vPosition");
+	glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(loc);
+	for (int i = 0; i < num_of_cam; i++) {
+		glActiveTexture(GL_TEXTURE1 + i);
+		glBindTexture(GL_TEXTURE_2D, sharpened[i]);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+
+	draw(n, strips);
+	glFinish();
+	double start = now_ms();
+	for (int l = 0; l < loops; l++) {
+		draw(n, strips);
+	}
+	glFinish();
+	double ms = (now_ms() - start) / loops;
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, image);
+
+	for (int i = 0; i < num_of_cam; i++) {
+		glActiveTexture(GL_TEXTURE1 + i);
+		glBindTexture(GL_TEXTURE_2D, cam_texture[i]);
+	}
+	glActiveTexture(GL_TEXTURE0);
+	glDeleteBuffers(1, &vbo);
+	glDeleteProgram(program);
+	return ms;
+}
+
+/**
+ * Reading the frame in framebuffer back as RGBA against having i420.frag
+ * pack it first, and how far the shader is from i420_from_rgb().
+ */
+static void bench_i420(GLuint frame_texture, GLuint framebuffer, int width,
+		int height, int loops) {
+	if (!i420_supported(width, height)) {
+		printf("i420 : %dx%d frames can not be packed\n", width, height);
+		return;
+	}
+	int target_width = width / 4;
+	int target_height = height * 3 / 2;
+	GLuint target_texture = create_texture(target_width, target_height,
+			GL_NEAREST, NULL);
+	GLuint target;
+	glGenFramebuffers(1, &target);
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+			target_texture, 0);
+
+	GLuint program = load_program("board.vert", "i420.frag", "");
+	glUseProgram(program);
+	int n, strips;
+	GLuint vbo = mesh(MODE_EQUIRECTANGULAR, &n, &strips);
+	GLuint loc = glGetAttribLocation(program, "vPosition");
+	glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(loc);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, frame_texture);
+	//as the fbo textures of the frames
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glUniform1i(glGetUniformLocation(program, "tex"), 0);
+	glUniform2f(glGetUniformLocation(program, "frame_size"), width, height);
+
+	int size = I420_SIZE(width, height);
+	unsigned char *rgb = malloc(width * height * 4);
+	unsigned char *gpu = malloc(size);
+	unsigned char *cpu = malloc(size);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFinish();
+	double start = now_ms();
+	for (int l = 0; l < loops; l++) {
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgb);
+	}
+	double rgb_ms = (now_ms() - start) / loops;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+	glViewport(0, 0, target_width, target_height);
+	start = now_ms();
+	for (int l = 0; l < loops; l++) {
+		draw(n, strips);
+		glReadPixels(0, 0, target_width, target_height, GL_RGBA,
+				GL_UNSIGNED_BYTE, gpu);
+	}
+	double i420_ms = (now_ms() - start) / loops;
+
+	start = now_ms();
+	i420_from_rgb(rgb, width, height, width * 4, 4, cpu);
+	double cpu_ms = now_ms() - start;
+
+	double diff_sum = 0;
+	int max_diff = 0;
+	for (int i = 0; i < size; i++) {
+		int d = abs(gpu[i] - cpu[i]);
+		diff_sum += d;
+		max_diff = (d > max_diff) ? d : max_diff;
+	}
+	printf(
+			"i420 : rgba readback %.2fms %d bytes, packed %.2fms %d bytes, cpu %.2fms, mean diff %.3f, max %d\n",
+			rgb_ms, width * height * 4, i420_ms, size, cpu_ms,
+			diff_sum / size, max_diff);
+
+	free(rgb);
+	free(gpu);
+	free(cpu);
+	glDeleteBuffers(1, &vbo);
+	glDeleteProgram(program);
+	glDeleteFramebuffers(1, &target);
+	glDeleteTextures(1, &target_texture);
+	glViewport(0, 0, width, height);
+}
+
+/**
+ * num_views window frames of VIEW_SIZE as picam360-capture draws the
+ * frames of start_view, each into its own fbo with the program set up
+ * again and read back on its own, against drawn into a view atlas with
+ * one setup, read back in one glReadPixels() and copied out per view.
+ * Both are waited for, the overlap the atlas ring gives is not counted.
+ */
+static void bench_views(int num_views, GLuint logo_texture, GLuint cam_texture,
+		int cam_width, float sharpness_gain, int loops) {
+	GLint max_texture_size, max_renderbuffer_size, max_viewport_dims[2];
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+	glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_renderbuffer_size);
+	glGetIntegerv(GL_MAX_VIEWPORT_DIMS, max_viewport_dims);
+	int max_size = max_texture_size;
+	max_size = (max_renderbuffer_size < max_size) ?
+			max_renderbuffer_size : max_size;
+	max_size = (max_viewport_dims[0] < max_size) ?
+			max_viewport_dims[0] : max_size;
+	max_size = (max_viewport_dims[1] < max_size) ?
+			max_viewport_dims[1] : max_size;
+
+	VIEW_ATLAS_CELL_T cells[VIEW_ATLAS_MAX_VIEWS];
+	if (num_views > VIEW_ATLAS_MAX_VIEWS) {
+		num_views = VIEW_ATLAS_MAX_VIEWS;
+	}
+	for (int i = 0; i < num_views; i++) {
+		cells[i].width = VIEW_SIZE;
+		cells[i].height = VIEW_SIZE;
+	}
+	int width, height;
+	int placed = view_atlas_layout(cells, num_views, max_size, &width,
+			&height);
+	if (placed < num_views) {
+		printf("views : %d of %d fit in %dx%d\n", placed, num_views,
+				max_size, max_size);
+		num_views = placed;
+	}
+
+	GLuint view_texture[VIEW_ATLAS_MAX_VIEWS + 1];
+	GLuint view_framebuffer[VIEW_ATLAS_MAX_VIEWS + 1];
+	for (int i = 0; i <= num_views; i++) { //the last is the atlas
+		glGenTextures(1, &view_texture[i]);
+		glBindTexture(GL_TEXTURE_2D, view_texture[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB,
+				(i < num_views) ? VIEW_SIZE : width,
+				(i < num_views) ? VIEW_SIZE : height, 0, GL_RGB,
+				GL_UNSIGNED_BYTE, NULL);
+		glGenFramebuffers(1, &view_framebuffer[i]);
+		glBindFramebuffer(GL_FRAMEBUFFER, view_framebuffer[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+				GL_TEXTURE_2D, view_texture[i], 0);
+	}
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, logo_texture);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, cam_texture);
+
+	int n, strips;
+	GLuint vbo = mesh(MODE_WINDOW, &n, &strips);
+	GLuint program = load_program("window.vert", "window.frag",
+			(sharpness_gain != 0) ?
+					"#define CHROMA\n#define SHARPEN\n" : "#define CHROMA\n");
+	int view_bytes = VIEW_SIZE * VIEW_SIZE * 3;
+	unsigned char *image[2] = { malloc(view_bytes * num_views), malloc(
+			view_bytes * num_views) };
+	unsigned char *atlas_image = malloc(width * height * 3);
+	float m[16];
+
+	glFinish();
+	double start = now_ms();
+	for (int l = 0; l < loops; l++) {
+		for (int i = 0; i < num_views; i++) {
+			glBindFramebuffer(GL_FRAMEBUFFER, view_framebuffer[i]);
+			glViewport(0, 0, VIEW_SIZE, VIEW_SIZE);
+			glUseProgram(program);
+			set_uniforms(program, 1, cam_width, 1.0, sharpness_gain);
+			view_matrix(m, i * 2 * M_PI / num_views);
+			glUniformMatrix4fv(glGetUniformLocation(program, "unif_matrix"),
+					1, GL_FALSE, m);
+			GLuint loc = glGetAttribLocation(program, "vPosition");
+			glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 0, 0);
+			glEnableVertexAttribArray(loc);
+			draw(n, strips);
+			glReadPixels(0, 0, VIEW_SIZE, VIEW_SIZE, GL_RGB, GL_UNSIGNED_BYTE,
+					image[0] + i * view_bytes);
+		}
+	}
+	double single_ms = (now_ms() - start) / loops;
+
+	start = now_ms();
+	for (int l = 0; l < loops; l++) {
+		glBindFramebuffer(GL_FRAMEBUFFER, view_framebuffer[num_views]);
+		glUseProgram(program);
+		set_uniforms(program, 1, cam_width, 1.0, sharpness_gain);
+		GLint matrix_loc = glGetUniformLocation(program, "unif_matrix");
+		GLuint loc = glGetAttribLocation(program, "vPosition");
+		glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 0, 0);
+		glEnableVertexAttribArray(loc);
+		for (int i = 0; i < num_views; i++) {
+			glViewport(cells[i].x, cells[i].y, VIEW_SIZE, VIEW_SIZE);
+			view_matrix(m, i * 2 * M_PI / num_views);
+			glUniformMatrix4fv(matrix_loc, 1, GL_FALSE, m);
+			draw(n, strips);
+		}
+		glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE,
+				atlas_image);
+		for (int i = 0; i < num_views; i++) {
+			view_atlas_copy(atlas_image, width, &cells[i],
+					image[1] + i * view_bytes);
+		}
+	}
+	double atlas_ms = (now_ms() - start) / loops;
+
+	int diff_bytes = 0;
+	for (int i = 0; i < view_bytes * num_views; i++) {
+		diff_bytes += (image[0][i] != image[1][i]);
+	}
+	printf(
+			"views : %d of %dx%d, one by one %.2fms %.1f views/s, atlas %dx%d %.2fms %.1f views/s, %d bytes differ\n",
+			num_views, VIEW_SIZE, VIEW_SIZE, single_ms,
+			num_views * 1000.0 / single_ms, width, height, atlas_ms,
+			num_views * 1000.0 / atlas_ms, diff_bytes);
+
+	free(image[0]);
+	free(image[1]);
+	free(atlas_image);
+	glDeleteProgram(program);
+	glDeleteBuffers(1, &vbo);
+	for (int i = 0; i <= num_views; i++) {
+		glDeleteFramebuffers(1, &view_framebuffer[i]);
+		glDeleteTextures(1, &view_texture[i]);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	int width = 1024;
+	int height = 512;
+	int cam_width = 2048;
+	int loops = 10;
+	float sharpness_gain = 0;
+	int num_views = 8;
+	const char *color_lut_file = NULL;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "w:h:c:n:g:v:l:H:")) != -1) {
+		switch (opt) {
+		case 'w':
+			sscanf(optarg, "%d", &width);
+			break;
+		case 'h':
+			sscanf(optarg, "%d", &height);
+			break;
+		case 'c':
+			sscanf(optarg, "%d", &cam_width);
+			break;
+		case 'n':
+			sscanf(optarg, "%d", &loops);
+			break;
+		case 'g':
+			sscanf(optarg, "%f", &sharpness_gain);
+			break;
+		case 'v':
+			sscanf(optarg, "%d", &num_views);
+			break;
+		case 'l':
+			color_lut_file = optarg;
+			break;
+		case 'H':
+			sscanf(optarg, "%f", &lg_cam[0].horizon_r);
+			lg_cam[1].horizon_r = lg_cam[0].horizon_r;
+			break;
+		default:
+			printf(
+					"usage: %s [-w frame_width] [-h frame_height] [-c cam_width] [-n loops] [-g sharpness_gain] [-v num_views] [-l color_lut.cube] [-H horizon_r]\n",
+					argv[0]);
+			return -1;
+		}
+	}
+
+#ifdef HAVE_BCM_HOST
+	bcm_host_init();
+#endif
+	static const EGLint config_attribs[] = { EGL_RED_SIZE, 8, EGL_GREEN_SIZE,
+			8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8, EGL_SURFACE_TYPE,
+			EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT, EGL_NONE };
+	static const EGLint context_attribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2,
+			EGL_NONE };
+	static const EGLint pbuffer_attribs[] = { EGL_WIDTH, 16, EGL_HEIGHT, 16,
+			EGL_NONE };
+	EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLConfig config;
+	EGLint num_config;
+	if (!eglInitialize(display, NULL, NULL)
+			|| !eglChooseConfig(display, config_attribs, &config, 1,
+					&num_config) || num_config < 1) {
+		printf("no egl pbuffer config\n");
+		return -1;
+	}
+	eglBindAPI(EGL_OPENGL_ES_API);
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT,
+			context_attribs);
+	EGLSurface surface = eglCreatePbufferSurface(display, config,
+			pbuffer_attribs);
+	if (context == EGL_NO_CONTEXT || surface == EGL_NO_SURFACE
+			|| !eglMakeCurrent(display, surface, surface, context)) {
+		printf("can not make an egl context current\n");
+		return -1;
+	}
+	printf("%s, %dx%d frames, %dx%d cameras\n", glGetString(GL_RENDERER),
+			width, height, cam_width, cam_width);
+
+	unsigned char *logo_pixels = camera_image(256, 1);
+	unsigned char *cam_pixels[2] = { camera_image(cam_width, 0), camera_image(
+			cam_width, 1) };
+	GLuint logo_texture = create_texture(256, 256, GL_LINEAR, logo_pixels);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	GLuint cam_texture[2];
+	for (int i = 0; i < 2; i++) {
+		cam_texture[i] = create_texture(cam_width, cam_width, GL_NEAREST,
+				cam_pixels[i]);
+	}
+	GLuint lut_texture[2];
+	unsigned char *lut = malloc(PROJECTION_LUT_WIDTH * PROJECTION_LUT_ROWS * 4);
+	for (int i = 0; i < 2; i++) {
+		double start = now_ms();
+		projection_lut_build(i + 1, lut);
+		printf("lut for %d cam built in %.2fms\n", i + 1, now_ms() - start);
+		lut_texture[i] = create_texture(PROJECTION_LUT_WIDTH,
+				PROJECTION_LUT_ROWS, GL_NEAREST, lut);
+	}
+	free(lut);
+	unsigned char *color_lut = color_lut_file ?
+			color_lut_load_cube(color_lut_file) :
+			color_lut_offset(COLOR_LUT_OFFSET);
+	if (color_lut == NULL) {
+		return -1;
+	}
+	glActiveTexture(GL_TEXTURE0 + COLOR_LUT_TEXTURE_UNIT);
+	GLuint color_lut_texture = create_texture(COLOR_LUT_WIDTH,
+			COLOR_LUT_WIDTH, GL_LINEAR, color_lut);
+	glActiveTexture(GL_TEXTURE0);
+
+	GLuint frame_texture, framebuffer;
+	glGenTextures(1, &frame_texture);
+	glBindTexture(GL_TEXTURE_2D, frame_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+			GL_UNSIGNED_BYTE, NULL);
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+			frame_texture, 0);
+	glViewport(0, 0, width, height);
+
+	unsigned char *image[4] = { malloc(width * height * 4), malloc(
+			width * height * 4), malloc(width * height * 4), malloc(
+			width * height * 4) };
+	CPU_REMAP_T *remap = cpu_remap_create(sysconf(_SC_NPROCESSORS_ONLN) - 1);
+	CPU_REMAP_PARAMS_T params = { };
+	cpu_image(&params.cam[0], cam_pixels[0], cam_width);
+	cpu_image(&params.cam[1], cam_pixels[1], cam_width);
+	cpu_image(&params.logo, logo_pixels, 256);
+	memcpy(params.cam_options, lg_cam, sizeof(lg_cam));
+	params.filter = CPU_REMAP_NEAREST;
+	params.sharpness_gain = sharpness_gain;
+	params.color_lut = color_lut;
+	params.fov = 120;
+	view_matrix(params.unif_matrix, 0.5);
+	GLuint sharpened[2];
+	if (sharpness_gain != 0) {
+		double sharpen_diff;
+		double sharpen_ms = sharpen_cameras(
+				(const unsigned char**) cam_pixels, cam_texture, cam_width,
+				sharpness_gain, color_lut, loops, sharpened, &sharpen_diff);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glViewport(0, 0, width, height);
+		printf("sharpen pass : %.2fms per camera, cpu mean diff %.3f\n",
+				sharpen_ms, sharpen_diff);
+	}
+	for (int mode = 0; mode < MODE_NUM; mode++) {
+		int n, strips;
+		GLuint vbo = mesh(mode, &n, &strips);
+		for (int num_of_cam = 1; num_of_cam <= 2; num_of_cam++) {
+			char frag[2][64];
+			sprintf(frag[0], "%s.frag", lg_mode_name[mode]);
+			sprintf(frag[1], "%s_lut.frag", lg_mode_name[mode]);
+			char vert[64];
+			sprintf(vert, "%s.vert", lg_mode_name[mode]);
+			char defines[64];
+			sprintf(defines, "#define %s\n#define COLOR_LUT\n%s",
+					(num_of_cam == 1) ? "CHROMA" : "TWO_CAMERAS",
+					(sharpness_gain != 0) ? "#define SHARPEN\n" : "");
+
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, logo_texture);
+			for (int i = 0; i < num_of_cam; i++) {
+				glActiveTexture(GL_TEXTURE1 + i);
+				glBindTexture(GL_TEXTURE_2D, cam_texture[i]);
+			}
+			glActiveTexture(GL_TEXTURE3);
+			glBindTexture(GL_TEXTURE_2D, lut_texture[num_of_cam - 1]);
+
+			double ms[2];
+			for (int k = 0; k < 2; k++) {
+				GLuint program = load_program(vert, frag[k], defines);
+				glUseProgram(program);
+				set_uniforms(program, num_of_cam, cam_width,
+						(float) width / height, sharpness_gain);
+				GLuint loc = glGetAttribLocation(program, "vPosition");
+				glBindBuffer(GL_ARRAY_BUFFER, vbo);
+				glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 0, 0);
+				glEnableVertexAttribArray(loc);
+
+				//first draw compiles on some drivers
+				draw(n, strips);
+				glFinish();
+				double start = now_ms();
+				for (int l = 0; l < loops; l++) {
+					draw(n, strips);
+				}
+				glFinish();
+				ms[k] = (now_ms() - start) / loops;
+				glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+						image[k]);
+				glDeleteProgram(program);
+			}
+
+			params.mode = (mode == MODE_EQUIRECTANGULAR) ?
+					CPU_REMAP_EQUIRECTANGULAR : CPU_REMAP_WINDOW;
+			params.num_of_cam = num_of_cam;
+			double start = now_ms();
+			cpu_remap(remap, &params, image[2], width, height, width * 4);
+			double cpu_ms = now_ms() - start;
+
+			//nearest sampling flips texels where the two differ slightly
+			double off[2];
+			double diff = compare(image[0], image[1], width * height, &off[0]);
+			double cpu_diff = compare(image[0], image[2], width * height,
+					&off[1]);
+			printf(
+					"%s %d cam : %.2fms, lut %.2fms x%.2f, mean diff %.3f, %.2f%% pixels off by more than 8\n",
+					lg_mode_name[mode], num_of_cam, ms[0], ms[1], ms[0] / ms[1],
+					diff, off[0]);
+			printf(
+					"%s %d cam : cpu %.2fms, mean diff %.3f, %.2f%% pixels off by more than 8\n",
+					lg_mode_name[mode], num_of_cam, cpu_ms, cpu_diff, off[1]);
+
+			double stitch_ms;
+			double stitched_ms = draw_stitched(mode, defines, num_of_cam,
+					cam_width, sharpness_gain, framebuffer, width, height,
+					loops, image[3], &stitch_ms);
+			double stitched_diff = compare(image[0], image[3], width * height,
+					&off[1]);
+			printf(
+					"%s %d cam : stitched %.2fms after %.2fms once, mean diff %.3f, %.2f%% pixels off by more than 8\n",
+					lg_mode_name[mode], num_of_cam, stitched_ms, stitch_ms,
+					stitched_diff, off[1]);
+
+			if (sharpness_gain != 0) {
+				double sharpened_ms = draw_sharpened(mode, num_of_cam,
+						cam_width, sharpness_gain, sharpened, cam_texture,
+						framebuffer, width, height, loops, image[3]);
+				double sharpened_diff = compare(image[0], image[3],
+						width * height, &off[1]);
+				printf(
+						"%s %d cam : sharpen pass %.2fms, mean diff %.3f, %.2f%% pixels off by more than 8\n",
+						lg_mode_name[mode], num_of_cam, sharpened_ms,
+						sharpened_diff, off[1]);
+			}
+
+			if (mode == MODE_WINDOW) {
+				int steps;
+				bool vertex_uv;
+				double mesh_ms = draw_window_mesh(defines, num_of_cam,
+						cam_width, sharpness_gain, width, height, loops,
+						image[3], &steps, &vertex_uv);
+				double mesh_diff = compare(image[0], image[3],
+						width * height, &off[1]);
+				printf(
+						"%s %d cam : mesh of %d steps %s %.2fms, mean diff %.3f, %.2f%% pixels off by more than 8\n",
+						lg_mode_name[mode], num_of_cam, steps,
+						vertex_uv ? "per vertex" : "per fragment", mesh_ms,
+						mesh_diff, off[1]);
+			}
+
+			{
+				double full_ms, cheap, black;
+				double masked_ms = draw_masked(mode, defines, num_of_cam,
+						cam_width, sharpness_gain, framebuffer, width, height,
+						loops, image[3], image[1], &full_ms, &cheap, &black);
+				double masked_diff = compare(image[1], image[3],
+						width * height, &off[1]);
+				printf(
+						"%s %d cam : masked %.2fms, cells unmasked %.2fms x%.2f, %.1f%% of fragments cheap (%.1f%% black), mean diff %.3f, %.2f%% pixels off by more than 8\n",
+						lg_mode_name[mode], num_of_cam, masked_ms, full_ms,
+						full_ms / masked_ms, 100 * cheap, 100 * black,
+						masked_diff, off[1]);
+			}
+		}
+		glDeleteBuffers(1, &vbo);
+	}
+	bench_i420(frame_texture, framebuffer, width, height, loops);
+	bench_views(num_views, logo_texture, cam_texture[0], cam_width,
+			sharpness_gain, loops);
+
+	cpu_remap_delete(remap);
+	glDeleteTextures(1, &color_lut_texture);
+	free(color_lut);
+	for (int i = 0; i < 4; i++) {
+		free(image[i]);
+	}
+	free(cam_pixels[0]);
+	free(cam_pixels[1]);
+	free(logo_pixels);
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroySurface(display, surface);
+	eglDestroyContext(display, context);
+	eglTerminate(display);
+	return 0;
+}
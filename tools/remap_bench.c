@@ -0,0 +1,156 @@
+/**
+ * Throughput of the cpu remapper.
+ * Draws every projection of cpu_remap.h from synthetic cameras on 1 to
+ * max_threads cores (the caller counts as one) with nearest and bilinear
+ * sampling and reports megapixels per second, in total and per core.
+ *
+ * usage: remap_bench [-w frame_width] [-h frame_height] [-c cam_width]
+ *                    [-t max_threads] [-n loops] [-g sharpness_gain]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "cpu_remap.h"
+#include "color_lut.h"
+
+static double now_ms() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+//smooth gradients with a grid every 64 texels, different per camera
+static void camera_image(CPU_REMAP_IMAGE_T *img, int width, int id) {
+	unsigned char *pixels = malloc(width * width * 4);
+	for (int y = 0; y < width; y++) {
+		for (int x = 0; x < width; x++) {
+			unsigned char *p = pixels + (y * width + x) * 4;
+			bool grid = (x % 64 == 0 || y % 64 == 0);
+			p[0] = grid ? 255 : x * 255 / width;
+			p[1] = grid ? 255 : y * 255 / width;
+			p[2] = grid ? 255 : (id ? 64 : 192);
+			p[3] = 255;
+		}
+	}
+	img->pixels = pixels;
+	img->width = width;
+	img->height = width;
+	img->stride = width * 4;
+}
+
+int main(int argc, char *argv[]) {
+	int width = 2048;
+	int height = 1024;
+	int cam_width = 2048;
+	int max_threads = 4;
+	int loops = 3;
+	float sharpness_gain = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "w:h:c:t:n:g:")) != -1) {
+		switch (opt) {
+		case 'w':
+			sscanf(optarg, "%d", &width);
+			break;
+		case 'h':
+			sscanf(optarg, "%d", &height);
+			break;
+		case 'c':
+			sscanf(optarg, "%d", &cam_width);
+			break;
+		case 't':
+			sscanf(optarg, "%d", &max_threads);
+			break;
+		case 'n':
+			sscanf(optarg, "%d", &loops);
+			break;
+		case 'g':
+			sscanf(optarg, "%f", &sharpness_gain);
+			break;
+		default:
+			printf(
+					"usage: %s [-w frame_width] [-h frame_height] [-c cam_width] [-t max_threads] [-n loops] [-g sharpness_gain]\n",
+					argv[0]);
+			return -1;
+		}
+	}
+	if (max_threads < 1) {
+		max_threads = 1;
+	}
+	if (max_threads > CPU_REMAP_MAX_THREADS + 1) {
+		max_threads = CPU_REMAP_MAX_THREADS + 1;
+	}
+
+	CPU_REMAP_PARAMS_T params = { };
+	camera_image(&params.cam[0], cam_width, 0);
+	camera_image(&params.cam[1], cam_width, 1);
+	camera_image(&params.logo, 256, 1);
+	CPU_REMAP_CAMERA_T cam_options[2] = { { 0.1, 0.01, -0.02, 0.8 }, { -0.2,
+			-0.015, 0.01, 0.78 } };
+	memcpy(params.cam_options, cam_options, sizeof(cam_options));
+	params.sharpness_gain = sharpness_gain;
+	params.fov = 120;
+	//a tilted view
+	float a = 0.3, b = 0.5;
+	float m[16] = { cos(b), 0, -sin(b), 0, sin(a) * sin(b), cos(a), sin(a)
+			* cos(b), 0, cos(a) * sin(b), -sin(a), cos(a) * cos(b), 0, 0, 0,
+			0, 1 };
+	memcpy(params.unif_matrix, m, sizeof(m));
+
+	//one camera is graded as picam360-capture does by default
+	unsigned char *color_lut = color_lut_offset(COLOR_LUT_OFFSET);
+
+	unsigned char *dst = malloc(width * height * 4);
+	CPU_REMAP_T *remap[CPU_REMAP_MAX_THREADS + 1];
+	for (int t = 0; t < max_threads; t++) {
+		remap[t] = cpu_remap_create(t);
+	}
+	printf("%dx%d frames, %dx%d cameras\n", width, height, cam_width,
+			cam_width);
+
+	const struct {
+		const char *name;
+		enum CPU_REMAP_MODE mode;
+		int num_of_cam;
+	} modes[] = { { "board", CPU_REMAP_BOARD, 1 }, { "fisheye",
+			CPU_REMAP_FISHEYE, 1 }, { "window", CPU_REMAP_WINDOW, 1 }, {
+			"window", CPU_REMAP_WINDOW, 2 }, { "equirectangular",
+			CPU_REMAP_EQUIRECTANGULAR, 1 }, { "equirectangular",
+			CPU_REMAP_EQUIRECTANGULAR, 2 }, { "cubemap", CPU_REMAP_CUBEMAP, 1 },
+			{ "eac", CPU_REMAP_EAC, 1 } };
+	const char *filter_name[2] = { "nearest", "bilinear" };
+	for (int i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+		for (int filter = 0; filter < 2; filter++) {
+			params.mode = modes[i].mode;
+			params.num_of_cam = modes[i].num_of_cam;
+			params.color_lut = (params.num_of_cam == 1) ? color_lut : NULL;
+			params.filter = filter;
+			printf("%s %d cam %s :", modes[i].name, modes[i].num_of_cam,
+					filter_name[filter]);
+			for (int t = 0; t < max_threads; t++) {
+				cpu_remap(remap[t], &params, dst, width, height, width * 4);
+				double start = now_ms();
+				for (int l = 0; l < loops; l++) {
+					cpu_remap(remap[t], &params, dst, width, height, width * 4);
+				}
+				double mpps = (double) width * height * loops
+						/ ((now_ms() - start) * 1000);
+				printf(" %d cores %.1f MP/s (%.1f per core)", t + 1, mpps,
+						mpps / (t + 1));
+			}
+			printf("\n");
+		}
+	}
+
+	for (int t = 0; t < max_threads; t++) {
+		cpu_remap_delete(remap[t]);
+	}
+	free(dst);
+	free(color_lut);
+	return 0;
+}
@@ -0,0 +1,345 @@
+/**
+ * Replays recordings to the capture binary's UDP receiver.
+ *
+ *   udp_sender [-a addr] [-p port] [-M] [-c MJPEG|H264] [-f fps]
+ *              [-m packet_size] [-d drop_percent] [-l] file0 [file1 ...]
+ *
+ * MJPEG files are raw recordings (container or legacy) and are paced by
+ * their timestamps, H.264 files are Annex-B streams paced at -f fps.
+ * Stream i goes to port + i, or to port with SSRC i when -M is given.
+ * -d drops packets at random to exercise loss handling.
+ * A single "-" sends a live stream from stdin, frames as they are found,
+ *   raspivid -cd MJPEG -o - | udp_sender -a host -
+ *   raspivid -ih -o - | udp_sender -a host -c H264 -
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "raw_container.h"
+#include "mjpeg_ring.h"
+#include "h264_parser.h"
+#include "udp_receiver.h"
+
+#define MAX_STREAMS 4
+
+typedef struct {
+	uint64_t offset;
+	uint32_t size;
+} ACCESS_UNIT_T;
+
+typedef struct {
+	struct sockaddr_in addr;
+	RAW_READER_T *reader; //MJPEG
+	unsigned char *map; //H264
+	size_t map_size;
+	ACCESS_UNIT_T *units;
+	int frame_num;
+	int frame;
+	uint16_t seq;
+	uint32_t timestamp; //90kHz of time 0
+	uint64_t sent_packets;
+	uint64_t dropped_packets;
+} STREAM_T;
+
+static uint64_t now_usec() {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (uint64_t) now.tv_sec * 1000000 + now.tv_usec;
+}
+
+static int next_start_code(const unsigned char *p, int pos, int len) {
+	for (; pos + 3 <= len; pos++) {
+		if (p[pos] == 0 && p[pos + 1] == 0 && p[pos + 2] == 1) {
+			return pos;
+		}
+	}
+	return len;
+}
+
+//split an Annex-B stream at access unit boundaries
+static int split_access_units(STREAM_T *stream) {
+	const unsigned char *p = stream->map;
+	int len = stream->map_size;
+	int size = 0;
+	int au_start = 0;
+	bool has_slice = false;
+	int pos = next_start_code(p, 0, len);
+
+	while (pos < len) {
+		int nal = pos + 3;
+		int type = (nal < len) ? p[nal] & 0x1f : 0;
+		//include a leading zero of a 4 byte start code
+		int start = (pos > 0 && p[pos - 1] == 0) ? pos - 1 : pos;
+		bool first_slice = (type == 1 || type == 5) && nal + 1 < len
+				&& (p[nal + 1] & 0x80); //first_mb_in_slice == 0
+		if (has_slice && (first_slice || type == 6 || type == 7 || type == 8
+				|| type == 9)) {
+			if (stream->frame_num == size) {
+				size = (size == 0) ? 1024 : size * 2;
+				stream->units = realloc(stream->units,
+						size * sizeof(ACCESS_UNIT_T));
+			}
+			stream->units[stream->frame_num].offset = au_start;
+			stream->units[stream->frame_num].size = start - au_start;
+			stream->frame_num++;
+			au_start = start;
+			has_slice = false;
+		}
+		if (type == 1 || type == 5) {
+			has_slice = true;
+		}
+		pos = next_start_code(p, nal, len);
+	}
+	if (has_slice) {
+		stream->units = realloc(stream->units,
+				(stream->frame_num + 1) * sizeof(ACCESS_UNIT_T));
+		stream->units[stream->frame_num].offset = au_start;
+		stream->units[stream->frame_num].size = len - au_start;
+		stream->frame_num++;
+	}
+	return stream->frame_num;
+}
+
+static void send_frame(int fd, STREAM_T *stream, uint32_t ssrc,
+		const unsigned char *data, uint32_t size, uint64_t usec,
+		int packet_size, int drop_percent) {
+	unsigned char packet[UDP_MAX_PACKET];
+	int payload_size = packet_size - UDP_HEADER_SIZE;
+	UDP_PACKET_HEADER_T header = { };
+
+	header.ssrc = ssrc;
+	header.timestamp = stream->timestamp + (uint32_t) (usec * 9 / 100); //90kHz
+	header.size = size;
+	for (uint32_t offset = 0; offset < size; offset += payload_size) {
+		int len = (size - offset < payload_size) ? size - offset : payload_size;
+		header.seq = stream->seq++;
+		header.offset = offset;
+		header.marker = (offset + len == size);
+		if (drop_percent > 0 && rand() % 100 < drop_percent) {
+			stream->dropped_packets++;
+			continue;
+		}
+		int header_size = udp_packet_write_header(packet, &header);
+		memcpy(packet + header_size, data + offset, len);
+		sendto(fd, packet, header_size + len, 0,
+				(struct sockaddr*) &stream->addr, sizeof(stream->addr));
+		stream->sent_packets++;
+	}
+}
+
+int main(int argc, char *argv[]) {
+	const char *addr = "127.0.0.1";
+	int port = 9000;
+	bool multiplex = false;
+	bool h264 = false;
+	bool loop = false;
+	int fps = 30;
+	int packet_size = UDP_DEFAULT_PACKET;
+	int drop_percent = 0;
+	STREAM_T streams[MAX_STREAMS];
+	int num = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "a:p:Mc:f:m:d:l")) != -1) {
+		switch (opt) {
+		case 'a':
+			addr = optarg;
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'M':
+			multiplex = true;
+			break;
+		case 'c':
+			h264 = (strcmp(optarg, "H264") == 0);
+			break;
+		case 'f':
+			fps = atoi(optarg);
+			break;
+		case 'm':
+			packet_size = atoi(optarg);
+			break;
+		case 'd':
+			drop_percent = atoi(optarg);
+			break;
+		case 'l':
+			loop = true;
+			break;
+		default:
+			printf("Usage: %s [-a addr] [-p port] [-M] [-c MJPEG|H264] "
+					"[-f fps] [-m packet_size] [-d drop_percent] [-l] "
+					"file0 [file1 ...]\n", argv[0]);
+			return -1;
+		}
+	}
+	if (packet_size <= UDP_HEADER_SIZE || packet_size > UDP_MAX_PACKET) {
+		packet_size = UDP_DEFAULT_PACKET;
+	}
+	if (fps <= 0) {
+		fps = 30;
+	}
+
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	int sndbuf = 4 * 1024 * 1024;
+	setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+	uint64_t start = now_usec();
+
+	//a restarted sender must not pick up where the last one left off, the
+	//receiver would take its packets for late ones, as RFC 3550 asks
+	srand(time(NULL) ^ getpid());
+	memset(streams, 0, sizeof(streams));
+	for (int i = 0; i < MAX_STREAMS; i++) {
+		streams[i].seq = rand();
+		streams[i].timestamp = rand();
+	}
+	if (optind == argc - 1 && strcmp(argv[optind], "-") == 0) {
+		STREAM_T *stream = &streams[0];
+		MJPEG_RING_T *ring = NULL;
+		IMAGE_POOL_T *pool = NULL;
+		H264_PARSER_T *parser = NULL;
+		IMAGE_DATA *image_data;
+		stream->addr.sin_family = AF_INET;
+		stream->addr.sin_addr.s_addr = inet_addr(addr);
+		stream->addr.sin_port = htons(port);
+		if (h264) {
+			pool = image_pool_create("stdin pool", 0);
+			parser = h264_parser_create(pool);
+		} else {
+			ring = mjpeg_ring_create(MJPEG_RING_DEFAULT_SIZE);
+		}
+		while ((h264 ? h264_parser_fill(parser, STDIN_FILENO) :
+				mjpeg_ring_fill(ring, STDIN_FILENO)) > 0) {
+			while ((image_data = (h264 ? h264_parser_get_frame(parser) :
+					mjpeg_ring_get_frame(ring))) != NULL) {
+				send_frame(fd, stream, 0, image_data->image_buff,
+						image_data->image_size, now_usec() - start,
+						packet_size, drop_percent);
+				release_image(image_data);
+			}
+		}
+		if (h264) { //the last access unit ends with the stream
+			h264_parser_flush(parser);
+			while ((image_data = h264_parser_get_frame(parser)) != NULL) {
+				send_frame(fd, stream, 0, image_data->image_buff,
+						image_data->image_size, now_usec() - start,
+						packet_size, drop_percent);
+				release_image(image_data);
+			}
+			h264_parser_delete(parser);
+			image_pool_delete(pool);
+		} else {
+			mjpeg_ring_delete(ring);
+		}
+		close(fd);
+		return 0;
+	}
+	for (int i = optind; i < argc && num < MAX_STREAMS; i++, num++) {
+		STREAM_T *stream = &streams[num];
+		stream->addr.sin_family = AF_INET;
+		stream->addr.sin_addr.s_addr = inet_addr(addr);
+		stream->addr.sin_port = htons(multiplex ? port : port + num);
+		if (h264) {
+			struct stat st;
+			int fd = open(argv[i], O_RDONLY);
+			if (fd < 0 || fstat(fd, &st) != 0) {
+				printf("failed to open %s\n", argv[i]);
+				return -1;
+			}
+			stream->map_size = st.st_size;
+			stream->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			close(fd);
+			if (stream->map == MAP_FAILED) {
+				printf("failed to map %s\n", argv[i]);
+				return -1;
+			}
+			split_access_units(stream);
+		} else {
+			stream->reader = raw_reader_open(argv[i]);
+			if (stream->reader == NULL) {
+				printf("failed to open %s\n", argv[i]);
+				return -1;
+			}
+			stream->frame_num = raw_reader_get_frame_num(stream->reader);
+		}
+		printf("stream %d : %s, %d frames -> %s:%d\n", num, argv[i],
+				stream->frame_num, addr, ntohs(stream->addr.sin_port));
+	}
+	if (num == 0) {
+		printf("no input file\n");
+		return -1;
+	}
+
+	start = now_usec();
+	uint64_t loop_offset = 0; //added to file times in the current loop
+	while (1) {
+		//send the stream whose next frame is due first
+		int next = -1;
+		uint64_t next_time = 0;
+		for (int i = 0; i < num; i++) {
+			STREAM_T *stream = &streams[i];
+			if (stream->frame >= stream->frame_num) {
+				continue;
+			}
+			uint64_t time = h264 ?
+					(uint64_t) stream->frame * 1000000 / fps :
+					raw_reader_get_time(stream->reader, stream->frame);
+			if (next < 0 || time < next_time) {
+				next = i;
+				next_time = time;
+			}
+		}
+		if (next < 0) {
+			if (!loop) {
+				break;
+			}
+			for (int i = 0; i < num; i++) {
+				streams[i].frame = 0;
+			}
+			loop_offset = now_usec() - start + 1000000 / fps;
+			continue;
+		}
+		next_time += loop_offset;
+		uint64_t elapsed = now_usec() - start;
+		if (next_time > elapsed) {
+			usleep(next_time - elapsed);
+		}
+
+		STREAM_T *stream = &streams[next];
+		if (h264) {
+			ACCESS_UNIT_T *unit = &stream->units[stream->frame];
+			send_frame(fd, stream, next, stream->map + unit->offset,
+					unit->size, next_time, packet_size, drop_percent);
+		} else {
+			IMAGE_DATA *image_data = raw_reader_get_frame(stream->reader,
+					stream->frame);
+			if (image_data != NULL) {
+				send_frame(fd, stream, next, image_data->image_buff,
+						image_data->image_size, next_time, packet_size,
+						drop_percent);
+				release_image(image_data);
+			}
+		}
+		stream->frame++;
+	}
+
+	for (int i = 0; i < num; i++) {
+		printf("stream %d : %llu packets sent, %llu dropped\n", i,
+				(unsigned long long) streams[i].sent_packets,
+				(unsigned long long) streams[i].dropped_packets);
+		raw_reader_close(streams[i].reader);
+	}
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,563 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE //recvmmsg
+#endif
+#include "udp_receiver.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+#define UDP_RECEIVER_BATCH 16 //datagrams per recvmmsg
+#define UDP_RECEIVER_RCVBUF (4 * 1024 * 1024)
+#define UDP_RECEIVER_WAKEUP 5000 //usec, to time out incomplete frames
+//a sequence jump this large means the sender restarted
+#define UDP_RECEIVER_RESYNC_GAP 3000
+//so does a timestamp going back this far (90kHz) or late packets of this
+//many frames in a row, a restarted sender may start near where the last one
+//left off
+#define UDP_RECEIVER_RESYNC_TIME (2 * 90000)
+#define UDP_RECEIVER_RESYNC_LATE 8
+
+typedef struct {
+	bool used;
+	bool failed; //no buffer, packets are discarded
+	IMAGE_DATA *image_data;
+	uint32_t timestamp;
+	uint32_t size;
+	uint32_t received; //bytes of distinct fragments
+	uint32_t fragment; //payload size of all but the last, 0 until known
+	bool tail; //the last fragment arrived
+	uint32_t fragments[UDP_RECEIVER_MAX_FRAGMENTS / 32]; //arrived, by offset
+	uint64_t first_usec;
+	uint64_t last_usec;
+} UDP_FRAME_SLOT_T;
+
+typedef struct {
+	bool active;
+	int stream_id;
+	enum UDP_PAYLOAD payload;
+	IMAGE_POOL_T *pool;
+	UDP_RECEIVER_CALLBACK callback;
+	void *user;
+
+	//loss accounting as in RFC 3550 appendix A.1
+	bool started;
+	uint16_t max_seq;
+	uint32_t cycles;
+	uint32_t base_seq;
+	uint64_t received;
+
+	bool emitted; //last_timestamp is valid
+	uint32_t last_timestamp; //of the last emitted or dropped frame
+	int late_run; //frames of the late packets in a row
+	uint32_t late_timestamp; //of the last late packet
+	bool need_keyframe;
+	UDP_FRAME_SLOT_T slots[UDP_RECEIVER_SLOTS];
+
+	bool jitter_valid;
+	uint64_t last_arrival;
+	uint32_t last_rtp;
+	double reorder; //usec, decaying maximum lateness of reordered frames
+
+	UDP_RECEIVER_STATS_T stats;
+} UDP_STREAM_T;
+
+struct _UDP_RECEIVER_T {
+	char name[32];
+	int fd;
+	bool run;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	UDP_STREAM_T streams[UDP_RECEIVER_MAX_STREAMS];
+	unsigned char *buff;
+};
+
+static uint64_t now_usec() {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (uint64_t) now.tv_sec * 1000000 + now.tv_usec;
+}
+
+static void put_be16(unsigned char *p, uint16_t v) {
+	p[0] = v >> 8;
+	p[1] = v;
+}
+
+static void put_be32(unsigned char *p, uint32_t v) {
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static uint32_t get_be32(const unsigned char *p) {
+	return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+int udp_packet_write_header(unsigned char *p, const UDP_PACKET_HEADER_T *header) {
+	p[0] = 0x80; //version 2
+	p[1] = (header->marker ? 0x80 : 0) | UDP_PAYLOAD_TYPE;
+	put_be16(p + 2, header->seq);
+	put_be32(p + 4, header->timestamp);
+	put_be32(p + 8, header->ssrc);
+	put_be32(p + 12, header->offset);
+	put_be32(p + 16, header->size);
+	return UDP_HEADER_SIZE;
+}
+
+int udp_packet_parse_header(const unsigned char *p, int len,
+		UDP_PACKET_HEADER_T *header) {
+	if (len < UDP_HEADER_SIZE || p[0] != 0x80
+			|| (p[1] & 0x7f) != UDP_PAYLOAD_TYPE) {
+		return -1;
+	}
+	header->marker = (p[1] & 0x80) != 0;
+	header->seq = (p[2] << 8) | p[3];
+	header->timestamp = get_be32(p + 4);
+	header->ssrc = get_be32(p + 8);
+	header->offset = get_be32(p + 12);
+	header->size = get_be32(p + 16);
+	return UDP_HEADER_SIZE;
+}
+
+//an access unit with an IDR slice or SPS is a point to restart decoding
+static bool is_h264_keyframe(const unsigned char *p, int len) {
+	for (int i = 0; i + 3 < len; i++) {
+		if (p[i] == 0 && p[i + 1] == 0 && p[i + 2] == 1) {
+			int type = p[i + 3] & 0x1f;
+			if (type == 5 || type == 7) {
+				return true;
+			}
+			i += 2;
+		}
+	}
+	return false;
+}
+
+static uint64_t stream_delay(UDP_STREAM_T *stream) {
+	double delay = MAX(stream->stats.jitter * 3, stream->reorder * 1.5);
+	return MIN(MAX((uint64_t) delay, UDP_RECEIVER_MIN_DELAY),
+			UDP_RECEIVER_MAX_DELAY);
+}
+
+static void slot_free(UDP_FRAME_SLOT_T *slot) {
+	release_image(slot->image_data);
+	memset(slot, 0, sizeof(UDP_FRAME_SLOT_T));
+}
+
+static void stream_reset(UDP_STREAM_T *stream) {
+	for (int i = 0; i < UDP_RECEIVER_SLOTS; i++) {
+		slot_free(&stream->slots[i]);
+	}
+	stream->started = false;
+	stream->emitted = false;
+	stream->jitter_valid = false;
+	stream->late_run = 0;
+	stream->need_keyframe = (stream->payload == UDP_PAYLOAD_H264);
+}
+
+static UDP_FRAME_SLOT_T *stream_oldest(UDP_STREAM_T *stream) {
+	UDP_FRAME_SLOT_T *oldest = NULL;
+	for (int i = 0; i < UDP_RECEIVER_SLOTS; i++) {
+		UDP_FRAME_SLOT_T *slot = &stream->slots[i];
+		if (slot->used && (oldest == NULL
+				|| (int32_t) (slot->timestamp - oldest->timestamp) < 0)) {
+			oldest = slot;
+		}
+	}
+	return oldest;
+}
+
+static void stream_emit(UDP_STREAM_T *stream, UDP_FRAME_SLOT_T *slot) {
+	IMAGE_DATA *image_data = slot->image_data;
+	stream->emitted = true;
+	stream->last_timestamp = slot->timestamp;
+	stream->reorder *= 0.95;
+
+	if (stream->need_keyframe
+			&& !is_h264_keyframe(image_data->image_buff, slot->size)) {
+		stream->stats.skipped_frames++;
+	} else {
+		stream->need_keyframe = false;
+		image_data->image_size = slot->size;
+		image_data->timestamp = slot->first_usec;
+		stream->stats.frames++;
+		stream->callback(stream->user, image_data);
+	}
+	slot_free(slot);
+}
+
+static void stream_drop(UDP_STREAM_T *stream, UDP_FRAME_SLOT_T *slot) {
+	stream->emitted = true;
+	stream->last_timestamp = slot->timestamp;
+	stream->stats.dropped_frames++;
+	if (stream->payload == UDP_PAYLOAD_H264) {
+		stream->need_keyframe = true; //references are broken
+	}
+	slot_free(slot);
+}
+
+/**
+ * Frames leave in timestamp order. A complete frame waits only for older
+ * incomplete ones, and those are given up once nothing arrived for them
+ * within the jitter buffer delay (or right away when force is set and no
+ * slot is free).
+ */
+static void stream_flush(UDP_STREAM_T *stream, uint64_t now, bool force) {
+	UDP_FRAME_SLOT_T *slot;
+	stream->stats.delay = stream_delay(stream);
+	while ((slot = stream_oldest(stream)) != NULL) {
+		if (!slot->failed && slot->received >= slot->size) {
+			stream_emit(stream, slot);
+		} else if (force || now - slot->last_usec > stream->stats.delay) {
+			stream_drop(stream, slot);
+			force = false;
+		} else {
+			break;
+		}
+	}
+}
+
+static void stream_track_seq(UDP_STREAM_T *stream, uint16_t seq) {
+	if (stream->started) {
+		int16_t delta = (int16_t) (seq - stream->max_seq);
+		if (abs(delta) > UDP_RECEIVER_RESYNC_GAP) {
+			stream->stats.resyncs++;
+			stream_reset(stream);
+		} else if (delta > 0) {
+			if (seq < stream->max_seq) {
+				stream->cycles += 65536;
+			}
+			stream->max_seq = seq;
+		}
+	}
+	if (!stream->started) {
+		stream->started = true;
+		stream->max_seq = seq;
+		stream->cycles = 0;
+		stream->base_seq = seq;
+		stream->received = 0;
+	}
+	stream->received++;
+}
+
+/**
+ * Marks the fragment at offset as arrived, false if it did before or does
+ * not fit the fragments seen so far. Duplicates must not count towards
+ * received, or a frame with holes would pass for complete.
+ */
+static bool slot_mark(UDP_FRAME_SLOT_T *slot, uint32_t offset, int len) {
+	if (offset + len == slot->size) {
+		if (slot->tail || (slot->fragment && offset % slot->fragment)) {
+			return false;
+		}
+		slot->tail = true;
+		return true;
+	}
+	if (slot->fragment == 0) {
+		if (len <= 0 || (slot->size + len - 1) / len
+				> UDP_RECEIVER_MAX_FRAGMENTS) {
+			return false;
+		}
+		slot->fragment = len;
+	}
+	uint32_t i = offset / slot->fragment;
+	uint32_t bit = 1u << (i % 32);
+	if (len != slot->fragment || offset % slot->fragment
+			|| (slot->fragments[i / 32] & bit)) {
+		return false;
+	}
+	slot->fragments[i / 32] |= bit;
+	return true;
+}
+
+static void stream_packet(UDP_STREAM_T *stream, UDP_PACKET_HEADER_T *header,
+		const unsigned char *payload, int len, uint64_t now) {
+	UDP_FRAME_SLOT_T *slot = NULL;
+	uint64_t newer_usec = 0;
+
+	stream_track_seq(stream, header->seq);
+	stream->stats.packets++;
+	stream->stats.bytes += len;
+
+	if (stream->emitted
+			&& (int32_t) (header->timestamp - stream->last_timestamp) <= 0) {
+		int32_t behind = stream->last_timestamp - header->timestamp;
+		if (stream->late_run == 0
+				|| header->timestamp != stream->late_timestamp) {
+			stream->late_run++;
+			stream->late_timestamp = header->timestamp;
+		}
+		if (behind <= UDP_RECEIVER_RESYNC_TIME
+				&& stream->late_run < UDP_RECEIVER_RESYNC_LATE) {
+			stream->stats.late_packets++;
+			return;
+		}
+		//the sender restarted, this packet starts the stream again
+		stream->stats.resyncs++;
+		stream_reset(stream);
+		stream_track_seq(stream, header->seq);
+	}
+	stream->late_run = 0;
+	for (int i = 0; i < UDP_RECEIVER_SLOTS; i++) {
+		UDP_FRAME_SLOT_T *s = &stream->slots[i];
+		if (!s->used) {
+			continue;
+		}
+		if (s->timestamp == header->timestamp) {
+			slot = s;
+		} else if ((int32_t) (s->timestamp - header->timestamp) > 0
+				&& (newer_usec == 0 || s->first_usec < newer_usec)) {
+			newer_usec = s->first_usec;
+		}
+	}
+	if (newer_usec != 0) { //a newer frame started before this packet came
+		stream->reorder = MAX(stream->reorder, (double) (now - newer_usec));
+	}
+	if (slot == NULL) {
+		if (stream->jitter_valid) {
+			double d = (double) (now - stream->last_arrival)
+					- (int32_t) (header->timestamp - stream->last_rtp) * 100.0
+							/ 9;
+			stream->stats.jitter += ((d < 0 ? -d : d) - stream->stats.jitter)
+					/ 16;
+		}
+		stream->jitter_valid = true;
+		stream->last_arrival = now;
+		stream->last_rtp = header->timestamp;
+
+		for (int i = 0; i < UDP_RECEIVER_SLOTS && slot == NULL; i++) {
+			if (!stream->slots[i].used) {
+				slot = &stream->slots[i];
+			}
+		}
+		if (slot == NULL) {
+			stream_flush(stream, now, true);
+			for (int i = 0; i < UDP_RECEIVER_SLOTS && slot == NULL; i++) {
+				if (!stream->slots[i].used) {
+					slot = &stream->slots[i];
+				}
+			}
+		}
+		slot->used = true;
+		slot->timestamp = header->timestamp;
+		slot->size = header->size;
+		slot->first_usec = now;
+		slot->last_usec = now;
+		if (header->size == 0 || header->size > UDP_RECEIVER_MAX_FRAME) {
+			slot->failed = true; //dropped once its time runs out
+			return;
+		}
+		slot->image_data = (stream->pool != NULL) ?
+				image_pool_alloc(stream->pool, header->size) :
+				create_image(header->size);
+		if (slot->image_data == NULL) {
+			stream->stats.pool_failures++;
+			slot->failed = true;
+		}
+	}
+	if (slot->failed || header->size != slot->size
+			|| (uint64_t) header->offset + len > slot->size
+			|| !slot_mark(slot, header->offset, len)) {
+		return;
+	}
+	memcpy(slot->image_data->image_buff + header->offset, payload, len);
+	slot->received += len;
+	slot->last_usec = now;
+}
+
+static UDP_STREAM_T *find_stream(UDP_RECEIVER_T *receiver, uint32_t ssrc) {
+	UDP_STREAM_T *any = NULL;
+	for (int i = 0; i < UDP_RECEIVER_MAX_STREAMS; i++) {
+		UDP_STREAM_T *stream = &receiver->streams[i];
+		if (!stream->active) {
+			continue;
+		}
+		if (stream->stream_id == (int) ssrc) {
+			return stream;
+		}
+		if (stream->stream_id == UDP_STREAM_ANY) {
+			any = stream;
+		}
+	}
+	return any;
+}
+
+static void *udp_receiver_thread(void *arg) {
+	UDP_RECEIVER_T *receiver = (UDP_RECEIVER_T*) arg;
+	struct mmsghdr msgs[UDP_RECEIVER_BATCH];
+	struct iovec iovecs[UDP_RECEIVER_BATCH];
+
+	memset(msgs, 0, sizeof(msgs));
+	for (int i = 0; i < UDP_RECEIVER_BATCH; i++) {
+		iovecs[i].iov_base = receiver->buff + i * UDP_MAX_PACKET;
+		iovecs[i].iov_len = UDP_MAX_PACKET;
+		msgs[i].msg_hdr.msg_iov = &iovecs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	while (receiver->run) {
+		//returns what is queued without waiting for a full batch
+		int num = recvmmsg(receiver->fd, msgs, UDP_RECEIVER_BATCH,
+				MSG_WAITFORONE, NULL);
+		uint64_t now = now_usec();
+
+		pthread_mutex_lock(&receiver->mutex);
+		for (int i = 0; i < num; i++) {
+			UDP_PACKET_HEADER_T header;
+			const unsigned char *p = iovecs[i].iov_base;
+			int len = msgs[i].msg_len;
+			int header_size = udp_packet_parse_header(p, len, &header);
+			if (header_size < 0) {
+				continue;
+			}
+			UDP_STREAM_T *stream = find_stream(receiver, header.ssrc);
+			if (stream != NULL) {
+				stream_packet(stream, &header, p + header_size,
+						len - header_size, now);
+			}
+		}
+		for (int i = 0; i < UDP_RECEIVER_MAX_STREAMS; i++) {
+			if (receiver->streams[i].active) {
+				stream_flush(&receiver->streams[i], now, false);
+			}
+		}
+		pthread_mutex_unlock(&receiver->mutex);
+	}
+	return NULL;
+}
+
+UDP_RECEIVER_T *udp_receiver_create(const char *name, int port) {
+	UDP_RECEIVER_T *receiver;
+	struct sockaddr_in addr = { };
+	struct timeval timeout = { 0, UDP_RECEIVER_WAKEUP };
+	int rcvbuf = UDP_RECEIVER_RCVBUF;
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		return NULL;
+	}
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+		printf("%s : failed to bind port %d\n", name, port);
+		close(fd);
+		return NULL;
+	}
+	//a few frames of slack, the kernel may clamp it to rmem_max
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	receiver = malloc(sizeof(UDP_RECEIVER_T));
+	memset(receiver, 0, sizeof(UDP_RECEIVER_T));
+	strncpy(receiver->name, name, sizeof(receiver->name) - 1);
+	receiver->fd = fd;
+	receiver->buff = malloc(UDP_RECEIVER_BATCH * UDP_MAX_PACKET);
+	pthread_mutex_init(&receiver->mutex, NULL);
+	receiver->run = true;
+	pthread_create(&receiver->thread, NULL, udp_receiver_thread, receiver);
+	printf("%s : listening on port %d\n", name, port);
+	return receiver;
+}
+
+void udp_receiver_delete(UDP_RECEIVER_T *receiver) {
+	if (receiver == NULL) {
+		return;
+	}
+	receiver->run = false;
+	pthread_join(receiver->thread, NULL);
+	for (int i = 0; i < UDP_RECEIVER_MAX_STREAMS; i++) {
+		stream_reset(&receiver->streams[i]);
+	}
+	close(receiver->fd);
+	pthread_mutex_destroy(&receiver->mutex);
+	free(receiver->buff);
+	free(receiver);
+}
+
+int udp_receiver_add_stream(UDP_RECEIVER_T *receiver, int stream_id,
+		enum UDP_PAYLOAD payload, IMAGE_POOL_T *pool,
+		UDP_RECEIVER_CALLBACK callback, void *user) {
+	int ret = -1;
+	pthread_mutex_lock(&receiver->mutex);
+	for (int i = 0; i < UDP_RECEIVER_MAX_STREAMS; i++) {
+		UDP_STREAM_T *stream = &receiver->streams[i];
+		if (!stream->active) {
+			memset(stream, 0, sizeof(UDP_STREAM_T));
+			stream->stream_id = stream_id;
+			stream->payload = payload;
+			stream->pool = pool;
+			stream->callback = callback;
+			stream->user = user;
+			stream->need_keyframe = (payload == UDP_PAYLOAD_H264);
+			stream->active = true;
+			ret = 0;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&receiver->mutex);
+	return ret;
+}
+
+void udp_receiver_remove_stream(UDP_RECEIVER_T *receiver, int stream_id) {
+	pthread_mutex_lock(&receiver->mutex);
+	for (int i = 0; i < UDP_RECEIVER_MAX_STREAMS; i++) {
+		UDP_STREAM_T *stream = &receiver->streams[i];
+		if (stream->active && stream->stream_id == stream_id) {
+			stream_reset(stream);
+			stream->active = false;
+		}
+	}
+	pthread_mutex_unlock(&receiver->mutex);
+}
+
+int udp_receiver_get_stats(UDP_RECEIVER_T *receiver, int stream_id,
+		UDP_RECEIVER_STATS_T *stats) {
+	int ret = -1;
+	pthread_mutex_lock(&receiver->mutex);
+	for (int i = 0; i < UDP_RECEIVER_MAX_STREAMS; i++) {
+		UDP_STREAM_T *stream = &receiver->streams[i];
+		if (stream->active && stream->stream_id == stream_id) {
+			int64_t expected = (int64_t) stream->cycles + stream->max_seq
+					- stream->base_seq + 1;
+			*stats = stream->stats;
+			stats->lost_packets = stream->started ?
+					MAX(expected - (int64_t ) stream->received, 0) : 0;
+			ret = 0;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&receiver->mutex);
+	return ret;
+}
+
+void udp_receiver_print_stats(UDP_RECEIVER_T *receiver) {
+	for (int i = 0; i < UDP_RECEIVER_MAX_STREAMS; i++) {
+		UDP_RECEIVER_STATS_T stats;
+		int stream_id = receiver->streams[i].stream_id;
+		if (!receiver->streams[i].active
+				|| udp_receiver_get_stats(receiver, stream_id, &stats) != 0) {
+			continue;
+		}
+		printf("%s stream %d : frames %llu, packets %llu, lost %llu, "
+				"late %llu, resyncs %llu\n", receiver->name, stream_id,
+				(unsigned long long) stats.frames,
+				(unsigned long long) stats.packets,
+				(unsigned long long) stats.lost_packets,
+				(unsigned long long) stats.late_packets,
+				(unsigned long long) stats.resyncs);
+		printf("%s stream %d : dropped %llu, skipped %llu, "
+				"pool failures %llu, jitter %.2fms, delay %.2fms\n",
+				receiver->name, stream_id,
+				(unsigned long long) stats.dropped_frames,
+				(unsigned long long) stats.skipped_frames,
+				(unsigned long long) stats.pool_failures, stats.jitter / 1000,
+				stats.delay / 1000.0);
+	}
+}
@@ -0,0 +1,96 @@
+#ifndef _UDP_RECEIVER_H
+#define _UDP_RECEIVER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "image_data.h"
+#include "image_pool.h"
+
+/**
+ * Packet layout, network byte order:
+ *   RTP header (RFC 3550, 12 bytes, no CSRC/extension)
+ *     marker bit on the last packet of a frame, payload type 96,
+ *     timestamp 90kHz per frame, SSRC = stream id
+ *   fragment header (8 bytes)
+ *     uint32 offset of this payload in the frame, uint32 frame size
+ *   payload
+ * A frame is a complete JPEG or an H.264 access unit in Annex-B format.
+ * All fragments of a frame but the last carry the same payload size.
+ */
+#define UDP_RTP_HEADER_SIZE 12
+#define UDP_FRAG_HEADER_SIZE 8
+#define UDP_HEADER_SIZE (UDP_RTP_HEADER_SIZE + UDP_FRAG_HEADER_SIZE)
+#define UDP_PAYLOAD_TYPE 96
+#define UDP_MAX_PACKET 65536
+#define UDP_DEFAULT_PACKET 1400 //fits an ethernet MTU with IP/UDP headers
+
+#define UDP_STREAM_ANY -1
+#define UDP_RECEIVER_MAX_STREAMS 4
+#define UDP_RECEIVER_SLOTS 4 //frames in reassembly per stream
+#define UDP_RECEIVER_MAX_FRAME (8 * 1024 * 1024) //larger frames are discarded
+#define UDP_RECEIVER_MAX_FRAGMENTS 8192 //per frame, 11MB of 1400 byte packets
+//bounds of the adaptive jitter buffer delay
+#define UDP_RECEIVER_MIN_DELAY 2000 //usec
+#define UDP_RECEIVER_MAX_DELAY 50000 //usec
+
+enum UDP_PAYLOAD {
+	UDP_PAYLOAD_MJPEG, UDP_PAYLOAD_H264
+};
+
+typedef struct {
+	uint32_t ssrc;
+	uint16_t seq;
+	uint32_t timestamp;
+	bool marker;
+	uint32_t offset;
+	uint32_t size;
+} UDP_PACKET_HEADER_T;
+
+typedef struct {
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t frames;
+	uint64_t lost_packets;
+	uint64_t late_packets; //for frames already emitted or dropped
+	uint64_t dropped_frames; //incomplete when their time ran out
+	uint64_t skipped_frames; //h264 frames dropped while waiting for a keyframe
+	uint64_t pool_failures;
+	uint64_t resyncs; //sender restarted or jumped
+	double jitter; //usec, RFC 3550 estimator
+	uint64_t delay; //usec, current jitter buffer delay
+} UDP_RECEIVER_STATS_T;
+
+/* called on the receiver thread, the callback takes its own reference */
+typedef void (*UDP_RECEIVER_CALLBACK)(void *user, IMAGE_DATA *image_data);
+
+typedef struct _UDP_RECEIVER_T UDP_RECEIVER_T;
+
+/* binds port and starts the receiver thread */
+UDP_RECEIVER_T *udp_receiver_create(const char *name, int port);
+
+void udp_receiver_delete(UDP_RECEIVER_T *receiver);
+
+/**
+ * Frames of stream_id (UDP_STREAM_ANY for every SSRC) are reassembled into
+ * buffers from pool (heap if NULL) and passed to callback in order.
+ */
+int udp_receiver_add_stream(UDP_RECEIVER_T *receiver, int stream_id,
+		enum UDP_PAYLOAD payload, IMAGE_POOL_T *pool,
+		UDP_RECEIVER_CALLBACK callback, void *user);
+
+/* no more callbacks for stream_id once this returns */
+void udp_receiver_remove_stream(UDP_RECEIVER_T *receiver, int stream_id);
+
+int udp_receiver_get_stats(UDP_RECEIVER_T *receiver, int stream_id,
+		UDP_RECEIVER_STATS_T *stats);
+
+void udp_receiver_print_stats(UDP_RECEIVER_T *receiver);
+
+/* returns the header size */
+int udp_packet_write_header(unsigned char *p, const UDP_PACKET_HEADER_T *header);
+
+/* returns the header size or -1 if this is not a packet of ours */
+int udp_packet_parse_header(const unsigned char *p, int len,
+		UDP_PACKET_HEADER_T *header);
+
+#endif
@@ -31,15 +31,29 @@
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
+#include <unistd.h>
 
 #include "bcm_host.h"
 #include "ilclient.h"
+#include "picam360_capture.h"
+#include "input_source.h"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
 
 static OMX_BUFFERHEADERTYPE* eglBuffer[2] = { };
 static COMPONENT_T* egl_render[2] = { };
 
 static void* eglImage[2] = { };
 
+static void set_timestamp(OMX_BUFFERHEADERTYPE *buf, uint64_t usec) {
+#ifdef OMX_SKIP64BIT
+	buf->nTimeStamp.nLowPart = (OMX_U32) usec;
+	buf->nTimeStamp.nHighPart = (OMX_U32) (usec >> 32);
+#else
+	buf->nTimeStamp = usec;
+#endif
+}
+
 static void my_fill_buffer_done(void* data, COMPONENT_T* comp) {
 	int index = (int) data;
 
@@ -54,8 +68,12 @@ static void my_fill_buffer_done(void* data, COMPONENT_T* comp) {
 void *video_decode_test(void* arg) {
 	int index;
 
+	PICAM360CAPTURE_T *state;
+	INPUT_SOURCE_T *source;
+
 	index = (int)((void**) arg)[0];
 	eglImage[index] = ((void**) arg)[1];
+	state = (PICAM360CAPTURE_T *) ((void**) arg)[2];
 
 	if (eglImage[index] == 0) {
 		printf("eglImage is null.\n");
@@ -102,39 +120,45 @@ void *video_decode_test(void* arg) {
 		status = -14;
 	list[1] = egl_render[index];
 
-	// create clock
-	if (status == 0
-			&& ilclient_create_component(client, &clock, "clock",
-					ILCLIENT_DISABLE_ALL_PORTS) != 0)
-		status = -14;
-	list[2] = clock;
-
-	memset(&cstate, 0, sizeof(cstate));
-	cstate.nSize = sizeof(cstate);
-	cstate.nVersion.nVersion = OMX_VERSION;
-	cstate.eState = OMX_TIME_ClockStateWaitingForStartTime;
-	cstate.nWaitMask = 1;
-	if (clock != NULL
-			&& OMX_SetParameter(ILC_GET_HANDLE(clock),
-					OMX_IndexConfigTimeClockState, &cstate) != OMX_ErrorNone)
-		status = -13;
-
-	// create video_scheduler
-	if (status == 0
-			&& ilclient_create_component(client, &video_scheduler,
-					"video_scheduler", ILCLIENT_DISABLE_ALL_PORTS) != 0)
-		status = -14;
-	list[3] = video_scheduler;
-
-	set_tunnel(tunnel, video_decode, 131, video_scheduler, 10);
-	set_tunnel(tunnel + 1, video_scheduler, 11, egl_render[index], 220);
-	set_tunnel(tunnel + 2, clock, 80, video_scheduler, 12);
-
-	// setup clock tunnel first
-	if (status == 0 && ilclient_setup_tunnel(tunnel + 2, 0, 0) != 0)
-		status = -15;
-	else
-		ilclient_change_component_state(clock, OMX_StateExecuting);
+	if (state->h264_low_latency) {
+		//frames go to the texture as soon as they are decoded
+		set_tunnel(tunnel, video_decode, 131, egl_render[index], 220);
+	} else {
+		// create clock
+		if (status == 0
+				&& ilclient_create_component(client, &clock, "clock",
+						ILCLIENT_DISABLE_ALL_PORTS) != 0)
+			status = -14;
+		list[2] = clock;
+
+		memset(&cstate, 0, sizeof(cstate));
+		cstate.nSize = sizeof(cstate);
+		cstate.nVersion.nVersion = OMX_VERSION;
+		cstate.eState = OMX_TIME_ClockStateWaitingForStartTime;
+		cstate.nWaitMask = 1;
+		if (clock != NULL
+				&& OMX_SetParameter(ILC_GET_HANDLE(clock),
+						OMX_IndexConfigTimeClockState, &cstate)
+						!= OMX_ErrorNone)
+			status = -13;
+
+		// create video_scheduler
+		if (status == 0
+				&& ilclient_create_component(client, &video_scheduler,
+						"video_scheduler", ILCLIENT_DISABLE_ALL_PORTS) != 0)
+			status = -14;
+		list[3] = video_scheduler;
+
+		set_tunnel(tunnel, video_decode, 131, video_scheduler, 10);
+		set_tunnel(tunnel + 1, video_scheduler, 11, egl_render[index], 220);
+		set_tunnel(tunnel + 2, clock, 80, video_scheduler, 12);
+
+		// setup clock tunnel first
+		if (status == 0 && ilclient_setup_tunnel(tunnel + 2, 0, 0) != 0)
+			status = -15;
+		else
+			ilclient_change_component_state(clock, OMX_StateExecuting);
+	}
 
 	if (status == 0)
 		ilclient_change_component_state(video_decode, OMX_StateIdle);
@@ -146,11 +170,8 @@ void *video_decode_test(void* arg) {
 	format.eCompressionFormat = OMX_VIDEO_CodingAVC;
 	format.xFramerate = 30 << 16;
 
-	char buff[256];
-	sprintf(buff, "cam%d", index);
-	int descriptor = open(buff, O_RDONLY);
-	if (descriptor == -1) {
-		printf("failed to open %s\n", buff);
+	source = open_input_source(state, index);
+	if (source == NULL) {
 		exit(-1);
 	}
 
@@ -162,98 +183,126 @@ void *video_decode_test(void* arg) {
 		OMX_BUFFERHEADERTYPE *buf;
 		int port_settings_changed = 0;
 		int first_packet = 1;
+		uint64_t base_timestamp = 0;
 
 		ilclient_change_component_state(video_decode, OMX_StateExecuting);
 
 
 		printf("milestone\n");
 
-		while ((buf = ilclient_get_input_buffer(video_decode, 130, 1)) != NULL) {
-
-// feed data and wait until we get port settings changed
-			unsigned char *dest = buf->pBuffer;
-//         data_len += read(STDIN_FILENO, dest, buf->nAllocLen-data_len);
-			data_len += read(descriptor, dest, buf->nAllocLen - data_len);
-
-			if (port_settings_changed == 0
-					&& ((data_len > 0
-							&& ilclient_remove_event(video_decode,
-									OMX_EventPortSettingsChanged, 131, 0, 0, 1)
-									== 0)
-							|| (data_len == 0
-									&& ilclient_wait_for_event(video_decode,
-											OMX_EventPortSettingsChanged, 131,
-											0, 0, 1,
-											ILCLIENT_EVENT_ERROR
-													| ILCLIENT_PARAMETER_CHANGED,
-											10000) == 0))) {
-				port_settings_changed = 1;
-
-				if (ilclient_setup_tunnel(tunnel, 0, 0) != 0) {
-					status = -7;
+		while (status == 0) {
+			IMAGE_DATA *image_data = input_source_next_frame(source, 0);
+			int image_cur = 0;
+			if (image_data == NULL) {
+				if (source->eos) { // end of stream
 					break;
 				}
+				continue;
+			}
+			if (first_packet) {
+				base_timestamp = image_data->timestamp;
+			}
 
-				ilclient_change_component_state(video_scheduler,
-						OMX_StateExecuting);
-
-				// now setup tunnel to egl_render
-				if (ilclient_setup_tunnel(tunnel + 1, 0, 1000) != 0) {
-					status = -12;
-					break;
+			// one access unit per buffer, split only if it does not fit
+			while (image_cur < image_data->image_size) {
+				buf = ilclient_get_input_buffer(video_decode, 130, 1);
+
+				data_len = MIN(buf->nAllocLen,
+						image_data->image_size - image_cur);
+				memcpy(buf->pBuffer, image_data->image_buff + image_cur,
+						data_len);
+				image_cur += data_len;
+
+				if (port_settings_changed == 0
+						&& ilclient_remove_event(video_decode,
+								OMX_EventPortSettingsChanged, 131, 0, 0, 1)
+								== 0) {
+					port_settings_changed = 1;
+
+					if (state->h264_low_latency) {
+						if (ilclient_setup_tunnel(tunnel, 0, 1000) != 0) {
+							status = -7;
+							break;
+						}
+					} else {
+						if (ilclient_setup_tunnel(tunnel, 0, 0) != 0) {
+							status = -7;
+							break;
+						}
+
+						ilclient_change_component_state(video_scheduler,
+								OMX_StateExecuting);
+
+						// now setup tunnel to egl_render
+						if (ilclient_setup_tunnel(tunnel + 1, 0, 1000) != 0) {
+							status = -12;
+							break;
+						}
+					}
+
+					// Set egl_render to idle
+					ilclient_change_component_state(egl_render[index],
+							OMX_StateIdle);
+
+					// Enable the output port and tell egl_render to use the texture as a buffer
+					//ilclient_enable_port(egl_render, 221); THIS BLOCKS SO CAN'T BE USED
+					if (OMX_SendCommand(ILC_GET_HANDLE(egl_render[index]),
+							OMX_CommandPortEnable, 221, NULL)
+							!= OMX_ErrorNone) {
+						printf("OMX_CommandPortEnable failed.\n");
+						exit(1);
+					}
+
+					if (OMX_UseEGLImage(ILC_GET_HANDLE(egl_render[index]),
+							&eglBuffer[index], 221, NULL, eglImage[index])
+							!= OMX_ErrorNone) {
+						printf("OMX_UseEGLImage failed.\n");
+						exit(1);
+					}
+
+					// Set egl_render to executing
+					ilclient_change_component_state(egl_render[index],
+							OMX_StateExecuting);
+
+					// Request egl_render to write data to the texture buffer
+					if (OMX_FillThisBuffer(ILC_GET_HANDLE(egl_render[index]),
+							eglBuffer[index]) != OMX_ErrorNone) {
+						printf("OMX_FillThisBuffer failed.\n");
+						exit(1);
+					}
 				}
-
-				// Set egl_render to idle
-				ilclient_change_component_state(egl_render[index],
-						OMX_StateIdle);
-
-				// Enable the output port and tell egl_render to use the texture as a buffer
-				//ilclient_enable_port(egl_render, 221); THIS BLOCKS SO CAN'T BE USED
-				if (OMX_SendCommand(ILC_GET_HANDLE(egl_render[index]),
-						OMX_CommandPortEnable, 221, NULL) != OMX_ErrorNone) {
-					printf("OMX_CommandPortEnable failed.\n");
-					exit(1);
+				buf->nFilledLen = data_len;
+
+				buf->nOffset = 0;
+				if (first_packet) {
+					buf->nFlags = OMX_BUFFERFLAG_STARTTIME;
+					first_packet = 0;
+				} else if (image_data->timestamp == 0) {
+					buf->nFlags = OMX_BUFFERFLAG_TIME_UNKNOWN;
+				} else {
+					buf->nFlags = 0;
 				}
+				set_timestamp(buf,
+						(image_data->timestamp > base_timestamp) ?
+								image_data->timestamp - base_timestamp : 0);
 
-				if (OMX_UseEGLImage(ILC_GET_HANDLE(egl_render[index]),
-						&eglBuffer[index], 221, NULL, eglImage[index])
-						!= OMX_ErrorNone) {
-					printf("OMX_UseEGLImage failed.\n");
-					exit(1);
+				if (image_cur >= image_data->image_size) {
+					buf->nFlags |= OMX_BUFFERFLAG_ENDOFFRAME;
 				}
 
-				// Set egl_render to executing
-				ilclient_change_component_state(egl_render[index],
-						OMX_StateExecuting);
-
-				// Request egl_render to write data to the texture buffer
-				if (OMX_FillThisBuffer(ILC_GET_HANDLE(egl_render[index]),
-						eglBuffer[index]) != OMX_ErrorNone) {
-					printf("OMX_FillThisBuffer failed.\n");
-					exit(1);
+				if (OMX_EmptyThisBuffer(ILC_GET_HANDLE(video_decode), buf)
+						!= OMX_ErrorNone) {
+					status = -6;
+					break;
 				}
 			}
-			if (!data_len) {
-				break;
-
-			}
-			buf->nFilledLen = data_len;
-			data_len = 0;
+			release_image(image_data);
 
-			buf->nOffset = 0;
-			if (first_packet) {
-				buf->nFlags = OMX_BUFFERFLAG_STARTTIME;
-				first_packet = 0;
-			} else
-				buf->nFlags = OMX_BUFFERFLAG_TIME_UNKNOWN;
-
-			if (OMX_EmptyThisBuffer(ILC_GET_HANDLE(video_decode), buf)
-					!= OMX_ErrorNone) {
-				status = -6;
-				break;
-			}
+			mrevent_reset(&state->request_frame_event[index]);
+			mrevent_trigger(&state->arrived_frame_event[index]);
 		}
 
+		buf = ilclient_get_input_buffer(video_decode, 130, 1);
 		buf->nFilledLen = 0;
 		buf->nFlags = OMX_BUFFERFLAG_TIME_UNKNOWN | OMX_BUFFERFLAG_EOS;
 
@@ -268,10 +317,14 @@ void *video_decode_test(void* arg) {
 	}
 
 	ilclient_disable_tunnel(tunnel);
-	ilclient_disable_tunnel(tunnel + 1);
-	ilclient_disable_tunnel(tunnel + 2);
+	if (!state->h264_low_latency) {
+		ilclient_disable_tunnel(tunnel + 1);
+		ilclient_disable_tunnel(tunnel + 2);
+	}
 	ilclient_teardown_tunnels(tunnel);
 
+	input_source_close(source);
+
 	ilclient_state_transition(list, OMX_StateIdle);
 	ilclient_state_transition(list, OMX_StateLoaded);
 
@@ -31,22 +31,49 @@
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 
 #include "bcm_host.h"
 #include "ilclient.h"
 #include "picam360_capture.h"
+#include "image_data.h"
+#include "input_source.h"
+#include "jpeg_decoder.h"
+#include "frame_channel.h"
+#include "raw_container.h"
+#include "device.h"
+#include "gl_state.h"
+#include "video_mjpeg.h"
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
 
 static OMX_BUFFERHEADERTYPE* eglBuffer[2] = { };
 static COMPONENT_T* egl_render[2] = { };
 
 static void* eglImage[2] = { };
 
+typedef struct _IMAGE_RECEIVER_DATA {
+	PICAM360CAPTURE_T *state;
+	int index;
+	INPUT_SOURCE_T *source; //live input, opened by the receiver thread
+	FRAME_CHANNEL_T decode_channel;
+	FRAME_CHANNEL_T dump_channel;
+	JPEG_DECODER_T *jpeg_decoder; //software decode, NULL with omx
+} IMAGE_RECEIVER_DATA;
+
+static IMAGE_RECEIVER_DATA *lg_receiver_data[MAX_CAM_NUM] = { };
+
 static void my_fill_buffer_done(void* data, COMPONENT_T* comp) {
 	int index = (int) data;
 
+	if (lg_receiver_data[index] != NULL) {
+		frame_pairing_decoded(&lg_receiver_data[index]->state->pairing,
+				index);
+	}
+
 	if (OMX_FillThisBuffer(ilclient_get_handle(egl_render[index]),
 			eglBuffer[index]) != OMX_ErrorNone) {
 		printf("test  OMX_FillThisBuffer failed in callback\n");
@@ -54,262 +81,210 @@ static void my_fill_buffer_done(void* data, COMPONENT_T* comp) {
 	}
 }
 
-static pthread_mutex_t image_mlock = PTHREAD_MUTEX_INITIALIZER;
-typedef struct _IMAGE_DATA {
-	int refcount;
-	int image_size;
-	unsigned char *image_buff;
-} IMAGE_DATA;
-
-static IMAGE_DATA *create_image(int image_buff_size) {
-	IMAGE_DATA *image_data = malloc(sizeof(IMAGE_DATA) + image_buff_size);
-	memset(image_data, 0, sizeof(IMAGE_DATA));
-	image_data->refcount = 1;
-	image_data->image_buff = (unsigned char*) image_data + sizeof(IMAGE_DATA);
-	image_data->image_size = image_buff_size;
-	return image_data;
-}
-
-static int addref_image(IMAGE_DATA *image_data) {
-	if (image_data == NULL)
-		return 0;
-
-	int ret;
-	pthread_mutex_lock(&image_mlock);
-	if (image_data->refcount == 0) {
-		ret = 0;
-	} else {
-		image_data->refcount++;
-		ret = image_data->refcount;
-	}
-	pthread_mutex_unlock(&image_mlock);
-	return ret;
-}
-
-static int release_image(IMAGE_DATA *image_data) {
-	if (image_data == NULL)
-		return 0;
 
-	int ret;
-	pthread_mutex_lock(&image_mlock);
-	if (--image_data->refcount == 0) {
-		free(image_data);
-		ret = 0;
-	} else {
-		ret = image_data->refcount;
-	}
-	pthread_mutex_unlock(&image_mlock);
-	return ret;
-}
-
-typedef struct _IMAGE_RECEIVER_DATA {
-	PICAM360CAPTURE_T *state;
-	int index;
-	pthread_mutex_t *mlock_p;
-	IMAGE_DATA *image_data;
-} IMAGE_RECEIVER_DATA;
+typedef struct _FILE_PLAYER_T {
+	INPUT_SOURCE_T *source;
+	int seek_id;
+	bool show_once; //deliver one frame even if paused
+	bool stopped; //paused or at the end, the clock restarts on resume
+} FILE_PLAYER_T;
 
 void *image_dumper(void* arg) {
 	IMAGE_RECEIVER_DATA *data = (IMAGE_RECEIVER_DATA*) arg;
-	IMAGE_DATA *image_data = NULL;
-	int descriptor = -1;
+	IMAGE_DATA *image_data;
+	RAW_WRITER_T *writer = NULL;
+	char path[256];
 	while (1) {
 
-		//wait untill image arived
-		if (data->image_data == NULL || data->image_data == image_data) {
-			usleep(1000);
-			continue;
-		}
+		//wait untill image arived, wake up now and then to see stop request
+		image_data = frame_channel_wait(&data->dump_channel, 100000);
 
-		pthread_mutex_lock(data->mlock_p);
-		if (image_data != NULL) { // release memory
-			release_image(image_data);
+		if (writer == NULL && data->state->output_raw) { // start
+			sprintf(path, data->state->output_raw_filepath, data->index);
+			writer = raw_writer_open(path, data->index);
+			if (writer == NULL) {
+				printf("failed to open %s\n", path);
+				data->state->output_raw = false;
+			}
 		}
-		image_data = data->image_data;
-		addref_image(image_data);
-		pthread_mutex_unlock(data->mlock_p);
-
-		if (descriptor >= 0) {
+		if (writer != NULL) {
 			if (!data->state->output_raw) { //end
-				close(descriptor);
-				descriptor = -1;
-				continue;
-			} else { // write
-				write(descriptor, image_data->image_buff,
-						image_data->image_size);
-			}
-		} else if (data->state->output_raw) { // start
-			char buff[256];
-			sprintf(buff, data->state->output_raw_filepath, data->index);
-			descriptor = open(buff, O_WRONLY | O_CREAT, 0666);
-			if (descriptor == -1) {
-				printf("failed to open %s\n", buff);
-				data->state->output_raw = false;
-				continue;
+				raw_writer_close(writer);
+				writer = NULL;
+				frame_channel_flush(&data->dump_channel);
+			} else if (image_data != NULL) { // write
+				if (raw_writer_write(writer, image_data, get_quatanion())
+						!= 0) {
+					printf("failed to write %s\n", path);
+					data->state->output_raw = false;
+				}
 			}
-		} else {
-			usleep(1000);
 		}
+		release_image(image_data);
 	}
 
 	return NULL;
 }
 
+static void receiver_publish(IMAGE_RECEIVER_DATA *data, IMAGE_DATA *image_data) {
+	if (data->state->frame_pairing) { //decoder gets it as part of a set
+		frame_pairing_push(&data->state->pairing, data->index, image_data);
+	} else {
+		frame_channel_publish(&data->decode_channel, image_data);
+	}
+	if (data->state->output_raw) {
+		frame_channel_publish(&data->dump_channel, image_data);
+	}
+
+	mrevent_reset(&data->state->request_frame_event[data->index]);
+	mrevent_trigger(&data->state->arrived_frame_event[data->index]);
+}
+
+static int file_player_open(IMAGE_RECEIVER_DATA *data, FILE_PLAYER_T *player) {
+	PICAM360CAPTURE_T *state = data->state;
+	char buff[256];
+	sprintf(buff, state->input_filepath, data->index);
+	player->source = input_source_file_open(buff,
+			state->image_pool[data->index]);
+	if (player->source == NULL) {
+		return -1;
+	}
+	player->seek_id = state->input_file_seek_id;
+	player->show_once = true;
+	player->stopped = false;
+	if (data->index == 0) {
+		state->input_file_size = player->source->get_frame_num(player->source);
+		state->input_file_cur = 0;
+	}
+	return 0;
+}
+
+//next frame of the loaded file when it is due, NULL otherwise
+static IMAGE_DATA *file_player_next(IMAGE_RECEIVER_DATA *data,
+		FILE_PLAYER_T *player) {
+	PICAM360CAPTURE_T *state = data->state;
+	INPUT_SOURCE_T *source = player->source;
+	int frame_num = source->get_frame_num(source);
+	IMAGE_DATA *image_data;
+
+	if (player->seek_id != state->input_file_seek_id) {
+		player->seek_id = state->input_file_seek_id;
+		if (state->input_file_seek_msec >= 0) {
+			source->seek(source,
+					source->find_frame(source,
+							(uint64_t) state->input_file_seek_msec * 1000));
+		} else {
+			source->seek(source, state->input_file_seek_frame);
+		}
+		player->show_once = true;
+		player->stopped = false;
+	}
+	if (source->get_position(source) >= frame_num
+			|| (state->input_file_pause && !player->show_once)) {
+		player->stopped = true;
+		usleep(10000);
+		return NULL;
+	}
+	if (player->stopped) {
+		source->seek(source, source->get_position(source));
+		player->stopped = false;
+	}
+	if (state->frame_sync) {
+		int res = mrevent_wait(&state->request_frame_event[data->index],
+				1000); //wait 1msec
+		if (res != 0) {
+			return NULL;
+		}
+	}
+	//with frame_sync the renderer sets the pace
+	source->realtime = !state->frame_sync;
+	image_data = input_source_next_frame(source, 10000);
+	if (image_data == NULL) {
+		return NULL;
+	}
+	player->show_once = false;
+	if (data->index == 0) {
+		state->input_file_cur = source->get_position(source);
+	}
+	return image_data;
+}
+
 void *image_receiver(void* arg) {
 	IMAGE_RECEIVER_DATA *data = (IMAGE_RECEIVER_DATA*) arg;
-	int buff_size = 4096;
-	unsigned char *buff = malloc(buff_size);
-	unsigned char *buff_trash = malloc(buff_size);
-	IMAGE_DATA *image_data = NULL;
-	int image_buff_size = 0;
-	int image_buff_cur = 0;
-	int image_start = -1;
-	int data_len = 0;
-	int data_len_total = 0;
-	int marker = 0;
-	int soicount = 0;
-	int camd_fd = -1;
-	int file_fd = -1;
+	PICAM360CAPTURE_T *state = data->state;
+	FILE_PLAYER_T player = { };
+	IMAGE_DATA *image_data;
 
 	while (1) {
-		bool reset = false;
-		if (data->state->input_mode == INPUT_MODE_CAM) {
-			if (camd_fd < 0) {
-				char buff[256];
-				sprintf(buff, "cam%d", data->index);
-				camd_fd = open(buff, O_RDONLY);
-				if (camd_fd == -1) {
-					printf("failed to open %s\n", buff);
+		if (state->input_mode == INPUT_MODE_FILE) {
+			if (player.source == NULL && file_player_open(data, &player) != 0) {
+				state->input_mode = INPUT_MODE_CAM;
+				continue;
+			}
+			if (data->source != NULL) { //keep the live input flowing
+				release_image(input_source_next_frame(data->source, 1000));
+			}
+			image_data = file_player_next(data, &player);
+		} else {
+			if (player.source != NULL) { //back from the file
+				input_source_close(player.source);
+				player.source = NULL;
+			}
+			if (data->source == NULL) {
+				data->source = open_input_source(state, data->index);
+				if (data->source == NULL) {
 					exit(-1);
 				}
-				printf("%s ready\n", buff);
 			}
-			data_len = read(camd_fd, buff, buff_size);
-			if (data_len == 0) {
+			image_data = input_source_next_frame(data->source, 10000);
+			if (image_data == NULL && data->source->eos) {
 				printf("camera input invalid\n");
 				break;
 			}
-		} else if (camd_fd >= 0) {
-			read(camd_fd, buff_trash, buff_size);
 		}
-		if (file_fd >= 0) {
-			if (data->state->input_mode != INPUT_MODE_FILE) { // end
-				close(file_fd);
-				file_fd = -1;
-				data->state->input_mode = INPUT_MODE_CAM;
-				reset = true;
-			} else { //read
-				if (data->state->frame_sync) {
-					int res = mrevent_wait(
-							&data->state->request_frame_event[data->index],
-							1000); //wait 1msec
-					if (res != 0) {
-						continue;
-					}
-				}
+		if (image_data != NULL) {
+			receiver_publish(data, image_data);
+			release_image(image_data);
+		}
+	}
 
-				if (data->state->input_file_cur
-						< data->state->input_file_size) {
-					data_len = read(file_fd, buff, buff_size);
-					data->state->input_file_cur += data_len;
-				}
-			}
-		} else if (data->state->input_mode == INPUT_MODE_FILE) { //start
-			char buff[256];
-			sprintf(buff, data->state->input_filepath, data->index);
-			file_fd = open(buff, O_RDONLY);
-			if (file_fd == -1) {
-				printf("failed to open %s\n", buff);
-				data->state->input_mode = INPUT_MODE_CAM;
-			}
-			struct stat st;
-			stat(buff, &st);
-			data->state->input_file_size = st.st_size;
-			data->state->input_file_cur = 0;
+	return NULL;
+}
 
-			printf("open %s : %ldB\n", buff, (long int) st.st_size);
+//data has to outlive the receiver threads
+static void start_receiver(IMAGE_RECEIVER_DATA *data,
+		PICAM360CAPTURE_T *state, int index) {
+	char name[32];
+	data->state = state;
+	data->index = index;
+	sprintf(name, "cam%d decoder", index);
+	frame_channel_init(&data->decode_channel, name, 1); //latest wins
+	sprintf(name, "cam%d dumper", index);
+	frame_channel_init(&data->dump_channel, name, FRAME_CHANNEL_MAX_DEPTH);
+	frame_pairing_set_output(&state->pairing, index, &data->decode_channel);
+	lg_receiver_data[index] = data;
+
+	pthread_t image_receiver_thread;
+	pthread_create(&image_receiver_thread, NULL, image_receiver, (void*) data);
+
+	pthread_t image_dumper_thread;
+	pthread_create(&image_dumper_thread, NULL, image_dumper, (void*) data);
+}
 
-			reset = true;
-		}
-		if (reset) {
-			image_buff_cur = 0;
-			image_start = -1;
-			data_len_total = 0;
-			marker = 0;
-			soicount = 0;
+void video_mjpeg_print_stats() {
+	for (int i = 0; i < MAX_CAM_NUM; i++) {
+		IMAGE_RECEIVER_DATA *data = lg_receiver_data[i];
+		if (data == NULL) {
 			continue;
 		}
-		for (int i = 0; i < data_len; i++) {
-			if (marker) {
-				marker = 0;
-				if (buff[i] == 0xd8) { //SOI
-					if (soicount == 0) {
-						image_start = data_len_total + (i - 1);
-					}
-					soicount++;
-				}
-				if (buff[i] == 0xd9 && image_start >= 0) { //EOI
-					soicount--;
-					if (soicount == 0) {
-						int image_size = (data_len_total - image_start)
-								+ (i + 1);
-
-						if (image_data == NULL) { //just allocate image buffer
-							image_buff_size = image_size * 2;
-						} else if (image_size > image_buff_size) { //exceed buffer size
-							free(image_data);
-							image_data = NULL;
-							image_buff_size = image_size * 2;
-						} else {
-							if (image_start > data_len_total) { //soi
-								memcpy(image_data->image_buff,
-										buff + (image_start - data_len_total),
-										(i + 1)
-												- (image_start - data_len_total));
-							} else {
-								memcpy(image_data->image_buff + image_buff_cur,
-										buff, i + 1);
-							}
-							image_data->image_size = image_size;
-							pthread_mutex_lock(data->mlock_p);
-							if (data->image_data != NULL) {
-								release_image(data->image_data);
-							}
-							data->image_data = image_data;
-							pthread_mutex_unlock(data->mlock_p);
-
-							mrevent_reset(
-									&data->state->request_frame_event[data->index]);
-							mrevent_trigger(
-									&data->state->arrived_frame_event[data->index]);
-						}
-						image_buff_cur = 0;
-						image_data = create_image(image_buff_size);
-						image_start = -1;
-					}
-				}
-			} else if (buff[i] == 0xff) {
-				marker = 1;
-			}
+		input_source_print_stats(data->source);
+		frame_channel_print_stats(&data->decode_channel);
+		if (data->jpeg_decoder) {
+			jpeg_decoder_print_stats(data->jpeg_decoder);
 		}
-		if (image_data != NULL && image_start >= 0) {
-			if (image_buff_cur + data_len > image_buff_size) { //exceed buffer size
-				free(image_data);
-				image_data = NULL;
-			} else if (image_start > data_len_total) { //soi
-				memcpy(image_data->image_buff,
-						buff + (image_start - data_len_total),
-						data_len - (image_start - data_len_total));
-				image_buff_cur = data_len - (image_start - data_len_total);
-			} else {
-				memcpy(image_data->image_buff + image_buff_cur, buff, data_len);
-				image_buff_cur += data_len;
-			}
-		}
-		data_len_total += data_len;
+		frame_channel_print_stats(&data->dump_channel);
+		image_pool_print_stats(data->state->image_pool[i]);
 	}
-
-	return NULL;
 }
 
 // Modified function prototype to work with pthreads
@@ -389,37 +364,15 @@ void *video_mjpeg_decode(void* arg) {
 
 		printf("milestone\n");
 
-		pthread_mutex_t mlock;
-		pthread_mutex_init(&mlock, NULL);
 		IMAGE_RECEIVER_DATA data = { };
-		data.state = state;
-		data.index = index;
-		data.mlock_p = &mlock;
+		start_receiver(&data, state, index);
 
-		pthread_t image_receiver_thread;
-		pthread_create(&image_receiver_thread, NULL, image_receiver,
-				(void*) &data);
-
-		pthread_t image_dumper_thread;
-		pthread_create(&image_dumper_thread, NULL, image_dumper, (void*) &data);
-
-		IMAGE_DATA *image_data = NULL;
 		while (1) {
 			int image_cur = 0;
 
 			//wait untill image arived
-			if (data.image_data == NULL || data.image_data == image_data) {
-				usleep(1000);
-				continue;
-			}
-
-			pthread_mutex_lock(&mlock);
-			if (image_data != NULL) { // release memory
-				release_image(image_data);
-			}
-			image_data = data.image_data;
-			addref_image(image_data);
-			pthread_mutex_unlock(&mlock);
+			IMAGE_DATA *image_data = frame_channel_wait(&data.decode_channel,
+					0);
 
 			while (image_cur < image_data->image_size) {
 				buf = ilclient_get_input_buffer(video_decode, 130, 1);
@@ -503,6 +456,7 @@ void *video_mjpeg_decode(void* arg) {
 					break;
 				}
 			}
+			release_image(image_data);
 		}
 
 		buf->nFilledLen = 0;
@@ -532,3 +486,92 @@ void *video_mjpeg_decode(void* arg) {
 	return (void *) status;
 }
 
+//called on a decode thread
+static void sw_frame_decoded(void *user, JPEG_DECODER_FRAME_T *frame) {
+	IMAGE_RECEIVER_DATA *data = (IMAGE_RECEIVER_DATA*) user;
+	frame_pairing_decoded(&data->state->pairing, data->index);
+}
+
+void *video_mjpeg_sw_decode(void* arg) {
+	int index = (int) ((void**) arg)[0];
+	PICAM360CAPTURE_T *state = (PICAM360CAPTURE_T *) ((void**) arg)[2];
+	IMAGE_RECEIVER_DATA data = { };
+	char name[32];
+
+	sprintf(name, "cam%d jpeg", index);
+	data.jpeg_decoder = jpeg_decoder_create(name, state->sw_decode_threads,
+			state->sw_decode_slice_threads, sw_frame_decoded, &data);
+	if (data.jpeg_decoder == NULL) {
+		exit(1);
+	}
+	start_receiver(&data, state, index);
+
+	while (1) {
+		//the decoder keeps only the latest frame waiting for a thread
+		IMAGE_DATA *image_data = frame_channel_wait(&data.decode_channel, 0);
+		jpeg_decoder_set_scale(data.jpeg_decoder, state->sw_decode_scale_denom);
+		jpeg_decoder_push(data.jpeg_decoder, image_data);
+		release_image(image_data);
+	}
+
+	return NULL;
+}
+
+//two textures per camera, the renderer samples one while the other is filled
+typedef struct {
+	GLuint texture[2];
+	int width[2];
+	int height[2];
+	GLenum format[2]; //internal format, gles2 uploads only in the same one
+	int front;
+} SW_TEXTURE_T;
+
+static SW_TEXTURE_T lg_sw_texture[MAX_CAM_NUM] = { };
+
+void video_mjpeg_sw_upload(PICAM360CAPTURE_T *state) {
+	for (int i = 0; i < state->num_of_cam; i++) {
+		IMAGE_RECEIVER_DATA *data = lg_receiver_data[i];
+		if (data == NULL || data->jpeg_decoder == NULL) {
+			continue;
+		}
+		JPEG_DECODER_FRAME_T *frame = jpeg_decoder_get_frame(
+				data->jpeg_decoder);
+		if (frame == NULL) {
+			continue;
+		}
+		SW_TEXTURE_T *tex = &lg_sw_texture[i];
+		if (tex->texture[0] == 0) { //the one made by init_textures() first
+			tex->texture[0] = state->cam_texture[i];
+			tex->width[0] = state->cam_width;
+			tex->height[0] = state->cam_height;
+			tex->format[0] = GL_RGBA;
+			glGenTextures(1, &tex->texture[1]);
+			tex->front = 0;
+		}
+		int back = 1 - tex->front;
+		GLenum format = (frame->components == 4) ? GL_RGBA : GL_RGB;
+
+		gl_state_bind_texture(0, tex->texture[back]);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		if (tex->width[back] != frame->width
+				|| tex->height[back] != frame->height
+				|| tex->format[back] != format) {
+			glTexImage2D(GL_TEXTURE_2D, 0, format, frame->width,
+					frame->height, 0, format, GL_UNSIGNED_BYTE, frame->pixels);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			tex->width[back] = frame->width;
+			tex->height[back] = frame->height;
+			tex->format[back] = format;
+		} else {
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame->width,
+					frame->height, format, GL_UNSIGNED_BYTE, frame->pixels);
+		}
+		jpeg_decoder_put_frame(data->jpeg_decoder, frame);
+
+		tex->front = back;
+		state->cam_texture[i] = tex->texture[back];
+	}
+}
@@ -27,4 +27,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #pragma once
 
 
+#include "picam360_capture.h"
+
 void* video_mjpeg_decode(void* arg);
+//decodes on state->sw_decode_threads cpu threads per camera, frames with
+//restart markers also split over sw_decode_slice_threads
+void* video_mjpeg_sw_decode(void* arg);
+//on the gl thread, puts the latest software decoded frames in cam_texture
+void video_mjpeg_sw_upload(PICAM360CAPTURE_T *state);
+void video_mjpeg_print_stats();
@@ -0,0 +1,51 @@
+#include "view_atlas.h"
+#include <string.h>
+
+int view_atlas_layout(VIEW_ATLAS_CELL_T *cells, int num, int max_size,
+		int *width, int *height) {
+	int placed = 0;
+	int x = 0;
+	int row_y = 0;
+	int row_height = 0;
+	*width = 0;
+	*height = 0;
+	for (int i = 0; i < num; i++) {
+		VIEW_ATLAS_CELL_T *cell = &cells[i];
+		cell->placed = false;
+		if (cell->width > max_size) {
+			continue;
+		}
+		if (x + cell->width > max_size) { //next row
+			row_y += row_height;
+			row_height = 0;
+			x = 0;
+		}
+		if (row_y + cell->height > max_size) {
+			continue;
+		}
+		cell->x = x;
+		cell->y = row_y;
+		cell->placed = true;
+		placed++;
+		x += cell->width;
+		if (cell->height > row_height) {
+			row_height = cell->height;
+		}
+		if (x > *width) {
+			*width = x;
+		}
+		if (row_y + row_height > *height) {
+			*height = row_y + row_height;
+		}
+	}
+	return placed;
+}
+
+void view_atlas_copy(const unsigned char *atlas, int atlas_width,
+		const VIEW_ATLAS_CELL_T *cell, unsigned char *image) {
+	int row_bytes = cell->width * 3;
+	const unsigned char *src = atlas + (cell->y * atlas_width + cell->x) * 3;
+	for (int y = 0; y < cell->height; y++) {
+		memcpy(image + y * row_bytes, src + y * atlas_width * 3, row_bytes);
+	}
+}
@@ -0,0 +1,31 @@
+#ifndef _VIEW_ATLAS_H
+#define _VIEW_ATLAS_H
+
+#include <stdbool.h>
+
+#define VIEW_ATLAS_MAX_VIEWS 32
+
+typedef struct {
+	int width;
+	int height;
+	//set by view_atlas_layout(), bottom left in gl coordinates, which is
+	//the first row read back
+	int x;
+	int y;
+	bool placed;
+} VIEW_ATLAS_CELL_T;
+
+/**
+ * Places views side by side in rows of at most max_size, in the order
+ * given, a row as high as its highest view. Views that do not fit below
+ * max_size are not placed. Returns the number placed and the size of the
+ * atlas they take up.
+ */
+int view_atlas_layout(VIEW_ATLAS_CELL_T *cells, int num, int max_size,
+		int *width, int *height);
+
+/* the view in cell out of an atlas read back as RGB, atlas_width wide */
+void view_atlas_copy(const unsigned char *atlas, int atlas_width,
+		const VIEW_ATLAS_CELL_T *cell, unsigned char *image);
+
+#endif
@@ -0,0 +1,112 @@
+#include "window_mesh.h"
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.141592654
+#endif
+
+#define ERROR_SAMPLES 256 //angles from the camera axis
+#define ERROR_ORIENTATIONS 8 //of the edge, meridian to parallel and back
+//radius up to which a camera is looked at: the logo of one camera, the
+//overlap of two
+#define LOGO_R 0.65
+#define BLEND_R 0.53
+
+void window_mesh_extent(float fov, float aspect_ratio, float *tan_x,
+		float *tan_y) {
+	float limit = tan(WINDOW_MESH_MAX_FOV * M_PI / 180.0 / 2);
+	*tan_x = fminf(tan(fov * M_PI / 180.0 / 2), limit);
+	*tan_y = fminf(*tan_x / aspect_ratio, limit);
+}
+
+//r * (z, x) / rho with r = acos(y) / pi, what VERTEX_UV interpolates
+static void fisheye(const double p[3], double q[2]) {
+	double rho = sqrt(p[0] * p[0] + p[2] * p[2]);
+	if (rho < 1e-12) {
+		q[0] = q[1] = 0;
+		return;
+	}
+	double r = acos(fmax(fmin(p[1], 1.0), -1.0)) / M_PI;
+	q[0] = r * p[2] / rho;
+	q[1] = r * p[0] / rho;
+}
+
+double window_mesh_error(int num_of_cam, double edge_rad) {
+	double r_max = (num_of_cam == 1) ? LOGO_R : BLEND_R;
+	double c = cos(edge_rad / 2), s = sin(edge_rad / 2);
+	double max_error = 0;
+	for (int i = 1; i <= ERROR_SAMPLES; i++) {
+		double rho = M_PI * r_max * i / ERROR_SAMPLES;
+		//the midpoint of the edge and the tangents there
+		double a[3] = { 0, cos(rho), sin(rho) };
+		double t1[3] = { 0, -sin(rho), cos(rho) };
+		for (int j = 0; j < ERROR_ORIENTATIONS; j++) {
+			double psi = M_PI * j / ERROR_ORIENTATIONS;
+			double t[3] = { sin(psi), cos(psi) * t1[1], cos(psi) * t1[2] };
+			double p0[3], p1[3];
+			for (int k = 0; k < 3; k++) {
+				p0[k] = a[k] * c - t[k] * s;
+				p1[k] = a[k] * c + t[k] * s;
+			}
+			if (acos(p0[1]) / M_PI > r_max || acos(p1[1]) / M_PI > r_max) {
+				continue;
+			}
+			double q[2], q0[2], q1[2];
+			fisheye(a, q);
+			fisheye(p0, q0);
+			fisheye(p1, q1);
+			double du = q[0] - (q0[0] + q1[0]) / 2;
+			double dv = q[1] - (q0[1] + q1[1]) / 2;
+			max_error = fmax(max_error, sqrt(du * du + dv * dv));
+		}
+	}
+	return max_error;
+}
+
+//longest edge of the grid, the diagonal of a cell at the center
+static double edge_rad(float tan_x, float tan_y, int steps) {
+	double sx = 2 * tan_x / steps, sy = 2 * tan_y / steps;
+	return acos(1.0 / sqrt(1.0 + sx * sx + sy * sy));
+}
+
+int window_mesh_steps(int num_of_cam, float tan_x, float tan_y,
+		double max_error) {
+	if (window_mesh_error(num_of_cam,
+			edge_rad(tan_x, tan_y, WINDOW_MESH_MAX_STEPS)) > max_error) {
+		return 0;
+	}
+	int lo = 1, hi = WINDOW_MESH_MAX_STEPS; //hi is fine, find the least
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (window_mesh_error(num_of_cam, edge_rad(tan_x, tan_y, mid))
+				> max_error) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return hi;
+}
+
+int window_mesh_vertices(int steps) {
+	return 2 * (steps + 1) * steps;
+}
+
+void window_mesh_build(float tan_x, float tan_y, int steps, float *points) {
+	float step_x = 2 * tan_x / steps;
+	float step_y = 2 * tan_y / steps;
+	int idx = 0;
+	for (int i = 0; i < steps; i++) { //x
+		for (int j = 0; j <= steps; j++) { //y
+			for (int k = 0; k < 2; k++) { //this column and the next
+				float x = -tan_x + step_x * (i + k);
+				float y = -tan_y + step_y * j;
+				float len = sqrt(x * x + y * y + 1.0);
+				points[idx++] = x / len;
+				points[idx++] = y / len;
+				points[idx++] = 1.0 / len;
+				points[idx++] = 1.0;
+			}
+		}
+	}
+}
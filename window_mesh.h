@@ -0,0 +1,40 @@
+#ifndef _WINDOW_MESH_H
+#define _WINDOW_MESH_H
+
+#define WINDOW_MESH_MAX_FOV 150.0 //degrees, the patch stops there
+#define WINDOW_MESH_MAX_STEPS 128
+//tan spacing of the fixed 128 step, 150 degree mesh of old, kept for the
+//shaders that map each fragment
+#define WINDOW_MESH_FRAGMENT_STEP (2 * 3.7320508 / 128)
+
+/**
+ * Patches of the unit sphere a WINDOW frame is drawn with. Vertices are a
+ * steps x steps grid, evenly spaced in x / z and y / z out to +-tan_x and
+ * +-tan_y, so the patch covers the frame and no more and its cells are of
+ * even size on the screen. The columns are drawn as one triangle strip.
+ */
+
+/* half extents of the patch of a frame of fov degrees and aspect w / h */
+void window_mesh_extent(float fov, float aspect_ratio, float *tan_x,
+		float *tan_y);
+
+/**
+ * Worst error of the fisheye coordinates of window.vert with VERTEX_UV,
+ * interpolated across a mesh edge of edge_rad radians anywhere on the
+ * sphere, in texture widths of a camera of horizon_r 1.
+ */
+double window_mesh_error(int num_of_cam, double edge_rad);
+
+/**
+ * Fewest steps that keep window_mesh_error() under max_error, 0 if more
+ * than WINDOW_MESH_MAX_STEPS would be needed.
+ */
+int window_mesh_steps(int num_of_cam, float tan_x, float tan_y,
+		double max_error);
+
+/* vertices of a patch, 4 floats each */
+int window_mesh_vertices(int steps);
+
+void window_mesh_build(float tan_x, float tan_y, int steps, float *points);
+
+#endif